@@ -1,44 +1,475 @@
 #!/usr/bin/env python3
-# laptop_server.py - simple multi-client TCP server that prints and saves received bytes
+# laptop_server.py - multi-client TCP server for the relay: parses the frame stream from each
+# primary, records every node's pictures (recorder.py) and logs a periodic per-connection summary
+#
+# one thread serves every primary through a selectors loop: each connection receives straight into
+# its parser's preallocated buffer (recv_into, no per-chunk allocation) and gets one read per
+# wakeup so a busy relay cannot starve the others. while the recorder is behind, reading stops on
+# all connections and tcp flow control slows the primaries instead of pictures being dropped.
 
-import socketserver
 import argparse
 import datetime
+import json
+import os
+import selectors
+import socket
 import sys
+import threading
+import time
+from collections import Counter, defaultdict, deque
 
-class Handler(socketserver.BaseRequestHandler):
-    def handle(self):
-        peer = f"{self.client_address[0]}:{self.client_address[1]}"
-        print(f"Connected: {peer}")
+from fleet_summary import FleetTracker, alert_names, format_status
+from jpeg_slices import SliceAssembler, parse_slice
+from recorder import FORMATS, Recorder
+from swarm_proto import (ALL_NODES, CMD_GET_LATEST, FLAG_CACHED, JPEG_HEADER, FrameParser, KNOWN_TYPES,
+                         MSG_FLEET_SUMMARY, MSG_JPEG_FRAME, MSG_JPEG_SLICE, MSG_MOSAIC, TILE_FRESH, TILE_STALE,
+                         encode_command, parse_mosaic)
+
+TILE_MARK = {TILE_FRESH: "+", TILE_STALE: "~"}  # anything else: empty tile
+RECV_SIZE = 256 * 1024       # free buffer space offered to each recv_into
+SOCK_RCVBUF = 1024 * 1024    # kernel receive buffer per connection
+LISTEN_BACKLOG = 128         # room for a reconnect storm
+PAUSED_POLL_S = 0.005        # how often a paused loop checks whether the recorder caught up
+RECORDED_SEQS = 64           # seqs of each node's last recorded pictures, to spot cached repeats
+
+
+def now_ts():
+    return datetime.datetime.now().isoformat(timespec='seconds')
+
+
+class IngestStats:
+    """counters for one connection, printed as one summary line every `interval` seconds"""
+
+    def __init__(self, peer, interval):
+        self.peer = peer
+        self.interval = interval
+        self.window_start = time.monotonic()
+        self.reset()
+
+    def reset(self):
+        self.bytes = 0
+        self.types = Counter()
+        self.pictures = Counter()            # node -> pictures
+        self.picture_bytes = defaultdict(int)
+        self.concealed = 0
+
+    def picture(self, node, size):
+        self.pictures[node] += 1
+        self.picture_bytes[node] += size
+
+    def maybe_log(self, parser, recorder):
+        now = time.monotonic()
+        dt = now - self.window_start
+        if dt < self.interval:
+            return
+        types = " ".join(f"{KNOWN_TYPES[t]} {n}" for t, n in sorted(self.types.items())) or "no frames"
+        nodes = "  ".join(f"node {n}: {c / dt:.1f} fps {self.picture_bytes[n] / dt / 1e3:.0f} KB/s"
+                          for n, c in sorted(self.pictures.items()))
+        extra = f", {self.concealed} intervals concealed" if self.concealed else ""
+        print(f"[{now_ts()}] {self.peer} {self.bytes / dt / 1e6:.2f} MB/s, {types}{extra}"
+              + (f" | {nodes}" if nodes else "")
+              + f" | crc errors {parser.crc_errors}, resyncs {parser.resyncs}, recorder dropped {recorder.dropped}")
+        self.window_start = now
+        self.reset()
+
+
+class Connection:
+    """one primary: its socket, frame parser and per-stream state"""
+
+    def __init__(self, sock, peer, server, relay):
+        self.sock = sock
+        self.peer = peer
+        self.server = server
+        self.relay = relay    # which primary this is in the mission recording
+        self.parser = FrameParser()
+        self.stats = IngestStats(peer, server.log_interval)
+        self.assemblers = {}  # node -> SliceAssembler
+        self.slice_seq = {}   # node -> seq of the headers slice of the picture being assembled
+        self.recorded = defaultdict(lambda: deque(maxlen=RECORDED_SEQS))  # node -> seqs recorded
+        self.fleet = FleetTracker()
+        self.alerts = {}      # node -> alert bits last printed
+        self.out = bytearray()  # commands the socket has not taken yet
+        self.events = 0       # what the selector currently waits for
+        self.now = 0.0        # when the frames being routed were read (with --metrics)
+
+    def readable(self):
+        """one recv_into; False once the primary has gone"""
+        recorder = self.server.recorder
+        with self.parser.writable(RECV_SIZE) as mv:
+            try:
+                n = self.sock.recv_into(mv)
+            except (BlockingIOError, InterruptedError):
+                return True
+            except OSError:
+                return False
+            if n and recorder.raw_enabled:
+                recorder.raw(bytes(mv[:n]))
+        if not n:
+            return False
+        self.stats.bytes += n
+        frames = self.parser.filled(n)
+        recorder.frames(time.time_ns() // 1000, frames, self.relay)
+        metrics = self.server.metrics
+        if metrics:
+            self.now = time.monotonic()
+            metrics.read(self.peer, n, frames, self.now)
+        for frame in frames:
+            self.stats.types[frame.type] += 1
+            try:
+                self.route(frame, recorder)
+            except Exception as e:  # one bad payload must not take the connection down
+                print(f"{self.peer} {KNOWN_TYPES[frame.type]} frame from node {frame.node}: {e}")
+        self.stats.maybe_log(self.parser, recorder)
+        return True
+
+    def writable(self):
+        try:
+            del self.out[:self.sock.send(self.out)]
+        except (BlockingIOError, InterruptedError):
+            pass
+        except OSError:
+            return False
+        return True
+
+    def picture(self, node, capture_ms, jpeg, recorder, seq=None, cached=False):
+        # a complete picture: recorded, then offered to whatever looks at pictures. a cached one
+        # (asked for, or replayed when the base connects) is recorded unless it already was live
+        if not (cached and seq in self.recorded[node]):
+            recorder.picture(node, capture_ms, jpeg)
+            if seq is not None:
+                self.recorded[node].append(seq)
+        self.stats.picture(node, len(jpeg))
+        if self.server.metrics:
+            self.server.metrics.picture(node, len(jpeg), capture_ms, self.now)
+        for sink in self.server.sinks:
+            sink.submit(node, capture_ms, jpeg)
+
+    def route(self, frame, recorder):
+        stats = self.stats
+        if frame.type == MSG_JPEG_FRAME:
+            capture_ms, _w, _h = JPEG_HEADER.unpack_from(frame.payload)
+            jpeg = memoryview(frame.payload)[JPEG_HEADER.size:]
+            cached = bool(frame.flags & FLAG_CACHED)
+            if cached:
+                print(f"[{now_ts()}] {self.peer} node {frame.node} cached picture, {len(jpeg)} bytes")
+            self.picture(frame.node, capture_ms, jpeg, recorder, frame.seq, cached)
+        elif frame.type == MSG_JPEG_SLICE:
+            asm = self.assemblers.setdefault(frame.node, SliceAssembler())
+            s = parse_slice(frame)
+            # the primary caches a sliced picture under the seq of its headers slice
+            for pic in asm.add(s):
+                self.picture(frame.node, pic.capture_ms, pic.jpeg, recorder, self.slice_seq.get(frame.node))
+                stats.concealed += pic.concealed
+            if s.headers:
+                self.slice_seq[frame.node] = frame.seq
+        elif frame.type == MSG_MOSAIC:
+            recorder.mosaic(parse_mosaic(frame).jpeg)
+        elif frame.type == MSG_FLEET_SUMMARY:
+            # the whole fleet once a minute, otherwise only nodes whose alerts changed
+            _capture_ms, full, rows = self.fleet.feed(frame)
+            for st in rows:
+                if full or self.alerts.get(st.node, 0) != st.alerts:
+                    cleared = self.alerts.get(st.node, 0) & ~st.alerts
+                    note = f"  cleared {' '.join(alert_names(cleared))}" if cleared and not full else ""
+                    print(f"[{now_ts()}] {self.peer} {'fleet ' if full else 'alert '}{format_status(st)}{note}")
+                self.alerts[st.node] = st.alerts
+
+
+class IngestServer:
+    """accepts primaries and serves them all from serve_forever() on the calling thread"""
+
+    def __init__(self, host, port, recorder, log_interval, sinks=(), metrics=None):
+        self.recorder = recorder
+        self.metrics = metrics
+        self.sinks = list(sinks)  # analysis pool, viewer: submit(node, capture_ms, jpeg), never blocking
+        self.log_interval = log_interval
+        self.sel = selectors.DefaultSelector()
+        self.conns = set()
+        self.paused = False
+        self.pauses = 0
+        self._stopping = False
+        self.listener = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.listener.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.listener.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, SOCK_RCVBUF)  # inherited on accept
+        self.listener.bind((host, port))
+        self.listener.listen(LISTEN_BACKLOG)
+        self.listener.setblocking(False)
+        self.sel.register(self.listener, selectors.EVENT_READ, self._accept)
+        # the console thread hands commands over through this pair so only the loop touches sockets
+        self.commands = deque()
+        self._wake_r, self._wake_w = socket.socketpair()
+        self._wake_r.setblocking(False)
+        self.sel.register(self._wake_r, selectors.EVENT_READ, self._run_commands)
+
+    def send_command(self, op, node):
+        """thread-safe: queue a command for every connected primary"""
+        self.commands.append(encode_command(op, node))
+        self._wake_w.send(b"\0")
+
+    def serve_forever(self):
+        while not self._stopping:
+            for key, mask in self.sel.select(PAUSED_POLL_S if self.paused else None):
+                if not isinstance(key.data, Connection):
+                    key.data()
+                elif self.paused and mask == selectors.EVENT_READ:
+                    continue  # still readable after the pause; the data waits in the kernel
+                else:
+                    self._service(key.data, mask)
+            self._backpressure()
+
+    def stop(self):
+        """thread-safe: serve_forever() returns"""
+        self._stopping = True
+        self._wake_w.send(b"\0")
+
+    def close(self):
+        for c in list(self.conns):
+            self._drop(c)
+        self.sel.close()
+        self.listener.close()
+        self._wake_r.close()
+        self._wake_w.close()
+
+    def _accept(self):
+        while True:
+            try:
+                sock, addr = self.listener.accept()
+            except (BlockingIOError, InterruptedError):
+                return
+            except OSError as e:  # e.g. out of descriptors; the rest stay in the backlog
+                print("Accept failed:", e)
+                return
+            sock.setblocking(False)
+            sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            # the lowest number no connected primary has, so one that reconnects usually keeps its own
+            used = {c.relay for c in self.conns}
+            relay = min(set(range(len(used) + 1)) - used)
+            c = Connection(sock, f"{addr[0]}:{addr[1]}", self, relay)
+            self.conns.add(c)
+            if self.metrics:
+                self.metrics.attach(c.peer, c.parser)
+            self._watch(c)
+            print(f"Connected: {c.peer} (relay {relay})")
+
+    def _service(self, c, mask):
+        ok = True
+        if mask & selectors.EVENT_READ and not self.paused:
+            ok = c.readable()
+        if ok and mask & selectors.EVENT_WRITE:
+            ok = c.writable()
+        if ok:
+            self._watch(c)
+        else:
+            self._drop(c)
+
+    def _watch(self, c):
+        events = (0 if self.paused else selectors.EVENT_READ) | (selectors.EVENT_WRITE if c.out else 0)
+        if events == c.events:
+            return
+        if not c.events:
+            self.sel.register(c.sock, events, c)
+        elif not events:
+            self.sel.unregister(c.sock)
+        else:
+            self.sel.modify(c.sock, events, c)
+        c.events = events
+
+    def _drop(self, c):
+        if c.events:
+            self.sel.unregister(c.sock)
+        self.conns.discard(c)
+        if self.metrics:
+            self.metrics.detach(c.peer)
+        c.sock.close()
+        p = c.parser
+        print(f"Disconnected: {c.peer} ({p.frames} frames, {p.crc_errors} crc errors, "
+              f"recorder dropped {self.recorder.dropped} so far)")
+
+    def _backpressure(self):
+        if self.paused and self.recorder.caught_up():
+            self.paused = False
+        elif not self.paused and self.recorder.behind():
+            self.paused = True
+            self.pauses += 1
+        else:
+            return
+        for c in self.conns:
+            self._watch(c)
+
+    def _run_commands(self):
         try:
-            while True:
-                data = self.request.recv(4096)
-                if not data:
-                    break
-                ts = datetime.datetime.now().isoformat(timespec='seconds')
-                print(f"[{ts}] {peer} {len(data)} bytes -> {data.hex()}")
-                with open("received.bin", "ab") as f:
-                    f.write(data)
-        except Exception as e:
-            print("Handler error:", e)
-        finally:
-            print(f"Disconnected: {peer}")
+            while self._wake_r.recv(4096):
+                pass
+        except (BlockingIOError, InterruptedError):
+            pass
+        while self.commands:
+            cmd = self.commands.popleft()
+            for c in self.conns:
+                c.out += cmd
+                if not c.writable():
+                    continue  # the read side notices the hang-up
+                self._watch(c)
+
+
+class EventLog:
+    """analysis results as json lines; prints when a drone's detection starts or ends"""
+
+    def __init__(self, path):
+        self.f = open(path, "a", buffering=1)  # line buffered, so tail -f follows it
+        self.detected = {}  # node -> last state
+
+    def __call__(self, event):  # the analysis pool's collector thread
+        event["time"] = now_ts()
+        self.f.write(json.dumps(event) + "\n")
+        node, now = event["node"], bool(event.get("detected"))
+        if now != self.detected.get(node, False):
+            where = f" at {event['bbox']}" if now and "bbox" in event else ""
+            print(f"[{event['time']}] node {node} {'DETECTION' if now else 'detection ended'}{where}")
+        self.detected[node] = now
+
+    def close(self):
+        self.f.close()
+
+
+class ConfirmLog:
+    """confirm.py results as json lines; prints a target's views and when it is confirmed"""
+
+    def __init__(self, path):
+        self.f = open(path, "a", buffering=1)
+        self.confirmed = set()
+
+    def __call__(self, result):  # the confirm thread
+        result["time"] = now_ts()
+        self.f.write(json.dumps(result) + "\n")
+        tid = result["target"]
+        if result["confirmed"] and tid not in self.confirmed:
+            self.confirmed.add(tid)
+            print(f"[{result['time']}] target {tid} CONFIRMED by nodes {result['nodes']} "
+                  f"(score {result['score']}, {result['fused']})")
+        elif not result["confirmed"]:
+            print(f"[{result['time']}] target {tid}: view from node {result['node']} "
+                  f"({result['inliers']} inliers, overlap {result['overlap']}, score {result['score']}, "
+                  f"{result['add_ms']} ms)")
+
+    def close(self):
+        self.f.close()
+
+
+def console(server):
+    """'latest <node>' or 'latest' asks every primary for its cached latest picture;
+    'metrics' prints the rolling statistics (with --metrics)"""
+    for line in sys.stdin:
+        words = line.split()
+        if not words:
+            continue
+        if words == ["metrics"] and server.metrics:
+            from metrics import format_summary
+            print(format_summary(server.metrics.snapshot()))
+            continue
+        if words[0] != "latest" or (len(words) > 1 and not words[1].isdigit()):
+            print("commands: latest [node]" + (", metrics" if server.metrics else ""))
+            continue
+        node = int(words[1]) if len(words) > 1 else ALL_NODES
+        server.send_command(CMD_GET_LATEST, node)
+        print(f"Requested latest picture of {'all nodes' if node == ALL_NODES else f'node {node}'} "
+              f"from {len(server.conns)} primaries")
+
 
 def main():
     p = argparse.ArgumentParser(description="Laptop TCP server for ESP relay")
     p.add_argument("--host", default="0.0.0.0", help="Host/IP to bind (use your laptop AP IP)")
     p.add_argument("--port", type=int, default=9000, help="Port to listen on")
+    p.add_argument("--record-dir", default="recordings", help="Where per-node recordings go")
+    p.add_argument("--format", choices=FORMATS, default="mjpeg",
+                   help="mjpeg: one node<N>.mjpeg per node; jpeg: node<N>/ directories of pictures")
+    p.add_argument("--raw", action="store_true", help="Also keep the undecoded stream in received.bin")
+    p.add_argument("--mission", nargs="?", const="", metavar="DIR",
+                   help="Also record every frame, indexed for mission_play.py (default DIR: "
+                        "<record-dir>/mission-<date>-<time>)")
+    p.add_argument("--log-interval", type=float, default=5.0, help="Seconds between summary lines")
+    p.add_argument("--metrics", type=int, nargs="?", const=9100, metavar="PORT",
+                   help="Keep rolling per-drone/per-relay statistics, as json on "
+                        "http://127.0.0.1:PORT/metrics (default 9100) and 'metrics' on the console")
+    p.add_argument("--analyze", type=int, default=0, metavar="WORKERS",
+                   help="Analyse pictures on this many worker processes, events to <record-dir>/events.jsonl")
+    p.add_argument("--analyzer", help="module:function taking a jpeg, returning a dict "
+                                      "(default analysis:detect_hotspots)")
+    p.add_argument("--confirm", action="store_true",
+                   help="Register detections from several drones into a fused view and score per target, "
+                        "to <record-dir>/confirm/ (needs --analyze and opencv)")
+    p.add_argument("--view", action="store_true", help="Show every feed in a window (click a tile for full size)")
     args = p.parse_args()
+    if args.confirm and not args.analyze:
+        p.error("--confirm works on --analyze detections")
 
-    server = socketserver.ThreadingTCPServer((args.host, args.port), Handler)
-    server.allow_reuse_address = True
-    print(f"Listening on {args.host}:{args.port}  -> output file: received.bin")
+    mission = args.mission
+    if mission == "":
+        mission = os.path.join(args.record_dir, datetime.datetime.now().strftime("mission-%Y%m%d-%H%M%S"))
+    recorder = Recorder(args.record_dir, args.format, raw=args.raw, mission=mission)
+    analysis = events = confirm = confirmations = None
+    if args.analyze:
+        from analysis import DEFAULT_ANALYZER, AnalysisPool  # numpy and PIL only when asked for
+        os.makedirs(args.record_dir, exist_ok=True)
+        events = EventLog(os.path.join(args.record_dir, "events.jsonl"))
+        on_event = events
+        if args.confirm:
+            from confirm import ConfirmPipeline  # opencv only when asked for
+            confirmations = ConfirmLog(os.path.join(args.record_dir, "confirmations.jsonl"))
+            confirm = ConfirmPipeline(os.path.join(args.record_dir, "confirm"), on_result=confirmations)
+            on_event = lambda e: (events(e), confirm.event(e))
+        analysis = AnalysisPool(args.analyze, on_event=on_event, analyzer=args.analyzer or DEFAULT_ANALYZER)
+    grid = app = None
+    if args.view:
+        from viewer import FeedGrid, ViewerApp  # PIL and tk only when asked for
+        grid = FeedGrid()
+        try:
+            app = ViewerApp(grid, title=f"swarm feeds :{args.port}")
+        except RuntimeError as e:
+            print(f"{e}; running without --view")
+            grid = None
+    metrics = None
+    if args.metrics is not None:
+        from metrics import Metrics, format_summary  # numpy only when asked for
+        metrics = Metrics()
+        print(f"Metrics on http://127.0.0.1:{metrics.serve('127.0.0.1', args.metrics)}/metrics")
+    server = IngestServer(args.host, args.port, recorder, args.log_interval,
+                          [x for x in (confirm, analysis, grid) if x],  # confirm holds a picture before it is analysed
+                          metrics)
+    if app:
+        # the focused drone's cached picture comes back as a FLAG_CACHED frame, through the sinks
+        app.on_focus = lambda node: server.send_command(CMD_GET_LATEST, node)
+    print(f"Listening on {args.host}:{args.port}  -> recording {args.format} to {args.record_dir}/"
+          + (f", every frame to {mission}/" if mission else ""))
+    print("Type 'latest [node]' to fetch cached pictures from the primary"
+          + (", 'metrics' for the statistics" if metrics else ""))
+    threading.Thread(target=console, args=(server,), daemon=True).start()
     try:
+        if app:
+            # tk wants the main thread; the receive loop moves to its own
+            loop = threading.Thread(target=server.serve_forever, name="ingest")
+            loop.start()
+            try:
+                app.run()
+            finally:
+                server.stop()
+                loop.join()
+            raise KeyboardInterrupt  # window closed: shut down as for ctrl-c
         server.serve_forever()
     except KeyboardInterrupt:
-        print("\nShutting down")
-        server.shutdown()
-        server.server_close()
+        print(f"\nShutting down (reading paused {server.pauses} times for the recorder)")
+        if metrics:
+            print(format_summary(metrics.snapshot()))
+        server.close()
+        recorder.close()  # flushes what is still queued
+        if analysis:
+            analysis.close()
+            events.close()
+            print(f"Analysed {analysis.analysed} of {analysis.submitted} pictures ({analysis.shed} shed for newer ones)")
+        if confirm:
+            confirm.close()
+            confirmations.close()
+            print(f"Confirmed {len(confirmations.confirmed)} of {confirm.next_id - 1} targets "
+                  f"({confirm.dropped} detections not registered)")
         sys.exit(0)
 
 if __name__ == "__main__":
@@ -0,0 +1,165 @@
+# analysis.py - per-picture analysis on a process pool, fed through shared memory
+#
+# the ingest side copies each picture once into a slot of a shared memory arena and queues only
+# (slot, length, node, capture_ms) to the workers, which analyse it in place: no pickling of
+# picture bytes, no GIL shared with the receive loop. at most two tasks per worker are queued;
+# beyond that each drone keeps one pending picture and a newer one replaces it (latest wins), so
+# under overload the pool analyses the freshest picture of every drone instead of falling behind.
+# every result is published to `on_event` from the pool's collector thread.
+#
+# the analyser is any function jpeg (buffer) -> dict, named as "module:function"; the default
+# flags warm-coloured hot spots (a person or fire on a thermal palette) in a 1/4 scale decode.
+
+import importlib
+import io
+import multiprocessing as mp
+import signal
+import threading
+import time
+from collections import OrderedDict, namedtuple
+from multiprocessing.shared_memory import SharedMemory
+
+import numpy as np
+from PIL import Image
+
+SLOT_BYTES = 256 * 1024
+DEFAULT_ANALYZER = "analysis:detect_hotspots"
+HOT_DELTA = 60            # red above the green/blue mean
+HOT_MIN_RED = 160
+HOT_FRACTION = 0.002      # share of hot pixels that counts as a detection
+
+Pending = namedtuple("Pending", "slot length capture_ms submitted")
+
+
+def detect_hotspots(jpeg):
+    img = Image.open(io.BytesIO(jpeg))
+    full = img.size
+    img.draft("RGB", (full[0] // 4, full[1] // 4))  # DCT-domain downscale while decoding
+    a = np.asarray(img.convert("RGB"), dtype=np.int16)
+    r, g, b = a[..., 0], a[..., 1], a[..., 2]
+    hot = (r - (g + b) // 2 > HOT_DELTA) & (r > HOT_MIN_RED)
+    frac = float(hot.mean())
+    out = {"hot_fraction": round(frac, 5), "luma": round(float((r * 3 + g * 6 + b).mean() / 10), 1),
+           "detected": frac >= HOT_FRACTION}
+    if out["detected"]:
+        ys, xs = np.nonzero(hot)
+        sx, sy = full[0] / a.shape[1], full[1] / a.shape[0]
+        out["bbox"] = [int(xs.min() * sx), int(ys.min() * sy), int((xs.max() + 1) * sx), int((ys.max() + 1) * sy)]
+    return out
+
+
+def _load(name):
+    module, _, fn = name.partition(":")
+    return getattr(importlib.import_module(module), fn)
+
+
+def _worker(shm_name, tasks, results, analyzer):
+    signal.signal(signal.SIGINT, signal.SIG_IGN)  # ctrl-c on the server reaches the group; close() stops us
+    shm = SharedMemory(name=shm_name)  # spawned workers share the pool's resource tracker
+    fn = _load(analyzer)
+    while True:
+        task = tasks.get()
+        if task is None:
+            break
+        slot, length, node, capture_ms, submitted = task
+        view = shm.buf[slot * SLOT_BYTES:slot * SLOT_BYTES + length]
+        t0 = time.perf_counter()
+        try:
+            result = fn(view)
+        except Exception as e:  # a broken picture is a result, not a dead worker
+            result = {"error": str(e)}
+        view.release()
+        results.put((slot, node, capture_ms, submitted, time.perf_counter() - t0, result))
+    shm.close()
+
+
+class AnalysisPool:
+    def __init__(self, workers=None, on_event=None, analyzer=DEFAULT_ANALYZER, slots=None):
+        self.workers = workers or mp.cpu_count()
+        self.max_queued = 2 * self.workers
+        nslots = slots or 4 * self.workers + 16
+        self.on_event = on_event
+        self.shm = SharedMemory(create=True, size=nslots * SLOT_BYTES)
+        self.free = list(range(nslots))
+        self.pending = OrderedDict()  # node -> Pending, oldest first
+        self.queued = 0
+        self.lock = threading.Lock()
+        self.submitted = 0
+        self.analysed = 0
+        self.shed = 0       # replaced by a newer picture of the same drone, or no slot free
+        self.too_big = 0
+        self.latency = []   # submit -> result seconds, since the last take_latency()
+        self.busy_s = 0.0   # summed analyser time
+        ctx = mp.get_context("spawn")  # the server has threads running; do not fork them
+        self.tasks = ctx.Queue()
+        self.results = ctx.Queue()
+        self.procs = [ctx.Process(target=_worker, args=(self.shm.name, self.tasks, self.results, analyzer),
+                                  daemon=True) for _ in range(self.workers)]
+        for p in self.procs:
+            p.start()
+        self.collector = threading.Thread(target=self._collect, name="analysis", daemon=True)
+        self.collector.start()
+
+    def submit(self, node, capture_ms, jpeg):
+        """queue a picture for analysis; never blocks. False if it was shed straight away"""
+        n = len(jpeg)
+        with self.lock:
+            self.submitted += 1
+            if n > SLOT_BYTES:
+                self.too_big += 1
+                return False
+            old = self.pending.pop(node, None)
+            if old is not None:
+                slot = old.slot  # not handed out yet: overwrite in place
+                self.shed += 1
+            elif self.free:
+                slot = self.free.pop()
+            else:
+                self.shed += 1
+                return False
+            self.shm.buf[slot * SLOT_BYTES:slot * SLOT_BYTES + n] = jpeg
+            self.pending[node] = Pending(slot, n, capture_ms, time.monotonic())
+            self._dispatch()
+        return True
+
+    def _dispatch(self):
+        # lock held; oldest waiting drone first
+        while self.pending and self.queued < self.max_queued:
+            node, p = self.pending.popitem(last=False)
+            self.tasks.put((p.slot, p.length, node, p.capture_ms, p.submitted))
+            self.queued += 1
+
+    def _collect(self):
+        while True:
+            item = self.results.get()
+            if item is None:
+                return
+            slot, node, capture_ms, submitted, analyse_s, result = item
+            now = time.monotonic()
+            with self.lock:
+                self.free.append(slot)
+                self.queued -= 1
+                self.analysed += 1
+                self.busy_s += analyse_s
+                self.latency.append(now - submitted)
+                self._dispatch()
+            if self.on_event:
+                self.on_event(dict(node=node, capture_ms=capture_ms, latency_ms=round((now - submitted) * 1e3, 1),
+                                   analyse_ms=round(analyse_s * 1e3, 1), **result))
+
+    def take_latency(self):
+        with self.lock:
+            lat, self.latency = self.latency, []
+        return lat
+
+    def close(self):
+        for _ in self.procs:
+            self.tasks.put(None)
+        for p in self.procs:
+            p.join(timeout=5)
+            if p.is_alive():
+                p.terminate()
+        self.results.put(None)
+        self.collector.join()
+        self.shm.close()
+        self.shm.unlink()
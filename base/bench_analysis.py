@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+# bench_analysis.py - pictures analysed per second by analysis.py's pool against worker count
+#
+# `--drones` feeds each submit a ~25 KB 640x480 picture at `--fps` for `--seconds`, all from one
+# thread as the receive loop would. for each worker count it prints what was analysed, what was
+# shed (latest-wins replacement under overload) and the submit -> result latency. the offered
+# load is drones x fps; once the pool saturates, analysed/s is its capacity.
+#
+#   python3 bench_analysis.py --workers 1 2 4 8 --drones 24 --fps 10
+
+import argparse
+import io
+import os
+import time
+
+from PIL import Image, ImageDraw
+
+from analysis import AnalysisPool
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+
+def make_pictures(image):
+    src = Image.open(image).convert("RGB").resize((640 + 64, 480 + 48))
+    out = []
+    for i in range(8):
+        pic = src.crop((i * 8, i * 6, i * 8 + 640, i * 6 + 480))
+        if i % 4 == 0:  # some pictures with a hot spot to find
+            ImageDraw.Draw(pic).ellipse((300 + i * 10, 200, 340 + i * 10, 260), fill=(250, 60, 30))
+        buf = io.BytesIO()
+        pic.save(buf, "JPEG", quality=80)
+        out.append(buf.getvalue())
+    return out
+
+
+def percentile(values, q):
+    if not values:
+        return 0.0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(q * len(values)))]
+
+
+def main():
+    p = argparse.ArgumentParser(description="Analysis pool throughput benchmark")
+    p.add_argument("--workers", type=int, nargs="+", default=[1, 2, 4])
+    p.add_argument("--drones", type=int, default=24)
+    p.add_argument("--fps", type=float, default=10)
+    p.add_argument("--seconds", type=float, default=10)
+    p.add_argument("--image", default=os.path.join(HERE, "..", "media", "swarm.jpg"))
+    args = p.parse_args()
+
+    pictures = make_pictures(args.image)
+    print(f"{os.cpu_count()} cpus; offered {args.drones} drones x {args.fps:g} fps = {args.drones * args.fps:.0f} pictures/s")
+    print(f"{'workers':>7} {'analysed/s':>10} {'shed':>6} {'detections':>10} {'lat p50':>8} {'lat p99':>8} {'ms/picture':>10}")
+    for workers in args.workers:
+        detections = [0]
+        pool = AnalysisPool(workers, on_event=lambda e: detections.__setitem__(0, detections[0] + bool(e.get("detected"))))
+        time.sleep(1.0)  # workers importing
+        period = 1.0 / (args.drones * args.fps)
+        k = 0
+        t0 = time.monotonic()
+        end = t0 + args.seconds
+        while True:
+            now = time.monotonic()
+            if now >= end:
+                break
+            due = t0 + k * period
+            if due > now:
+                time.sleep(due - now)
+            pool.submit(k % args.drones, int((due - t0) * 1e3), pictures[k % len(pictures)])
+            k += 1
+        analysed0 = pool.analysed
+        elapsed = time.monotonic() - t0
+        lat = pool.take_latency()
+        busy = pool.busy_s
+        pool.close()
+        print(f"{workers:7d} {analysed0 / elapsed:10.1f} {pool.shed:6d} {detections[0]:10d} "
+              f"{percentile(lat, 0.5) * 1e3:6.0f}ms {percentile(lat, 0.99) * 1e3:6.0f}ms "
+              f"{busy / max(pool.analysed, 1) * 1e3:10.1f}")
+
+
+if __name__ == "__main__":
+    main()
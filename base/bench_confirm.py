@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+# bench_confirm.py - cost of confirming a target from several drones' views (confirm.py)
+#
+# renders `--views` pictures of the same scene with a hot target in it, each through a random
+# perspective as a different drone would see it, and adds them one by one to a confirm.Target.
+# for every addition it prints the registration time, inliers, the target's score and how far
+# the estimated homography puts the picture corners from the true ones. it then times the same
+# additions done by recomputing the whole set each time (every view's features extracted again
+# and registered onto the anchor), which is what the incremental Target avoids.
+#
+#   python3 bench_confirm.py --views 8
+#   python3 bench_confirm.py --views 8 --warp 0.12 --seed 3
+
+import argparse
+import io
+import os
+import random
+import tempfile
+import time
+
+import cv2
+import numpy as np
+from PIL import Image
+
+from analysis import detect_hotspots
+from confirm import WORK_WIDTH, Target, prepare
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+SIZE = (640, 480)
+
+
+def make_views(image, n, warp, seed):
+    """[(jpeg, bbox, H view -> anchor at WORK_WIDTH)]; view 0 is the anchor"""
+    rng = random.Random(seed)
+    scene = cv2.resize(cv2.imread(image), SIZE, interpolation=cv2.INTER_AREA)
+    cv2.ellipse(scene, (400, 260), (18, 26), 0, 0, 360, (30, 60, 250), -1)  # BGR: red-hot blob
+    w, h = SIZE
+    corners = np.float32([[0, 0], [w, 0], [w, h], [0, h]])
+    s = WORK_WIDTH / w
+    S = np.diag([s, s, 1.0])
+    out = []
+    for i in range(n):
+        if i == 0:
+            A = np.eye(3)  # anchor: scene -> anchor picture
+        else:
+            moved = corners + np.float32([[rng.uniform(-warp, warp) * w, rng.uniform(-warp, warp) * h]
+                                          for _ in range(4)])
+            A = cv2.getPerspectiveTransform(corners, moved)
+        pic = cv2.warpPerspective(scene, A, SIZE, borderMode=cv2.BORDER_REFLECT)
+        ok, buf = cv2.imencode(".jpg", pic, [cv2.IMWRITE_JPEG_QUALITY, 80])
+        jpeg = buf.tobytes()
+        det = detect_hotspots(jpeg)
+        H = S @ np.linalg.inv(A) @ np.linalg.inv(S)  # view -> scene (= anchor), at working scale
+        out.append((jpeg, det.get("bbox"), H))
+    return out
+
+
+def corner_error(H_est, H_true):
+    w, h = WORK_WIDTH, WORK_WIDTH * SIZE[1] // SIZE[0]
+    c = np.float32([[0, 0], [w, 0], [w, h], [0, h]]).reshape(-1, 1, 2)
+    a = cv2.perspectiveTransform(c, H_est.astype(np.float64))
+    b = cv2.perspectiveTransform(c, H_true)
+    return float(np.linalg.norm(a - b, axis=2).mean())
+
+
+def main():
+    p = argparse.ArgumentParser(description="Target confirmation benchmark")
+    p.add_argument("--views", type=int, default=8)
+    p.add_argument("--warp", type=float, default=0.08, help="corner displacement, share of the picture size")
+    p.add_argument("--seed", type=int, default=1)
+    p.add_argument("--image", default=os.path.join(HERE, "..", "media", "swarm.jpg"))
+    args = p.parse_args()
+
+    views = make_views(args.image, args.views, args.warp, args.seed)
+    print(f"{args.views} views of {SIZE[0]}x{SIZE[1]} ({sum(len(v[0]) for v in views) // len(views) // 1000} KB each), "
+          f"warp {args.warp:g}; view i comes from node i + 1")
+    cv2.setNumThreads(1)
+
+    print(f"{'view':>4} {'node':>4} {'add ms':>7} {'inliers':>7} {'overlap':>7} {'score':>6} {'corner err px':>13}")
+    jpeg, bbox, _ = views[0]
+    t0 = time.perf_counter()
+    target = Target(1, 1, 0, prepare(jpeg), bbox, time.monotonic())
+    incremental = [(time.perf_counter() - t0) * 1e3]
+    print(f"{0:4d} {1:4d} {incremental[0]:7.1f} {'anchor':>7} {'':>7} {target.score:6.2f}")
+    for i, (jpeg, bbox, H) in enumerate(views[1:], 1):
+        t0 = time.perf_counter()
+        v = target.add(i + 1, i * 100, prepare(jpeg), bbox)
+        incremental.append((time.perf_counter() - t0) * 1e3)
+        if v is None:
+            print(f"{i:4d} {i + 1:4d} {incremental[-1]:7.1f} {'not registered':>22}")
+            continue
+        print(f"{i:4d} {i + 1:4d} {incremental[-1]:7.1f} {v.inliers:7d} {v.overlap:7.2f} {target.score:6.2f} "
+              f"{corner_error(v.H, H):13.2f}")
+    fused = os.path.join(tempfile.gettempdir(), "bench_confirm_fused.jpg")
+    cv2.imwrite(fused, target.fused())
+
+    # the same set, recomputed from scratch on every addition
+    recompute = []
+    for k in range(1, len(views) + 1):
+        t0 = time.perf_counter()
+        t = Target(1, 1, 0, prepare(views[0][0]), views[0][1], 0)
+        for i, (jpeg, bbox, _) in enumerate(views[1:k], 1):
+            t.add(i + 1, i * 100, prepare(jpeg), bbox)
+        recompute.append((time.perf_counter() - t0) * 1e3)
+    print(f"confirmed: {target.confirmed} (score {target.score:.2f}), fused view in {fused}")
+    print(f"per addition: incremental {np.mean(incremental):.1f} ms (last {incremental[-1]:.1f}), "
+          f"recompute {np.mean(recompute):.1f} ms (last {recompute[-1]:.1f})")
+    print(f"whole set as it grew: incremental {sum(incremental):.0f} ms, recompute {sum(recompute):.0f} ms")
+
+
+if __name__ == "__main__":
+    main()
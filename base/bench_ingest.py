@@ -0,0 +1,155 @@
+#!/usr/bin/env python3
+# bench_ingest.py - sustainable ingest rate of a base server (BaseServer.py by default)
+#
+# starts the server in a scratch directory with its stdout sent to a file; `--relays` threads each
+# connect like a primary and push a pre-built stream of JpegFrame frames from their own nodes as
+# fast as the socket takes them, then half-close and wait for the server to hang up. with
+# `--reconnects` every relay drops and re-opens its connection that many times along the way. the
+# rate is stream bytes over the time until the last relay is done; the server is then stopped
+# with ctrl-c and the time until its recorder has flushed is reported separately, as is the cpu
+# time the server used from start to exit.
+#
+#   python3 bench_ingest.py --megabytes 200 --nodes 4
+#   python3 bench_ingest.py --relays 50 --nodes 2 --reconnects 3
+#   python3 bench_ingest.py --server /path/to/old/BaseServer.py   # compare another version
+
+import argparse
+import io
+import os
+import resource
+import signal
+import socket
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+from PIL import Image
+
+from swarm_proto import JPEG_HEADER, MSG_JPEG_FRAME, encode_frame
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+
+def make_pictures(image):
+    src = Image.open(image).convert("RGB").resize((640 + 64, 480 + 48))
+    pictures = []
+    for i in range(8):  # a few different pictures so the stream is not one repeated frame
+        buf = io.BytesIO()
+        src.crop((i * 8, i * 6, i * 8 + 640, i * 6 + 480)).save(buf, "JPEG", quality=80)
+        pictures.append(buf.getvalue())
+    return pictures
+
+
+def make_stream(pictures, first_node, nodes, megabytes, pieces):
+    """one relay's frames, cut into `pieces` connections' worth at frame boundaries"""
+    frames = []
+    total = 0
+    seq = 0
+    while total < megabytes * 1e6:
+        jpeg = pictures[seq % len(pictures)]
+        f = encode_frame(MSG_JPEG_FRAME, first_node + seq % nodes, seq, JPEG_HEADER.pack(seq * 33, 640, 480) + jpeg)
+        frames.append(f)
+        total += len(f)
+        seq += 1
+    per = -(-len(frames) // pieces)
+    return [b"".join(frames[i:i + per]) for i in range(0, len(frames), per)], seq
+
+
+def relay(port, pieces, start, errors):
+    try:
+        start.wait()
+        for piece in pieces:
+            s = socket.create_connection(("127.0.0.1", port))
+            s.sendall(piece)
+            s.shutdown(socket.SHUT_WR)
+            while s.recv(65536):  # the server closes once it has consumed everything
+                pass
+            s.close()
+    except OSError as e:
+        errors.append(e)
+
+
+def wait_port(port, proc, timeout=10.0):
+    end = time.monotonic() + timeout
+    while time.monotonic() < end:
+        if proc.poll() is not None:
+            raise RuntimeError("server exited during startup")
+        try:
+            socket.create_connection(("127.0.0.1", port), timeout=0.2).close()
+            return
+        except OSError:
+            time.sleep(0.05)
+    raise RuntimeError("server did not start")
+
+
+def main():
+    p = argparse.ArgumentParser(description="Base server ingest benchmark")
+    p.add_argument("--server", default=os.path.join(HERE, "BaseServer.py"))
+    p.add_argument("--megabytes", type=float, default=200)
+    p.add_argument("--nodes", type=int, default=4, help="nodes per relay")
+    p.add_argument("--relays", type=int, default=1, help="concurrent primaries")
+    p.add_argument("--reconnects", type=int, default=0, help="times each relay re-opens its connection")
+    p.add_argument("--image", default=os.path.join(HERE, "..", "media", "swarm.jpg"))
+    p.add_argument("--port", type=int, default=9471)
+    p.add_argument("server_args", nargs="*", help="extra arguments for the server (after --)")
+    args = p.parse_args()
+
+    if args.relays * args.nodes > 254:
+        p.error("relays x nodes must fit in the node ids")
+    pictures = make_pictures(args.image)
+    streams, frames = [], 0
+    for r in range(args.relays):
+        pieces, n = make_stream(pictures, 1 + r * args.nodes, args.nodes, args.megabytes / args.relays,
+                                args.reconnects + 1)
+        streams.append(pieces)
+        frames += n
+    size = sum(len(piece) for pieces in streams for piece in pieces)
+    print(f"stream: {size / 1e6:.1f} MB, {frames} frames from {args.relays} relays x {args.nodes} nodes, "
+          f"~{sum(map(len, pictures)) // len(pictures)} byte pictures")
+
+    with tempfile.TemporaryDirectory() as scratch:
+        log = open(os.path.join(scratch, "server.log"), "wb")
+        cmd = [sys.executable, os.path.abspath(args.server), "--port", str(args.port)] + args.server_args
+        cpu0 = resource.getrusage(resource.RUSAGE_CHILDREN)
+        proc = subprocess.Popen(cmd, cwd=scratch, stdin=subprocess.DEVNULL, stdout=log, stderr=subprocess.STDOUT,
+                                env=dict(os.environ, PYTHONPATH=os.path.dirname(os.path.abspath(args.server))))
+        try:
+            wait_port(args.port, proc)
+            start, errors = threading.Event(), []
+            threads = [threading.Thread(target=relay, args=(args.port, pieces, start, errors)) for pieces in streams]
+            for t in threads:
+                t.start()
+            t0 = time.monotonic()
+            start.set()
+            for t in threads:
+                t.join()
+            ingest = time.monotonic() - t0
+            if errors:
+                print(f"{len(errors)} relays failed, first: {errors[0]}")
+            t1 = time.monotonic()
+            proc.send_signal(signal.SIGINT)
+            proc.wait(timeout=120)
+            flush = time.monotonic() - t1
+            cpu1 = resource.getrusage(resource.RUSAGE_CHILDREN)
+            cpu = cpu1.ru_utime + cpu1.ru_stime - cpu0.ru_utime - cpu0.ru_stime
+        finally:
+            if proc.poll() is None:
+                proc.kill()
+            log.close()
+        log_size = os.path.getsize(os.path.join(scratch, "server.log"))
+        written = sum(os.path.getsize(os.path.join(d, f)) for d, _, fs in os.walk(scratch) for f in fs) - log_size
+        with open(os.path.join(scratch, "server.log"), "rb") as f:
+            tail = f.read()[-2000:].decode(errors="replace").splitlines()
+        summary = [l for l in tail if l.startswith("Disconnected") or l.startswith("Shutting")]
+
+    print(f"ingest: {size / ingest / 1e6:.1f} MB/s ({frames / ingest:.0f} frames/s) over {ingest:.2f} s")
+    print(f"server cpu: {cpu:.2f} s from start to exit, {cpu / frames * 1e6:.1f} us per frame")
+    print(f"shutdown incl. flush: {flush:.2f} s, {written / 1e6:.1f} MB on disk, {log_size} bytes of log")
+    for line in summary[-2:]:
+        print(f"server: {line[:200]}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+# bench_metrics.py - cpu cost of BaseServer.py --metrics against the rest of ingest
+#
+# runs the server's own Connection code (parser, recorder, routing) on one end of a socket pair
+# while a child process writes the stream into the other, and takes this process's cpu time, best
+# of `--reps`: the ingest cpu of a base server serving one busy relay. then it times the Metrics
+# calls alone on the same reads and pictures, as the receive loop would make them. the stream is
+# `--nodes` drones sending ~25 KB pictures (smaller with `--quality`), with a seq gap now and then
+# so the gap accounting runs too.
+#
+#   python3 bench_metrics.py --megabytes 200 --nodes 8
+#   python3 bench_metrics.py --quality 20 --nodes 32      # small pictures: the most frames per byte
+
+import argparse
+import io
+import os
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+
+from PIL import Image
+
+import BaseServer
+from metrics import Metrics, format_summary
+from recorder import Recorder
+from swarm_proto import JPEG_HEADER, MSG_JPEG_FRAME, FrameParser, encode_frame
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+READ_SIZE = 64 * 1024  # what one recv returns on a busy link
+
+
+class StreamSocket:
+    """recv_into from a bytes object, READ_SIZE at a time"""
+
+    def __init__(self, data):
+        self.data = memoryview(data)
+        self.pos = 0
+
+    def recv_into(self, mv):
+        n = min(len(mv), READ_SIZE, len(self.data) - self.pos)
+        mv[:n] = self.data[self.pos:self.pos + n]
+        self.pos += n
+        return n
+
+
+SENDER = """
+import os, socket, sys
+s = socket.socket(fileno=int(sys.argv[2]))
+with open(sys.argv[1], "rb") as f:
+    s.sendfile(f)
+s.close()
+"""
+
+
+class Server:
+    """what a Connection needs of IngestServer"""
+
+    def __init__(self, recorder, metrics):
+        self.recorder = recorder
+        self.metrics = metrics
+        self.sinks = []
+        self.log_interval = 1e9
+
+
+def make_stream(image, nodes, megabytes, quality):
+    src = Image.open(image).convert("RGB").resize((640 + 64, 480 + 48))
+    pictures = []
+    for i in range(8):
+        buf = io.BytesIO()
+        src.crop((i * 8, i * 6, i * 8 + 640, i * 6 + 480)).save(buf, "JPEG", quality=quality)
+        pictures.append(buf.getvalue())
+    out, total, k = [], 0, 0
+    seq = [0] * (nodes + 1)
+    while total < megabytes * 1e6:
+        node = 1 + k % nodes
+        seq[node] += 2 if k % 97 == 0 else 1  # one frame in ~100 lost on the way
+        f = encode_frame(MSG_JPEG_FRAME, node, seq[node] & 0xFFFF,
+                         JPEG_HEADER.pack(k * 33 // nodes, 640, 480) + pictures[k % len(pictures)])
+        out.append(f)
+        total += len(f)
+        k += 1
+    return b"".join(out), k
+
+
+def ingest(path, root):
+    recorder = Recorder(root, "mjpeg")
+    ours, theirs = socket.socketpair()
+    ours.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, BaseServer.SOCK_RCVBUF)
+    sender = subprocess.Popen([sys.executable, "-c", SENDER, path, str(theirs.fileno())], pass_fds=[theirs.fileno()])
+    theirs.close()
+    c = BaseServer.Connection(ours, "bench:1", Server(recorder, None), 0)
+    t0 = time.process_time()
+    while c.readable():
+        while recorder.behind():  # as the server pauses reading
+            time.sleep(0.001)
+    recorder.close()
+    cpu = time.process_time() - t0
+    sender.wait()
+    ours.close()
+    return cpu
+
+
+def reads(stream):
+    """[(nbytes, frames, [(node, size, capture_ms)])] as the receive loop sees them"""
+    parser = FrameParser()
+    sock = StreamSocket(stream)
+    out = []
+    while True:
+        with parser.writable(BaseServer.RECV_SIZE) as mv:
+            n = sock.recv_into(mv)
+        if not n:
+            return out
+        frames = parser.filled(n)
+        pictures = []
+        for f in frames:
+            capture_ms, _w, _h = JPEG_HEADER.unpack_from(f.payload)
+            pictures.append((f.node, len(f.payload) - JPEG_HEADER.size, capture_ms))
+        out.append((n, frames, pictures))
+
+
+def metrics_only(batches, metrics):
+    # the receive timestamps advance at a steady 300 MB/s so the windows roll as they would live
+    t, t0 = time.monotonic(), time.perf_counter()
+    for n, frames, pictures in batches:
+        t += n / 300e6
+        metrics.read("bench:1", n, frames, t)
+        for node, size, capture_ms in pictures:
+            metrics.picture(node, size, capture_ms, t)
+    metrics.fold(t)
+    return time.perf_counter() - t0
+
+
+def main():
+    p = argparse.ArgumentParser(description="Metrics overhead benchmark")
+    p.add_argument("--megabytes", type=float, default=100)
+    p.add_argument("--nodes", type=int, default=8)
+    p.add_argument("--quality", type=int, default=80, help="jpeg quality of the pictures")
+    p.add_argument("--reps", type=int, default=3)
+    p.add_argument("--image", default=os.path.join(HERE, "..", "media", "swarm.jpg"))
+    args = p.parse_args()
+
+    stream, frames = make_stream(args.image, args.nodes, args.megabytes, args.quality)
+    print(f"stream: {len(stream) / 1e6:.1f} MB, {frames} frames from {args.nodes} nodes, "
+          f"{len(stream) // frames} bytes each")
+    BaseServer.print = lambda *a, **k: None  # no summary lines in the timing
+    with tempfile.TemporaryDirectory() as scratch:
+        path = os.path.join(scratch, "stream.bin")
+        with open(path, "wb") as f:
+            f.write(stream)
+        base = min(ingest(path, os.path.join(scratch, str(i))) for i in range(args.reps))
+    batches = reads(stream)
+    cost = []
+    for _ in range(args.reps):
+        metrics = Metrics()
+        metrics.attach("bench:1", FrameParser())
+        cost.append(metrics_only(batches, metrics))
+    extra = min(cost)
+    print(f"ingest cpu without metrics: {base:.3f} s, {base / frames * 1e6:.2f} us per frame")
+    print(f"metrics calls:              {extra:.4f} s, {extra / frames * 1e6:.2f} us per frame, "
+          f"{extra / base * 100:.2f}% of ingest cpu")
+    print(format_summary(metrics.snapshot()))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+# bench_mission.py - seek and extract cost of a multi-GB mission recording (mission.py)
+#
+# writes a synthetic mission (`--hours` of `--nodes` cameras at `--fps`, real ~25 KB pictures)
+# with MissionWriter as the base would, and the same frames as a received.bin style dump. then
+# times opening the mission and `--seeks` random "picture of node N at time T" lookups, against
+# finding one such picture in the dump, which can only be done by parsing from the start.
+#
+#   python3 bench_mission.py --hours 2 --nodes 4 --fps 3      # ~2.2 GB of pictures
+#   python3 bench_mission.py --dir /big/disk --keep           # keep the mission for mission_play.py
+
+import argparse
+import io
+import os
+import random
+import shutil
+import tempfile
+import time
+
+from PIL import Image
+
+from mission import MissionReader, MissionWriter
+from swarm_proto import JPEG_HEADER, MSG_JPEG_FRAME, MSG_TELEMETRY, Frame, FrameParser, encode_frame
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+
+def make_pictures(image):
+    src = Image.open(image).convert("RGB").resize((640 + 64, 480 + 48))
+    out = []
+    for i in range(8):
+        buf = io.BytesIO()
+        src.crop((i * 8, i * 6, i * 8 + 640, i * 6 + 480)).save(buf, "JPEG", quality=80)
+        out.append(buf.getvalue())
+    return out
+
+
+def percentile(values, q):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(q * len(values)))]
+
+
+def main():
+    p = argparse.ArgumentParser(description="Mission recording seek benchmark")
+    p.add_argument("--hours", type=float, default=2)
+    p.add_argument("--nodes", type=int, default=4)
+    p.add_argument("--fps", type=float, default=3)
+    p.add_argument("--seeks", type=int, default=2000)
+    p.add_argument("--image", default=os.path.join(HERE, "..", "media", "swarm.jpg"))
+    p.add_argument("--dir", help="where to write (default: a temporary directory)")
+    p.add_argument("--keep", action="store_true")
+    p.add_argument("--no-dump", action="store_true", help="skip the received.bin comparison")
+    args = p.parse_args()
+
+    pictures = make_pictures(args.image)
+    root = tempfile.mkdtemp(dir=args.dir)
+    path = os.path.join(root, "mission")
+    try:
+        # a picture from every node each 1/fps s plus a heartbeat per node per second
+        w = MissionWriter(path)
+        dump = None if args.no_dump else open(os.path.join(root, "received.bin"), "wb", buffering=1 << 20)
+        step_us = int(1e6 / args.fps)
+        end_us = int(args.hours * 3600e6)
+        seq = 0
+        node_seq = [0] * (args.nodes + 1)  # per node frame counter, as a secondary numbers its frames
+        t0 = time.monotonic()
+        for t in range(0, end_us, step_us):
+            for node in range(1, args.nodes + 1):
+                jpeg = pictures[seq % len(pictures)]
+                f = Frame(MSG_JPEG_FRAME, node, 0, node_seq[node] & 0xFFFF,
+                          JPEG_HEADER.pack((t // 1000) & 0xFFFFFFFF, 640, 480) + jpeg)
+                w.append(w.start_us + t + node * 100, f)
+                node_seq[node] += 1
+                if t % 1000000 < step_us:
+                    hb = Frame(MSG_TELEMETRY, node, 0, node_seq[node] & 0xFFFF, bytes(12))
+                    w.append(w.start_us + t + node * 100 + 50, hb)
+                    node_seq[node] += 1
+                if dump:
+                    dump.write(encode_frame(f.type, f.node, f.seq, f.payload))
+                seq += 1
+        w.close()
+        if dump:
+            dump.close()
+        write_s = time.monotonic() - t0
+        print(f"wrote {w.frames} frames, {w.bytes / 1e9:.2f} GB in {w.segment + 1} segments "
+              f"({w.bytes / write_s / 1e6:.0f} MB/s incl. building the dump)")
+
+        t0 = time.monotonic()
+        r = MissionReader(path)
+        open_ms = (time.monotonic() - t0) * 1e3
+        print(f"open: {open_ms:.2f} ms for {len(r)} indexed frames over {r.duration_us() / 3600e6:.2f} h")
+
+        rng = random.Random(1)
+        lat = []
+        got = 0
+        for _ in range(args.seeks):
+            node = rng.randrange(1, args.nodes + 1)
+            at = rng.randrange(0, end_us)
+            t0 = time.perf_counter()
+            rows = r.rows(node)
+            k = r.seek(at, node)
+            while k < len(rows) and r.record(rows[k]).type != MSG_JPEG_FRAME:
+                k += 1
+            if k < len(rows):
+                got += len(bytes(r.payload(rows[k])[JPEG_HEADER.size:]))
+            lat.append(time.perf_counter() - t0)
+        print(f"seek + extract: median {percentile(lat, 0.5) * 1e6:.0f} us, p99 {percentile(lat, 0.99) * 1e6:.0f} us "
+              f"over {args.seeks} random (node, time) lookups, {got / args.seeks / 1e3:.1f} KB each")
+
+        if dump:
+            # the same question of the dump: the picture of the last node half way through
+            target = (end_us // 2) // step_us * args.nodes + args.nodes - 1
+            t0 = time.monotonic()
+            parser = FrameParser()
+            seen = 0
+            found = None
+            with open(os.path.join(root, "received.bin"), "rb") as f:
+                while found is None:
+                    chunk = f.read(1 << 20)
+                    if not chunk:
+                        break
+                    for fr in parser.feed(chunk):
+                        if seen == target:
+                            found = fr
+                        seen += 1
+            print(f"received.bin scan to the middle: {(time.monotonic() - t0) * 1e3:.0f} ms "
+                  f"({seen} frames parsed)")
+        r.close()
+    finally:
+        if args.keep:
+            print(f"kept {path}")
+        else:
+            shutil.rmtree(root)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+# bench_slice_loss.py - picture delivery under packet loss: restart-interval slices vs whole frames
+#
+# encodes a moving crop of an image (or a directory of JPEG frames) with one restart interval per
+# MCU row, packetizes it like secondary-cam (~1400 byte packets on interval boundaries) and drops
+# packets at random. whole-frame delivery loses a picture if any of its packets is lost; sliced
+# delivery conceals lost intervals from the previous picture.
+#
+#   python3 bench_slice_loss.py --loss 0.05 --frames 300
+
+import argparse
+import glob
+import io
+import random
+
+from PIL import Image
+
+from jpeg_slices import Slice, SliceAssembler, packetize
+
+
+def synth_frames(path, count, size=(640, 480), quality=80):
+    src = Image.open(path).convert("RGB")
+    w, h = size
+    src = src.resize((w + count, h + count // 2))
+    for i in range(count):
+        buf = io.BytesIO()
+        src.crop((i, i // 2, i + w, i // 2 + h)).save(buf, "JPEG", quality=quality, restart_marker_rows=1)
+        yield buf.getvalue()
+
+
+def load_frames(directory):
+    for name in sorted(glob.glob(f"{directory}/*.jpg")):
+        with open(name, "rb") as f:
+            yield f.read()
+
+
+def decodes(jpeg):
+    try:
+        Image.open(io.BytesIO(jpeg)).load()
+        return True
+    except Exception:
+        return False
+
+
+def main():
+    p = argparse.ArgumentParser(description="JPEG slice vs whole-frame delivery under loss")
+    p.add_argument("--loss", type=float, default=0.05, help="packet loss probability")
+    p.add_argument("--frames", type=int, default=300)
+    p.add_argument("--image", default="../media/swarm.jpg", help="source image for synthetic frames")
+    p.add_argument("--dir", help="directory of recorded JPEG frames instead of synthetic ones")
+    p.add_argument("--packet", type=int, default=1400, help="target packet size in bytes")
+    p.add_argument("--seed", type=int, default=1)
+    args = p.parse_args()
+
+    rng = random.Random(args.seed)
+    frames = load_frames(args.dir) if args.dir else synth_frames(args.image, args.frames)
+    asm = SliceAssembler()
+    n = whole_ok = sliced_ok = fresh = total_intervals = bad_decode = packets_sent = 0
+
+    for frame_id, jpeg in enumerate(frames):
+        packets, intervals = packetize(jpeg, args.packet)
+        arrived = [rng.random() >= args.loss for _ in packets]
+        n += 1
+        packets_sent += len(packets)
+        total_intervals += intervals
+        whole_ok += all(arrived)
+        pictures = []
+        for (first, count, data), ok in zip(packets, arrived):
+            if ok:
+                pictures += asm.add(Slice(0, frame_id & 0xFFFF, 0, 0, first, count, intervals, data, count == 0))
+        pictures += asm.flush()
+        for pic in pictures:
+            if decodes(pic.jpeg):
+                sliced_ok += 1
+                fresh += pic.fresh
+            else:
+                bad_decode += 1
+
+    print(f"frames {n}, {packets_sent / n:.1f} packets/frame, loss {args.loss:.1%}")
+    print(f"whole-frame drop : {whole_ok / n:6.1%} of frames displayed")
+    print(f"restart slices   : {sliced_ok / n:6.1%} of frames displayed, "
+          f"{fresh / total_intervals:6.1%} of picture rows fresh, {bad_decode} failed to decode")
+
+
+if __name__ == "__main__":
+    main()
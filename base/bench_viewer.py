@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+# bench_viewer.py - display latency and cpu of viewer.py's FeedGrid with many feeds
+#
+# a feeder thread submits `--feeds` synthetic camera feeds at `--fps` each, as the receive loop
+# would, while the main thread repaints every 33 ms as ViewerApp does (headless: the grid is
+# converted to raw RGB in place of handing it to Tk). compared per mode:
+#   naive    every picture decoded at full size, then scaled to its tile
+#   skip     only the newest picture per feed per repaint, full-size decode
+#   reduced  every picture, DCT-scaled decode
+#   both     newest only + DCT-scaled decode (what the viewer does)
+# latency is receive -> repainted grid; cpu is process time over wall time (100% = one core).
+#
+#   python3 bench_viewer.py --feeds 12 --fps 15 --seconds 10
+
+import argparse
+import io
+import os
+import threading
+import time
+
+from PIL import Image
+
+from viewer import REFRESH_MS, FeedGrid
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+MODES = {"naive": (False, False), "skip": (False, True), "reduced": (True, False), "both": (True, True)}
+
+
+def make_pictures(image, size):
+    src = Image.open(image).convert("RGB").resize((size[0] + 64, size[1] + 48))
+    out = []
+    for i in range(8):
+        buf = io.BytesIO()
+        src.crop((i * 8, i * 6, i * 8 + size[0], i * 6 + size[1])).save(buf, "JPEG", quality=80)
+        out.append(buf.getvalue())
+    return out
+
+
+def percentile(values, q):
+    if not values:
+        return 0.0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(q * len(values)))]
+
+
+def feeder(grid, pictures, feeds, fps, end):
+    period = 1.0 / (feeds * fps)
+    t0 = time.monotonic()
+    k = 0
+    while True:
+        due = t0 + k * period
+        now = time.monotonic()
+        if now >= end:
+            return
+        if due > now:
+            time.sleep(due - now)
+        grid.submit(k % feeds, 0, pictures[k % len(pictures)])
+        k += 1
+
+
+def main():
+    p = argparse.ArgumentParser(description="Multi-feed viewer benchmark")
+    p.add_argument("--feeds", type=int, default=12)
+    p.add_argument("--fps", type=float, default=15)
+    p.add_argument("--seconds", type=float, default=10)
+    p.add_argument("--size", default="640x480", help="camera picture size")
+    p.add_argument("--modes", nargs="+", choices=MODES, default=list(MODES))
+    p.add_argument("--image", default=os.path.join(HERE, "..", "media", "swarm.jpg"))
+    args = p.parse_args()
+
+    size = tuple(int(v) for v in args.size.split("x"))
+    pictures = make_pictures(args.image, size)
+    print(f"{args.feeds} feeds x {args.fps:g} fps of {size[0]}x{size[1]} (~{sum(map(len, pictures)) // len(pictures) // 1000} KB), "
+          f"repaint every {REFRESH_MS} ms")
+    print(f"{'mode':8} {'decoded/s':>9} {'skipped/s':>9} {'lat p50':>8} {'lat p99':>8} {'cpu':>6}")
+    for mode in args.modes:
+        reduced, skip = MODES[mode]
+        grid = FeedGrid(reduced=reduced, skip_stale=skip)
+        end = time.monotonic() + args.seconds
+        t = threading.Thread(target=feeder, args=(grid, pictures, args.feeds, args.fps, end))
+        wall0, cpu0 = time.monotonic(), time.process_time()
+        t.start()
+        while time.monotonic() < end:
+            tick = time.monotonic()
+            canvas, changed = grid.render()
+            if changed:
+                canvas.tobytes()  # stands in for the copy into a Tk PhotoImage
+            rest = REFRESH_MS / 1e3 - (time.monotonic() - tick)
+            if rest > 0:
+                time.sleep(rest)
+        t.join()
+        wall, cpu = time.monotonic() - wall0, time.process_time() - cpu0
+        decoded, skipped = grid.counts()
+        lat = grid.take_latency()
+        print(f"{mode:8} {decoded / wall:9.0f} {skipped / wall:9.0f} {percentile(lat, 0.5) * 1e3:6.0f}ms "
+              f"{percentile(lat, 0.99) * 1e3:6.0f}ms {cpu / wall * 100:5.0f}%")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,228 @@
+# confirm.py - multi-angle target confirmation (BaseServer.py --confirm)
+#
+# a detection from analysis.py opens a target, anchored on the picture it came from. detections
+# from other drones within GROUP_S of a target's latest one are taken as views of the same spot
+# (the base knows no drone positions, so co-timed detections are what groups them) and each is
+# registered onto the anchor with ORB features and a RANSAC homography; a detection that shares
+# nothing with any open target opens its own. a target stays open as long as detections keep
+# registering onto it, so a drone hovering over the same thing extends it rather than opening a
+# new target (and fused view) every GROUP_S. a view whose detection box lands on the anchor's box
+# agrees with it; the score is 1 - 0.5 * prod(1 - p) over the first view of every other drone, p
+# being that view's registration quality times its box overlap, so the anchor alone scores 0.5
+# and one clean second drone 1.0.
+# more views of a drone already in the set only sharpen the fused view, up to VIEWS_PER_NODE; past
+# that its detections only keep the target open. everything is incremental: a detection's picture
+# is decoded and described once, whatever the number of open targets it is tried on, and each try
+# costs one match (plus one warp into a running sum if it is added), whatever the size of the set.
+# the fused view (mean of the registered views, anchor box drawn) is written per target.
+#
+# needs opencv (pip install opencv-python-headless).
+
+import os
+import queue
+import threading
+import time
+from collections import Counter, defaultdict, deque, namedtuple
+
+import cv2
+import numpy as np
+
+GROUP_S = 3.0            # detections this close in time are taken as the same target
+MAX_VIEWS = 8
+VIEWS_PER_NODE = 2
+WORK_WIDTH = 480         # pictures are registered at this width
+ORB_FEATURES = 1000
+RATIO = 0.75             # Lowe's ratio test
+MIN_INLIERS = 15
+GOOD_INLIERS = 60        # registration quality saturates here
+CONFIRM_SCORE = 0.8
+RECENT_PICTURES = 8      # per drone, to find the picture a detection was made on
+
+View = namedtuple("View", "node capture_ms inliers overlap p add_ms H")  # H: view -> anchor, at WORK_WIDTH
+Picture = namedtuple("Picture", "colour grey scale kp des ms")  # ms: decoding and describing it
+
+_orb = cv2.ORB_create(ORB_FEATURES)
+_matcher = cv2.BFMatcher(cv2.NORM_HAMMING)
+
+
+def prepare(jpeg):
+    """jpeg -> Picture at WORK_WIDTH with its ORB features, for Target() and Target.add()"""
+    t0 = time.perf_counter()
+    img = cv2.imdecode(np.frombuffer(jpeg, np.uint8), cv2.IMREAD_COLOR)
+    if img is None:
+        raise ValueError("undecodable picture")
+    scale = WORK_WIDTH / img.shape[1]
+    if scale < 1:
+        img = cv2.resize(img, (WORK_WIDTH, int(img.shape[0] * scale)), interpolation=cv2.INTER_AREA)
+    else:
+        scale = 1.0
+    grey = cv2.cvtColor(img, cv2.COLOR_BGR2GRAY)
+    kp, des = _orb.detectAndCompute(grey, None)
+    return Picture(img, grey, scale, kp, des, (time.perf_counter() - t0) * 1e3)
+
+
+def _iou(a, b):
+    ix = max(0.0, min(a[2], b[2]) - max(a[0], b[0]))
+    iy = max(0.0, min(a[3], b[3]) - max(a[1], b[1]))
+    inter = ix * iy
+    union = (a[2] - a[0]) * (a[3] - a[1]) + (b[2] - b[0]) * (b[3] - b[1]) - inter
+    return inter / union if union > 0 else 0.0
+
+
+class Target:
+    """one detection and the views registered onto it"""
+
+    def __init__(self, tid, node, capture_ms, pic, bbox, opened):
+        t0 = time.perf_counter()
+        self.id = tid
+        self.opened = opened
+        self.seen = opened  # the latest detection that registered onto it
+        self.size = (pic.colour.shape[1], pic.colour.shape[0])
+        self.kp, self.des = pic.kp, pic.des
+        self.bbox = [v * pic.scale for v in bbox] if bbox else None
+        self.sum = pic.colour.astype(np.float32)
+        self.weight = np.ones(pic.colour.shape[:2], np.float32)
+        add_ms = pic.ms + (time.perf_counter() - t0) * 1e3
+        self.views = [View(node, capture_ms, len(self.kp), 1.0, 1.0, add_ms, np.eye(3))]
+        self.per_node = Counter({node: 1})
+        self.miss = 1.0  # prod(1 - p) over the other drones' first views
+
+    @property
+    def score(self):
+        return 1.0 - 0.5 * self.miss
+
+    @property
+    def confirmed(self):
+        return self.score >= CONFIRM_SCORE
+
+    def accepts(self, node):
+        return len(self.views) < MAX_VIEWS and self.per_node[node] < VIEWS_PER_NODE
+
+    def register(self, pic):
+        """(H, inliers) of `pic` onto the anchor, or None if it shares too little with it"""
+        if pic.des is None or self.des is None or len(pic.kp) < MIN_INLIERS:
+            return None
+        good = [m for m, *rest in _matcher.knnMatch(pic.des, self.des, k=2)
+                if rest and m.distance < RATIO * rest[0].distance]
+        if len(good) < MIN_INLIERS:
+            return None
+        src = np.float32([pic.kp[m.queryIdx].pt for m in good]).reshape(-1, 1, 2)
+        dst = np.float32([self.kp[m.trainIdx].pt for m in good]).reshape(-1, 1, 2)
+        H, mask = cv2.findHomography(src, dst, cv2.RANSAC, 4.0)
+        inliers = int(mask.sum()) if mask is not None else 0
+        if H is None or inliers < MIN_INLIERS:
+            return None
+        return H, inliers
+
+    def add(self, node, capture_ms, pic, bbox):
+        """registers one more view; returns its View, or None if it could not be registered"""
+        t0 = time.perf_counter()
+        reg = self.register(pic)
+        if reg is None:
+            return None
+        H, inliers = reg
+        warped = cv2.warpPerspective(pic.colour, H, self.size)
+        valid = cv2.warpPerspective(np.ones(pic.grey.shape, np.float32), H, self.size)
+        self.sum += warped.astype(np.float32) * valid[..., None]
+        self.weight += valid
+        overlap = 0.0
+        if bbox and self.bbox:
+            x0, y0, x1, y1 = (v * pic.scale for v in bbox)
+            corners = cv2.perspectiveTransform(np.float32([[x0, y0], [x1, y0], [x1, y1], [x0, y1]]).reshape(-1, 1, 2), H)
+            xs, ys = corners[:, 0, 0], corners[:, 0, 1]
+            overlap = _iou((float(xs.min()), float(ys.min()), float(xs.max()), float(ys.max())), self.bbox)
+        p = min(1.0, inliers / GOOD_INLIERS) * min(1.0, overlap / 0.3)
+        if not self.per_node[node]:  # only another drone is an independent angle
+            self.miss *= 1.0 - p
+        add_ms = pic.ms + (time.perf_counter() - t0) * 1e3
+        view = View(node, capture_ms, inliers, round(overlap, 3), round(p, 3), add_ms, H)
+        self.views.append(view)
+        self.per_node[node] += 1
+        return view
+
+    def fused(self):
+        img = (self.sum / self.weight[..., None]).astype(np.uint8)
+        if self.bbox:
+            x0, y0, x1, y1 = (int(v) for v in self.bbox)
+            cv2.rectangle(img, (x0, y0), (x1, y1), (0, 255, 0) if self.confirmed else (0, 200, 255), 2)
+        nodes = ",".join(str(n) for n in sorted(self.per_node))
+        cv2.putText(img, f"target {self.id}  nodes {nodes}  score {self.score:.2f}", (8, 20),
+                    cv2.FONT_HERSHEY_SIMPLEX, 0.5, (255, 255, 255), 1, cv2.LINE_AA)
+        return img
+
+
+class ConfirmPipeline:
+    """picture sink + analysis event consumer; registration runs on its own thread"""
+
+    def __init__(self, out_dir, on_result=None):
+        self.out_dir = out_dir
+        os.makedirs(out_dir, exist_ok=True)
+        self.on_result = on_result
+        self.recent = defaultdict(lambda: deque(maxlen=RECENT_PICTURES))  # node -> (capture_ms, jpeg)
+        self.lock = threading.Lock()
+        self.tasks = queue.Queue(maxsize=64)
+        self.targets = []  # open ones, oldest first
+        self.next_id = 1
+        self.dropped = 0   # detections that found the queue full or their picture gone
+        self.thread = threading.Thread(target=self._run, name="confirm", daemon=True)
+        self.thread.start()
+
+    def submit(self, node, capture_ms, jpeg):
+        # the receive loop: keep the last few pictures so a detection can find its own
+        with self.lock:
+            self.recent[node].append((capture_ms, bytes(jpeg)))
+
+    def event(self, ev):
+        # analysis results (collector thread)
+        if not ev.get("detected"):
+            return
+        with self.lock:
+            jpeg = next((j for c, j in self.recent[ev["node"]] if c == ev["capture_ms"]), None)
+        if jpeg is None:  # already pushed out of the recent pictures
+            self.dropped += 1
+            return
+        try:
+            self.tasks.put_nowait((ev["node"], ev["capture_ms"], jpeg, ev.get("bbox"), time.monotonic()))
+        except queue.Full:
+            self.dropped += 1
+
+    def close(self):
+        self.tasks.put(None)
+        self.thread.join()
+
+    def _run(self):
+        while True:
+            task = self.tasks.get()
+            if task is None:
+                return
+            node, capture_ms, jpeg, bbox, t = task
+            self.targets = [x for x in self.targets if t - x.seen < GROUP_S]
+            try:
+                pic = prepare(jpeg)  # once, for every target it is tried on
+                target = view = None
+                for x in self.targets:
+                    if x.accepts(node):
+                        view = x.add(node, capture_ms, pic, bbox)
+                        if view is not None:
+                            target = x
+                            break
+                    elif node in x.per_node and x.register(pic) is not None:
+                        target = x  # more of what this drone already gave it: keeps it open
+                        break
+                if target is None:
+                    target = Target(self.next_id, node, capture_ms, pic, bbox, t)
+                    self.next_id += 1
+                    self.targets.append(target)
+                    view = target.views[0]
+                target.seen = t
+                if view is None:
+                    continue
+            except (ValueError, cv2.error):
+                continue
+            path = os.path.join(self.out_dir, f"target{target.id}.jpg")
+            cv2.imwrite(path, target.fused())
+            if self.on_result:
+                self.on_result(dict(target=target.id, node=node, capture_ms=capture_ms,
+                                    nodes=sorted(target.per_node), views=len(target.views),
+                                    inliers=view.inliers, overlap=view.overlap, score=round(target.score, 3),
+                                    confirmed=target.confirmed, add_ms=round(view.add_ms, 1), fused=path))
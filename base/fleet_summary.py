@@ -0,0 +1,62 @@
+# fleet_summary.py - python side of lib/telemetry/src/fleet_summary.h
+#
+# the primary sends one FleetSummary for the whole swarm instead of relaying every heartbeat.
+# each row is a node id, its alert bits and a telemetry_codec sample delta-coded against that
+# node's previous row. FleetTracker keeps a decoder and the latest status per node; rows that
+# cannot be decoded yet (joined late, or a summary was lost) still carry their alert bits, and
+# the next full summary (FLAG_FLEET_FULL, about once a minute) brings every node back.
+
+from collections import namedtuple
+
+from swarm_proto import ALERT_NAMES, FLEET_HEADER, FLEET_ROW, FLAG_FLEET_FULL
+from telemetry_codec import FLEET_FIELDS, FLEET_MODES, OK, TRUNCATED, Decoder
+
+NodeStatus = namedtuple("NodeStatus", "node alerts values")  # values: dict, or None if undecodable
+
+
+def alert_names(alerts):
+    return [name for bit, name in sorted(ALERT_NAMES.items()) if alerts & bit]
+
+
+class FleetTracker:
+    def __init__(self):
+        self.decoders = {}  # node -> Decoder
+        self.nodes = {}     # node -> latest NodeStatus
+        self.undecodable = 0
+
+    def feed(self, frame):
+        """FleetSummary frame -> (capture_ms, full, [NodeStatus]) for the rows it carried"""
+        capture_ms, count = FLEET_HEADER.unpack_from(frame.payload)
+        pos = FLEET_HEADER.size
+        rows = []
+        for _ in range(count):
+            if pos + FLEET_ROW.size > len(frame.payload):
+                raise ValueError("fleet row truncated")
+            node, alerts = FLEET_ROW.unpack_from(frame.payload, pos)
+            pos += FLEET_ROW.size
+            dec = self.decoders.setdefault(node, Decoder(FLEET_MODES))
+            status, values, used = dec.decode(frame.payload[pos:])
+            if status == TRUNCATED:
+                raise ValueError("fleet sample truncated")
+            pos += used
+            if status == OK:
+                values = dict(zip(FLEET_FIELDS, values))
+            else:
+                self.undecodable += 1
+                prev = self.nodes.get(node)
+                values = prev.values if prev else None
+            st = NodeStatus(node, alerts, values)
+            self.nodes[node] = st
+            rows.append(st)
+        return capture_ms, bool(frame.flags & FLAG_FLEET_FULL), rows
+
+
+def format_status(st):
+    if st.values is None:
+        text = "(waiting for full summary)"
+    else:
+        v = st.values
+        text = (f"rssi {v['rssi_dbm']} dBm  batt {v['battery_mv']} mV  {v['fps_x10'] / 10:.1f} fps  "
+                f"seen {v['last_seen_s']} s ago  queue {v['queue_kb']} KB  crc {v['crc_errors']}")
+    alerts = alert_names(st.alerts)
+    return f"node {st.node}: {text}" + (f"  ALERT {' '.join(alerts)}" if alerts else "")
@@ -0,0 +1,141 @@
+# jpeg_slices.py - python side of lib/jpeg_slices/src/jpeg_slices.h
+#
+# secondary-cam sends each picture as a JpegSlice headers packet (SOI .. SOS) followed by packets
+# of whole restart intervals. SliceAssembler rebuilds a decodable JPEG from whatever arrived:
+# a missing interval is replaced by the same interval of the previous picture (restart intervals
+# decode independently, and the tables do not change between frames), and missing headers are
+# taken from the previous picture of the same node.
+
+import struct
+from collections import namedtuple
+
+SLICE_HEADER = struct.Struct(">IHHHHHH")  # capture_ms, frame_id, width, height, first, count, total
+FLAG_SLICE_HEADERS = 0x01
+
+Slice = namedtuple("Slice", "capture_ms frame_id width height first count total data headers")
+Picture = namedtuple("Picture", "frame_id capture_ms width height jpeg fresh concealed")
+
+EOI = b"\xff\xd9"
+
+
+def parse_slice(frame):
+    capture_ms, frame_id, width, height, first, count, total = SLICE_HEADER.unpack_from(frame.payload)
+    return Slice(capture_ms, frame_id, width, height, first, count, total,
+                 frame.payload[SLICE_HEADER.size:], bool(frame.flags & FLAG_SLICE_HEADERS))
+
+
+def scan_bounds(jpeg):
+    """(header_len, scan_end) of a baseline JPEG, mirroring jpeg::parseHeaders"""
+    if jpeg[:2] != b"\xff\xd8":
+        raise ValueError("not a JPEG")
+    pos = 2
+    while pos + 4 <= len(jpeg):
+        if jpeg[pos] != 0xFF:
+            raise ValueError("bad marker")
+        marker = jpeg[pos + 1]
+        if marker == 0xFF:
+            pos += 1
+            continue
+        (seg_len,) = struct.unpack_from(">H", jpeg, pos + 2)
+        pos += 2 + seg_len
+        if marker == 0xDA:
+            end = jpeg.rfind(EOI, pos)
+            return pos, end if end >= 0 else len(jpeg)
+    raise ValueError("no SOS")
+
+
+def split_intervals(entropy):
+    """split entropy-coded data on RSTn markers (markers removed)"""
+    out, start, i = [], 0, entropy.find(b"\xff")
+    while 0 <= i < len(entropy) - 1:
+        if 0xD0 <= entropy[i + 1] <= 0xD7:
+            out.append(entropy[start:i])
+            start = i + 2
+            i = entropy.find(b"\xff", start)
+        else:
+            i = entropy.find(b"\xff", i + 2)
+    out.append(entropy[start:])
+    return out
+
+
+def join_intervals(intervals):
+    parts = []
+    for k, data in enumerate(intervals):
+        if k:
+            parts.append(bytes((0xFF, 0xD0 + (k - 1) % 8)))
+        parts.append(data)
+    return b"".join(parts)
+
+
+def packetize(jpeg, target_bytes=1400):
+    """same grouping as sendSlicesToPrimary(): list of (first, count, data); first entry is headers"""
+    header_len, scan_end = scan_bounds(jpeg)
+    intervals = split_intervals(jpeg[header_len:scan_end])
+    packets = [(0, 0, jpeg[:header_len])]
+    first, group = 0, []
+    for k, data in enumerate(intervals):
+        if group and len(join_intervals(group + [data])) > target_bytes:
+            packets.append((first, len(group), join_intervals(group)))
+            group = []
+        if not group:
+            first = k
+        group.append(data)
+    if group:
+        packets.append((first, len(group), join_intervals(group)))
+    return packets, len(intervals)
+
+
+class SliceAssembler:
+    """per-node reassembly; add() returns the pictures completed by this slice"""
+
+    def __init__(self):
+        self.headers = None       # last jpeg headers seen for this node
+        self.reference = []       # intervals of the last emitted picture, for concealment
+        self.current = None       # slice metadata of the picture being assembled
+        self.intervals = {}
+        self.pictures = 0
+        self.concealed = 0
+        self.undecodable = 0
+
+    def add(self, s):
+        done = []
+        if self.current is not None and s.frame_id != self.current.frame_id:
+            done += self._finish()
+        if self.current is None:
+            self.current = s
+            self.intervals = {}
+        if s.headers:
+            self.headers = s.data
+        else:
+            for k, data in enumerate(split_intervals(s.data)):
+                self.intervals[s.first + k] = data
+            if s.first + s.count >= s.total:
+                done += self._finish()
+        return done
+
+    def flush(self):
+        return self._finish() if self.current is not None else []
+
+    def _finish(self):
+        cur, got = self.current, self.intervals
+        self.current, self.intervals = None, {}
+        total = cur.total
+        if self.headers is None or not got:
+            self.undecodable += 1
+            return []
+        intervals, concealed = [], 0
+        for k in range(total):
+            if k in got:
+                intervals.append(got[k])
+            elif k < len(self.reference) and len(self.reference) == total:
+                intervals.append(self.reference[k])
+                concealed += 1
+            else:
+                self.undecodable += 1
+                return []
+        self.reference = intervals
+        self.pictures += 1
+        self.concealed += concealed
+        jpeg = self.headers + join_intervals(intervals) + EOI
+        return [Picture(cur.frame_id, cur.capture_ms, cur.width, cur.height, jpeg,
+                        total - concealed, concealed)]
@@ -0,0 +1,339 @@
+#!/usr/bin/env python3
+# metrics.py - rolling per-drone and per-relay ingest statistics (BaseServer.py --metrics)
+#
+# the receive loop must not pay for this per frame, so read() only counts the read and keeps the
+# frames, and picture() appends size, capture time and arrival: O(1), tens of ns per frame. every
+# FOLD_S (the frames also once FOLD_FRAMES are kept) the receive loop folds them into per-drone
+# arrays with numpy: seq gaps, inter-arrival and transit times, and log-bucketed quantile sketches (relative
+# error ACCURACY, a fixed bucket range per drone however many samples). statistics cover the
+# previous and the current WINDOW_S, so they are between one and two windows old and lag the
+# receive loop by at most FOLD_S.
+#
+#   per drone: fps, goodput (picture bytes/s), inter-arrival p50/p99, jitter (mean change of
+#              transit time between pictures, as RFC 3550 measures it), frames lost to seq gaps,
+#              latency p50/p95/p99
+#   per relay: MB/s, frames/s, reads/s, crc errors and resyncs
+#
+# capture_ms is the drone's own millis(), so latency is measured above the fastest picture of that
+# drone in the window: queueing and relay delay, not the (unknown) constant part.
+#
+# snapshot() is what the http endpoint serves as json (GET /metrics) and what format_summary()
+# prints on the console ('metrics'). run this file to watch a running server from a terminal:
+#
+#   python3 metrics.py http://127.0.0.1:9100/metrics --every 2
+
+import argparse
+import json
+import math
+import threading
+import time
+import urllib.request
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from operator import itemgetter
+
+import numpy as np
+
+WINDOW_S = 10.0
+FOLD_S = 0.5
+FOLD_FRAMES = 1024         # frames (and their payloads) held before a fold
+ACCURACY = 0.02           # relative error of sketch quantiles
+SKETCH_MIN_MS = 0.01      # smaller values count as 0
+SKETCH_MAX_MS = 1e7
+RESTART_MS = 60_000       # a transit time jump this large means the drone's clock restarted
+SEQ_WINDOW = 0x8000       # a seq step beyond this is a duplicate or reordering, not a gap
+NODES = 256
+
+_GAMMA = (1 + ACCURACY) / (1 - ACCURACY)
+_LOG_GAMMA = math.log(_GAMMA)
+BUCKETS = int(math.ceil(math.log(SKETCH_MAX_MS / SKETCH_MIN_MS) / _LOG_GAMMA)) + 1
+# what each bucket reports: the middle of its range, within ACCURACY of anything in it
+_BUCKET_VALUE = np.concatenate(([0.0], SKETCH_MIN_MS * 2 * _GAMMA ** np.arange(1, BUCKETS) / (_GAMMA + 1)))
+_PICTURE = np.dtype([("node", np.uint8), ("size", np.int64), ("capture_ms", np.int64), ("t", np.float64)])
+_node, _seq = itemgetter(1), itemgetter(3)  # of a Frame
+
+
+def _histogram(ms):
+    """log-bucket counts of `ms`: one sketch row's worth, added to the row"""
+    k = np.ceil(np.log(np.maximum(ms, SKETCH_MIN_MS) * (1 / SKETCH_MIN_MS)) * (1 / _LOG_GAMMA))
+    return np.bincount(np.minimum(k, BUCKETS - 1).astype(np.intp), minlength=BUCKETS)
+
+
+def quantiles(row, qs):
+    """values at each q of one sketch row, None if it is empty"""
+    n = int(row.sum())
+    if not n:
+        return [None] * len(qs)
+    cum = np.cumsum(row)
+    return [float(_BUCKET_VALUE[np.searchsorted(cum, q * (n - 1), side="right")]) for q in qs]
+
+
+class _Gen:
+    """one window of every stream"""
+
+    def __init__(self, start):
+        self.start = start
+        self.relays = {}  # peer -> [reads, bytes, frames]
+        z = lambda: np.zeros(NODES, np.int64)
+        self.frames, self.pictures, self.bytes = z(), z(), z()  # bytes: of pictures
+        self.gaps, self.lost, self.reordered = z(), z(), z()
+        self.jitter_sum, self.jitter_n = np.zeros(NODES), z()
+        self.interarrival = np.zeros((NODES, BUCKETS), np.int64)  # ms between pictures
+        self.latency = np.zeros((NODES, BUCKETS), np.int64)       # ms above the fastest picture
+        self.min_transit = np.full(NODES, np.inf)
+
+
+def _drain(buf):
+    """empties a list another thread may be appending to, keeping whatever lands meanwhile"""
+    n = len(buf)
+    items = buf[:n]
+    del buf[:n]
+    return items
+
+
+def _r(v):
+    return None if v is None else round(v, 1)
+
+
+class Metrics:
+    """all streams of a base server. read() and picture() belong to the receive loop; snapshot()
+    may be called from any thread"""
+
+    def __init__(self):
+        now = time.monotonic()
+        self.started = now
+        self.cur = _Gen(now)
+        self.prev = None
+        self.lock = threading.Lock()  # fold and roll against snapshot
+        self.relay_errors = {}        # peer -> FrameParser, for its crc/resync counters
+        # not folded yet
+        self._frames = []
+        self._pictures = []           # (node, size, capture_ms, arrival s)
+        self._due = now + FOLD_S
+        # per drone, across folds
+        self.seen = np.zeros(NODES, bool)
+        self.last_seq = np.full(NODES, -1, np.int64)
+        self.last_arrival = np.full(NODES, np.nan)
+        self.last_transit = np.full(NODES, np.nan)
+        self.ref = np.full(NODES, -1, np.int64)  # first raw transit; later ones are relative to it
+
+    def read(self, peer, nbytes, frames, now):
+        r = self.cur.relays.get(peer)
+        if r is None:
+            r = self.cur.relays[peer] = [0, 0, 0]
+        r[0] += 1
+        r[1] += nbytes
+        r[2] += len(frames)
+        self._frames += frames
+        if now >= self._due:
+            self.fold(now)
+        elif len(self._frames) >= FOLD_FRAMES:  # let go of the payloads
+            with self.lock:
+                self._take_frames()
+
+    def picture(self, node, size, capture_ms, now):
+        self._pictures.append((node, size, capture_ms, now))
+
+    def attach(self, peer, parser):
+        self.relay_errors[peer] = parser
+
+    def detach(self, peer):
+        self.relay_errors.pop(peer, None)
+
+    def fold(self, now):
+        """receive loop only: buffers into the current window, which rolls every WINDOW_S"""
+        self._due = now + FOLD_S
+        with self.lock:
+            self._take_frames()
+            self._take_pictures()
+            if now - self.cur.start >= WINDOW_S:
+                # a gap of more than a window leaves nothing worth keeping
+                self.prev = self.cur if now - self.cur.start < 2 * WINDOW_S else None
+                self.cur = _Gen(now)
+
+    def _take_pictures(self):
+        pictures = _drain(self._pictures)
+        if pictures:
+            p = np.fromiter(pictures, _PICTURE, len(pictures))
+            self._fold_pictures(p["node"], p["size"], p["capture_ms"], p["t"])
+
+    def _take_frames(self):
+        frames = _drain(self._frames)
+        if frames:
+            self._fold_frames(np.fromiter(map(_node, frames), np.uint8, len(frames)),
+                              np.fromiter(map(_seq, frames), np.int64, len(frames)))
+
+    def _fold_frames(self, nodes, seqs):
+        g = self.cur
+        g.frames += np.bincount(nodes, minlength=NODES)
+        self.seen[nodes] = True
+        order = np.argsort(nodes, kind="stable")  # radix sort on uint8
+        ns, ss = nodes[order].astype(np.intp), seqs[order]
+        first = np.empty(len(ns), bool)
+        first[0] = True
+        first[1:] = ns[1:] != ns[:-1]
+        prev = np.empty_like(ss)
+        prev[1:] = ss[:-1]
+        prev[first] = self.last_seq[ns[first]]
+        step = (ss - prev) & 0xFFFF
+        known = prev >= 0
+        gap = known & (step > 1) & (step < SEQ_WINDOW)
+        g.gaps += np.bincount(ns[gap], minlength=NODES)
+        g.lost += np.bincount(ns[gap], step[gap] - 1, minlength=NODES).astype(np.int64)
+        odd = known & ((step == 0) | (step >= SEQ_WINDOW))
+        g.reordered += np.bincount(ns[odd], minlength=NODES)
+        last = np.empty(len(ns), bool)
+        last[:-1] = first[1:]
+        last[-1] = True
+        self.last_seq[ns[last]] = ss[last]
+
+    def _fold_pictures(self, nodes, sizes, capture_ms, t):
+        g = self.cur
+        order = np.argsort(nodes, kind="stable")  # radix sort on uint8
+        nodes, sizes, capture_ms, t = nodes[order], sizes[order], capture_ms[order], t[order]
+        g.pictures += np.bincount(nodes, minlength=NODES)
+        g.bytes += np.bincount(nodes, sizes, minlength=NODES).astype(np.int64)
+        # transit = receive - capture on two unrelated clocks; only its changes mean anything
+        raw = (np.floor(t * 1e3).astype(np.int64) - capture_ms) & 0xFFFFFFFF
+        bounds = np.flatnonzero(nodes[1:] != nodes[:-1]) + 1
+        for lo, hi in zip([0, *bounds], [*bounds, len(nodes)]):
+            self._drone_pictures(int(nodes[lo]), t[lo:hi], raw[lo:hi])
+
+    def _drone_pictures(self, n, t, raw):
+        """one drone's pictures of this fold, in arrival order"""
+        g, p = self.cur, self.prev
+        before = self.last_arrival[n]
+        ia = np.diff(t) if np.isnan(before) else np.diff(t, prepend=before)
+        g.interarrival[n] += _histogram(ia * 1e3)
+        self.last_arrival[n] = t[-1]
+        if self.ref[n] < 0:
+            self.ref[n] = raw[0]
+        transit = (((raw - self.ref[n] + 0x80000000) & 0xFFFFFFFF) - 0x80000000).astype(np.float64)
+        before = self.last_transit[n]
+        jump = np.abs(np.diff(transit) if np.isnan(before) else np.diff(transit, prepend=before))
+        if len(jump) and jump.max() > RESTART_MS:
+            # the drone rebooted: new clock. its next pictures set a new baseline
+            self.ref[n] = -1
+            self.last_transit[n] = np.nan
+            for gen in (g, p):
+                if gen is not None:
+                    gen.min_transit[n] = np.inf
+            return
+        g.jitter_sum[n] += jump.sum()
+        g.jitter_n[n] += len(jump)
+        g.min_transit[n] = min(g.min_transit[n], transit.min())
+        floor = g.min_transit[n] if p is None else min(g.min_transit[n], p.min_transit[n])
+        g.latency[n] += _histogram(transit - floor)
+        self.last_transit[n] = transit[-1]
+
+    def snapshot(self):
+        now = time.monotonic()
+        with self.lock:
+            # what the last reads before the traffic stopped left unfolded
+            self._take_frames()
+            self._take_pictures()
+            g, p = self.cur, self.prev
+            age = now - g.start
+            if age >= WINDOW_S:  # quiet since: roll, as the next fold would
+                p = g if age < 2 * WINDOW_S else None
+                g = _Gen(g.start + WINDOW_S * (age // WINDOW_S))
+            span = max(now - (p.start if p else g.start), 1e-3)
+            gens = [x for x in (g, p) if x is not None]
+
+            def total(field):
+                return sum(getattr(x, field) for x in gens)
+
+            relays = {}
+            for peer, parser in list(self.relay_errors.items()):
+                reads, nbytes, frames = (sum(x.relays.get(peer, (0, 0, 0))[i] for x in gens) for i in range(3))
+                relays[peer] = {"frames": frames, "frames_per_s": round(frames / span, 1),
+                                "bytes_per_s": round(nbytes / span), "reads_per_s": round(reads / span, 1),
+                                "crc_errors": parser.crc_errors, "resyncs": parser.resyncs}
+            frames, nbytes, pictures = total("frames"), total("bytes"), total("pictures")
+            gaps, lost, reordered = total("gaps"), total("lost"), total("reordered")
+            jitter_sum, jitter_n = total("jitter_sum"), total("jitter_n")
+            ia, lat = total("interarrival"), total("latency")
+            drones = {}
+            for n in np.nonzero(self.seen)[0]:
+                if not n:  # the primary's own frames (mosaic, fleet summary) count for the relay only
+                    continue
+                ia_q = quantiles(ia[n], (0.5, 0.99))
+                lat_q = quantiles(lat[n], (0.5, 0.95, 0.99))
+                drones[str(n)] = {
+                    "window_s": round(span, 1), "frames": int(frames[n]),
+                    "frames_per_s": round(frames[n] / span, 1), "fps": round(pictures[n] / span, 1),
+                    "goodput_bytes_per_s": round(float(nbytes[n]) / span),
+                    "interarrival_ms": {"p50": _r(ia_q[0]), "p99": _r(ia_q[1])},
+                    "jitter_ms": round(jitter_sum[n] / jitter_n[n], 1) if jitter_n[n] else None,
+                    "gaps": int(gaps[n]), "lost": int(lost[n]), "reordered": int(reordered[n]),
+                    "latency_ms": {"p50": _r(lat_q[0]), "p95": _r(lat_q[1]), "p99": _r(lat_q[2])}}
+        return {"time": time.time(), "uptime_s": round(now - self.started, 1), "window_s": WINDOW_S,
+                "relays": relays, "drones": drones}
+
+    def serve(self, host, port):
+        """json snapshot on http://host:port/metrics from a daemon thread; returns the bound port"""
+        metrics = self
+
+        class Handler(BaseHTTPRequestHandler):
+            def do_GET(self):
+                if self.path.split("?")[0] not in ("/", "/metrics"):
+                    self.send_error(404)
+                    return
+                body = json.dumps(metrics.snapshot()).encode()
+                self.send_response(200)
+                self.send_header("Content-Type", "application/json")
+                self.send_header("Content-Length", str(len(body)))
+                self.end_headers()
+                self.wfile.write(body)
+
+            def log_message(self, *args):  # no line per request on the server's console
+                pass
+
+        httpd = ThreadingHTTPServer((host, port), Handler)
+        httpd.daemon_threads = True
+        threading.Thread(target=httpd.serve_forever, name="metrics", daemon=True).start()
+        return httpd.server_address[1]
+
+
+def format_summary(snap):
+    """the snapshot as a terminal table"""
+    lines = [f"{'relay':>21} {'MB/s':>7} {'frames/s':>9} {'reads/s':>8} {'crc':>5} {'resync':>6}"]
+    for peer, r in snap["relays"].items():
+        lines.append(f"{peer:>21} {r['bytes_per_s'] / 1e6:7.2f} {r['frames_per_s']:9.1f} "
+                     f"{r['reads_per_s']:8.1f} {r['crc_errors']:5d} {r['resyncs']:6d}")
+    lines.append(f"{'drone':>5} {'fps':>6} {'KB/s':>7} {'ia p50':>7} {'ia p99':>7} {'jitter':>7} "
+                 f"{'lost':>5} {'gaps':>5} {'lat p50':>8} {'p95':>6} {'p99':>6}  (ms; last {snap['window_s']:g}-"
+                 f"{2 * snap['window_s']:g} s)")
+    for node, d in snap["drones"].items():
+        ia, lat = d["interarrival_ms"], d["latency_ms"]
+        lines.append(f"{node:>5} {d['fps']:6.1f} {d['goodput_bytes_per_s'] / 1e3:7.0f} {_f(ia['p50']):>7} "
+                     f"{_f(ia['p99']):>7} {_f(d['jitter_ms'], 1):>7} {d['lost']:5d} {d['gaps']:5d} "
+                     f"{_f(lat['p50']):>8} {_f(lat['p95']):>6} {_f(lat['p99']):>6}")
+    return "\n".join(lines)
+
+
+def _f(v, digits=0):
+    return "-" if v is None else f"{v:.{digits}f}"
+
+
+def main():
+    p = argparse.ArgumentParser(description="Print a running base server's metrics")
+    p.add_argument("url", nargs="?", default="http://127.0.0.1:9100/metrics")
+    p.add_argument("--every", type=float, default=2.0, help="seconds between refreshes (0: once)")
+    args = p.parse_args()
+    while True:
+        with urllib.request.urlopen(args.url, timeout=5) as resp:
+            snap = json.load(resp)
+        if args.every:
+            print("\033[H\033[J", end="")  # clear the terminal
+        print(f"{args.url}  up {snap['uptime_s']:.0f} s")
+        print(format_summary(snap))
+        if not args.every:
+            return
+        time.sleep(args.every)
+
+
+if __name__ == "__main__":
+    try:
+        main()
+    except KeyboardInterrupt:
+        pass
@@ -0,0 +1,248 @@
+# mission.py - indexed mission recording: every crc-checked frame the base received, seekable
+#
+# a mission directory holds
+#   mission.json       version, wall clock start, segment size
+#   seg00000.dat ...   append-only data segments: frame payloads back to back, nothing else
+#   index.bin          one INDEX record per frame in receive order (times never go backwards)
+#   node<N>.idx        u32 record numbers of node N's frames, for per-node seeks
+#   relay<R>-node<N>.idx  the same for node N behind primary connection R (R = 0 has no prefix)
+# every record carries the relay: the number BaseServer.py gave the primary connection it came in
+# on, so node 0 (each primary's mosaics and fleet summaries) and any node id two primaries share
+# stay separate streams.
+# the writer only appends, so a mission that was cut short (power, crash) stays readable: the
+# reader ignores a torn index record and any record whose bytes never reached its segment, and
+# reindex() rebuilds node indexes that lost their unflushed tail.
+# MissionReader memory-maps everything and seeks by receive time, per node or overall, by binary
+# search; nothing is scanned or loaded up front, so multi-GB recordings open instantly.
+
+import array
+import bisect
+import json
+import mmap
+import os
+import re
+import struct
+import time
+from collections import namedtuple
+
+from swarm_proto import MSG_FLEET_SUMMARY, MSG_JPEG_FRAME, MSG_JPEG_SLICE, MSG_MOSAIC, Frame
+
+MISSION_VERSION = 1
+# recv_us, capture_ms, offset, length, segment, seq, node, type, flags, relay
+INDEX = struct.Struct("<QIIIHHBBBB")
+NODE_INDEX = struct.Struct("<I")
+SEGMENT_BYTES = 1 << 30
+CAPTURE_MS = struct.Struct(">I")
+CAPTURE_TYPES = {MSG_JPEG_FRAME, MSG_JPEG_SLICE, MSG_MOSAIC, MSG_FLEET_SUMMARY}  # payloads start with capture_ms
+
+Record = namedtuple("Record", "recv_us capture_ms offset length segment seq node type flags relay")
+STREAM_INDEX = re.compile(r"(?:relay(\d+)-)?node(\d+)\.idx")
+
+
+def segment_name(n):
+    return f"seg{n:05d}.dat"
+
+
+def stream_name(relay, node):
+    """node<N>, or relay<R>-node<N> behind any but the first primary connection"""
+    return f"relay{relay}-node{node}" if relay else f"node{node}"
+
+
+class MissionWriter:
+    """appends frames; owned by one thread (the recorder's writer)"""
+
+    def __init__(self, path, segment_bytes=SEGMENT_BYTES, buffer_bytes=1 << 20):
+        os.makedirs(path, exist_ok=True)
+        if os.listdir(path):
+            raise FileExistsError(f"{path} is not empty")
+        self.path = path
+        self.segment_bytes = segment_bytes
+        self.buffer_bytes = buffer_bytes
+        self.start_us = time.time_ns() // 1000
+        with open(os.path.join(path, "mission.json"), "w") as f:
+            json.dump({"version": MISSION_VERSION, "start_unix_us": self.start_us,
+                       "segment_bytes": segment_bytes}, f)
+        self.index = open(os.path.join(path, "index.bin"), "ab", buffering=buffer_bytes)
+        self.node_files = {}
+        self.frames = 0
+        self.bytes = 0
+        self.segment = -1
+        self.data = None
+        self.offset = 0
+        self.last_us = 0
+        self._next_segment()
+
+    def _next_segment(self):
+        if self.data:
+            self.data.close()
+        self.segment += 1
+        self.data = open(os.path.join(self.path, segment_name(self.segment)), "ab", buffering=self.buffer_bytes)
+        self.offset = 0
+
+    def append(self, recv_us, frame, relay=0):
+        payload = frame.payload
+        if self.offset and self.offset + len(payload) > self.segment_bytes:
+            self._next_segment()
+        recv_us = max(recv_us, self.last_us)  # the wall clock may step back; the index must not
+        self.last_us = recv_us
+        capture_ms = CAPTURE_MS.unpack_from(payload)[0] if frame.type in CAPTURE_TYPES else 0
+        self.data.write(payload)  # data before its index record, so a torn tail is detectable
+        self.index.write(INDEX.pack(recv_us, capture_ms, self.offset, len(payload), self.segment, frame.seq,
+                                    frame.node, frame.type, frame.flags, relay))
+        key = (relay, frame.node)
+        f = self.node_files.get(key)
+        if f is None:
+            f = self.node_files[key] = open(os.path.join(self.path, stream_name(*key) + ".idx"), "ab",
+                                            buffering=64 * 1024)
+        f.write(NODE_INDEX.pack(self.frames))
+        self.offset += len(payload)
+        self.frames += 1
+        self.bytes += len(payload)
+
+    def flush(self):
+        # data first, then what points at it
+        self.data.flush()
+        self.index.flush()
+        for f in self.node_files.values():
+            f.flush()
+
+    def close(self):
+        self.flush()
+        self.data.close()
+        self.index.close()
+        for f in self.node_files.values():
+            f.close()
+
+
+class _Times:
+    """receive times of a list of record numbers, as a sequence bisect can search"""
+
+    def __init__(self, reader, rows=None):
+        self.reader = reader
+        self.rows = rows
+
+    def __len__(self):
+        return len(self.rows) if self.rows is not None else len(self.reader)
+
+    def __getitem__(self, i):
+        return self.reader.recv_us(self.rows[i] if self.rows is not None else i)
+
+
+class MissionReader:
+    def __init__(self, path):
+        self.path = path
+        with open(os.path.join(path, "mission.json")) as f:
+            meta = json.load(f)
+        if meta.get("version") != MISSION_VERSION:
+            raise ValueError(f"{path}: mission version {meta.get('version')} not supported")
+        self.start_us = meta["start_unix_us"]
+        self._segments = {}    # number -> mmap, opened on first use
+        self._seg_sizes = {}
+        self._index = self._map(os.path.join(path, "index.bin"))
+        n = len(self._index) // INDEX.size if self._index else 0
+        while n and not self._complete(n - 1):  # torn tail of an interrupted mission
+            n -= 1
+        self._n = n
+        self._nodes = {}  # (relay, node) -> record numbers
+        for name in os.listdir(path):
+            match = STREAM_INDEX.fullmatch(name)
+            if match:
+                m = self._map(os.path.join(path, name)) or memoryview(b"")
+                rows = m[:len(m) // NODE_INDEX.size * NODE_INDEX.size].cast("I")  # little endian, as written
+                k = len(rows)
+                while k and rows[k - 1] >= n:
+                    k -= 1
+                self._nodes[int(match[1] or 0), int(match[2])] = rows[:k]
+        # fewer node rows than frames: the node indexes lost their buffered tail
+        self.partial_node_index = sum(map(len, self._nodes.values())) < n
+
+    @staticmethod
+    def _map(name):
+        with open(name, "rb") as f:
+            if os.fstat(f.fileno()).st_size == 0:
+                return None
+            return memoryview(mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ))
+
+    def _segment(self, n):
+        m = self._segments.get(n)
+        if m is None:
+            m = self._segments[n] = self._map(os.path.join(self.path, segment_name(n))) or memoryview(b"")
+        return m
+
+    def _complete(self, i):
+        r = self.record(i)
+        size = self._seg_sizes.get(r.segment)
+        if size is None:
+            p = os.path.join(self.path, segment_name(r.segment))
+            size = self._seg_sizes[r.segment] = os.path.getsize(p) if os.path.exists(p) else -1
+        return r.offset + r.length <= size
+
+    def __len__(self):
+        return self._n
+
+    def streams(self):
+        """(relay, node) of every node with frames, one per primary connection it came in on"""
+        return sorted(k for k, rows in self._nodes.items() if len(rows))
+
+    def node_frames(self, node, relay=0):
+        return len(self._nodes.get((relay, node), ()))
+
+    def record(self, i):
+        return Record._make(INDEX.unpack_from(self._index, i * INDEX.size))
+
+    def recv_us(self, i):
+        return struct.unpack_from("<Q", self._index, i * INDEX.size)[0]
+
+    def payload(self, i):
+        """memoryview into the mapped segment; valid while the reader is open"""
+        r = self.record(i)
+        return self._segment(r.segment)[r.offset:r.offset + r.length]
+
+    def frame(self, i):
+        r = self.record(i)
+        return Frame(r.type, r.node, r.flags, r.seq, bytes(self.payload(i)))
+
+    def duration_us(self):
+        return self.recv_us(self._n - 1) - self.start_us if self._n else 0
+
+    def seek(self, t_us, node=None, relay=0):
+        """position of the first frame received at or after mission time t_us (of `node` behind
+        `relay`, if given): an index into the whole recording, or into rows(node, relay)"""
+        t = self.start_us + t_us
+        if node is None:
+            return bisect.bisect_left(_Times(self), t)
+        return bisect.bisect_left(_Times(self, self.rows(node, relay)), t)
+
+    def rows(self, node, relay=0):
+        """record numbers of `node`'s frames from primary connection `relay`, in receive order"""
+        return self._nodes.get((relay, node), ())
+
+    def between(self, t0_us, t1_us, node=None, relay=0):
+        """record numbers of the frames received in [t0_us, t1_us) of mission time"""
+        lo, hi = self.seek(t0_us, node, relay), self.seek(t1_us, node, relay)
+        if node is None:
+            return range(lo, hi)
+        return self.rows(node, relay)[lo:hi]
+
+    def close(self):
+        # the mappings go with the last view of them
+        self._segments.clear()
+        self._nodes.clear()
+        self._index = None
+
+
+def reindex(path):
+    """rewrite every node index from index.bin (one linear pass), e.g. after a crash"""
+    r = MissionReader(path)
+    rows = {}
+    for i in range(len(r)):
+        rec = r.record(i)
+        rows.setdefault((rec.relay, rec.node), []).append(i)
+    r.close()
+    for name in os.listdir(path):
+        if STREAM_INDEX.fullmatch(name):
+            os.remove(os.path.join(path, name))
+    for key, nums in rows.items():
+        with open(os.path.join(path, stream_name(*key) + ".idx"), "wb") as f:
+            array.array("I", nums).tofile(f)
+    return len(rows)
@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+# mission_play.py - look into and export from a mission recording (BaseServer.py --mission)
+#
+#   python3 mission_play.py info recordings/mission-20260101-120000
+#   python3 mission_play.py list MISSION --node 3 --from 1:05:00 --to 1:05:10
+#   python3 mission_play.py export MISSION --node 3 --from 65:00 --to 70:00 --out clip   # clip/node3.mjpeg
+#   python3 mission_play.py export MISSION --at 1:05:00 --out still                   # one picture per node
+#   python3 mission_play.py export MISSION --node 0 --relay 1 --out mosaics          # the second primary's
+#   python3 mission_play.py reindex MISSION   # after a crash left the node indexes short
+#
+# times are mission time (since the recording started) as seconds, mm:ss or hh:mm:ss. every seek
+# is a binary search over the memory-mapped index, and export reads only the frames it writes.
+# a node is kept apart per primary connection (relay) it came in on: --node picks it behind every
+# relay unless --relay narrows it down, and exports behind relay R > 0 are named relay<R>-node<N>.
+
+import argparse
+import heapq
+import os
+import sys
+
+from jpeg_slices import SliceAssembler, parse_slice
+from mission import MissionReader, reindex, stream_name
+from swarm_proto import JPEG_HEADER, KNOWN_TYPES, MSG_JPEG_FRAME, MSG_JPEG_SLICE, MSG_MOSAIC, parse_mosaic
+
+
+def parse_time(text):
+    """'90', '1:30', '0:01:30.5' -> microseconds"""
+    secs = 0.0
+    for part in text.split(":"):
+        secs = secs * 60 + float(part)
+    return int(secs * 1e6)
+
+
+def fmt_time(us):
+    ms = us // 1000
+    return f"{ms // 3600000}:{ms // 60000 % 60:02d}:{ms // 1000 % 60:02d}.{ms % 1000:03d}"
+
+
+def chosen(r, args):
+    """(relay, node) of the streams --node / --relay pick, all of them by default"""
+    return [(relay, node) for relay, node in r.streams()
+            if (args.node is None or node == args.node) and (args.relay is None or relay == args.relay)]
+
+
+def cmd_info(r, args):
+    print(f"{args.mission}: {len(r)} frames over {fmt_time(r.duration_us())}")
+    for relay, node in r.streams():
+        rows = r.rows(node, relay)
+        first, last = r.recv_us(rows[0]) - r.start_us, r.recv_us(rows[-1]) - r.start_us
+        print(f"  relay {relay:3d} node {node:3d}: {len(rows):8d} frames  {fmt_time(first)} .. {fmt_time(last)}")
+    if r.partial_node_index:
+        print("  node indexes are missing frames at the end: run reindex")
+
+
+def cmd_list(r, args):
+    if args.node is None:
+        rows = r.between(args.start, args.end)
+        if args.relay is not None:
+            rows = [i for i in rows if r.record(i).relay == args.relay]
+    else:  # record numbers are in receive order, so the streams merge by them
+        rows = list(heapq.merge(*(r.between(args.start, args.end, node, relay)
+                                  for relay, node in chosen(r, args))))
+    for k, i in enumerate(rows):
+        if k == args.limit:
+            print(f"... {len(rows) - k} more")
+            break
+        rec = r.record(i)
+        print(f"{fmt_time(rec.recv_us - r.start_us)}  relay {rec.relay:3d}  node {rec.node:3d}  "
+              f"{KNOWN_TYPES.get(rec.type, rec.type):10s} "
+              f"seq {rec.seq:5d}  capture {rec.capture_ms:10d} ms  {rec.length:7d} bytes")
+
+
+def pictures(r, rows):
+    """(record, capture_ms, jpeg) for every picture in `rows` of one node behind one relay"""
+    asm = SliceAssembler()
+    rec = None
+    for i in rows:
+        rec = r.record(i)
+        if rec.type == MSG_JPEG_FRAME:
+            yield rec, rec.capture_ms, r.payload(i)[JPEG_HEADER.size:]
+        elif rec.type == MSG_JPEG_SLICE:
+            for pic in asm.add(parse_slice(r.frame(i))):
+                yield rec, pic.capture_ms, pic.jpeg
+        elif rec.type == MSG_MOSAIC:
+            yield rec, rec.capture_ms, parse_mosaic(r.frame(i)).jpeg
+    for pic in asm.flush():
+        yield rec, pic.capture_ms, pic.jpeg
+
+
+def cmd_export(r, args):
+    os.makedirs(args.out, exist_ok=True)
+    total = 0
+    for relay, node in chosen(r, args):
+        name = stream_name(relay, node)
+        if args.at is not None:
+            # the picture on screen at that time: the last one received at or before it, which
+            # for sliced pictures means starting a little earlier to catch its headers packet
+            rows = r.rows(node, relay)
+            k = r.seek(args.at + 1, node, relay)
+            got = None
+            for rec, capture_ms, jpeg in pictures(r, rows[max(0, k - 256):k]):
+                got = (rec, capture_ms, jpeg)
+            if got:
+                rec, capture_ms, jpeg = got
+                with open(os.path.join(args.out, f"{name}_{(rec.recv_us - r.start_us) // 1000}.jpg"), "wb") as f:
+                    f.write(jpeg)
+                total += 1
+            continue
+        rows = r.between(args.start, args.end, node, relay)
+        if args.format == "mjpeg":
+            with open(os.path.join(args.out, f"{name}.mjpeg"), "wb") as f:
+                for _rec, _capture_ms, jpeg in pictures(r, rows):
+                    f.write(jpeg)
+                    total += 1
+        else:
+            d = os.path.join(args.out, name)
+            os.makedirs(d, exist_ok=True)
+            for rec, capture_ms, jpeg in pictures(r, rows):
+                with open(os.path.join(d, f"{(rec.recv_us - r.start_us) // 1000:010d}_{capture_ms}.jpg"), "wb") as f:
+                    f.write(jpeg)
+                total += 1
+    print(f"exported {total} pictures to {args.out}/")
+
+
+def main():
+    p = argparse.ArgumentParser(description="Mission recording playback / export")
+    sub = p.add_subparsers(dest="cmd", required=True)
+    for name in ("info", "list", "export", "reindex"):
+        s = sub.add_parser(name)
+        s.add_argument("mission")
+        if name in ("list", "export"):
+            s.add_argument("--node", type=int)
+            s.add_argument("--relay", type=int, help="only frames from this primary connection")
+            s.add_argument("--from", dest="start", type=parse_time, default=0)
+            s.add_argument("--to", dest="end", type=parse_time, default=1 << 62)
+        if name == "list":
+            s.add_argument("--limit", type=int, default=50)
+        if name == "export":
+            s.add_argument("--out", required=True)
+            s.add_argument("--format", choices=("mjpeg", "jpeg"), default="mjpeg")
+            s.add_argument("--at", type=parse_time, help="only the picture showing at this time")
+    args = p.parse_args()
+
+    if args.cmd == "reindex":
+        print(f"rebuilt the indexes of {reindex(args.mission)} node streams")
+        return
+    r = MissionReader(args.mission)
+    try:
+        {"info": cmd_info, "list": cmd_list, "export": cmd_export}[args.cmd](r, args)
+    except BrokenPipeError:  # | head
+        sys.stderr.close()
+    finally:
+        r.close()
+
+
+if __name__ == "__main__":
+    main()
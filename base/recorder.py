@@ -0,0 +1,134 @@
+# recorder.py - per-node picture recording for BaseServer.py on a dedicated writer thread
+#
+# the receive loop only queues (node, picture) and goes back to the sockets; one writer thread owns
+# every file. "mjpeg" appends each node's pictures to recordings/node<N>.mjpeg (a plain
+# concatenation of JPEGs, which ffplay / vlc play as -f mjpeg), kept open with a large buffer;
+# "jpeg" writes recordings/node<N>/<count>_<capture_ms>.jpg. BaseServer.py stops reading its
+# sockets while behind() and resumes once caught_up(), so a slow disk pushes back on the primaries
+# through tcp flow control; a picture that still finds the queue full is dropped and counted.
+# with a mission directory every received frame is also kept in mission.py's indexed format.
+# the latest mosaic from the primaries replaces recordings/mosaic.jpg (whatever the format).
+
+import os
+import queue
+import threading
+from collections import defaultdict
+
+from mission import MissionWriter
+
+FORMATS = ("mjpeg", "jpeg", "none")
+
+
+class Recorder:
+    def __init__(self, root="recordings", fmt="mjpeg", raw=False, mission=None, queue_items=512,
+                 buffer_bytes=1 << 20):
+        if fmt not in FORMATS:
+            raise ValueError(f"unknown format {fmt}")
+        self.root = root
+        self.fmt = fmt
+        self.buffer_bytes = buffer_bytes
+        self.pictures = defaultdict(int)  # node -> pictures written
+        self.bytes = 0
+        self.dropped = 0
+        self._files = {}  # node (or "raw") -> open file
+        self._q = queue.Queue(maxsize=queue_items)
+        self._high = queue_items // 2  # headroom for the pictures of reads already in progress
+        self._low = queue_items // 8
+        self.raw_enabled = raw
+        if fmt != "none" or raw:
+            os.makedirs(root, exist_ok=True)
+        self.mission = MissionWriter(mission, buffer_bytes=buffer_bytes) if mission else None
+        self._thread = threading.Thread(target=self._run, name="recorder", daemon=True)
+        self._thread.start()
+
+    def picture(self, node, capture_ms, jpeg):
+        """queue one picture of `node`; never blocks the caller"""
+        if self.fmt != "none":
+            self._put(("pic", node, capture_ms, jpeg))
+
+    def mosaic(self, jpeg):
+        """the primary's latest composite of every node's thumbnail, for mosaic.jpg"""
+        self._put(("mosaic", None, 0, jpeg))
+
+    def frames(self, recv_us, frames, relay=0):
+        """every frame of one read from primary connection `relay`, for the mission recording;
+        one queue item per read"""
+        if self.mission and frames:
+            self._put(("frames", relay, recv_us, frames))
+
+    def raw(self, data):
+        """the undecoded stream, for debugging the framing (--raw)"""
+        if self.raw_enabled:
+            self._put(("raw", None, 0, data))
+
+    def _put(self, item):
+        try:
+            self._q.put_nowait(item)
+        except queue.Full:
+            self.dropped += 1
+
+    def behind(self):
+        return self._q.qsize() >= self._high
+
+    def caught_up(self):
+        return self._q.qsize() <= self._low
+
+    def close(self):
+        self._q.put(None)
+        self._thread.join()
+
+    def _file(self, key, name):
+        f = self._files.get(key)
+        if f is None:
+            f = self._files[key] = open(os.path.join(self.root, name), "ab", buffering=self.buffer_bytes)
+        return f
+
+    def _write(self, kind, node, stamp, data):
+        # stamp: capture_ms of a picture, receive time of a batch of frames (whose node is the relay)
+        if kind == "frames":
+            for frame in data:
+                self.mission.append(stamp, frame, node)
+            return
+        if kind == "mosaic":
+            os.makedirs(self.root, exist_ok=True)
+            path = os.path.join(self.root, "mosaic.jpg")
+            with open(path + ".tmp", "wb") as f:
+                f.write(data)
+            os.replace(path + ".tmp", path)  # a viewer reading it never sees half a picture
+            self.bytes += len(data)
+            return
+        if kind == "raw":
+            self._file("raw", "received.bin").write(data)
+        elif self.fmt == "mjpeg":
+            self._file(node, f"node{node}.mjpeg").write(data)
+        else:
+            d = os.path.join(self.root, f"node{node}")
+            if self.pictures[node] == 0:
+                os.makedirs(d, exist_ok=True)
+            with open(os.path.join(d, f"{self.pictures[node]:06d}_{stamp}.jpg"), "wb") as f:
+                f.write(data)
+        if kind != "raw":
+            self.pictures[node] += 1
+        self.bytes += len(data)
+
+    def _run(self):
+        while True:
+            try:
+                item = self._q.get(timeout=1.0)
+            except queue.Empty:
+                for f in self._files.values():  # idle: make what we have visible on disk
+                    f.flush()
+                if self.mission:
+                    self.mission.flush()
+                continue
+            if item is None:
+                break
+            try:
+                self._write(*item)
+            except OSError as e:
+                print("Recorder write failed:", e)
+        for f in self._files.values():
+            f.close()
+        self._files.clear()
+        if self.mission:
+            self.mission.close()
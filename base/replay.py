@@ -0,0 +1,260 @@
+#!/usr/bin/env python3
+# replay.py - re-inject a mission recording (BaseServer.py --mission) into a primary or a base
+#
+#   --as primaries   one connection per recorded primary (relay) and copy, each carrying every
+#                    node that came in on it, like that primary's uplink; point it at BaseServer.py
+#   --as secondaries one connection per recorded node behind each relay (and copy), each sending
+#                    only that node's frames, like the secondaries; point it at a primary's
+#                    SERVER_PORT. the primaries' own frames (node 0: mosaics, fleet summaries) are
+#                    left out
+# copies get their own node ids (node + copy * span) so the receiver sees distinct nodes; as
+# secondaries, so does each relay of a copy, since they all go to the one primary.
+#
+# frames go out on the recorded receive-time schedule divided by `--speed` (1 = real time,
+# 10 = ten times faster) or, with --speed 0, as fast as the target takes them. the same recording
+# and settings always produce the same byte stream on every connection, so runs are comparable.
+# reported: throughput, and how late frames went out against the schedule (a target that cannot
+# keep up pushes back through tcp and shows up here). with --listen the tool also plays the base
+# for a primary under test, matches the relayed frames by (node, seq) and reports relay latency.
+# a send is only matched for PENDING_S: one the primary never relayed cannot be taken for a later
+# frame once a long replay has wrapped the seq counter.
+#
+#   python3 replay.py recordings/mission-20260101-120000 --target 127.0.0.1:9000 --copies 20 --speed 0
+#   python3 replay.py MISSION --as secondaries --target 192.168.4.1:8000 --listen 9000 --speed 1
+#   python3 replay.py MISSION --target 127.0.0.1:9000 --from 10:00 --to 20:00 --report run.json
+
+import argparse
+import heapq
+import json
+import socket
+import threading
+import time
+from collections import deque
+
+from mission import MissionReader
+from mission_play import parse_time
+from swarm_proto import FrameParser, encode_frame
+
+CHUNK_BYTES = 256 * 1024  # frames due together are sent with one sendall
+PENDING_S = 10.0          # a relayed frame later than this is not matched to its send
+MAX_SLEEP_S = 0.05
+
+
+def percentile(values, q):
+    if not values:
+        return 0.0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(q * len(values)))]
+
+
+class Stream:
+    """one synthetic sender: a connection and the record numbers it replays"""
+
+    def __init__(self, name, rows, node_offset):
+        self.name = name
+        self.rows = rows
+        self.node_offset = node_offset
+        self.frames = 0
+        self.bytes = 0
+        self.late = []      # seconds behind schedule, one sample per send
+        self.done = None    # when the last frame was handed to the socket
+        self.error = None
+
+
+class Uplink:
+    """the base side for a primary under test: arrival time per relayed (node, seq)"""
+
+    def __init__(self, port):
+        self.listener = socket.create_server(("0.0.0.0", port))
+        self.sent = {}      # (node, seq) -> send time, for PENDING_S
+        self.order = deque()  # (send time, (node, seq)) in send order, to expire them
+        self.latency = []
+        self.unmatched = 0
+        self.lock = threading.Lock()
+        self.conn = None
+
+    def accept(self):
+        print(f"waiting for the primary on :{self.listener.getsockname()[1]}")
+        self.conn, addr = self.listener.accept()
+        print(f"primary connected from {addr[0]}")
+        threading.Thread(target=self._run, daemon=True).start()
+
+    def note_sent(self, keys, t):
+        with self.lock:
+            order, sent = self.order, self.sent
+            while order and order[0][0] < t - PENDING_S:
+                old, k = order.popleft()
+                if sent.get(k) == old:  # not relayed, nor sent again since
+                    del sent[k]
+            for k in keys:
+                sent[k] = t
+                order.append((t, k))
+
+    def _run(self):
+        parser = FrameParser()
+        while True:
+            with parser.writable() as mv:
+                n = self.conn.recv_into(mv)
+            if not n:
+                return
+            now = time.monotonic()
+            for f in parser.filled(n):
+                with self.lock:
+                    t = self.sent.pop((f.node, f.seq), None)
+                if t is None or now - t > PENDING_S:
+                    self.unmatched += 1
+                else:
+                    self.latency.append(now - t)
+
+
+def run_stream(s, r, target, t0_us, speed, start, uplink):
+    try:
+        sock = socket.create_connection(target)
+        sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        start.wait()
+        began = time.monotonic()
+        k, n = 0, len(s.rows)
+        while k < n:
+            if speed:
+                due = began + (r.recv_us(s.rows[k]) - t0_us) / 1e6 / speed
+                wait = due - time.monotonic()
+                if wait > 0:
+                    time.sleep(min(wait, MAX_SLEEP_S))
+                    continue
+            # everything already due (or everything, unpaced), up to one chunk
+            now_us = t0_us + (time.monotonic() - began) * speed * 1e6 if speed else None
+            chunk, keys, first = [], [], k
+            size = 0
+            while k < n and size < CHUNK_BYTES:
+                i = s.rows[k]
+                rec = r.record(i)
+                if now_us is not None and k > first and rec.recv_us > now_us:
+                    break
+                node = rec.node + s.node_offset if rec.node else rec.node
+                data = encode_frame(rec.type, node, rec.seq, r.payload(i), rec.flags)
+                chunk.append(data)
+                keys.append((node, rec.seq))
+                size += len(data)
+                k += 1
+            if speed:
+                s.late.append(time.monotonic() - (began + (r.recv_us(s.rows[first]) - t0_us) / 1e6 / speed))
+            if uplink:
+                uplink.note_sent(keys, time.monotonic())
+            sock.sendall(b"".join(chunk))
+            s.frames += len(chunk)
+            s.bytes += size
+        s.done = time.monotonic()
+        sock.shutdown(socket.SHUT_WR)
+        sock.settimeout(5.0)
+        try:
+            while sock.recv(65536):  # a base closes once it has consumed everything
+                pass
+        except (socket.timeout, OSError):
+            pass  # a primary keeps the connection open
+        sock.close()
+    except OSError as e:
+        s.error = e
+
+
+def main():
+    p = argparse.ArgumentParser(description="Replay a mission recording into a primary or base")
+    p.add_argument("mission")
+    p.add_argument("--target", required=True, help="host:port to connect to")
+    p.add_argument("--as", dest="role", choices=("primaries", "secondaries"), default="primaries")
+    p.add_argument("--copies", type=int, default=1, help="replay the recording this many times side by side")
+    p.add_argument("--speed", type=float, default=1.0, help="1 = real time, N = N times faster, 0 = unpaced")
+    p.add_argument("--node", type=int, action="append", help="only these recorded nodes (repeatable)")
+    p.add_argument("--from", dest="start", type=parse_time, default=0)
+    p.add_argument("--to", dest="end", type=parse_time, default=1 << 62)
+    p.add_argument("--listen", type=int, metavar="PORT", help="act as the base for the primary under test")
+    p.add_argument("--report", help="write the summary as json")
+    args = p.parse_args()
+
+    host, port = args.target.rsplit(":", 1)
+    target = (host, int(port))
+    r = MissionReader(args.mission)
+    keys = [(relay, n) for relay, n in r.streams() if (args.node is None or n in args.node)]
+    if args.role == "secondaries":
+        keys = [(relay, n) for relay, n in keys if n != 0]
+    if not keys:
+        p.error("no frames to replay")
+    relays = sorted({relay for relay, _n in keys})
+    span = max(n for _relay, n in keys) + 1
+    blocks = args.copies * (len(relays) if args.role == "secondaries" else 1)
+    if span * blocks > 255:
+        p.error(f"{blocks} copies of node ids up to {span - 1} do not fit in a byte")
+
+    rows = {(relay, n): r.between(args.start, args.end, n, relay) for relay, n in keys}
+    streams = []
+    for c in range(args.copies):
+        for k, relay in enumerate(relays):
+            if args.role == "secondaries":
+                offset = (c * len(relays) + k) * span
+                streams += [Stream(f"node {n + offset}", rows[relay, n], offset)
+                            for rl, n in keys if rl == relay and len(rows[relay, n])]
+            else:
+                # one receive-ordered list across the chosen nodes of that primary
+                merged = list(heapq.merge(*(rows[key] for key in keys if key[0] == relay)))
+                streams.append(Stream(f"primary {c * len(relays) + k + 1}", merged, c * span))
+    streams = [s for s in streams if len(s.rows)]  # nodes with nothing between --from and --to
+    if not streams:
+        p.error("no frames between --from and --to")
+    first = min(r.recv_us(s.rows[0]) for s in streams)
+    total = sum(len(s.rows) for s in streams)
+    print(f"replaying {total} frames over {len(streams)} connections as {args.role} to {args.target} "
+          f"at {'max speed' if not args.speed else f'{args.speed:g}x'}")
+
+    uplink = Uplink(args.listen) if args.listen else None
+    if uplink:
+        uplink.accept()
+    start = threading.Event()
+    threads = [threading.Thread(target=run_stream, args=(s, r, target, first, args.speed, start, uplink))
+               for s in streams]
+    for t in threads:
+        t.start()
+    time.sleep(0.2)  # let the connections open so they all start on the same schedule
+    t0 = time.monotonic()
+    start.set()
+    for t in threads:
+        t.join()
+    # a base has consumed everything once it closes; a primary keeps its side open, so for
+    # secondaries this is when the last byte was handed over
+    ends = [s.done for s in streams if s.done]
+    elapsed = (time.monotonic() if args.role == "primaries" or not ends else max(ends)) - t0
+
+    sent = sum(s.frames for s in streams)
+    nbytes = sum(s.bytes for s in streams)
+    late = [x for s in streams for x in s.late]
+    report = {
+        "mission": args.mission, "role": args.role, "copies": args.copies, "speed": args.speed,
+        "connections": len(streams), "frames": sent, "bytes": nbytes, "seconds": elapsed,
+        "mb_per_s": nbytes / elapsed / 1e6, "frames_per_s": sent / elapsed,
+        "errors": [f"{s.name}: {s.error}" for s in streams if s.error],
+    }
+    if late:
+        report.update(late_p50_ms=percentile(late, 0.5) * 1e3, late_p99_ms=percentile(late, 0.99) * 1e3,
+                      late_max_ms=max(late) * 1e3)
+    if uplink:
+        lat = uplink.latency
+        report.update(relayed=len(lat), unmatched=uplink.unmatched, latency_p50_ms=percentile(lat, 0.5) * 1e3,
+                      latency_p90_ms=percentile(lat, 0.9) * 1e3, latency_p99_ms=percentile(lat, 0.99) * 1e3)
+
+    print(f"sent {sent} frames, {nbytes / 1e6:.1f} MB in {elapsed:.2f} s: {report['mb_per_s']:.1f} MB/s, "
+          f"{report['frames_per_s']:.0f} frames/s")
+    if late:
+        print(f"behind schedule: p50 {report['late_p50_ms']:.1f} ms, p99 {report['late_p99_ms']:.1f} ms, "
+              f"max {report['late_max_ms']:.1f} ms")
+    if uplink:
+        print(f"relayed {report['relayed']} of {sent} ({uplink.unmatched} unmatched: not sent by us, or over {PENDING_S:g} s late): latency p50 "
+              f"{report['latency_p50_ms']:.1f} ms, p90 {report['latency_p90_ms']:.1f} ms, "
+              f"p99 {report['latency_p99_ms']:.1f} ms")
+    for e in report["errors"]:
+        print("error:", e)
+    if args.report:
+        with open(args.report, "w") as f:
+            json.dump(report, f, indent=2)
+    r.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,144 @@
+# swarm_proto.py - python side of lib/swarm_proto/src/swarm_proto.h
+#
+# frame = 14 byte big-endian header, payload, u32 CRC-32 (zlib.crc32) over header + payload.
+# FrameParser takes arbitrary recv() chunks, yields crc-checked frames and resynchronises on
+# FRAME_MAGIC after a bad header or crc, so corruption costs one frame, not the connection.
+
+import struct
+import zlib
+from collections import namedtuple
+
+PROTO_VERSION = 2
+FRAME_MAGIC = 0x53575246  # "SWRF"
+MAGIC_BYTES = struct.pack(">I", FRAME_MAGIC)
+
+HEADER = struct.Struct(">IBBBBHI")   # magic, version, type, node, flags, seq, length
+CRC = struct.Struct(">I")
+HEADER_SIZE = HEADER.size            # 14
+CRC_SIZE = CRC.size
+MAX_PAYLOAD = 128 * 1024
+
+MSG_TELEMETRY = 1
+MSG_JPEG_FRAME = 2
+MSG_JPEG_SLICE = 3
+MSG_MOSAIC = 4
+MSG_COMMAND = 5
+MSG_FLEET_SUMMARY = 6
+KNOWN_TYPES = {MSG_TELEMETRY: "telemetry", MSG_JPEG_FRAME: "jpeg", MSG_JPEG_SLICE: "jpeg-slice",
+               MSG_MOSAIC: "mosaic", MSG_COMMAND: "command", MSG_FLEET_SUMMARY: "fleet"}
+MIN_PAYLOAD = {MSG_JPEG_FRAME: 8, MSG_JPEG_SLICE: 16, MSG_MOSAIC: 12, MSG_COMMAND: 2, MSG_FLEET_SUMMARY: 6}
+
+FLAG_CACHED = 0x02  # jpeg frame replayed from the primary's latest-frame cache, not live
+FLAG_FLEET_FULL = 0x04  # fleet summary with every node, all rows keyframes
+
+CMD_GET_LATEST = 1
+ALL_NODES = 0xFF
+COMMAND = struct.Struct(">BB")  # op, node
+
+JPEG_HEADER = struct.Struct(">IHH")  # capture_ms, width, height
+MOSAIC_HEADER = struct.Struct(">IHHBBBx")  # capture_ms, width, height, cols, rows, tile_count
+MOSAIC_TILE = struct.Struct(">BBHI")  # node, state, seq, age_ms
+TILE_EMPTY, TILE_FRESH, TILE_STALE = 0, 1, 2
+FLEET_HEADER = struct.Struct(">IBx")  # capture_ms, node_count
+FLEET_ROW = struct.Struct(">BB")  # node, alerts; a telemetry_codec sample follows
+ALERT_LOST, ALERT_LOW_BATTERY, ALERT_WEAK_LINK, ALERT_BACKLOG = 0x01, 0x02, 0x04, 0x08
+ALERT_NAMES = {ALERT_LOST: "LOST", ALERT_LOW_BATTERY: "LOW-BATTERY", ALERT_WEAK_LINK: "WEAK-LINK",
+               ALERT_BACKLOG: "BACKLOG"}
+
+Frame = namedtuple("Frame", "type node flags seq payload")
+Tile = namedtuple("Tile", "node state seq age_ms")
+Mosaic = namedtuple("Mosaic", "capture_ms width height cols rows tiles jpeg")
+
+
+def encode_frame(msg_type, node, seq, payload, flags=0):
+    hdr = HEADER.pack(FRAME_MAGIC, PROTO_VERSION, msg_type, node, flags, seq & 0xFFFF, len(payload))
+    return hdr + payload + CRC.pack(zlib.crc32(payload, zlib.crc32(hdr)))
+
+
+def encode_command(op, node=ALL_NODES, seq=0):
+    """a base -> primary command frame, sent on the same socket the primary relays on"""
+    return encode_frame(MSG_COMMAND, 0, seq, COMMAND.pack(op, node))
+
+
+def parse_mosaic(frame):
+    """Mosaic payload -> Mosaic; tile i sits at column i % cols, row i // cols"""
+    capture_ms, width, height, cols, rows, count = MOSAIC_HEADER.unpack_from(frame.payload)
+    off = MOSAIC_HEADER.size + count * MOSAIC_TILE.size
+    if off > len(frame.payload):
+        raise ValueError("mosaic tile table truncated")
+    tiles = [Tile(*MOSAIC_TILE.unpack_from(frame.payload, MOSAIC_HEADER.size + i * MOSAIC_TILE.size))
+             for i in range(count)]
+    return Mosaic(capture_ms, width, height, cols, rows, tiles, frame.payload[off:])
+
+
+class FrameParser:
+    """frames are cut out of one preallocated buffer by offset. the socket can recv_into()
+    writable() directly, so receiving allocates nothing but the frame payloads; consumed bytes
+    are dropped once per batch rather than per frame, and the buffer only grows if a frame is
+    larger than it"""
+
+    def __init__(self, capacity=512 * 1024):
+        self.buf = bytearray(max(capacity, HEADER_SIZE + MAX_PAYLOAD + CRC_SIZE))
+        self.pos = 0   # first unparsed byte
+        self.end = 0   # end of received bytes
+        self.frames = 0
+        self.crc_errors = 0
+        self.resyncs = 0
+        self.discarded = 0
+
+    def _header_ok(self):
+        magic, version, msg_type, _node, _flags, _seq, length = HEADER.unpack_from(self.buf, self.pos)
+        return (magic == FRAME_MAGIC and version == PROTO_VERSION and msg_type in KNOWN_TYPES
+                and MIN_PAYLOAD.get(msg_type, 0) <= length <= MAX_PAYLOAD)
+
+    def _resync(self):
+        # drop the damaged frame start and skip to the next magic (keeping a possible partial one)
+        nxt = self.buf.find(MAGIC_BYTES, self.pos + 1, self.end)
+        if nxt < 0:
+            nxt = max(self.pos + 1, self.end - (len(MAGIC_BYTES) - 1))
+        self.discarded += nxt - self.pos
+        self.resyncs += 1
+        self.pos = nxt
+
+    def writable(self, min_free=64 * 1024):
+        """memoryview of the free tail to recv_into(); call filled() with the byte count"""
+        if len(self.buf) - self.end < min_free:
+            rest = self.end - self.pos
+            self.buf[:rest] = self.buf[self.pos:self.end]  # same length: moved in place
+            self.pos, self.end = 0, rest
+            if len(self.buf) - self.end < min_free:
+                self.buf.extend(bytes(min_free))
+        return memoryview(self.buf)[self.end:]
+
+    def filled(self, n):
+        """`n` bytes were received into writable(); returns the complete valid frames"""
+        self.end += n
+        out = []
+        buf = self.buf
+        with memoryview(buf) as mv:
+            while self.end - self.pos >= HEADER_SIZE:
+                if not self._header_ok():
+                    self._resync()
+                    continue
+                _magic, _version, msg_type, node, flags, seq, length = HEADER.unpack_from(buf, self.pos)
+                start = self.pos + HEADER_SIZE
+                end = start + length
+                if self.end < end + CRC_SIZE:
+                    break
+                (crc,) = CRC.unpack_from(buf, end)
+                if crc != zlib.crc32(mv[self.pos:end]):
+                    self.crc_errors += 1
+                    self._resync()
+                    continue
+                out.append(Frame(msg_type, node, flags, seq, bytes(mv[start:end])))
+                self.pos = end + CRC_SIZE
+                self.frames += 1
+        if self.pos == self.end:
+            self.pos = self.end = 0
+        return out
+
+    def feed(self, data):
+        """append received bytes, return the list of complete valid frames"""
+        with self.writable(len(data)) as mv:
+            mv[:len(data)] = data
+        return self.filled(len(data))
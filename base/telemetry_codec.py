@@ -0,0 +1,99 @@
+# telemetry_codec.py - python side of lib/telemetry/src/telemetry_codec.h (decoder only)
+#
+# one sample = 1 bit keyframe flag, 8 bit sequence, then either N bit-varints of zigzag values
+# (keyframe) or N 2 bit tags and the residuals they announce (delta). Decoder keeps the previous
+# sample per stream and drops deltas until it has seen a keyframe, like the C++ decoder.
+
+RAW, DELTA, DELTA_OF_DELTA = 0, 1, 2
+
+OK, NEED_KEYFRAME, TRUNCATED = "ok", "need-keyframe", "truncated"
+
+# heartbeat a secondary sends (node_telemetry.h)
+NODE_FIELDS = ("uptime_s", "rssi_dbm", "battery_mv", "temp_centi_c", "free_heap")
+NODE_MODES = (DELTA_OF_DELTA, DELTA, DELTA, DELTA, DELTA)
+
+# one row of the primary's fleet summary (fleet_summary.h)
+FLEET_FIELDS = ("rssi_dbm", "battery_mv", "fps_x10", "last_seen_s", "queue_kb", "crc_errors")
+FLEET_MODES = (DELTA,) * len(FLEET_FIELDS)
+
+
+def _s32(v):
+    v &= 0xFFFFFFFF
+    return v - (1 << 32) if v & 0x80000000 else v
+
+
+def zigzag_decode(v):
+    return (v >> 1) ^ -(v & 1)
+
+
+class _Bits:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def get(self, bits):
+        value = 0
+        for _ in range(bits):
+            byte = self.pos >> 3
+            if byte >= len(self.data):
+                raise EOFError
+            value = (value << 1) | ((self.data[byte] >> (7 - (self.pos & 7))) & 1)
+            self.pos += 1
+        return value
+
+    def varint(self):
+        value = 0
+        for shift in range(0, 35, 7):
+            group = self.get(8)
+            value |= (group & 0x7F) << shift
+            if not group & 0x80:
+                break
+        return value & 0xFFFFFFFF
+
+    def bytes_used(self):
+        return (self.pos + 7) >> 3
+
+
+class Decoder:
+    def __init__(self, modes):
+        self.modes = tuple(modes)
+        n = len(self.modes)
+        self.prev = [0] * n
+        self.prev_delta = [0] * n
+        self.expected_seq = 0
+        self.synced = False
+
+    def decode(self, data):
+        """(status, values or None, bytes consumed) for the sample at the front of `data`"""
+        r = _Bits(data)
+        n = len(self.modes)
+        try:
+            key = r.get(1)
+            seq = r.get(8)
+            if key:
+                values = [zigzag_decode(r.varint()) for _ in range(n)]
+            else:
+                tags = [r.get(2) for _ in range(n)]
+                values = []
+                for i, tag in enumerate(tags):
+                    zz = 0 if tag == 0 else r.get(4) if tag == 1 else r.get(8) if tag == 2 else r.varint()
+                    res = zigzag_decode(zz)
+                    mode = self.modes[i]
+                    if mode == RAW:
+                        values.append(_s32(res))
+                    elif mode == DELTA:
+                        values.append(_s32(self.prev[i] + res))
+                    else:
+                        values.append(_s32(self.prev[i] + self.prev_delta[i] + res))
+        except EOFError:
+            return TRUNCATED, None, 0
+        used = r.bytes_used()
+        if not key and (not self.synced or seq != self.expected_seq):
+            self.synced = False
+            return NEED_KEYFRAME, None, used
+        for i in range(n):
+            self.prev_delta[i] = 0 if key else _s32(values[i] - self.prev[i])
+            self.prev[i] = values[i]
+        self.synced = True
+        self.expected_seq = (seq + 1) & 0xFF
+        return OK, values, used
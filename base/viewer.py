@@ -0,0 +1,209 @@
+# viewer.py - live grid of every drone's feed for BaseServer.py --view
+#
+# built to keep up with many feeds on a laptop:
+#   - each feed holds only its newest undecoded picture; one that is replaced before the next
+#     repaint is never decoded (counted as skipped)
+#   - grid tiles are decoded at reduced scale in the JPEG decoder itself (PIL draft(): 1/2, 1/4
+#     or 1/8 scale DCT, so a 640x480 picture for a 320x240 tile costs about a quarter of a full
+#     decode), and only tiles with a new picture are repainted
+#   - only the focused feed (click a tile; Escape to leave) is decoded at full resolution; the
+#     click also asks the primaries for that drone's cached picture (on_focus), so a drone that
+#     is slow or has gone quiet shows at once instead of at its next live picture
+# FeedGrid does the work and runs headless (bench_viewer.py); ViewerApp puts it in a Tk window.
+
+import io
+import math
+import signal
+import threading
+import time
+
+from PIL import Image, ImageDraw
+
+TILE = (320, 240)
+REFRESH_MS = 33
+STALE_S = 2.0  # a tile whose feed went quiet this long is dimmed
+
+
+class Feed:
+    def __init__(self, node, index):
+        self.node = node
+        self.index = index       # grid position
+        self.jpeg = None         # newest picture not yet decoded
+        self.received = 0.0
+        self.last_shown = 0.0
+        self.queue = []          # every picture, when skipping is off
+        self.decoded = 0
+        self.skipped = 0
+
+
+class FeedGrid:
+    def __init__(self, tile=TILE, reduced=True, skip_stale=True):
+        self.tile = tile
+        self.reduced = reduced          # False: decode every picture at full size, then scale
+        self.skip_stale = skip_stale    # False: decode every picture received, in order
+        self.feeds = {}                 # node -> Feed
+        self.lock = threading.Lock()
+        self.focus = None
+        self.focus_image = None
+        self.canvas = None
+        self.latency = []               # receive -> repaint seconds, since the last take_latency()
+
+    def submit(self, node, capture_ms, jpeg):
+        """newest picture of `node`; called from the receive loop, never blocks on decoding"""
+        now = time.monotonic()
+        with self.lock:
+            f = self.feeds.get(node)
+            if f is None:
+                f = self.feeds[node] = Feed(node, len(self.feeds))
+            if not self.skip_stale:
+                f.queue.append((bytes(jpeg), now))
+                return
+            if f.jpeg is not None:
+                f.skipped += 1
+            f.jpeg = bytes(jpeg)
+            f.received = now
+
+    def set_focus(self, node):
+        """decode `node` at full resolution from its next picture on (None: no focus)"""
+        self.focus = node
+        self.focus_image = None
+
+    def node_at(self, x, y):
+        """feed under grid pixel (x, y), or None"""
+        cols, _rows = self._layout(len(self.feeds))
+        index = (y // self.tile[1]) * cols + x // self.tile[0]
+        for f in self.feeds.values():
+            if f.index == index:
+                return f.node
+        return None
+
+    @staticmethod
+    def _layout(n):
+        cols = max(1, math.ceil(math.sqrt(n)))
+        return cols, max(1, math.ceil(n / cols))
+
+    def _decode(self, jpeg, full):
+        img = Image.open(io.BytesIO(jpeg))
+        if not full and self.reduced:
+            img.draft("RGB", self.tile)  # smallest DCT scale still at least tile sized
+        img = img.convert("RGB")
+        tile = img if img.size == self.tile else img.resize(self.tile, Image.BILINEAR)
+        return tile, (img if full else None)
+
+    def render(self):
+        """repaints tiles with new pictures; returns the grid image (the same object while the
+        layout holds) and whether anything changed"""
+        with self.lock:
+            work = []
+            for f in self.feeds.values():
+                if self.skip_stale and f.jpeg is not None:
+                    work.append((f, [(f.jpeg, f.received)]))
+                    f.jpeg = None
+                elif f.queue:
+                    work.append((f, f.queue))
+                    f.queue = []
+            n = len(self.feeds)
+        cols, rows = self._layout(n)
+        size = (cols * self.tile[0], rows * self.tile[1])
+        relaid = self.canvas is None or self.canvas.size != size
+        if relaid:
+            old, self.canvas = self.canvas, Image.new("RGB", size)
+            if old is not None:  # tiles keep their index; copy the ones already painted
+                ocols = old.size[0] // self.tile[0]
+                for f in self.feeds.values():
+                    ox, oy = (f.index % ocols) * self.tile[0], (f.index // ocols) * self.tile[1]
+                    if oy < old.size[1]:
+                        self.canvas.paste(old.crop((ox, oy, ox + self.tile[0], oy + self.tile[1])), self._origin(f, cols))
+        draw = ImageDraw.Draw(self.canvas)
+        now = time.monotonic()
+        for f, pictures in work:
+            for jpeg, received in pictures:
+                full = f.node == self.focus
+                try:
+                    tile, big = self._decode(jpeg, full)
+                except (OSError, ValueError):
+                    continue  # damaged picture: keep the last good one
+                f.decoded += 1
+                if big is not None:
+                    self.focus_image = big
+                x, y = self._origin(f, cols)
+                self.canvas.paste(tile, (x, y))
+                draw.text((x + 4, y + 2), f"node {f.node}", fill=(255, 255, 0))
+                f.last_shown = received
+            if pictures:
+                self.latency.append(time.monotonic() - pictures[-1][1])
+        for f in self.feeds.values():
+            if f.last_shown and now - f.last_shown > STALE_S:
+                x, y = self._origin(f, cols)
+                draw.rectangle((x, y, x + self.tile[0] - 1, y + self.tile[1] - 1), outline=(255, 0, 0), width=3)
+        return self.canvas, bool(work) or relaid
+
+    def _origin(self, f, cols):
+        return (f.index % cols) * self.tile[0], (f.index // cols) * self.tile[1]
+
+    def take_latency(self):
+        lat, self.latency = self.latency, []
+        return lat
+
+    def counts(self):
+        with self.lock:
+            return sum(f.decoded for f in self.feeds.values()), sum(f.skipped for f in self.feeds.values())
+
+
+class ViewerApp:
+    """Tk window: the grid on the left, the focused feed at full resolution on the right.
+    on_focus(node), if given, is called from the Tk thread when a feed is clicked"""
+
+    def __init__(self, grid, title="swarm feeds", on_focus=None):
+        import tkinter as tk
+        from PIL import ImageTk
+        self.tk, self.ImageTk = tk, ImageTk
+        self.grid = grid
+        self.on_focus = on_focus
+        try:
+            self.root = tk.Tk()
+        except tk.TclError as e:  # no display
+            raise RuntimeError(f"cannot open a window: {e}") from None
+        self.root.title(title)
+        self.grid_label = tk.Label(self.root, bg="black")
+        self.grid_label.pack(side=tk.LEFT)
+        self.focus_label = tk.Label(self.root, bg="black")
+        self.focus_label.pack(side=tk.LEFT)
+        self.grid_label.bind("<Button-1>", self._click)
+        self.root.bind("<Escape>", lambda _e: self._focus(None))
+        self.root.protocol("WM_DELETE_WINDOW", self.root.quit)
+        self._photo = self._focus_photo = None
+        self._shown_focus = None
+
+    def _click(self, e):
+        self._focus(self.grid.node_at(e.x, e.y))
+
+    def _focus(self, node):
+        self.grid.set_focus(node)
+        if node is not None and self.on_focus:
+            self.on_focus(node)
+        if node is None:
+            self.focus_label.configure(image="")
+            self._focus_photo = self._shown_focus = None
+
+    def _tick(self):
+        canvas, changed = self.grid.render()
+        if changed:
+            self._photo = self.ImageTk.PhotoImage(canvas)
+            self.grid_label.configure(image=self._photo)
+        img = self.grid.focus_image
+        if img is not None and img is not self._shown_focus:
+            self._focus_photo = self.ImageTk.PhotoImage(img)
+            self.focus_label.configure(image=self._focus_photo)
+            self._shown_focus = img
+        self.root.after(REFRESH_MS, self._tick)  # python signal handlers run between ticks
+
+    def run(self):
+        """until the window is closed or ctrl-c"""
+        previous = signal.signal(signal.SIGINT, lambda *_: self.root.quit())
+        self.root.after(REFRESH_MS, self._tick)
+        try:
+            self.root.mainloop()
+        finally:
+            signal.signal(signal.SIGINT, previous)
+            self.root.destroy()
@@ -0,0 +1,341 @@
+// frame_cache.h - latest complete picture of every node, in a fixed memory budget
+//
+// header-only, no allocation: the pool handed to init() is split into two equal buffers per slot,
+// the latest complete picture (served at any time) and a back buffer that the next one is built
+// in. a picture replaces the served one only once it is complete, so a reader never sees a
+// partial frame. sliced pictures are reassembled as their slices pass through (RSTn markers put
+// back between packets), and everything is stored as a ready-to-send JpegFrame wire frame with
+// FLAG_CACHED set, so serving a picture is a single write of contiguous bytes.
+//
+// a pool too small for two whole pictures per slot (no PSRAM) is single-buffered instead, over as
+// many slots as it holds pictures: the next picture is built in place of the served one, and the
+// node has none to fetch until it is complete.
+//
+// slots are bound to node ids on first sight; when all are taken the least recently updated node
+// is evicted. a node that disconnects keeps its picture until then.
+//
+// one writer (the relay loop) calls add(); latest() / at() are for that same thread. other tasks
+// read through acquire() / release(): a lease pins the served buffer so the writer will not build
+// into it after the next swap (that picture is skipped instead) while the reader copies it out;
+// a reader that has to wait on a slow socket copies first and releases at once (mjpeg_server.h).
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(ESP_PLATFORM)
+#include "freertos/FreeRTOS.h"
+#else
+#include <mutex>
+#endif
+
+#include <swarm_proto.h>
+
+namespace cache {
+
+// guards slot binding, publishing and pins; held for a few field updates, never for a copy
+class CacheLock {
+ public:
+#if defined(ESP_PLATFORM)
+  void lock() { portENTER_CRITICAL(&mux_); }
+  void unlock() { portEXIT_CRITICAL(&mux_); }
+
+ private:
+  portMUX_TYPE mux_ = portMUX_INITIALIZER_UNLOCKED;
+#else
+  void lock() { m_.lock(); }
+  void unlock() { m_.unlock(); }
+
+ private:
+  std::mutex m_;
+#endif
+};
+
+struct Picture {
+  const uint8_t* frame = nullptr;  // whole wire frame, header to crc
+  size_t len = 0;
+  uint8_t node = 0;
+  uint16_t seq = 0;
+  uint32_t captureMs = 0;  // sender clock
+  uint16_t width = 0;
+  uint16_t height = 0;
+  uint32_t storedMs = 0;   // cache clock when it became the latest
+};
+
+// a reader's hold on a published picture; valid until release()
+struct Lease {
+  Picture pic;
+  int slot = -1;
+  uint8_t buf = 0;
+};
+
+struct Stats {
+  uint32_t stored = 0;
+  uint32_t tooLarge = 0;    // picture bigger than a slot buffer; the previous one is kept
+  uint32_t incomplete = 0;  // sliced picture with a missing slice
+  uint32_t evictions = 0;
+  uint32_t busy = 0;        // skipped because a reader still held the buffer it would reuse
+};
+
+template <int Slots>
+class FrameCache {
+ public:
+  // splits `pool` into buffers of at least `minPicture` bytes and returns the per-picture
+  // capacity: two per slot if they fit, else one per slot for as many slots as fit. 0 (nothing
+  // is ever stored) if the pool does not hold a single picture
+  size_t init(uint8_t* pool, size_t bytes, size_t minPicture = 0) {
+    buffers_ = bytes / (2 * Slots) >= minPicture ? 2 : 1;
+    active_ = buffers_ == 2 ? Slots : int(bytes / minPicture < Slots ? bytes / minPicture : Slots);
+    cap_ = active_ ? bytes / (buffers_ * active_) : 0;
+    for (int i = 0; i < Slots; ++i) {
+      slots_[i] = Slot();
+      if (i >= active_) continue;
+      slots_[i].buf[0] = pool + buffers_ * i * cap_;
+      slots_[i].buf[1] = slots_[i].buf[0] + (buffers_ - 1) * cap_;
+    }
+    return cap_;
+  }
+
+  // every crc-checked frame relayed from a secondary; anything but pictures is ignored
+  void add(const proto::FrameRef& f, uint32_t nowMs) {
+    if (!cap_) return;
+    if (f.type() == proto::MsgType::JpegFrame) {
+      storeFrame(f, nowMs);
+    } else if (f.type() == proto::MsgType::JpegSlice) {
+      if (f.flags() & proto::FLAG_SLICE_HEADERS) beginPicture(f, nowMs);
+      else appendSlice(f, nowMs);
+    }
+  }
+
+  // latest complete picture of `node`, nullptr if there is none
+  const Picture* latest(uint8_t node) const {
+    for (const Slot& s : slots_)
+      if (s.used && s.node == node && s.valid) return &s.pic;
+    return nullptr;
+  }
+
+  // slot-order access for serving every node
+  const Picture* at(int i) const { return slots_[i].used && slots_[i].valid ? &slots_[i].pic : nullptr; }
+  static constexpr int size() { return Slots; }
+
+  // any task: pins the latest picture of `node` (or of slot `slot` when node is ALL_NODES)
+  bool acquire(uint8_t node, Lease* out, int slot = -1) {
+    lock_.lock();
+    bool ok = false;
+    for (int i = 0; i < Slots && !ok; ++i) {
+      const Slot& s = slots_[i];
+      if (!s.used || !s.valid || (slot >= 0 ? i != slot : s.node != node)) continue;
+      out->pic = s.pic;
+      out->slot = i;
+      out->buf = s.front;
+      pins_[i][s.front]++;
+      ok = true;
+    }
+    lock_.unlock();
+    return ok;
+  }
+
+  void release(Lease& l) {
+    if (l.slot < 0) return;
+    lock_.lock();
+    pins_[l.slot][l.buf]--;
+    lock_.unlock();
+    l.slot = -1;
+  }
+
+  // any task: metadata of slot `i` (frame pointer excluded), false if it holds no picture
+  bool info(int i, Picture* out) {
+    lock_.lock();
+    bool ok = slots_[i].used && slots_[i].valid;
+    if (ok) {
+      *out = slots_[i].pic;
+      out->frame = nullptr;
+    }
+    lock_.unlock();
+    return ok;
+  }
+
+  size_t capacity() const { return cap_; }
+  int slots() const { return active_; }  // nodes held at once
+  bool doubleBuffered() const { return buffers_ == 2; }
+  const Stats& stats() const { return stats_; }
+
+ private:
+  struct Slot {
+    bool used = false;
+    bool valid = false;  // pic describes a complete picture in buf[front]
+    uint8_t node = 0;
+    uint8_t front = 0;
+    uint32_t touchedMs = 0;
+    uint8_t* buf[2] = {nullptr, nullptr};
+    Picture pic;
+    // sliced picture being assembled in the back buffer
+    bool building = false;
+    uint16_t frameId = 0, expected = 0, total = 0;
+    size_t len = 0;
+    Picture next;
+  };
+
+  bool pinned(const Slot& s) const {
+    int i = int(&s - slots_);
+    return pins_[i][0] || pins_[i][1];
+  }
+
+  // the buffer the next picture is built in: the served one when single-buffered
+  uint8_t back(const Slot& s) const { return s.front ^ (buffers_ - 1); }
+
+  // the node's slot with its back buffer free to build into, or nullptr (counted as busy) if a
+  // reader still holds that buffer or every evictable slot is pinned. single-buffered, the slot's
+  // picture stops being served from here on
+  Slot* slotFor(uint8_t node, uint32_t nowMs) {
+    lock_.lock();
+    Slot* found = nullptr;
+    Slot* victim = nullptr;
+    for (int i = 0; i < active_; ++i) {
+      Slot& s = slots_[i];
+      if (s.used && s.node == node) {
+        found = &s;
+        break;
+      }
+      if (pinned(s)) continue;
+      if (!victim || (victim->used && (!s.used || s.touchedMs < victim->touchedMs))) victim = &s;
+    }
+    if (found) {
+      if (pins_[found - slots_][back(*found)]) found = nullptr;
+      else if (buffers_ == 1) found->valid = false;
+    } else if (victim) {
+      if (victim->used) stats_.evictions++;
+      uint8_t* buf0 = victim->buf[0];
+      uint8_t* buf1 = victim->buf[1];
+      *victim = Slot();
+      victim->buf[0] = buf0;
+      victim->buf[1] = buf1;
+      victim->used = true;
+      victim->node = node;
+      victim->touchedMs = nowMs;
+      found = victim;
+    }
+    lock_.unlock();
+    if (!found) stats_.busy++;
+    return found;
+  }
+
+  // makes the back buffer the served picture
+  void publish(Slot& s, const Picture& p, uint32_t nowMs) {
+    lock_.lock();
+    s.front = back(s);
+    s.pic = p;
+    s.pic.frame = s.buf[s.front];
+    s.pic.storedMs = nowMs;
+    s.valid = true;
+    s.touchedMs = nowMs;
+    lock_.unlock();
+    stats_.stored++;
+  }
+
+  // header + crc for a frame whose payload is already in place
+  static void seal(uint8_t* frame, uint8_t node, uint16_t seq, uint32_t length) {
+    proto::writeHeader(frame, proto::MsgType::JpegFrame, node, seq, length, proto::FLAG_CACHED);
+    proto::writeTrailer(frame + proto::FrameHeader::SIZE + length,
+                        proto::frameCrc(frame, frame + proto::FrameHeader::SIZE, length));
+  }
+
+  void storeFrame(const proto::FrameRef& f, uint32_t nowMs) {
+    if (f.size() > cap_) {
+      stats_.tooLarge++;
+      return;
+    }
+    Slot* sp = slotFor(f.node(), nowMs);
+    if (!sp) return;
+    Slot& s = *sp;
+    uint8_t* back = s.buf[this->back(s)];
+    if (s.building) {
+      s.building = false;  // a whole frame supersedes the sliced one in progress
+      stats_.incomplete++;
+    }
+    memcpy(back + proto::FrameHeader::SIZE, f.payload, f.length);
+    seal(back, f.node(), f.seq(), f.length);
+    proto::JpegView jv(f.payload);
+    Picture p;
+    p.len = f.size();
+    p.node = f.node();
+    p.seq = f.seq();
+    p.captureMs = jv.get<proto::JpegFrameHeader::CaptureMs>();
+    p.width = jv.get<proto::JpegFrameHeader::Width>();
+    p.height = jv.get<proto::JpegFrameHeader::Height>();
+    publish(s, p, nowMs);
+  }
+
+  bool append(Slot& s, const uint8_t* data, size_t len) {
+    if (s.len + len + proto::CRC_SIZE > cap_) {
+      s.building = false;
+      stats_.tooLarge++;
+      return false;
+    }
+    memcpy(s.buf[back(s)] + s.len, data, len);
+    s.len += len;
+    return true;
+  }
+
+  void beginPicture(const proto::FrameRef& f, uint32_t nowMs) {
+    Slot* sp = slotFor(f.node(), nowMs);
+    if (!sp) return;
+    Slot& s = *sp;
+    if (s.building) stats_.incomplete++;
+    proto::JpegSliceView sv(f.payload);
+    s.building = true;
+    s.frameId = sv.get<proto::JpegSliceHeader::FrameId>();
+    s.total = sv.get<proto::JpegSliceHeader::TotalIntervals>();
+    s.expected = 0;
+    s.next = Picture();
+    s.next.node = f.node();
+    s.next.seq = f.seq();
+    s.next.captureMs = sv.get<proto::JpegSliceHeader::CaptureMs>();
+    s.next.width = sv.get<proto::JpegSliceHeader::Width>();
+    s.next.height = sv.get<proto::JpegSliceHeader::Height>();
+    s.len = proto::FrameHeader::SIZE + proto::JpegFrameHeader::SIZE;
+    append(s, f.payload + proto::JpegSliceHeader::SIZE, f.length - proto::JpegSliceHeader::SIZE);
+  }
+
+  void appendSlice(const proto::FrameRef& f, uint32_t nowMs) {
+    Slot* s = nullptr;
+    for (Slot& c : slots_)
+      if (c.used && c.node == f.node()) s = &c;
+    if (!s || !s->building) return;
+    proto::JpegSliceView sv(f.payload);
+    uint16_t first = sv.get<proto::JpegSliceHeader::FirstInterval>();
+    if (sv.get<proto::JpegSliceHeader::FrameId>() != s->frameId || first != s->expected) {
+      s->building = false;
+      stats_.incomplete++;
+      return;
+    }
+    if (first > 0) {
+      const uint8_t rst[2] = {0xFF, uint8_t(0xD0 + ((first - 1) & 7))};
+      if (!append(*s, rst, sizeof(rst))) return;
+    }
+    if (!append(*s, f.payload + proto::JpegSliceHeader::SIZE, f.length - proto::JpegSliceHeader::SIZE)) return;
+    s->expected = uint16_t(first + sv.get<proto::JpegSliceHeader::IntervalCount>());
+    if (s->expected < s->total) return;
+
+    static const uint8_t EOI[2] = {0xFF, 0xD9};
+    if (!append(*s, EOI, sizeof(EOI))) return;
+    s->building = false;
+    uint8_t* back = s->buf[this->back(*s)];
+    uint32_t length = uint32_t(s->len - proto::FrameHeader::SIZE);
+    proto::writeJpegHeader(back + proto::FrameHeader::SIZE, s->next.captureMs, s->next.width, s->next.height);
+    seal(back, s->next.node, s->next.seq, length);
+    s->next.len = proto::frameSize(length);
+    publish(*s, s->next, nowMs);
+  }
+
+  Slot slots_[Slots];
+  uint8_t pins_[Slots][2] = {};  // leases per buffer, under lock_
+  CacheLock lock_;
+  size_t cap_ = 0;
+  int active_ = 0;      // slots with buffers
+  uint8_t buffers_ = 2; // per slot
+  Stats stats_;
+};
+
+}  // namespace cache
@@ -0,0 +1,55 @@
+// bench_jpeg_scale.cpp - native benchmark for jpeg_scale.h (same code the primary runs)
+//
+// build & run from the repo root:
+//   g++ -O2 -std=c++17 -Ilib/jpeg_scale/src lib/jpeg_scale/examples/bench_jpeg_scale.cpp -o bench_jpeg_scale
+//   ./bench_jpeg_scale frame.jpg [out_prefix]
+//
+// prints per-frame time and output size for each scale; with out_prefix the outputs are written
+// as <out_prefix>_<scale>.jpg for visual checks.
+#include <jpeg_scale.h>
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s frame.jpg [out_prefix]\n", argv[0]);
+    return 1;
+  }
+  FILE* f = fopen(argv[1], "rb");
+  if (!f) { perror(argv[1]); return 1; }
+  std::vector<uint8_t> in;
+  uint8_t chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) in.insert(in.end(), chunk, chunk + n);
+  fclose(f);
+
+  auto tc = std::make_unique<jpeg::Transcoder>();
+  std::vector<uint8_t> out(in.size() * 2 + 4096);
+  const struct { uint8_t scale, quality; } modes[] = {{1, 50}, {2, 75}, {4, 75}, {8, 75}};
+  printf("input %zu bytes\n", in.size());
+  printf("%-6s %-8s %11s %10s %10s\n", "scale", "quality", "out size", "saved", "ms/frame");
+  for (auto m : modes) {
+    size_t len = 0;
+    const int RUNS = 20;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < RUNS; ++i) len = tc->transcode(in.data(), in.size(), m.scale, m.quality, out.data(), out.size());
+    auto t1 = std::chrono::steady_clock::now();
+    if (!len) {
+      printf("1/%-4u transcode failed (status %d)\n", m.scale, int(tc->status()));
+      continue;
+    }
+    double ms = std::chrono::duration<double, std::milli>(t1 - t0).count() / RUNS;
+    printf("1/%-4u %-8u %6zu bytes %9.1f%% %10.2f  (%ux%u)\n", m.scale, m.quality, len,
+           100.0 * (1.0 - double(len) / double(in.size())), ms, tc->outWidth(), tc->outHeight());
+    if (argc > 2) {
+      std::string name = std::string(argv[2]) + "_" + std::to_string(m.scale) + ".jpg";
+      FILE* o = fopen(name.c_str(), "wb");
+      if (o) { fwrite(out.data(), 1, len, o); fclose(o); }
+    }
+  }
+  return 0;
+}
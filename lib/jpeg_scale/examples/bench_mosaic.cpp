@@ -0,0 +1,80 @@
+// bench_mosaic.cpp - native benchmark for jpeg_mosaic.h (same code the primary runs)
+//
+// build & run from the repo root:
+//   g++ -O2 -std=c++17 -Ilib/jpeg_scale/src lib/jpeg_scale/examples/bench_mosaic.cpp -o bench_mosaic
+//   ./bench_mosaic a.jpg [b.jpg ...] [-o mosaic.jpg]
+//
+// fills the six tiles of the primary's 3x2 mosaic from the given pictures (repeated as needed),
+// then prints the per-tile decode cost, the composite encode cost and the composite size against
+// forwarding the six pictures individually.
+#include <jpeg_mosaic.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double msSince(Clock::time_point t0, int runs) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - t0).count() / runs;
+}
+
+int main(int argc, char** argv) {
+  std::vector<std::vector<uint8_t>> feeds;
+  const char* outName = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+      outName = argv[++i];
+      continue;
+    }
+    FILE* f = fopen(argv[i], "rb");
+    if (!f) { perror(argv[i]); return 1; }
+    std::vector<uint8_t> d;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) d.insert(d.end(), chunk, chunk + n);
+    fclose(f);
+    feeds.push_back(std::move(d));
+  }
+  if (feeds.empty()) {
+    fprintf(stderr, "usage: %s a.jpg [b.jpg ...] [-o mosaic.jpg]\n", argv[0]);
+    return 1;
+  }
+
+  using Canvas = jpeg::Mosaic<3, 2, 80, 60>;
+  auto mosaic = std::make_unique<Canvas>();
+  auto dec = std::make_unique<jpeg::BasicTranscoder<160>>();
+  const int RUNS = 50;
+
+  size_t feedBytes = 0;
+  printf("%-5s %10s %12s %12s\n", "tile", "in bytes", "decoded at", "ms/tile");
+  for (int t = 0; t < Canvas::TILES; ++t) {
+    const std::vector<uint8_t>& in = feeds[t % feeds.size()];
+    feedBytes += in.size();
+    bool ok = true;
+    auto t0 = Clock::now();
+    for (int r = 0; r < RUNS && ok; ++r) ok = mosaic->setTile(t, *dec, in.data(), in.size());
+    double ms = msSince(t0, RUNS);
+    if (!ok) {
+      printf("%-5d %10zu  decode failed (status %d)\n", t, in.size(), int(dec->status()));
+      continue;
+    }
+    printf("%-5d %10zu %5ux%-6u %12.3f\n", t, in.size(), dec->outWidth(), dec->outHeight(), ms);
+  }
+  mosaic->dimTile(Canvas::TILES - 1);
+
+  std::vector<uint8_t> out(64 * 1024);
+  size_t len = 0;
+  auto t0 = Clock::now();
+  for (int r = 0; r < RUNS; ++r) len = mosaic->encode(60, out.data(), out.size());
+  double ms = msSince(t0, RUNS);
+  printf("mosaic %dx%d q60: %zu bytes in %.3f ms, vs %zu bytes for %d separate pictures (%.1f%%)\n", Canvas::WIDTH,
+         Canvas::HEIGHT, len, ms, feedBytes, Canvas::TILES, 100.0 * double(len) / double(feedBytes));
+  if (outName && len) {
+    FILE* o = fopen(outName, "wb");
+    if (o) { fwrite(out.data(), 1, len, o); fclose(o); }
+  }
+  return 0;
+}
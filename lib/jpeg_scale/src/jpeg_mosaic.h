@@ -0,0 +1,129 @@
+// jpeg_mosaic.h - tiles thumbnails of several feeds into one composite JPEG
+//
+// header-only, fixed-size canvas (4:2:0 planes) held inside the object. each tile is filled by
+// decoding a feed's picture at 1/2, 1/4 or 1/8 in the DCT domain (BasicTranscoder decode-only
+// mode) and resampling the strips straight into the tile, so no full-size picture is decoded.
+// the canvas keeps the last picture of every tile; encode() compresses the whole canvas as one
+// baseline JPEG, which costs one decode at the receiver instead of one per feed.
+#pragma once
+
+#include "jpeg_scale.h"
+
+namespace jpeg {
+
+template <int Cols, int Rows, int TileW, int TileH>
+class Mosaic : public StripSink {
+  static_assert(TileW % 2 == 0 && TileH % 2 == 0, "tiles must cover whole chroma samples");
+
+ public:
+  static constexpr int TILES = Cols * Rows;
+  static constexpr int WIDTH = Cols * TileW;
+  static constexpr int HEIGHT = Rows * TileH;
+
+  Mosaic() { clear(); }
+
+  void clear() {
+    memset(y_, 0x40, sizeof(y_));
+    memset(cb_, 0x80, sizeof(cb_));
+    memset(cr_, 0x80, sizeof(cr_));
+  }
+
+  // decodes a whole JPEG into `tile`; false if it is unsupported or corrupt (the tile is kept)
+  template <typename Decoder>
+  bool setTile(int tile, Decoder& dec, const uint8_t* jpegData, size_t len) {
+    size_t headerLen = Decoder::scanOffset(jpegData, len);
+    if (!headerLen || !beginTile(tile, dec, jpegData, headerLen)) return false;
+    if (dec.feed(jpegData + headerLen, len - headerLen) != Decoder::Status::Ok) return false;
+    return dec.finish() != 0;
+  }
+
+  // piecewise variant for sliced pictures: beginTile() on the jpeg headers, then dec.feed() with
+  // each run of restart intervals and dec.finish(). picks the largest DCT scale that still gives
+  // at least the tile size, falling back to coarser scales if the decoder's strips are too narrow.
+  template <typename Decoder>
+  bool beginTile(int tile, Decoder& dec, const uint8_t* headers, size_t len) {
+    if (tile < 0 || tile >= TILES) return false;
+    tile_ = tile;
+    uint8_t chosen = 0;
+    for (uint8_t scale = 8; scale >= 1; scale /= 2) {
+      typename Decoder::Status s = dec.beginDecode(headers, len, scale, this);
+      if (s != Decoder::Status::Ok) {
+        if (s != Decoder::Status::TooWide || !chosen) return false;
+        dec.beginDecode(headers, len, chosen, this);
+        break;
+      }
+      chosen = scale;
+      if (dec.outWidth() >= TileW && dec.outHeight() >= TileH) break;
+    }
+    srcW_ = dec.outWidth();
+    srcH_ = dec.outHeight();
+    return true;
+  }
+
+  // dims a tile towards grey so a stale feed is obvious; the next picture overwrites it
+  void dimTile(int tile) {
+    if (tile < 0 || tile >= TILES) return;
+    int x0 = (tile % Cols) * TileW, y0 = (tile / Cols) * TileH;
+    for (int y = 0; y < TileH; ++y) {
+      uint8_t* row = y_ + (y0 + y) * PLANE_W + x0;
+      for (int x = 0; x < TileW; ++x) row[x] = uint8_t(64 + row[x] / 2);
+    }
+    for (int y = 0; y < TileH / 2; ++y) {
+      int off = (y0 / 2 + y) * CHROMA_W + x0 / 2;
+      for (int x = 0; x < TileW / 2; ++x) {
+        cb_[off + x] = uint8_t(64 + cb_[off + x] / 2);
+        cr_[off + x] = uint8_t(64 + cr_[off + x] / 2);
+      }
+    }
+  }
+
+  // the whole canvas as one JPEG; 0 if it does not fit in `cap`
+  size_t encode(uint8_t quality, uint8_t* out, size_t cap) {
+    static const uint8_t SAMPLING[3] = {0x22, 0x11, 0x11};
+    encoder_.begin(out, cap, WIDTH, HEIGHT, 3, SAMPLING, quality);
+    for (int row = 0; row < PLANE_H / 16 && !encoder_.overflow(); ++row) {
+      const uint8_t* planes[3] = {y_ + row * 16 * PLANE_W, cb_ + row * 8 * CHROMA_W, cr_ + row * 8 * CHROMA_W};
+      const int strides[3] = {PLANE_W, CHROMA_W, CHROMA_W};
+      encoder_.encodeRow(planes, strides);
+    }
+    return encoder_.finish();
+  }
+
+  // StripSink: nearest-neighbour resample of the decoded rows that land in the current tile
+  void strip(const Strip& s) override {
+    int x0 = (tile_ % Cols) * TileW, y0 = (tile_ / Cols) * TileH;
+    for (int ty = 0; ty < TileH; ++ty) {
+      int sy = ty * srcH_ / TileH;
+      if (sy < s.y0 || sy >= s.y0 + s.rows) continue;
+      const uint8_t* srcY = s.plane[0] + ((sy - s.y0) * s.v[0] / s.vmax) * s.stride[0];
+      uint8_t* dstY = y_ + (y0 + ty) * PLANE_W + x0;
+      for (int tx = 0; tx < TileW; ++tx) dstY[tx] = srcY[(tx * srcW_ / TileW) * s.h[0] / s.hmax];
+      if (ty & 1) continue;
+      int off = ((y0 + ty) / 2) * CHROMA_W + x0 / 2;
+      for (int tx = 0; tx < TileW; tx += 2) {
+        int sx = tx * srcW_ / TileW;
+        if (s.ncomp == 3) {
+          cb_[off + tx / 2] = s.plane[1][((sy - s.y0) * s.v[1] / s.vmax) * s.stride[1] + sx * s.h[1] / s.hmax];
+          cr_[off + tx / 2] = s.plane[2][((sy - s.y0) * s.v[2] / s.vmax) * s.stride[2] + sx * s.h[2] / s.hmax];
+        } else {
+          cb_[off + tx / 2] = cr_[off + tx / 2] = 0x80;
+        }
+      }
+    }
+  }
+
+ private:
+  // planes are padded to whole 16x16 MCUs
+  static constexpr int PLANE_W = (WIDTH + 15) / 16 * 16;
+  static constexpr int PLANE_H = (HEIGHT + 15) / 16 * 16;
+  static constexpr int CHROMA_W = PLANE_W / 2;
+
+  uint8_t y_[PLANE_W * PLANE_H];
+  uint8_t cb_[CHROMA_W * PLANE_H / 2];
+  uint8_t cr_[CHROMA_W * PLANE_H / 2];
+  BaselineEncoder encoder_;
+  int tile_ = 0;
+  int srcW_ = 1, srcH_ = 1;
+};
+
+}  // namespace jpeg
@@ -0,0 +1,823 @@
+// jpeg_scale.h - DCT-domain JPEG downscaling (1/1, 1/2, 1/4, 1/8) with baseline re-encode
+//
+// header-only, no heap allocation beyond the Transcoder object itself, builds for ESP32 and
+// natively. the decoder still has to walk every huffman code to stay in sync, but it only
+// dequantizes and inverse-transforms the top-left NxN coefficients of each block (N = 8/scale):
+// an N-point IDCT of the low frequencies gives the block directly at 1/scale size, so no
+// full-resolution pixels are ever produced. scale 1 with a lower quality re-quantizes instead.
+//
+// decoding and encoding are streamed one output MCU row at a time through a small strip buffer,
+// and the entropy data may be fed in pieces that end on restart-interval boundaries, so JpegSlice
+// packets can be transcoded as they arrive without reassembling the picture.
+//
+// supported input: baseline / extended huffman, 8-bit, one interleaved scan, 1 or 3 components
+// with sampling factors 1 or 2 (what esp32-camera and most encoders produce). the output keeps
+// the input's sampling factors and uses the standard Annex K tables.
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace jpeg {
+
+constexpr int MAX_COMPONENTS = 3;
+
+// output samples per row the strip buffers can hold (3 x 16 rows each), 640 covers re-quantizing
+// VGA at scale 1; wider pictures fail with TooWide and are forwarded untouched
+#ifndef JPEG_SCALE_MAX_OUT_WIDTH
+#define JPEG_SCALE_MAX_OUT_WIDTH 640
+#endif
+constexpr int MAX_OUT_WIDTH = JPEG_SCALE_MAX_OUT_WIDTH;
+
+static const uint8_t ZIGZAG[64] = {
+  0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+  12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+  35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+  58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+// ---- huffman tables --------------------------------------------------------------------------
+
+struct HuffDecodeTable {
+  uint8_t vals[256];
+  int32_t maxcode[18];
+  int32_t valptr[17];
+  uint16_t mincode[17];
+  uint16_t lookup[256];  // (length << 8) | value for codes of up to 8 bits, 0 = slow path
+  bool present = false;
+
+  void build(const uint8_t* bits /* [16] */, const uint8_t* values, int count) {
+    memcpy(vals, values, count);
+    int code = 0, k = 0;
+    memset(lookup, 0, sizeof(lookup));
+    for (int l = 1; l <= 16; ++l) {
+      valptr[l] = k;
+      mincode[l] = uint16_t(code);
+      for (int i = 0; i < bits[l - 1]; ++i, ++k, ++code) {
+        if (l <= 8) {
+          int shift = 8 - l;
+          for (int j = 0; j < (1 << shift); ++j) lookup[(code << shift) | j] = uint16_t(l << 8 | vals[k]);
+        }
+      }
+      maxcode[l] = bits[l - 1] ? code - 1 : -1;
+      code <<= 1;
+    }
+    maxcode[17] = 0x7FFFFFFF;
+    present = true;
+  }
+};
+
+struct HuffEncodeTable {
+  uint16_t code[256];
+  uint8_t size[256];
+
+  void build(const uint8_t* bits, const uint8_t* values) {
+    memset(size, 0, sizeof(size));
+    int k = 0, c = 0;
+    for (int l = 1; l <= 16; ++l) {
+      for (int i = 0; i < bits[l - 1]; ++i, ++k, ++c) {
+        code[values[k]] = uint16_t(c);
+        size[values[k]] = uint8_t(l);
+      }
+      c <<= 1;
+    }
+  }
+};
+
+// ITU T.81 Annex K tables
+static const uint8_t STD_DC_LUMA_BITS[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+static const uint8_t STD_DC_CHROMA_BITS[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+static const uint8_t STD_DC_VALS[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+static const uint8_t STD_AC_LUMA_BITS[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d};
+static const uint8_t STD_AC_LUMA_VALS[162] = {
+  0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+  0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+  0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+  0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+  0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+  0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+  0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+  0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+  0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+  0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+  0xf9, 0xfa,
+};
+static const uint8_t STD_AC_CHROMA_BITS[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+static const uint8_t STD_AC_CHROMA_VALS[162] = {
+  0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+  0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+  0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+  0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+  0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+  0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+  0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+  0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+  0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+  0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+  0xf9, 0xfa,
+};
+static const uint8_t STD_LUMA_QUANT[64] = {  // natural order
+  16, 11, 10, 16, 24,  40,  51,  61,  12, 12, 14, 19, 26,  58,  60,  55,
+  14, 13, 16, 24, 40,  57,  69,  56,  14, 17, 22, 29, 51,  87,  80,  62,
+  18, 22, 37, 56, 68,  109, 103, 77,  24, 35, 55, 64, 81,  104, 113, 92,
+  49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99,
+};
+static const uint8_t STD_CHROMA_QUANT[64] = {
+  17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+  24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+};
+
+// ---- entropy bit i/o -------------------------------------------------------------------------
+
+// reads entropy-coded bytes, undoing 0xFF00 stuffing. stops (feeding zero bits) at any marker.
+class EntropyReader {
+ public:
+  EntropyReader(const uint8_t* p, size_t len) : p_(p), end_(p + len) {}
+
+  uint32_t peek(int n) {
+    fill();
+    return acc_ >> (32 - n);
+  }
+  void skip(int n) {
+    acc_ <<= n;
+    bits_ -= n;
+  }
+  uint32_t get(int n) {
+    if (n == 0) return 0;
+    uint32_t v = peek(n);
+    skip(n);
+    return v;
+  }
+
+  // drops the partial byte and moves past the next RSTn marker; false if the data ends first
+  bool skipRestart() {
+    acc_ = 0;
+    bits_ = 0;
+    const uint8_t* q = marker_ ? marker_ : p_;
+    while (q + 1 < end_ && !(q[0] == 0xFF && q[1] >= 0xD0 && q[1] <= 0xD7)) ++q;
+    if (q + 1 >= end_) return false;
+    p_ = q + 2;
+    marker_ = nullptr;
+    return true;
+  }
+
+ private:
+  void fill() {
+    while (bits_ <= 24) {
+      uint32_t b = 0;
+      if (!marker_ && p_ < end_) {
+        b = *p_;
+        if (b == 0xFF) {
+          if (p_ + 1 < end_ && p_[1] == 0x00) {
+            p_ += 2;
+          } else {
+            marker_ = p_;
+            b = 0;
+          }
+        } else {
+          ++p_;
+        }
+      }
+      acc_ |= b << (24 - bits_);
+      bits_ += 8;
+    }
+  }
+
+  const uint8_t* p_;
+  const uint8_t* end_;
+  const uint8_t* marker_ = nullptr;
+  uint32_t acc_ = 0;
+  int bits_ = 0;
+};
+
+// bounded output with 0xFF stuffing; writes past `cap` set overflow
+class ByteSink {
+ public:
+  void reset(uint8_t* out, size_t cap) {
+    out_ = out;
+    cap_ = cap;
+    len_ = 0;
+    acc_ = 0;
+    bits_ = 0;
+    overflow_ = false;
+  }
+  void byte(uint8_t b) {
+    if (len_ < cap_) out_[len_++] = b;
+    else overflow_ = true;
+  }
+  void word(uint16_t w) {
+    byte(uint8_t(w >> 8));
+    byte(uint8_t(w));
+  }
+  void bits(uint32_t value, int n) {
+    acc_ = (acc_ << n) | (value & ((1u << n) - 1));
+    bits_ += n;
+    while (bits_ >= 8) {
+      uint8_t b = uint8_t(acc_ >> (bits_ - 8));
+      byte(b);
+      if (b == 0xFF) byte(0);
+      bits_ -= 8;
+    }
+  }
+  void flushBits() {
+    if (bits_ > 0) bits(0x7F, 8 - bits_);  // pad with 1s
+  }
+  size_t size() const { return len_; }
+  bool overflow() const { return overflow_; }
+
+ private:
+  uint8_t* out_ = nullptr;
+  size_t cap_ = 0;
+  size_t len_ = 0;
+  uint32_t acc_ = 0;
+  int bits_ = 0;
+  bool overflow_ = false;
+};
+
+// ---- transforms ------------------------------------------------------------------------------
+
+// reduced inverse DCT: the top-left NxN coefficients of an 8x8 block -> NxN pixels.
+// out(n) = 1/2 * sum_k C(k) F(k) cos((2n+1) k pi / 2N), the same DC gain as the 8-point IDCT.
+class ReducedIdct {
+ public:
+  void init(int n) {
+    n_ = n;
+    for (int x = 0; x < n; ++x)
+      for (int k = 0; k < n; ++k)
+        basis_[x][k] = 0.5f * (k == 0 ? 0.70710678f : 1.0f) * cosf(float((2 * x + 1) * k) * 3.14159265f / float(2 * n));
+  }
+
+  // coef: natural order 8x8, only [v][u] with u,v < n are read
+  void run(const float* coef, uint8_t* out, int stride) const {
+    float tmp[8][8];
+    for (int v = 0; v < n_; ++v)
+      for (int x = 0; x < n_; ++x) {
+        float s = 0;
+        for (int u = 0; u < n_; ++u) s += basis_[x][u] * coef[v * 8 + u];
+        tmp[v][x] = s;
+      }
+    for (int y = 0; y < n_; ++y)
+      for (int x = 0; x < n_; ++x) {
+        float s = 128.0f;
+        for (int v = 0; v < n_; ++v) s += basis_[y][v] * tmp[v][x];
+        int p = int(s + 0.5f);
+        out[y * stride + x] = uint8_t(p < 0 ? 0 : p > 255 ? 255 : p);
+      }
+  }
+
+ private:
+  int n_ = 8;
+  float basis_[8][8];
+};
+
+class ForwardDct {
+ public:
+  ForwardDct() {
+    for (int k = 0; k < 8; ++k)
+      for (int x = 0; x < 8; ++x)
+        basis_[k][x] = 0.5f * (k == 0 ? 0.70710678f : 1.0f) * cosf(float((2 * x + 1) * k) * 3.14159265f / 16.0f);
+  }
+
+  void run(const uint8_t* in, int stride, float* out) const {
+    float tmp[8][8];
+    for (int y = 0; y < 8; ++y)
+      for (int u = 0; u < 8; ++u) {
+        float s = 0;
+        for (int x = 0; x < 8; ++x) s += basis_[u][x] * (float(in[y * stride + x]) - 128.0f);
+        tmp[y][u] = s;
+      }
+    for (int v = 0; v < 8; ++v)
+      for (int u = 0; u < 8; ++u) {
+        float s = 0;
+        for (int y = 0; y < 8; ++y) s += basis_[v][y] * tmp[y][u];
+        out[v * 8 + u] = s;
+      }
+  }
+
+ private:
+  float basis_[8][8];
+};
+
+// ---- encoder --------------------------------------------------------------------------------
+
+// baseline encoder with the Annex K tables, fed one MCU row at a time from component planes
+class BaselineEncoder {
+ public:
+  // writes SOI .. SOS. `sampling[c]` is (h << 4 | v) for each of the 1 or 3 components
+  void begin(uint8_t* out, size_t cap, uint16_t width, uint16_t height, int ncomp, const uint8_t* sampling,
+             uint8_t quality) {
+    sink_.reset(out, cap);
+    ncomp_ = ncomp;
+    hmax_ = vmax_ = 1;
+    for (int c = 0; c < ncomp; ++c) {
+      h_[c] = sampling[c] >> 4;
+      v_[c] = sampling[c] & 15;
+      pred_[c] = 0;
+      if (h_[c] > hmax_) hmax_ = h_[c];
+      if (v_[c] > vmax_) vmax_ = v_[c];
+    }
+    mcusX_ = (width + 8 * hmax_ - 1) / (8 * hmax_);
+    writeHeaders(width, height, quality);
+  }
+
+  // one MCU row: planes[c] holds v*8 rows of at least mcusX*h*8 samples, row stride strides[c]
+  void encodeRow(const uint8_t* const* planes, const int* strides) {
+    for (int mx = 0; mx < mcusX_; ++mx) {
+      for (int c = 0; c < ncomp_; ++c) {
+        int t = c == 0 ? 0 : 1;
+        for (int by = 0; by < v_[c]; ++by)
+          for (int bx = 0; bx < h_[c]; ++bx) {
+            float coef[64];
+            fdct_.run(planes[c] + by * 8 * strides[c] + (mx * h_[c] + bx) * 8, strides[c], coef);
+            encodeBlock(coef, pred_[c], t);
+          }
+      }
+    }
+  }
+
+  // writes EOI; returns the output size, 0 on overflow
+  size_t finish() {
+    sink_.flushBits();
+    sink_.word(0xFFD9);
+    return sink_.overflow() ? 0 : sink_.size();
+  }
+
+  bool overflow() const { return sink_.overflow(); }
+
+ private:
+  static int magnitude(int v) {
+    int a = v < 0 ? -v : v, n = 0;
+    while (a) { ++n; a >>= 1; }
+    return n;
+  }
+
+  void encodeBlock(const float* coef, int& pred, int t) {
+    int q[64];
+    for (int i = 0; i < 64; ++i) {
+      int z = ZIGZAG[i];
+      float v = coef[z] / outQuant_[t][z];
+      q[i] = int(v < 0 ? v - 0.5f : v + 0.5f);
+    }
+    int diff = q[0] - pred;
+    pred = q[0];
+    int s = magnitude(diff);
+    sink_.bits(encDc_[t].code[s], encDc_[t].size[s]);
+    if (s) sink_.bits(uint32_t(diff < 0 ? diff - 1 : diff), s);
+    int run = 0;
+    for (int i = 1; i < 64; ++i) {
+      if (q[i] == 0) { ++run; continue; }
+      while (run > 15) {
+        sink_.bits(encAc_[t].code[0xF0], encAc_[t].size[0xF0]);
+        run -= 16;
+      }
+      int sz = magnitude(q[i]);
+      int sym = run << 4 | sz;
+      sink_.bits(encAc_[t].code[sym], encAc_[t].size[sym]);
+      sink_.bits(uint32_t(q[i] < 0 ? q[i] - 1 : q[i]), sz);
+      run = 0;
+    }
+    if (run) sink_.bits(encAc_[t].code[0x00], encAc_[t].size[0x00]);
+  }
+
+  void writeHeaders(uint16_t width, uint16_t height, uint8_t quality) {
+    if (quality < 1) quality = 1;
+    if (quality > 100) quality = 100;
+    int qs = quality < 50 ? 5000 / quality : 200 - 2 * quality;
+    int tables = ncomp_ == 1 ? 1 : 2;
+
+    sink_.word(0xFFD8);
+    for (int t = 0; t < tables; ++t) {
+      const uint8_t* base = t ? STD_CHROMA_QUANT : STD_LUMA_QUANT;
+      sink_.word(0xFFDB);
+      sink_.word(67);
+      sink_.byte(uint8_t(t));
+      for (int i = 0; i < 64; ++i) {
+        int z = ZIGZAG[i];
+        int v = (base[z] * qs + 50) / 100;
+        v = v < 1 ? 1 : v > 255 ? 255 : v;
+        outQuant_[t][z] = float(v);
+        sink_.byte(uint8_t(v));
+      }
+    }
+
+    sink_.word(0xFFC0);
+    sink_.word(uint16_t(8 + 3 * ncomp_));
+    sink_.byte(8);
+    sink_.word(height);
+    sink_.word(width);
+    sink_.byte(uint8_t(ncomp_));
+    for (int c = 0; c < ncomp_; ++c) {
+      sink_.byte(uint8_t(c + 1));
+      sink_.byte(uint8_t(h_[c] << 4 | v_[c]));
+      sink_.byte(uint8_t(c ? 1 : 0));
+    }
+
+    for (int t = 0; t < tables; ++t) {
+      const uint8_t* dcBits = t ? STD_DC_CHROMA_BITS : STD_DC_LUMA_BITS;
+      const uint8_t* acBits = t ? STD_AC_CHROMA_BITS : STD_AC_LUMA_BITS;
+      const uint8_t* acVals = t ? STD_AC_CHROMA_VALS : STD_AC_LUMA_VALS;
+      encDc_[t].build(dcBits, STD_DC_VALS);
+      encAc_[t].build(acBits, acVals);
+      sink_.word(0xFFC4);
+      sink_.word(uint16_t(2 + 17 + 12 + 17 + 162));
+      sink_.byte(uint8_t(0x00 | t));
+      for (int i = 0; i < 16; ++i) sink_.byte(dcBits[i]);
+      for (int i = 0; i < 12; ++i) sink_.byte(STD_DC_VALS[i]);
+      sink_.byte(uint8_t(0x10 | t));
+      for (int i = 0; i < 16; ++i) sink_.byte(acBits[i]);
+      for (int i = 0; i < 162; ++i) sink_.byte(acVals[i]);
+    }
+
+    sink_.word(0xFFDA);
+    sink_.word(uint16_t(6 + 2 * ncomp_));
+    sink_.byte(uint8_t(ncomp_));
+    for (int c = 0; c < ncomp_; ++c) {
+      sink_.byte(uint8_t(c + 1));
+      sink_.byte(uint8_t(c ? 0x11 : 0x00));
+    }
+    sink_.byte(0);
+    sink_.byte(63);
+    sink_.byte(0);
+  }
+
+  int ncomp_ = 0;
+  int h_[MAX_COMPONENTS], v_[MAX_COMPONENTS], pred_[MAX_COMPONENTS];
+  int hmax_ = 1, vmax_ = 1, mcusX_ = 0;
+  HuffEncodeTable encDc_[2], encAc_[2];
+  float outQuant_[2][64];
+  ForwardDct fdct_;
+  ByteSink sink_;
+};
+
+// ---- transcoder ------------------------------------------------------------------------------
+
+// one decoded output MCU row, handed to a StripSink in decode-only mode. the sample of component
+// c at output luma position (x, y) is plane[c][((y - y0) * v[c] / vmax) * stride[c] + x * h[c] / hmax].
+struct Strip {
+  int ncomp;
+  const uint8_t* plane[MAX_COMPONENTS];
+  int stride[MAX_COMPONENTS];
+  int h[MAX_COMPONENTS], v[MAX_COMPONENTS];
+  int hmax, vmax;
+  int y0;     // first output row in this strip
+  int rows;   // valid output rows
+  int width;  // valid output columns
+};
+
+class StripSink {
+ public:
+  virtual void strip(const Strip& s) = 0;
+
+ protected:
+  ~StripSink() = default;
+};
+
+// `MaxOutWidth` bounds the strip buffers, and with them the object size: a decoder that only
+// produces thumbnails can use a much smaller instance than the full transcoder.
+template <int MaxOutWidth = MAX_OUT_WIDTH>
+class BasicTranscoder {
+ public:
+  enum class Status : uint8_t { Ok, Unsupported, Corrupt, TooWide, OutputFull };
+
+  // parses the input headers (SOI .. SOS) and writes the output headers. `scale` is 1, 2, 4 or 8.
+  Status begin(const uint8_t* headers, size_t len, uint8_t scale, uint8_t quality, uint8_t* out, size_t cap) {
+    Status s = start(headers, len, scale, nullptr);
+    if (s != Status::Ok) return s;
+    uint8_t sampling[MAX_COMPONENTS];
+    for (int c = 0; c < ncomp_; ++c) sampling[c] = uint8_t(comp_[c].h << 4 | comp_[c].v);
+    encoder_.begin(out, cap, outWidth_, outHeight_, ncomp_, sampling, quality);
+    return encoder_.overflow() ? fail(Status::OutputFull) : Status::Ok;
+  }
+
+  // decode-only: the 1/scale picture goes to `sink` one MCU row at a time instead of the encoder
+  Status beginDecode(const uint8_t* headers, size_t len, uint8_t scale, StripSink* sink) {
+    return start(headers, len, scale, sink);
+  }
+
+  // entropy-coded data; each call must end on a restart-interval boundary or at the end of scan
+  Status feed(const uint8_t* data, size_t len) {
+    if (status_ != Status::Ok) return status_;
+    EntropyReader r(data, len);
+    bool fresh = true;
+    const uint32_t total = uint32_t(mcusX_) * mcusY_;
+    while (mcu_ < total) {
+      if (restartInterval_ && inInterval_ == restartInterval_) {
+        if (!fresh && !r.skipRestart()) return Status::Ok;  // piece ended; next feed starts the interval
+        for (int c = 0; c < ncomp_; ++c) comp_[c].pred = 0;
+        inInterval_ = 0;
+      }
+      fresh = false;
+      if (!decodeMcu(r)) return fail(Status::Corrupt);
+      ++mcu_;
+      ++inInterval_;
+      if (mcu_ % mcusX_ == 0) {
+        if (++stripRows_ == scale_ || mcu_ == total) emitStrip();
+        if (!stripSink_ && encoder_.overflow()) return fail(Status::OutputFull);
+      }
+    }
+    return Status::Ok;
+  }
+
+  // writes EOI; returns the output size, 0 if the picture was incomplete or anything failed.
+  // in decode-only mode it returns 1 once the whole picture has gone to the sink.
+  size_t finish() {
+    if (status_ != Status::Ok || mcu_ < uint32_t(mcusX_) * mcusY_) return 0;
+    return stripSink_ ? 1 : encoder_.finish();
+  }
+
+  // whole JPEG in one buffer
+  size_t transcode(const uint8_t* in, size_t len, uint8_t scale, uint8_t quality, uint8_t* out, size_t cap) {
+    size_t headerLen = scanOffset(in, len);
+    if (!headerLen) return 0;
+    if (begin(in, headerLen, scale, quality, out, cap) != Status::Ok) return 0;
+    if (feed(in + headerLen, len - headerLen) != Status::Ok) return 0;
+    return finish();
+  }
+
+  // whole JPEG in one buffer, decode-only
+  bool decode(const uint8_t* in, size_t len, uint8_t scale, StripSink* sink) {
+    size_t headerLen = scanOffset(in, len);
+    if (!headerLen) return false;
+    if (beginDecode(in, headerLen, scale, sink) != Status::Ok) return false;
+    if (feed(in + headerLen, len - headerLen) != Status::Ok) return false;
+    return finish() != 0;
+  }
+
+  // offset just past the SOS segment, 0 if there is none
+  static size_t scanOffset(const uint8_t* d, size_t len) {
+    if (len < 4 || d[0] != 0xFF || d[1] != 0xD8) return 0;
+    size_t pos = 2;
+    while (pos + 4 <= len) {
+      if (d[pos] != 0xFF) return 0;
+      uint8_t m = d[pos + 1];
+      if (m == 0xFF) { ++pos; continue; }
+      size_t segLen = size_t(d[pos + 2]) << 8 | d[pos + 3];
+      pos += 2 + segLen;
+      if (m == 0xDA) return pos <= len ? pos : 0;
+    }
+    return 0;
+  }
+
+  Status status() const { return status_; }
+  uint16_t width() const { return width_; }
+  uint16_t height() const { return height_; }
+  uint16_t outWidth() const { return outWidth_; }
+  uint16_t outHeight() const { return outHeight_; }
+
+ private:
+  struct Component {
+    uint8_t id, h, v, tq, td, ta;
+    int pred;
+    int stripW, producedW;
+    uint8_t strip[MaxOutWidth * 16];  // stripW x (v * 8) output samples
+  };
+
+  Status fail(Status s) {
+    status_ = s;
+    return s;
+  }
+
+  Status start(const uint8_t* headers, size_t len, uint8_t scale, StripSink* sink) {
+    status_ = Status::Ok;
+    stripSink_ = sink;
+    if (scale != 1 && scale != 2 && scale != 4 && scale != 8) return fail(Status::Unsupported);
+    scale_ = scale;
+    n_ = 8 / scale;
+    idct_.init(n_);
+    restartInterval_ = 0;
+    ncomp_ = 0;
+    for (auto& t : dc_) t.present = false;
+    for (auto& t : ac_) t.present = false;
+
+    Status s = parseHeaders(headers, len);
+    if (s != Status::Ok) return fail(s);
+
+    outWidth_ = uint16_t((width_ + scale - 1) / scale);
+    outHeight_ = uint16_t((height_ + scale - 1) / scale);
+    mcusX_ = (width_ + 8 * hmax_ - 1) / (8 * hmax_);
+    mcusY_ = (height_ + 8 * vmax_ - 1) / (8 * vmax_);
+    outMcusX_ = (outWidth_ + 8 * hmax_ - 1) / (8 * hmax_);
+    for (int c = 0; c < ncomp_; ++c) {
+      comp_[c].stripW = outMcusX_ * comp_[c].h * 8;
+      comp_[c].producedW = mcusX_ * comp_[c].h * n_;
+      if (comp_[c].stripW > MaxOutWidth) return fail(Status::TooWide);
+      comp_[c].pred = 0;
+    }
+    mcu_ = 0;
+    inInterval_ = 0;
+    stripRows_ = 0;
+    rowsOut_ = 0;
+    return Status::Ok;
+  }
+
+  Status parseHeaders(const uint8_t* d, size_t len) {
+    if (len < 4 || d[0] != 0xFF || d[1] != 0xD8) return Status::Corrupt;
+    size_t pos = 2;
+    bool haveFrame = false;
+    while (pos + 4 <= len) {
+      if (d[pos] != 0xFF) return Status::Corrupt;
+      uint8_t m = d[pos + 1];
+      if (m == 0xFF) { ++pos; continue; }
+      size_t segLen = size_t(d[pos + 2]) << 8 | d[pos + 3];
+      if (segLen < 2 || pos + 2 + segLen > len) return Status::Corrupt;
+      const uint8_t* s = d + pos + 4;
+      const uint8_t* e = d + pos + 2 + segLen;
+      switch (m) {
+        case 0xC0:
+        case 0xC1: {
+          if (segLen < 8 || s[0] != 8) return Status::Unsupported;
+          height_ = uint16_t(s[1] << 8 | s[2]);
+          width_ = uint16_t(s[3] << 8 | s[4]);
+          ncomp_ = s[5];
+          if ((ncomp_ != 1 && ncomp_ != 3) || segLen < size_t(8 + 3 * ncomp_) || !width_ || !height_)
+            return Status::Unsupported;
+          hmax_ = vmax_ = 1;
+          for (int c = 0; c < ncomp_; ++c) {
+            Component& k = comp_[c];
+            k.id = s[6 + 3 * c];
+            k.h = s[7 + 3 * c] >> 4;
+            k.v = s[7 + 3 * c] & 15;
+            k.tq = s[8 + 3 * c] & 3;
+            if (k.h < 1 || k.h > 2 || k.v < 1 || k.v > 2) return Status::Unsupported;
+            if (k.h > hmax_) hmax_ = k.h;
+            if (k.v > vmax_) vmax_ = k.v;
+          }
+          if (ncomp_ == 1) comp_[0].h = comp_[0].v = hmax_ = vmax_ = 1;  // single component: 1 block MCU
+          haveFrame = true;
+          break;
+        }
+        case 0xC2: case 0xC3: case 0xC5: case 0xC6: case 0xC7:
+        case 0xC9: case 0xCA: case 0xCB: case 0xCD: case 0xCE: case 0xCF:
+          return Status::Unsupported;  // progressive, lossless, arithmetic
+        case 0xC4: {
+          while (s + 17 <= e) {
+            uint8_t tc = s[0] >> 4, th = s[0] & 3;
+            int count = 0;
+            for (int i = 0; i < 16; ++i) count += s[1 + i];
+            if (count > 256 || s + 17 + count > e) return Status::Corrupt;
+            (tc ? ac_ : dc_)[th].build(s + 1, s + 17, count);
+            s += 17 + count;
+          }
+          break;
+        }
+        case 0xDB: {
+          while (s < e) {
+            uint8_t pq = s[0] >> 4, tq = s[0] & 3;
+            size_t n = pq ? 128 : 64;
+            if (s + 1 + n > e) return Status::Corrupt;
+            for (int i = 0; i < 64; ++i) quant_[tq][ZIGZAG[i]] = float(pq ? (s[1 + 2 * i] << 8 | s[2 + 2 * i]) : s[1 + i]);
+            s += 1 + n;
+          }
+          break;
+        }
+        case 0xDD:
+          if (segLen >= 4) restartInterval_ = uint16_t(s[0] << 8 | s[1]);
+          break;
+        case 0xDA: {
+          if (!haveFrame || s[0] != ncomp_) return Status::Unsupported;  // one interleaved scan only
+          for (int i = 0; i < ncomp_; ++i) {
+            uint8_t cid = s[1 + 2 * i];
+            int c = 0;
+            while (c < ncomp_ && comp_[c].id != cid) ++c;
+            if (c == ncomp_) return Status::Corrupt;
+            comp_[c].td = s[2 + 2 * i] >> 4 & 3;
+            comp_[c].ta = s[2 + 2 * i] & 3;
+            if (!dc_[comp_[c].td].present || !ac_[comp_[c].ta].present) return Status::Corrupt;
+          }
+          return Status::Ok;
+        }
+        default:
+          break;
+      }
+      pos += 2 + segLen;
+    }
+    return Status::Corrupt;
+  }
+
+  static int decodeHuff(EntropyReader& r, const HuffDecodeTable& t) {
+    uint32_t look = t.lookup[r.peek(8)];
+    if (look) {
+      r.skip(look >> 8);
+      return look & 0xFF;
+    }
+    uint32_t bits16 = r.peek(16);
+    for (int l = 9; l <= 16; ++l) {
+      int32_t code = int32_t(bits16 >> (16 - l));
+      if (code <= t.maxcode[l]) {
+        r.skip(l);
+        return t.vals[t.valptr[l] + code - t.mincode[l]];
+      }
+    }
+    return -1;
+  }
+
+  static int extend(uint32_t v, int s) { return s && v < (1u << (s - 1)) ? int(v) - (1 << s) + 1 : int(v); }
+
+  bool decodeMcu(EntropyReader& r) {
+    const uint32_t mx = mcu_ % mcusX_;
+    for (int c = 0; c < ncomp_; ++c) {
+      Component& k = comp_[c];
+      for (int by = 0; by < k.v; ++by) {
+        for (int bx = 0; bx < k.h; ++bx) {
+          float coef[64];
+          for (int i = 0; i < n_; ++i)
+            for (int j = 0; j < n_; ++j) coef[i * 8 + j] = 0;
+          int s = decodeHuff(r, dc_[k.td]);
+          if (s < 0 || s > 11) return false;
+          k.pred += extend(r.get(s), s);
+          coef[0] = float(k.pred) * quant_[k.tq][0];
+          for (int i = 1; i < 64;) {
+            int rs = decodeHuff(r, ac_[k.ta]);
+            if (rs < 0) return false;
+            int run = rs >> 4, size = rs & 15;
+            if (size == 0) {
+              if (run != 15) break;  // EOB
+              i += 16;
+              continue;
+            }
+            i += run;
+            if (i > 63) return false;
+            int v = extend(r.get(size), size);
+            int z = ZIGZAG[i];
+            if ((z & 7) < n_ && (z >> 3) < n_) coef[z] = float(v) * quant_[k.tq][z];  // keep only low freqs
+            ++i;
+          }
+          int x = int(mx) * k.h * n_ + bx * n_;
+          int y = int(stripRows_) * k.v * n_ + by * n_;
+          idct_.run(coef, k.strip + y * k.stripW + x, k.stripW);
+        }
+      }
+    }
+    return true;
+  }
+
+  // pads the strip to whole blocks by edge replication, then hands it to the encoder as one
+  // output MCU row, or to the sink in decode-only mode
+  void emitStrip() {
+    for (int c = 0; c < ncomp_; ++c) {
+      Component& k = comp_[c];
+      int rows = stripRows_ * k.v * n_;
+      int full = k.v * 8;
+      for (int y = 0; y < full; ++y) {
+        uint8_t* row = k.strip + y * k.stripW;
+        if (y >= rows) memcpy(row, k.strip + (rows - 1) * k.stripW, k.producedW);
+        for (int x = k.producedW; x < k.stripW; ++x) row[x] = row[k.producedW - 1];
+      }
+    }
+    const uint8_t* planes[MAX_COMPONENTS];
+    int strides[MAX_COMPONENTS];
+    for (int c = 0; c < ncomp_; ++c) {
+      planes[c] = comp_[c].strip;
+      strides[c] = comp_[c].stripW;
+    }
+    if (stripSink_) {
+      Strip st;
+      st.ncomp = ncomp_;
+      for (int c = 0; c < ncomp_; ++c) {
+        st.plane[c] = planes[c];
+        st.stride[c] = strides[c];
+        st.h[c] = comp_[c].h;
+        st.v[c] = comp_[c].v;
+      }
+      st.hmax = hmax_;
+      st.vmax = vmax_;
+      st.y0 = rowsOut_;
+      int produced = stripRows_ * vmax_ * n_;
+      st.rows = rowsOut_ + produced > outHeight_ ? outHeight_ - rowsOut_ : produced;
+      st.width = outWidth_;
+      stripSink_->strip(st);
+      rowsOut_ += produced;
+    } else {
+      encoder_.encodeRow(planes, strides);
+    }
+    stripRows_ = 0;
+  }
+
+  Status status_ = Status::Ok;
+  uint8_t scale_ = 1;
+  int n_ = 8;
+  uint16_t width_ = 0, height_ = 0, outWidth_ = 0, outHeight_ = 0;
+  int ncomp_ = 0;
+  int hmax_ = 1, vmax_ = 1;
+  int mcusX_ = 0, mcusY_ = 0, outMcusX_ = 0;
+  uint16_t restartInterval_ = 0;
+  uint32_t mcu_ = 0;
+  uint32_t inInterval_ = 0;
+  int stripRows_ = 0;
+
+  Component comp_[MAX_COMPONENTS];
+  HuffDecodeTable dc_[4], ac_[4];
+  float quant_[4][64];
+  ReducedIdct idct_;
+  BaselineEncoder encoder_;
+  StripSink* stripSink_ = nullptr;
+  int rowsOut_ = 0;
+};
+
+using Transcoder = BasicTranscoder<>;
+
+}  // namespace jpeg
@@ -0,0 +1,91 @@
+// scale_governor.h - picks a transcode level from measured uplink utilisation
+//
+// utilisation over a window is the larger of
+//   - the fraction of wall time spent blocked in uplink writes (self-calibrating: a saturated
+//     TCP send buffer makes write() block), and
+//   - bytes sent / budgetBytesPerSec, when a nominal link budget is configured.
+// levels are ordered from passthrough (0) to the most aggressive reduction; the caller maps them
+// to a scale / quality. above `high` the level steps up. it steps back down only when the
+// utilisation projected for the lower level, from the output/input byte ratio observed at each
+// level, stays under `low` for `calmWindows` windows, so it does not oscillate.
+#pragma once
+
+#include <stdint.h>
+
+namespace jpeg {
+
+class ScaleGovernor {
+ public:
+  static constexpr uint8_t MAX_LEVELS = 8;
+
+  ScaleGovernor(uint8_t levels, float high = 0.75f, float low = 0.5f, uint32_t budgetBytesPerSec = 0,
+                uint32_t windowMs = 1000, uint8_t calmWindows = 3)
+      : maxLevel_(uint8_t((levels < MAX_LEVELS ? levels : MAX_LEVELS) - 1)), high_(high), low_(low),
+        budget_(budgetBytesPerSec), windowMs_(windowMs), calmWindows_(calmWindows) {
+    for (float& r : ratio_) r = 1.0f;
+  }
+
+  // every uplink write: bytes sent and microseconds spent inside write()/flush()
+  void onWrite(uint32_t bytes, uint32_t busyUs) {
+    bytes_ += bytes;
+    busyUs_ += busyUs;
+  }
+
+  // every transcoded picture, to learn how much each level saves
+  void onTranscode(uint32_t inBytes, uint32_t outBytes) {
+    if (!inBytes) return;
+    float r = float(outBytes) / float(inBytes);
+    ratio_[level_] = ratio_[level_] * 0.8f + r * 0.2f;
+  }
+
+  // call often; returns true when a window closed and the level changed
+  bool tick(uint32_t nowMs) {
+    if (!started_) {
+      started_ = true;
+      windowStart_ = nowMs;
+      return false;
+    }
+    uint32_t elapsed = nowMs - windowStart_;
+    if (elapsed < windowMs_) return false;
+
+    float busy = float(busyUs_) / (float(elapsed) * 1000.0f);
+    float load = budget_ ? float(bytes_) * 1000.0f / (float(budget_) * float(elapsed)) : 0.0f;
+    util_ = busy > load ? busy : load;
+    windowStart_ = nowMs;
+    bytes_ = 0;
+    busyUs_ = 0;
+
+    uint8_t before = level_;
+    if (util_ > high_ && level_ < maxLevel_) {
+      ++level_;
+      calm_ = 0;
+    } else if (level_ > 0) {
+      float projected = util_ * ratio_[level_ - 1] / ratio_[level_];
+      calm_ = projected < low_ ? uint8_t(calm_ + 1) : 0;
+      if (calm_ >= calmWindows_) {
+        --level_;
+        calm_ = 0;
+      }
+    }
+    return level_ != before;
+  }
+
+  uint8_t level() const { return level_; }
+  float utilisation() const { return util_; }
+
+ private:
+  uint8_t maxLevel_;
+  float high_, low_;
+  uint32_t budget_;
+  uint32_t windowMs_;
+  uint8_t calmWindows_;
+  uint8_t level_ = 0;
+  uint8_t calm_ = 0;
+  float ratio_[MAX_LEVELS];  // observed output/input bytes per level (level 0 = passthrough = 1)
+  float util_ = 0;
+  uint32_t bytes_ = 0, busyUs_ = 0;
+  uint32_t windowStart_ = 0;
+  bool started_ = false;
+};
+
+}  // namespace jpeg
@@ -0,0 +1,98 @@
+// jpeg_slices.h - split a baseline JPEG into independently decodable restart intervals
+//
+// header-only, no allocation. a JPEG encoded with a restart interval (DRI marker) resets the DC
+// predictors at every RSTn marker, so each interval's entropy data can be decoded on its own.
+// the camera path sends the headers (SOI .. SOS) and groups of whole intervals as separate
+// packets; a receiver that loses a packet only loses those intervals (the base conceals them
+// with the same intervals of the previous frame, see base/jpeg_slices.py).
+//
+// a JPEG without DRI is a single interval, i.e. the whole scan travels as one slice.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace jpeg {
+
+struct ScanInfo {
+  size_t headerLen = 0;          // bytes from SOI up to and including the SOS segment
+  size_t scanEnd = 0;            // offset of EOI (or end of buffer if it is missing)
+  uint16_t restartInterval = 0;  // MCUs per interval, 0 when there is no DRI
+  uint16_t width = 0;
+  uint16_t height = 0;
+};
+
+inline uint16_t be16(const uint8_t* p) { return uint16_t(p[0] << 8 | p[1]); }
+
+inline bool isRst(uint8_t marker) { return marker >= 0xD0 && marker <= 0xD7; }
+
+// walks the marker segments up to the first SOS. false for anything that is not a baseline or
+// extended sequential JPEG with a single scan following its headers.
+inline bool parseHeaders(const uint8_t* d, size_t len, ScanInfo* out) {
+  if (len < 4 || d[0] != 0xFF || d[1] != 0xD8) return false;
+  size_t pos = 2;
+  while (pos + 4 <= len) {
+    if (d[pos] != 0xFF) return false;
+    uint8_t marker = d[pos + 1];
+    if (marker == 0xFF) { ++pos; continue; }  // fill byte
+    uint16_t segLen = be16(d + pos + 2);
+    if (segLen < 2 || pos + 2 + segLen > len) return false;
+    const uint8_t* seg = d + pos + 4;
+    if (marker == 0xC2 || marker == 0xC6 || marker == 0xCA) return false;  // progressive
+    if ((marker == 0xC0 || marker == 0xC1) && segLen >= 7) {
+      out->height = be16(seg + 1);
+      out->width = be16(seg + 3);
+    } else if (marker == 0xDD && segLen >= 4) {
+      out->restartInterval = be16(seg);
+    }
+    pos += 2 + segLen;
+    if (marker == 0xDA) {
+      out->headerLen = pos;
+      // EOI is normally the last two bytes; scan back over any padding the encoder appended
+      size_t end = len;
+      while (end >= pos + 2 && !(d[end - 2] == 0xFF && d[end - 1] == 0xD9)) --end;
+      out->scanEnd = end >= pos + 2 ? end - 2 : len;
+      return true;
+    }
+  }
+  return false;
+}
+
+// iterates the restart intervals of the scan: [start, end) excludes the RSTn marker that follows
+// an interval. markers inside entropy data are always unescaped (0xFF00 is stuffing), so a plain
+// byte scan is exact.
+class IntervalIterator {
+ public:
+  IntervalIterator(const uint8_t* d, const ScanInfo& scan) : d_(d), pos_(scan.headerLen), end_(scan.scanEnd) {}
+
+  bool next(size_t* start, size_t* end) {
+    if (pos_ >= end_) return false;
+    *start = pos_;
+    size_t p = pos_;
+    while (p + 1 < end_ && !(d_[p] == 0xFF && isRst(d_[p + 1]))) ++p;
+    if (p + 1 < end_) {
+      *end = p;
+      pos_ = p + 2;
+    } else {
+      *end = end_;
+      pos_ = end_;
+    }
+    return true;
+  }
+
+ private:
+  const uint8_t* d_;
+  size_t pos_;
+  size_t end_;
+};
+
+// number of restart intervals in the scan
+inline uint16_t countIntervals(const uint8_t* d, const ScanInfo& scan) {
+  IntervalIterator it(d, scan);
+  size_t s, e;
+  uint16_t n = 0;
+  while (it.next(&s, &e)) ++n;
+  return n;
+}
+
+}  // namespace jpeg
@@ -0,0 +1,250 @@
+// bench_mjpeg.cpp - native viewer-throughput benchmark for mjpeg_server.h (same code the primary runs)
+//
+// build & run from the repo root (linux / macos):
+//   g++ -O2 -std=c++17 -pthread -Ilib/mjpeg_http/src -Ilib/frame_cache/src -Ilib/swarm_proto/src
+//       lib/mjpeg_http/examples/bench_mjpeg.cpp -o bench_mjpeg
+//   ./bench_mjpeg [frame.jpg] [publish_fps]
+//
+// a writer thread publishes the picture into a FrameCache at publish_fps (0 = as fast as it can,
+// default 30) like the relay loop does, a server thread accepts on 127.0.0.1 and polls the
+// MjpegServer, and 1..MAX_VIEWERS viewer threads read /stream/1 for two seconds each round. one
+// extra viewer is started at the limit to check it gets a 503. a last round has one viewer that
+// asks for the stream and never reads it, like a phone gone out of range: the others must keep
+// their rate and the cache must keep replacing the picture.
+#include <mjpeg_server.h>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static uint32_t nowMs() {
+  static const Clock::time_point start = Clock::now();
+  return uint32_t(std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count());
+}
+
+// the client surface MjpegServer uses, over a posix socket: writes never block
+class SocketClient {
+ public:
+  SocketClient() = default;
+  explicit SocketClient(int fd) : fd_(fd) {}
+  int available() {
+    int n = 0;
+    return fd_ >= 0 && ioctl(fd_, FIONREAD, &n) == 0 ? n : 0;
+  }
+  int read(uint8_t* buf, size_t n) { return fd_ >= 0 ? int(::recv(fd_, buf, n, MSG_DONTWAIT)) : -1; }
+  int availableForWrite() {
+    pollfd p{fd_, POLLOUT, 0};
+    return fd_ >= 0 && ::poll(&p, 1, 0) == 1 && (p.revents & POLLOUT) ? 64 * 1024 : 0;  // send() takes what fits
+  }
+  size_t write(const uint8_t* buf, size_t n) {
+    ssize_t w = fd_ >= 0 ? ::send(fd_, buf, n, MSG_NOSIGNAL | MSG_DONTWAIT) : -1;
+    return w > 0 ? size_t(w) : 0;
+  }
+  bool connected() {
+    if (fd_ < 0) return false;
+    uint8_t b;
+    ssize_t r = ::recv(fd_, &b, 1, MSG_PEEK | MSG_DONTWAIT);
+    return r != 0;
+  }
+  void stop() {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+  }
+
+ private:
+  int fd_ = -1;
+};
+
+constexpr int MAX_VIEWERS = 4;
+using Cache = cache::FrameCache<2>;
+using Server = http::MjpegServer<SocketClient, 2, MAX_VIEWERS>;
+
+struct ViewerResult {
+  bool refused = false;
+  uint64_t bytes = 0;
+  uint32_t frames = 0;
+};
+
+// a viewer that asks for the stream and then never reads: its socket fills and stays full
+static int stalledViewer(uint16_t port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  int small = 4096;
+  setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+  sockaddr_in a{};
+  a.sin_family = AF_INET;
+  a.sin_port = htons(port);
+  a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, (sockaddr*)&a, sizeof(a)) != 0) { close(fd); return -1; }
+  const char req[] = "GET /stream/1 HTTP/1.1\r\nHost: x\r\n\r\n";
+  send(fd, req, sizeof(req) - 1, 0);
+  return fd;
+}
+
+static void viewer(uint16_t port, int seconds, ViewerResult* out) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in a{};
+  a.sin_family = AF_INET;
+  a.sin_port = htons(port);
+  a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, (sockaddr*)&a, sizeof(a)) != 0) { close(fd); return; }
+  const char req[] = "GET /stream/1 HTTP/1.1\r\nHost: x\r\n\r\n";
+  send(fd, req, sizeof(req) - 1, 0);
+  timeval tv{0, 200000};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  std::vector<char> buf(64 * 1024);
+  std::string tail;  // boundary matching across reads
+  auto end = Clock::now() + std::chrono::seconds(seconds);
+  bool first = true;
+  while (Clock::now() < end) {
+    ssize_t n = recv(fd, buf.data(), buf.size(), 0);
+    if (n == 0) break;
+    if (n < 0) continue;
+    if (first && strncmp(buf.data(), "HTTP/1.1 503", 12) == 0) {
+      out->refused = true;
+      break;
+    }
+    first = false;
+    out->bytes += uint64_t(n);
+    tail.append(buf.data(), size_t(n));
+    size_t pos = 0;
+    while ((pos = tail.find("--frame\r\n", pos)) != std::string::npos) {
+      out->frames++;
+      pos += 9;
+    }
+    if (tail.size() > 16) tail.erase(0, tail.size() - 16);
+  }
+  close(fd);
+}
+
+int main(int argc, char** argv) {
+  std::vector<uint8_t> jpeg;
+  if (argc > 1) {
+    FILE* f = fopen(argv[1], "rb");
+    if (!f) { perror(argv[1]); return 1; }
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) jpeg.insert(jpeg.end(), chunk, chunk + n);
+    fclose(f);
+  } else {
+    jpeg.assign(24 * 1024, 0x55);  // typical VGA camera frame size; content does not matter here
+  }
+  int publishFps = argc > 2 ? atoi(argv[2]) : 30;
+
+  // the picture as the secondary would send it
+  std::vector<uint8_t> frame(proto::jpegFrameSize(jpeg.size()));
+  uint32_t plen = uint32_t(proto::JpegFrameHeader::SIZE + jpeg.size());
+
+  std::vector<uint8_t> pool(4 * 64 * 1024);
+  auto cache = std::make_unique<Cache>();
+  size_t cap = cache->init(pool.data(), pool.size());
+  std::vector<uint8_t> sendPool(Server::sendPoolSize(cap));
+  auto server = std::make_unique<Server>(*cache, sendPool.data(), sendPool.size());
+
+  int lfd = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in a{};
+  a.sin_family = AF_INET;
+  a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(lfd, (sockaddr*)&a, sizeof(a)) != 0 || listen(lfd, 16) != 0) { perror("listen"); return 1; }
+  socklen_t alen = sizeof(a);
+  getsockname(lfd, (sockaddr*)&a, &alen);
+  uint16_t port = ntohs(a.sin_port);
+  fcntl(lfd, F_SETFL, O_NONBLOCK);
+
+  std::atomic<bool> running{true};
+  std::atomic<uint32_t> published{0};
+  std::thread writer([&] {
+    uint16_t seq = 0;
+    while (running) {
+      proto::writeHeader(frame.data(), proto::MsgType::JpegFrame, 1, seq++, plen);
+      proto::writeJpegHeader(frame.data() + proto::FrameHeader::SIZE, nowMs(), 640, 480);
+      memcpy(frame.data() + proto::FrameHeader::SIZE + proto::JpegFrameHeader::SIZE, jpeg.data(), jpeg.size());
+      proto::writeTrailer(frame.data() + proto::FrameHeader::SIZE + plen,
+                          proto::frameCrc(frame.data(), frame.data() + proto::FrameHeader::SIZE, plen));
+      proto::FrameRef ref;
+      proto::parseFrame(frame.data(), frame.size(), &ref);
+      cache->add(ref, nowMs());
+      published++;
+      if (publishFps > 0) std::this_thread::sleep_for(std::chrono::microseconds(1000000 / publishFps));
+    }
+  });
+  std::thread serve([&] {
+    while (running) {
+      int fd = accept(lfd, nullptr, nullptr);
+      if (fd >= 0) {
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        int sndbuf = 16 * 1024;  // small like lwip's, so a viewer that stops reading fills it soon
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+        server->accept(SocketClient(fd), nowMs());
+      }
+      server->poll(nowMs());
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+  });
+
+  printf("picture %zu bytes, publishing at %s fps\n", jpeg.size(), publishFps ? std::to_string(publishFps).c_str() : "max");
+  printf("%-8s %12s %14s %12s\n", "viewers", "fps/viewer", "total MB/s", "refused");
+  const int SECONDS = 2;
+  for (int v = 1; v <= MAX_VIEWERS + 1; v = v == MAX_VIEWERS ? MAX_VIEWERS + 1 : v * 2) {
+    std::vector<ViewerResult> results(static_cast<size_t>(v));
+    std::vector<std::thread> threads;
+    for (int i = 0; i < v; ++i) {
+      threads.emplace_back(viewer, port, SECONDS, &results[size_t(i)]);
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    for (auto& t : threads) t.join();
+    uint64_t bytes = 0;
+    uint32_t frames = 0;
+    int refused = 0, served = 0;
+    for (const auto& r : results) {
+      if (r.refused) { ++refused; continue; }
+      ++served;
+      bytes += r.bytes;
+      frames += r.frames;
+    }
+    printf("%-8d %12.1f %14.1f %12d\n", v, served ? double(frames) / served / SECONDS : 0.0,
+           double(bytes) / SECONDS / 1e6, refused);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));  // let the server reap closed viewers
+  }
+  {
+    int stalled = stalledViewer(port);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));  // its socket fills
+    uint32_t stored0 = cache->stats().stored;
+    const int v = MAX_VIEWERS - 1;
+    std::vector<ViewerResult> results(static_cast<size_t>(v));
+    std::vector<std::thread> threads;
+    for (int i = 0; i < v; ++i) threads.emplace_back(viewer, port, SECONDS, &results[size_t(i)]);
+    for (auto& t : threads) t.join();
+    uint32_t frames = 0;
+    for (const auto& r : results) frames += r.frames;
+    printf("with one viewer not reading: %d others at %.1f fps each, %u pictures stored meanwhile\n", v,
+           double(frames) / v / SECONDS, cache->stats().stored - stored0);
+    close(stalled);
+  }
+  running = false;
+  writer.join();
+  serve.join();
+  close(lfd);
+  const auto& st = cache->stats();
+  printf("cache: %u published, %u stored, %u skipped while a viewer held the buffer\n", published.load(),
+         st.stored, st.busy);
+  if (server->stats().tooLarge) printf("server: %u pictures too large for a send buffer\n", server->stats().tooLarge);
+  return 0;
+}
@@ -0,0 +1,317 @@
+// mjpeg_server.h - tiny HTTP server for phones on the primary's softAP: per-node MJPEG streams
+// and a status page, each picture copied out of the frame cache into a per-viewer send buffer
+//
+// transport-agnostic: Client is anything with available() / read(buf, n) / availableForWrite() /
+// write(buf, n) / connected() / stop(), where write() takes what the socket accepts without
+// blocking and returns how much that was (a non-blocking WiFiClient wrapper on the ESP32, a socket
+// wrapper in the host benchmark). the owner accepts connections and calls poll() from its own
+// task. at most MaxViewers connections are served at once, anything beyond gets a 503.
+//
+// pictures never block the loop: each pass writes only as much of a connection's part as
+// availableForWrite() says its socket takes, so a phone on a weak link slows only its own stream.
+// a part is copied out of the cache lease into that viewer's send buffer (sendPoolSize() bytes
+// handed to the constructor) and the lease released at once, so a slow viewer never keeps the
+// cache from replacing a picture. a viewer is sent its node's newest picture once the previous
+// part is out, so a slow one skips the pictures it had no room for.
+//
+// routes: /            status page (nodes, picture size and age, viewers)
+//         /stream/<n>  multipart/x-mixed-replace MJPEG of node n
+//         /latest/<n>  latest picture of node n as a single image/jpeg
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <frame_cache.h>
+
+namespace http {
+
+struct Stats {
+  uint32_t requests = 0;
+  uint32_t refused = 0;  // 503: all viewer slots busy
+  uint32_t framesSent = 0;
+  uint32_t tooLarge = 0;  // picture bigger than a viewer's send buffer, not sent
+  uint64_t bytesSent = 0;
+};
+
+template <typename Client, int CacheSlots, int MaxViewers = 4>
+class MjpegServer {
+ public:
+  using Cache = cache::FrameCache<CacheSlots>;
+  // extra html appended to the status page (relay counters etc.); returns bytes written, `cap`
+  // or more if it did not fit (it is then left out)
+  using StatusFn = size_t (*)(char* out, size_t cap);
+
+  static constexpr uint32_t REQUEST_TIMEOUT_MS = 3000;
+  static constexpr uint32_t SEND_TIMEOUT_MS = 5000;  // a part making no progress this long closes the viewer
+
+  static constexpr size_t PART_HEADERS = 128 + 2;  // a part's http headers and trailing crlf, at most
+
+  // send pool for pictures of up to `capacity` bytes (the cache's): a buffer per viewer
+  static constexpr size_t sendPoolSize(size_t capacity) { return MaxViewers * (capacity + PART_HEADERS); }
+
+  // sendPool (sendPoolSize(cache capacity) bytes) is split into a send buffer per viewer
+  MjpegServer(Cache& cache, uint8_t* sendPool, size_t poolBytes, StatusFn extraStatus = nullptr)
+      : cache_(cache), extra_(extraStatus) {
+    for (int i = 0; i < MaxViewers && sendPool; ++i) {
+      conns_[i].buf = sendPool + size_t(i) * (poolBytes / MaxViewers);
+      conns_[i].bufCap = poolBytes / MaxViewers;
+    }
+  }
+
+  // takes a freshly accepted connection; false if it was refused because every slot is busy
+  bool accept(Client c, uint32_t nowMs) {
+    for (Conn& k : conns_) {
+      if (k.state != State::Free) continue;
+      uint8_t* buf = k.buf;
+      size_t bufCap = k.bufCap;
+      k = Conn();
+      k.buf = buf;
+      k.bufCap = bufCap;
+      k.client = c;
+      k.state = State::Reading;
+      k.since = nowMs;
+      return true;
+    }
+    static const char BUSY[] = "HTTP/1.1 503 Service Unavailable\r\nConnection: close\r\nContent-Length: 0\r\n\r\n";
+    c.write((const uint8_t*)BUSY, sizeof(BUSY) - 1);
+    c.stop();
+    stats_.refused++;
+    return false;
+  }
+
+  // one service pass over every connection
+  void poll(uint32_t nowMs) {
+    now_ = nowMs;
+    for (Conn& k : conns_) {
+      if (k.state == State::Free) continue;
+      if (!k.client.connected()) {
+        close(k);
+        continue;
+      }
+      if (k.state == State::Reading) readRequest(k, nowMs);
+      else if (k.len) pump(k);
+      else if (k.state == State::Streaming) sendNextPicture(k);
+    }
+  }
+
+  int viewers() const {
+    int n = 0;
+    for (const Conn& k : conns_) n += k.state == State::Streaming;
+    return n;
+  }
+
+  const Stats& stats() const { return stats_; }
+
+ private:
+  // Closing: the part in flight (a /latest picture) goes out, then the connection is closed
+  enum class State : uint8_t { Free, Reading, Streaming, Closing };
+
+  struct Conn {
+    Client client;
+    State state = State::Free;
+    char req[256];
+    size_t reqLen = 0;
+    uint32_t since = 0;
+    uint8_t node = 0;
+    bool sentAny = false;
+    uint32_t lastStoredMs = 0;
+    uint16_t lastSeq = 0;
+    // the part in flight, in buf: headers, jpeg and tail, sent up to `len`
+    size_t len = 0;
+    size_t off = 0;
+    uint8_t* buf = nullptr;
+    size_t bufCap = 0;
+  };
+
+  void close(Conn& k) {
+    k.len = 0;
+    k.client.stop();
+    k.state = State::Free;
+  }
+
+  // small responses (headers, status page, errors) on a fresh connection, whose socket takes them
+  // at once; pictures go out a pass at a time through pump()
+  bool writeAll(Conn& k, const void* data, size_t len) {
+    size_t n = k.client.write((const uint8_t*)data, len);
+    stats_.bytesSent += n;
+    return n == len;
+  }
+
+  bool writeStr(Conn& k, const char* s) { return writeAll(k, s, strlen(s)); }
+
+  void readRequest(Conn& k, uint32_t nowMs) {
+    while (k.client.available() > 0 && k.reqLen < sizeof(k.req) - 1) {
+      int n = k.client.read((uint8_t*)k.req + k.reqLen, sizeof(k.req) - 1 - k.reqLen);
+      if (n <= 0) break;
+      k.reqLen += size_t(n);
+    }
+    k.req[k.reqLen] = 0;
+    // only the request line matters; wait until it is complete
+    if (!strchr(k.req, '\n')) {
+      if (k.reqLen >= sizeof(k.req) - 1 || nowMs - k.since > REQUEST_TIMEOUT_MS) close(k);
+      return;
+    }
+    stats_.requests++;
+    route(k);
+  }
+
+  // the jpeg inside a cached JpegFrame wire frame
+  static const uint8_t* jpegOf(const cache::Picture& p, size_t* len) {
+    const size_t prefix = proto::FrameHeader::SIZE + proto::JpegFrameHeader::SIZE;
+    *len = p.len - prefix - proto::CRC_SIZE;
+    return p.frame + prefix;
+  }
+
+  static bool nodeArg(const char* path, const char* prefix, uint8_t* node) {
+    size_t n = strlen(prefix);
+    if (strncmp(path, prefix, n) != 0) return false;
+    char* end = nullptr;
+    long v = strtol(path + n, &end, 10);
+    if (end == path + n || v < 0 || v > 254) return false;
+    *node = uint8_t(v);
+    return true;
+  }
+
+  void route(Conn& k) {
+    char* path = nullptr;
+    if (strncmp(k.req, "GET ", 4) == 0) {
+      path = k.req + 4;
+      char* sp = strchr(path, ' ');
+      if (sp) *sp = 0;
+    }
+    uint8_t node;
+    if (path && strcmp(path, "/") == 0) {
+      sendStatus(k);
+    } else if (path && nodeArg(path, "/stream/", &node)) {
+      k.node = node;
+      k.state = State::Streaming;
+      if (!writeStr(k, "HTTP/1.1 200 OK\r\nContent-Type: multipart/x-mixed-replace; boundary=frame\r\n"
+                       "Cache-Control: no-cache\r\nConnection: close\r\n\r\n")) {
+        close(k);
+      }
+      return;
+    } else if (path && nodeArg(path, "/latest/", &node)) {
+      sendLatest(k, node);
+      return;
+    } else {
+      writeStr(k, "HTTP/1.1 404 Not Found\r\nConnection: close\r\nContent-Length: 0\r\n\r\n");
+    }
+    close(k);
+  }
+
+  void sendLatest(Conn& k, uint8_t node) {
+    cache::Lease lease;
+    if (!cache_.acquire(node, &lease)) {
+      writeStr(k, "HTTP/1.1 404 Not Found\r\nConnection: close\r\nContent-Length: 0\r\n\r\n");
+      close(k);
+      return;
+    }
+    k.state = State::Closing;
+    startPart(k, lease, "HTTP/1.1 200 OK\r\nContent-Type: image/jpeg\r\nContent-Length: %u\r\n"
+                        "Connection: close\r\n\r\n", "");
+  }
+
+  void sendNextPicture(Conn& k) {
+    cache::Lease lease;
+    if (!cache_.acquire(k.node, &lease)) return;
+    const cache::Picture& p = lease.pic;
+    if (k.sentAny && p.storedMs == k.lastStoredMs && p.seq == k.lastSeq) {
+      cache_.release(lease);
+      return;
+    }
+    k.sentAny = true;
+    k.lastStoredMs = p.storedMs;
+    k.lastSeq = p.seq;
+    startPart(k, lease, "--frame\r\nContent-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n", "\r\n");
+  }
+
+  // copies headers (`head`, given the jpeg length), the leased picture's jpeg and `tail` into the
+  // viewer's send buffer as the part in flight, releases the lease and starts sending
+  void startPart(Conn& k, cache::Lease& lease, const char* head, const char* tail) {
+    size_t len;
+    const uint8_t* jpeg = jpegOf(lease.pic, &len);
+    int headLen = snprintf((char*)k.buf, k.bufCap, head, (unsigned)len);
+    size_t tailLen = strlen(tail);
+    if (headLen < 0 || size_t(headLen) + len + tailLen > k.bufCap) {
+      cache_.release(lease);
+      stats_.tooLarge++;
+      if (k.state == State::Closing) close(k);
+      return;
+    }
+    memcpy(k.buf + headLen, jpeg, len);
+    cache_.release(lease);
+    memcpy(k.buf + headLen + len, tail, tailLen);
+    k.len = size_t(headLen) + len + tailLen;
+    k.off = 0;
+    k.since = now_;
+    pump(k);
+  }
+
+  // writes as much of the part in flight as the socket takes now
+  void pump(Conn& k) {
+    while (k.off < k.len) {
+      size_t left = k.len - k.off;
+      int room = k.client.availableForWrite();
+      size_t n = room > 0 ? k.client.write(k.buf + k.off, left < size_t(room) ? left : size_t(room)) : 0;
+      if (n == 0) {
+        if (now_ - k.since > SEND_TIMEOUT_MS) close(k);
+        return;  // socket full: the rest on a later pass
+      }
+      stats_.bytesSent += n;
+      k.since = now_;
+      k.off += n;
+    }
+    k.len = 0;
+    stats_.framesSent++;
+    if (k.state == State::Closing) close(k);
+  }
+
+  void sendStatus(Conn& k) {
+    // whatever does not fit whole is left out, so the page never ends mid-tag; the closing tags
+    // always have room. n never counts snprintf's terminator
+    static const char TAIL[] = "</body></html>";
+    const size_t room = sizeof(page_) - sizeof(TAIL);  // body bytes, plus one for a terminator
+    size_t n = 0;
+    bool full = false;
+    auto put = [&](const char* fmt, auto... args) {
+      if (full) return;
+      int w = snprintf(page_ + n, room - n, fmt, args...);
+      if (w < 0 || size_t(w) >= room - n) full = true;
+      else n += size_t(w);
+    };
+    put("%s", "<!doctype html><html><head><meta name=viewport content='width=device-width'>"
+              "<meta http-equiv=refresh content=5><title>relay</title></head><body><h3>relay status</h3>"
+              "<table border=1 cellpadding=4><tr><th>node</th><th>picture</th><th>bytes</th><th>age</th><th></th></tr>");
+    for (int i = 0; i < CacheSlots; ++i) {
+      cache::Picture p;
+      if (!cache_.info(i, &p)) continue;
+      put("<tr><td>%u</td><td>%ux%u</td><td>%u</td><td>%lu ms</td>"
+          "<td><a href='/stream/%u'>stream</a> <a href='/latest/%u'>still</a></td></tr>",
+          p.node, p.width, p.height, (unsigned)p.len, (unsigned long)(now_ - p.storedMs), p.node, p.node);
+    }
+    put("</table><p>viewers %d/%d, frames sent %lu, refused %lu</p>", viewers(), MaxViewers,
+        (unsigned long)stats_.framesSent, (unsigned long)stats_.refused);
+    if (extra_ && !full) {
+      size_t w = extra_(page_ + n, room - n);
+      if (w < room - n) n += w;
+    }
+    memcpy(page_ + n, TAIL, sizeof(TAIL) - 1);
+    n += sizeof(TAIL) - 1;
+
+    char hdr[128];
+    snprintf(hdr, sizeof(hdr), "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: %u\r\n"
+             "Connection: close\r\n\r\n", (unsigned)n);
+    if (writeStr(k, hdr)) writeAll(k, page_, n);
+  }
+
+  Cache& cache_;
+  StatusFn extra_;
+  Conn conns_[MaxViewers];
+  char page_[2048];
+  uint32_t now_ = 0;
+  Stats stats_;
+};
+
+}  // namespace http
@@ -0,0 +1,85 @@
+// bench_proto.cpp - native microbenchmark for swarm_proto.h
+//
+// build & run from the repo root:
+//   g++ -O2 -std=c++17 -Ilib/swarm_proto/src lib/swarm_proto/examples/bench_proto.cpp -o bench_proto
+//   ./bench_proto
+#include <swarm_proto.h>
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using namespace proto;
+using Clock = std::chrono::steady_clock;
+
+static double nsPer(Clock::time_point t0, Clock::time_point t1, size_t n) {
+  return std::chrono::duration<double, std::nano>(t1 - t0).count() / double(n);
+}
+
+// tells the compiler the bytes at p are read and written here: stores before it must happen and
+// loads after it must be redone, so a loop's header work cannot be hoisted out or thrown away
+static inline void clobber(void* p) { asm volatile("" : : "r"(p) : "memory"); }
+
+int main() {
+  const size_t ITER = 10000000;
+  uint8_t hdr[FrameHeader::SIZE + JpegFrameHeader::SIZE];
+  volatile uint32_t sink = 0;
+
+  auto t0 = Clock::now();
+  for (size_t i = 0; i < ITER; ++i) {
+    writeHeader(hdr, MsgType::JpegFrame, uint8_t(i), uint16_t(i), uint32_t(i & 0xFFFF));
+    writeJpegHeader(hdr + FrameHeader::SIZE, uint32_t(i), 640, 480);
+    clobber(hdr);
+  }
+  auto t1 = Clock::now();
+  for (size_t i = 0; i < ITER; ++i) {
+    clobber(hdr);
+    HeaderView h(hdr);
+    sink = sink + h.get<FrameHeader::Length>() + h.get<FrameHeader::Seq>() + h.get<FrameHeader::Node>();
+  }
+  auto t2 = Clock::now();
+  printf("encode header:  %6.2f ns\n", nsPer(t0, t1, ITER));
+  printf("decode header:  %6.2f ns\n", nsPer(t1, t2, ITER));
+
+  // a relay stream of mixed telemetry and ~20 KB jpeg frames, walked with parseFrame
+  std::vector<uint8_t> stream;
+  for (size_t f = 0; f < 2000; ++f) {
+    bool jpeg = f % 4 != 0;
+    uint32_t len = jpeg ? uint32_t(JpegFrameHeader::SIZE + 18000 + (f * 97) % 4000) : 12;
+    size_t off = stream.size();
+    stream.resize(off + frameSize(len));
+    uint8_t* fr = &stream[off];
+    writeHeader(fr, jpeg ? MsgType::JpegFrame : MsgType::Telemetry, uint8_t(f % 6), uint16_t(f), len);
+    if (jpeg) writeJpegHeader(fr + FrameHeader::SIZE, uint32_t(f), 640, 480);
+    for (uint32_t b = jpeg ? JpegFrameHeader::SIZE : 0; b < len; ++b) fr[FrameHeader::SIZE + b] = uint8_t(b * 131 + f);
+    writeTrailer(fr + FrameHeader::SIZE + len, frameCrc(fr, fr + FrameHeader::SIZE, len));
+  }
+
+  const int PASSES = 20;
+  size_t frames = 0;
+  auto t3 = Clock::now();
+  for (int p = 0; p < PASSES; ++p) {
+    size_t pos = 0;
+    FrameRef ref;
+    while (parseFrame(stream.data() + pos, stream.size() - pos, &ref) == ParseStatus::Ok) {
+      sink = sink + ref.node();
+      pos += ref.size();
+      ++frames;
+    }
+  }
+  auto t4 = Clock::now();
+  double secs = std::chrono::duration<double>(t4 - t3).count();
+  printf("parse stream:   %6.2f ns/frame, %.0f MB/s of relay traffic (crc checked)\n", nsPer(t3, t4, frames),
+         double(stream.size()) * PASSES / secs / 1e6);
+  if (frames != 2000 * size_t(PASSES)) { printf("stream did not parse\n"); return 1; }
+
+  auto t5 = Clock::now();
+  uint32_t crc = 0;
+  for (int p = 0; p < PASSES; ++p) crc = crc32Update(crc, stream.data(), stream.size());
+  auto t6 = Clock::now();
+  double crcSecs = std::chrono::duration<double>(t6 - t5).count();
+  double mb = double(stream.size()) * PASSES / (1024.0 * 1024.0);
+  printf("crc32:          %6.0f us/MB, %.0f MB/s\n", crcSecs * 1e6 / mb, mb / crcSecs);
+  sink = sink + crc;
+  return sink == 42 ? 1 : 0;
+}
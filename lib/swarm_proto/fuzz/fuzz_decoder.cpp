@@ -0,0 +1,176 @@
+// fuzz_decoder.cpp - fuzz target for the swarm_proto.h / telemetry_codec.h / jpeg_slices.h decoders
+// (and the fleet_summary.h rows the base decodes)
+//
+// libFuzzer (clang):
+//   clang++ -g -O1 -std=c++17 -fsanitize=fuzzer,address,undefined
+//       -Ilib/swarm_proto/src -Ilib/telemetry/src -Ilib/jpeg_slices/src lib/swarm_proto/fuzz/fuzz_decoder.cpp -o fuzz_decoder
+//   ./fuzz_decoder corpus/
+//
+// without libFuzzer (gcc): add -DFUZZ_STANDALONE to get a driver that replays files given on the
+// command line, or runs random mutations of a valid stream when called without arguments:
+//   g++ -g -O1 -std=c++17 -fsanitize=address,undefined -DFUZZ_STANDALONE
+//       -Ilib/swarm_proto/src -Ilib/telemetry/src -Ilib/jpeg_slices/src lib/swarm_proto/fuzz/fuzz_decoder.cpp -o fuzz_decoder
+#include <fleet_summary.h>
+#include <jpeg_slices.h>
+#include <swarm_proto.h>
+#include <telemetry_codec.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  static const telemetry::FieldMode modes[5] = {
+    telemetry::FieldMode::DeltaOfDelta, telemetry::FieldMode::Delta, telemetry::FieldMode::Delta,
+    telemetry::FieldMode::Delta, telemetry::FieldMode::Raw,
+  };
+  telemetry::Decoder<5> telem(modes);
+  telemetry::Decoder<telemetry::FF_COUNT> fleet(telemetry::FLEET_MODES);
+
+  size_t pos = 0;
+  proto::FrameRef ref;
+  while (pos < size) {
+    proto::ParseStatus s = proto::parseFrame(data + pos, size - pos, &ref);
+    if (s == proto::ParseStatus::NeedMore) break;
+    if (s != proto::ParseStatus::Ok) {  // resync on the next magic, as the primary and base do
+      pos = proto::findMagic(data, size, pos + 1);
+      continue;
+    }
+    if (ref.payload < data || ref.payload + ref.length > data + size) abort();
+
+    if (ref.type() == proto::MsgType::JpegFrame) {
+      proto::JpegView j(ref.payload);
+      volatile uint32_t w = uint32_t(j.get<proto::JpegFrameHeader::Width>()) * j.get<proto::JpegFrameHeader::Height>();
+      (void)w;
+    } else if (ref.type() == proto::MsgType::JpegSlice) {
+      const uint8_t* d = ref.payload + proto::JpegSliceHeader::SIZE;
+      size_t n = ref.length - proto::JpegSliceHeader::SIZE;
+      jpeg::ScanInfo scan;
+      if (jpeg::parseHeaders(d, n, &scan)) {
+        if (scan.headerLen > n || scan.scanEnd > n) abort();
+        jpeg::IntervalIterator it(d, scan);
+        size_t start, end;
+        while (it.next(&start, &end)) {
+          if (start > end || end > n) abort();
+        }
+      }
+    } else if (ref.type() == proto::MsgType::Mosaic) {
+      size_t off = proto::mosaicJpegOffset(ref);
+      if (off > ref.length) abort();
+      if (off) {
+        for (size_t t = proto::MosaicHeader::SIZE; t < off; t += proto::MosaicTile::SIZE) {
+          volatile uint32_t age = proto::MosaicTileView(ref.payload + t).get<proto::MosaicTile::AgeMs>();
+          (void)age;
+        }
+      }
+    } else if (ref.type() == proto::MsgType::FleetSummary) {
+      size_t off = proto::FleetHeader::SIZE;
+      uint8_t count = proto::FleetView(ref.payload).get<proto::FleetHeader::NodeCount>();
+      for (uint8_t r = 0; r < count && off + proto::FleetRow::SIZE <= ref.length; ++r) {
+        off += proto::FleetRow::SIZE;
+        int32_t row[telemetry::FF_COUNT];
+        size_t used = 0;
+        if (fleet.decode(ref.payload + off, ref.length - off, row, &used) == telemetry::DecodeStatus::Truncated) break;
+        if (used == 0 || off + used > ref.length) abort();
+        off += used;
+      }
+    } else if (ref.type() == proto::MsgType::Telemetry) {
+      int32_t sample[5];
+      size_t off = 0, used = 0;
+      while (off < ref.length &&
+             telem.decode(ref.payload + off, ref.length - off, sample, &used) != telemetry::DecodeStatus::Truncated) {
+        if (used == 0) abort();
+        off += used;
+      }
+    }
+    pos += ref.size();
+  }
+  return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+int main(int argc, char** argv) {
+  if (argc > 1) {
+    for (int i = 1; i < argc; ++i) {
+      FILE* f = fopen(argv[i], "rb");
+      if (!f) { perror(argv[i]); continue; }
+      std::vector<uint8_t> buf;
+      int c;
+      while ((c = fgetc(f)) != EOF) buf.push_back(uint8_t(c));
+      fclose(f);
+      LLVMFuzzerTestOneInput(buf.data(), buf.size());
+    }
+    return 0;
+  }
+
+  // seed: a valid telemetry frame, a jpeg frame, a jpeg slice, a mosaic and a full fleet summary,
+  // then random byte flips / truncations
+  static const uint8_t sliceJpeg[] = {
+    0xFF, 0xD8, 0xFF, 0xDD, 0x00, 0x04, 0x00, 0x01,                                      // SOI, DRI 1
+    0xFF, 0xC0, 0x00, 0x0B, 0x08, 0x00, 0x10, 0x00, 0x08, 0x01, 0x01, 0x11, 0x00,        // SOF0 8x16 gray
+    0xFF, 0xDA, 0x00, 0x08, 0x01, 0x01, 0x00, 0x00, 0x3F, 0x00,                          // SOS
+    0x12, 0xFF, 0x00, 0x34, 0xFF, 0xD0, 0x56, 0x78, 0xFF, 0xD9,                          // 2 intervals, EOI
+  };
+  const uint32_t slen = uint32_t(proto::JpegSliceHeader::SIZE + sizeof(sliceJpeg));
+  const uint32_t mlen = uint32_t(proto::MosaicHeader::SIZE + 2 * proto::MosaicTile::SIZE + 16);
+  telemetry::FleetSummary<4> summary;
+  uint8_t fleetPayload[telemetry::FleetSummary<4>::maxPayload()];
+  for (uint8_t n = 1; n <= 3; ++n) {
+    const int32_t status[telemetry::FF_COUNT] = {-60 - n, 3900, 100, 0, n, 0};
+    summary.heard(n, 0);
+    summary.update(n, status, 0);
+  }
+  uint8_t fleetFlags = 0;
+  const uint32_t flen = uint32_t(summary.poll(0, fleetPayload, sizeof(fleetPayload), &fleetFlags));
+  std::vector<uint8_t> seed(proto::frameSize(6) + proto::jpegFrameSize(32) + proto::frameSize(slen) +
+                            proto::frameSize(mlen) + proto::frameSize(flen));
+  uint8_t* tf = seed.data();
+  proto::writeHeader(tf, proto::MsgType::Telemetry, 3, 1, 6);
+  tf[proto::FrameHeader::SIZE] = 0x80;
+  proto::writeTrailer(tf + proto::FrameHeader::SIZE + 6, proto::frameCrc(tf, tf + proto::FrameHeader::SIZE, 6));
+  uint8_t* jf = seed.data() + proto::frameSize(6);
+  uint32_t jlen = proto::JpegFrameHeader::SIZE + 32;
+  proto::writeHeader(jf, proto::MsgType::JpegFrame, 3, 2, jlen);
+  proto::writeTrailer(jf + proto::FrameHeader::SIZE + jlen, proto::frameCrc(jf, jf + proto::FrameHeader::SIZE, jlen));
+  uint8_t* sf = jf + proto::frameSize(jlen);
+  proto::writeHeader(sf, proto::MsgType::JpegSlice, 3, 3, slen, proto::FLAG_SLICE_HEADERS);
+  proto::writeJpegSliceHeader(sf + proto::FrameHeader::SIZE, 0, 1, 16, 8, 0, 0, 2);
+  memcpy(sf + proto::FrameHeader::SIZE + proto::JpegSliceHeader::SIZE, sliceJpeg, sizeof(sliceJpeg));
+  proto::writeTrailer(sf + proto::FrameHeader::SIZE + slen, proto::frameCrc(sf, sf + proto::FrameHeader::SIZE, slen));
+  uint8_t* mf = sf + proto::frameSize(slen);
+  proto::writeHeader(mf, proto::MsgType::Mosaic, 0, 4, mlen);
+  proto::writeMosaicHeader(mf + proto::FrameHeader::SIZE, 0, 32, 16, 2, 1, 2);
+  proto::writeMosaicTile(mf + proto::FrameHeader::SIZE + proto::MosaicHeader::SIZE, 1, proto::TileState::Fresh, 7, 40);
+  proto::writeMosaicTile(mf + proto::FrameHeader::SIZE + proto::MosaicHeader::SIZE + proto::MosaicTile::SIZE, 2,
+                         proto::TileState::Stale, 9, 5000);
+  proto::writeTrailer(mf + proto::FrameHeader::SIZE + mlen, proto::frameCrc(mf, mf + proto::FrameHeader::SIZE, mlen));
+  uint8_t* ff = mf + proto::frameSize(mlen);
+  proto::writeHeader(ff, proto::MsgType::FleetSummary, 0, 5, flen, fleetFlags);
+  memcpy(ff + proto::FrameHeader::SIZE, fleetPayload, flen);
+  proto::writeTrailer(ff + proto::FrameHeader::SIZE + flen, proto::frameCrc(ff, ff + proto::FrameHeader::SIZE, flen));
+  {
+    size_t valid = 0, pos = 0;
+    proto::FrameRef ref;
+    while (proto::parseFrame(seed.data() + pos, seed.size() - pos, &ref) == proto::ParseStatus::Ok) {
+      pos += ref.size();
+      ++valid;
+    }
+    if (valid != 5) { printf("seed does not parse\n"); return 1; }
+  }
+  srand(1);
+  const int RUNS = 2000000;
+  for (int run = 0; run < RUNS; ++run) {
+    std::vector<uint8_t> buf = seed;
+    int flips = 1 + rand() % 8;
+    for (int k = 0; k < flips; ++k) buf[rand() % buf.size()] = uint8_t(rand());
+    buf.resize(rand() % (buf.size() + 1));
+    LLVMFuzzerTestOneInput(buf.data(), buf.size());
+  }
+  printf("%d inputs ok\n", RUNS);
+  return 0;
+}
+#endif
@@ -0,0 +1,69 @@
+// crc32.h - CRC-32 (IEEE 802.3, reflected, same result as zlib.crc32) for frame trailers
+//
+// on ESP32 this calls the ROM routine esp_rom_crc32_le(); natively it uses slicing-by-8 over
+// tables built at compile time. both are incremental: start from 0 and feed the previous result.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(ESP_PLATFORM)
+#include "esp_rom_crc.h"
+#endif
+
+namespace proto {
+
+#if defined(ESP_PLATFORM)
+
+inline uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t len) {
+  return esp_rom_crc32_le(crc, data, len);
+}
+
+#else
+
+namespace detail {
+
+struct Crc32Tables {
+  uint32_t t[8][256];
+};
+
+constexpr Crc32Tables makeCrc32Tables() {
+  Crc32Tables tables{};
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t c = i;
+    for (int k = 0; k < 8; ++k) c = (c >> 1) ^ (0xEDB88320u & (0u - (c & 1)));
+    tables.t[0][i] = c;
+  }
+  for (uint32_t i = 0; i < 256; ++i) {
+    for (int s = 1; s < 8; ++s) {
+      uint32_t prev = tables.t[s - 1][i];
+      tables.t[s][i] = (prev >> 8) ^ tables.t[0][prev & 0xFF];
+    }
+  }
+  return tables;
+}
+
+inline constexpr Crc32Tables CRC32_TABLES = makeCrc32Tables();
+
+}  // namespace detail
+
+inline uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t len) {
+  const auto& t = detail::CRC32_TABLES.t;
+  crc = ~crc;
+  while (len >= 8) {
+    uint32_t lo = (uint32_t(data[0]) | uint32_t(data[1]) << 8 | uint32_t(data[2]) << 16 | uint32_t(data[3]) << 24) ^ crc;
+    uint32_t hi = uint32_t(data[4]) | uint32_t(data[5]) << 8 | uint32_t(data[6]) << 16 | uint32_t(data[7]) << 24;
+    crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+          t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    data += 8;
+    len -= 8;
+  }
+  while (len--) crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF];
+  return ~crc;
+}
+
+#endif
+
+inline uint32_t crc32(const uint8_t* data, size_t len) { return crc32Update(0, data, len); }
+
+}  // namespace proto
@@ -0,0 +1,411 @@
+// swarm_proto.h - wire protocol shared by the primary, both secondaries and (mirrored) the base
+//
+// header-only C++17, no allocation, builds for ESP32 (arduino) and natively.
+//
+// every message on a secondary -> primary or primary -> base TCP stream is one frame:
+//
+//   FrameHeader (14 bytes, big-endian)
+//     0  u32  magic        FRAME_MAGIC, where a receiver resynchronises after corruption
+//     4  u8   version      PROTO_VERSION
+//     5  u8   type         MsgType
+//     6  u8   node         id of the secondary that produced the payload
+//     7  u8   flags        per-type bits, 0 if unused
+//     8  u16  seq          per-node message counter (wraps)
+//    10  u32  length       payload bytes that follow the header
+//   payload (length bytes, layout depends on type)
+//   u32 crc                CRC-32 (crc32.h) of header + payload, big-endian
+//
+// a receiver that sees a bad header or crc drops that one frame and scans forward for the next
+// FRAME_MAGIC instead of trusting a possibly garbage length field.
+//
+// layouts are described at compile time as lists of Field<offset, type>, so sizes and offsets are
+// constexpr and checked by static_assert. views read and write fields in place over a byte buffer
+// (no copies of received data), and the big-endian load/store helpers are straight-line shifts
+// with no data dependent branches.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+
+#include "crc32.h"
+
+namespace proto {
+
+constexpr uint8_t PROTO_VERSION = 2;
+constexpr uint32_t FRAME_MAGIC = 0x53575246;  // "SWRF"
+
+enum class MsgType : uint8_t {
+  Telemetry = 1,  // payload: one telemetry_codec.h sample
+  JpegFrame = 2,  // payload: JpegFrameHeader + jpeg bytes
+  JpegSlice = 3,  // payload: JpegSliceHeader + jpeg headers or whole restart intervals
+  Mosaic = 4,     // payload: MosaicHeader + TileCount x MosaicTile + jpeg bytes (from the primary)
+  Command = 5,    // payload: CommandHeader (base -> primary, on the uplink socket)
+  FleetSummary = 6,  // payload: FleetHeader + NodeCount x (FleetRow + fleet sample) (from the primary)
+};
+
+// JpegSlice frame flag: the data is the jpeg headers (SOI .. SOS) rather than intervals
+constexpr uint8_t FLAG_SLICE_HEADERS = 0x01;
+// JpegFrame flag: replayed from the primary's latest-frame cache rather than relayed live
+constexpr uint8_t FLAG_CACHED = 0x02;
+
+// FleetSummary flag: every tracked node is included and every row is a keyframe
+constexpr uint8_t FLAG_FLEET_FULL = 0x04;
+
+// node id addressing every node in a Command
+constexpr uint8_t ALL_NODES = 0xFF;
+
+// ---- big-endian load / store ---------------------------------------------------------------
+
+template <typename T, size_t... I>
+constexpr T loadBE(const uint8_t* p, std::index_sequence<I...>) {
+  return T(((T(p[I]) << (8 * (sizeof(T) - 1 - I))) | ...));
+}
+
+template <typename T>
+constexpr T loadBE(const uint8_t* p) {
+  return loadBE<T>(p, std::make_index_sequence<sizeof(T)>{});
+}
+
+template <typename T, size_t... I>
+constexpr void storeBE(uint8_t* p, T v, std::index_sequence<I...>) {
+  ((p[I] = uint8_t(v >> (8 * (sizeof(T) - 1 - I)))), ...);
+}
+
+template <typename T>
+constexpr void storeBE(uint8_t* p, T v) {
+  storeBE<T>(p, v, std::make_index_sequence<sizeof(T)>{});
+}
+
+// ---- compile-time layouts --------------------------------------------------------------------
+
+template <size_t Offset, typename T>
+struct Field {
+  using type = T;
+  static constexpr size_t offset = Offset;
+  static constexpr size_t size = sizeof(T);
+  static constexpr size_t end = Offset + sizeof(T);
+};
+
+// a layout is a list of fields; its size is the end of the furthest field
+template <typename... Fields>
+struct Layout {
+  static constexpr size_t size() {
+    size_t end = 0;
+    ((end = Fields::end > end ? Fields::end : end), ...);
+    return end;
+  }
+};
+
+// read-only view over a received buffer; the caller guarantees at least L::SIZE bytes
+template <typename L>
+class View {
+ public:
+  constexpr explicit View(const uint8_t* p) : p_(p) {}
+  template <typename F>
+  constexpr typename F::type get() const { return loadBE<typename F::type>(p_ + F::offset); }
+  constexpr const uint8_t* data() const { return p_; }
+  constexpr const uint8_t* body() const { return p_ + L::SIZE; }
+
+ private:
+  const uint8_t* p_;
+};
+
+template <typename L>
+class MutableView {
+ public:
+  constexpr explicit MutableView(uint8_t* p) : p_(p) {}
+  template <typename F>
+  constexpr typename F::type get() const { return loadBE<typename F::type>(p_ + F::offset); }
+  template <typename F>
+  constexpr void set(typename F::type v) { storeBE<typename F::type>(p_ + F::offset, v); }
+  constexpr uint8_t* data() { return p_; }
+
+ private:
+  uint8_t* p_;
+};
+
+// ---- message layouts -------------------------------------------------------------------------
+
+struct FrameHeader {
+  using Magic = Field<0, uint32_t>;
+  using Version = Field<4, uint8_t>;
+  using Type = Field<5, uint8_t>;
+  using Node = Field<6, uint8_t>;
+  using Flags = Field<7, uint8_t>;
+  using Seq = Field<8, uint16_t>;
+  using Length = Field<10, uint32_t>;
+  static constexpr size_t SIZE = Layout<Magic, Version, Type, Node, Flags, Seq, Length>::size();
+};
+static_assert(FrameHeader::SIZE == 14, "FrameHeader layout changed");
+
+constexpr size_t CRC_SIZE = 4;
+
+// prefix of a JpegFrame payload, followed by the jpeg bytes
+struct JpegFrameHeader {
+  using CaptureMs = Field<0, uint32_t>;  // sender millis() at capture
+  using Width = Field<4, uint16_t>;
+  using Height = Field<6, uint16_t>;
+  static constexpr size_t SIZE = Layout<CaptureMs, Width, Height>::size();
+};
+static_assert(JpegFrameHeader::SIZE == 8, "JpegFrameHeader layout changed");
+
+// prefix of a JpegSlice payload. the data that follows is either the jpeg headers
+// (FLAG_SLICE_HEADERS) or `IntervalCount` consecutive restart intervals starting at
+// `FirstInterval`, with the RSTn markers between them but not the one after the last.
+struct JpegSliceHeader {
+  using CaptureMs = Field<0, uint32_t>;
+  using FrameId = Field<4, uint16_t>;  // same for every slice of one picture
+  using Width = Field<6, uint16_t>;
+  using Height = Field<8, uint16_t>;
+  using FirstInterval = Field<10, uint16_t>;
+  using IntervalCount = Field<12, uint16_t>;
+  using TotalIntervals = Field<14, uint16_t>;
+  static constexpr size_t SIZE = Layout<CaptureMs, FrameId, Width, Height, FirstInterval, IntervalCount,
+                                        TotalIntervals>::size();
+};
+static_assert(JpegSliceHeader::SIZE == 16, "JpegSliceHeader layout changed");
+
+// prefix of a Mosaic payload: one composite jpeg of Cols x Rows thumbnails, tile i at column
+// i % Cols, row i / Cols. a MosaicTile entry per tile follows, then the jpeg bytes.
+struct MosaicHeader {
+  using CaptureMs = Field<0, uint32_t>;  // primary millis() when the composite was encoded
+  using Width = Field<4, uint16_t>;
+  using Height = Field<6, uint16_t>;
+  using Cols = Field<8, uint8_t>;
+  using Rows = Field<9, uint8_t>;
+  using TileCount = Field<10, uint8_t>;
+  using Reserved = Field<11, uint8_t>;
+  static constexpr size_t SIZE = Layout<CaptureMs, Width, Height, Cols, Rows, TileCount, Reserved>::size();
+};
+static_assert(MosaicHeader::SIZE == 12, "MosaicHeader layout changed");
+
+// per-tile freshness: which node the thumbnail came from and how old it was when encoded
+enum class TileState : uint8_t {
+  Empty = 0,  // no picture yet
+  Fresh = 1,
+  Stale = 2,  // older than the primary's stale limit; the tile is drawn dimmed
+};
+
+struct MosaicTile {
+  using Node = Field<0, uint8_t>;
+  using State = Field<1, uint8_t>;
+  using Seq = Field<2, uint16_t>;    // frame seq of the source picture
+  using AgeMs = Field<4, uint32_t>;  // time since the tile was last updated
+  static constexpr size_t SIZE = Layout<Node, State, Seq, AgeMs>::size();
+};
+static_assert(MosaicTile::SIZE == 8, "MosaicTile layout changed");
+
+enum class CommandOp : uint8_t {
+  GetLatest = 1,  // send the cached latest picture of Node (or of every node) right away
+};
+
+struct CommandHeader {
+  using Op = Field<0, uint8_t>;
+  using Node = Field<1, uint8_t>;
+  static constexpr size_t SIZE = Layout<Op, Node>::size();
+};
+static_assert(CommandHeader::SIZE == 2, "CommandHeader layout changed");
+
+// prefix of a FleetSummary payload. NodeCount rows follow, each a FleetRow and then one
+// telemetry_codec.h sample in the fleet_summary.h layout (self-delimiting, decoded per node).
+struct FleetHeader {
+  using CaptureMs = Field<0, uint32_t>;  // primary millis() when the summary was built
+  using NodeCount = Field<4, uint8_t>;
+  using Reserved = Field<5, uint8_t>;
+  static constexpr size_t SIZE = Layout<CaptureMs, NodeCount, Reserved>::size();
+};
+static_assert(FleetHeader::SIZE == 6, "FleetHeader layout changed");
+
+// FleetRow alert bits, readable without the sample so the base sees them even when out of sync
+constexpr uint8_t ALERT_LOST = 0x01;         // nothing heard from the node for a while
+constexpr uint8_t ALERT_LOW_BATTERY = 0x02;
+constexpr uint8_t ALERT_WEAK_LINK = 0x04;    // rssi at the node below the limit
+constexpr uint8_t ALERT_BACKLOG = 0x08;      // bytes queued at the primary from the node
+
+struct FleetRow {
+  using Node = Field<0, uint8_t>;
+  using Alerts = Field<1, uint8_t>;
+  static constexpr size_t SIZE = Layout<Node, Alerts>::size();
+};
+static_assert(FleetRow::SIZE == 2, "FleetRow layout changed");
+
+using HeaderView = View<FrameHeader>;
+using JpegView = View<JpegFrameHeader>;
+using JpegSliceView = View<JpegSliceHeader>;
+using MosaicView = View<MosaicHeader>;
+using MosaicTileView = View<MosaicTile>;
+using CommandView = View<CommandHeader>;
+using FleetView = View<FleetHeader>;
+using FleetRowView = View<FleetRow>;
+
+// largest payload a receiver accepts; anything bigger means the stream is out of sync
+constexpr uint32_t MAX_PAYLOAD = 128 * 1024;
+
+constexpr size_t frameSize(size_t payloadLen) { return FrameHeader::SIZE + payloadLen + CRC_SIZE; }
+constexpr size_t jpegFrameSize(size_t jpegLen) { return frameSize(JpegFrameHeader::SIZE + jpegLen); }
+
+// ---- encode ----------------------------------------------------------------------------------
+
+constexpr void writeHeader(uint8_t* out, MsgType type, uint8_t node, uint16_t seq, uint32_t length,
+                           uint8_t flags = 0) {
+  MutableView<FrameHeader> h(out);
+  h.set<FrameHeader::Magic>(FRAME_MAGIC);
+  h.set<FrameHeader::Version>(PROTO_VERSION);
+  h.set<FrameHeader::Type>(uint8_t(type));
+  h.set<FrameHeader::Node>(node);
+  h.set<FrameHeader::Flags>(flags);
+  h.set<FrameHeader::Seq>(seq);
+  h.set<FrameHeader::Length>(length);
+}
+
+constexpr void writeJpegHeader(uint8_t* out, uint32_t captureMs, uint16_t width, uint16_t height) {
+  MutableView<JpegFrameHeader> h(out);
+  h.set<JpegFrameHeader::CaptureMs>(captureMs);
+  h.set<JpegFrameHeader::Width>(width);
+  h.set<JpegFrameHeader::Height>(height);
+}
+
+constexpr void writeMosaicHeader(uint8_t* out, uint32_t captureMs, uint16_t width, uint16_t height, uint8_t cols,
+                                 uint8_t rows, uint8_t tileCount) {
+  MutableView<MosaicHeader> h(out);
+  h.set<MosaicHeader::CaptureMs>(captureMs);
+  h.set<MosaicHeader::Width>(width);
+  h.set<MosaicHeader::Height>(height);
+  h.set<MosaicHeader::Cols>(cols);
+  h.set<MosaicHeader::Rows>(rows);
+  h.set<MosaicHeader::TileCount>(tileCount);
+  h.set<MosaicHeader::Reserved>(0);
+}
+
+constexpr void writeMosaicTile(uint8_t* out, uint8_t node, TileState state, uint16_t seq, uint32_t ageMs) {
+  MutableView<MosaicTile> t(out);
+  t.set<MosaicTile::Node>(node);
+  t.set<MosaicTile::State>(uint8_t(state));
+  t.set<MosaicTile::Seq>(seq);
+  t.set<MosaicTile::AgeMs>(ageMs);
+}
+
+constexpr void writeCommand(uint8_t* out, CommandOp op, uint8_t node) {
+  MutableView<CommandHeader> c(out);
+  c.set<CommandHeader::Op>(uint8_t(op));
+  c.set<CommandHeader::Node>(node);
+}
+
+constexpr void writeFleetHeader(uint8_t* out, uint32_t captureMs, uint8_t nodeCount) {
+  MutableView<FleetHeader> h(out);
+  h.set<FleetHeader::CaptureMs>(captureMs);
+  h.set<FleetHeader::NodeCount>(nodeCount);
+  h.set<FleetHeader::Reserved>(0);
+}
+
+constexpr void writeFleetRow(uint8_t* out, uint8_t node, uint8_t alerts) {
+  MutableView<FleetRow> r(out);
+  r.set<FleetRow::Node>(node);
+  r.set<FleetRow::Alerts>(alerts);
+}
+
+constexpr void writeJpegSliceHeader(uint8_t* out, uint32_t captureMs, uint16_t frameId, uint16_t width,
+                                    uint16_t height, uint16_t firstInterval, uint16_t intervalCount,
+                                    uint16_t totalIntervals) {
+  MutableView<JpegSliceHeader> h(out);
+  h.set<JpegSliceHeader::CaptureMs>(captureMs);
+  h.set<JpegSliceHeader::FrameId>(frameId);
+  h.set<JpegSliceHeader::Width>(width);
+  h.set<JpegSliceHeader::Height>(height);
+  h.set<JpegSliceHeader::FirstInterval>(firstInterval);
+  h.set<JpegSliceHeader::IntervalCount>(intervalCount);
+  h.set<JpegSliceHeader::TotalIntervals>(totalIntervals);
+}
+
+// crc over a header and a payload that may live in separate buffers
+inline uint32_t frameCrc(const uint8_t* hdr, const uint8_t* payload, size_t len) {
+  return crc32Update(crc32(hdr, FrameHeader::SIZE), payload, len);
+}
+
+inline void writeTrailer(uint8_t* out, uint32_t crc) { storeBE<uint32_t>(out, crc); }
+
+// ---- decode ----------------------------------------------------------------------------------
+
+enum class ParseStatus : uint8_t {
+  Ok,           // header valid, `length` payload bytes + crc follow
+  NeedMore,     // fewer than FrameHeader::SIZE bytes available
+  BadMagic,
+  BadVersion,
+  BadType,
+  TooLarge,     // length above MAX_PAYLOAD (stream desync)
+  BadPayload,   // payload too short for its type's fixed prefix
+  BadCrc,
+};
+
+constexpr bool knownType(uint8_t t) {
+  return t == uint8_t(MsgType::Telemetry) || t == uint8_t(MsgType::JpegFrame) || t == uint8_t(MsgType::JpegSlice) ||
+         t == uint8_t(MsgType::Mosaic) || t == uint8_t(MsgType::Command) || t == uint8_t(MsgType::FleetSummary);
+}
+
+constexpr size_t minPayload(uint8_t t) {
+  return t == uint8_t(MsgType::JpegFrame) ? JpegFrameHeader::SIZE
+         : t == uint8_t(MsgType::JpegSlice) ? JpegSliceHeader::SIZE
+         : t == uint8_t(MsgType::Mosaic)    ? MosaicHeader::SIZE
+         : t == uint8_t(MsgType::Command)   ? CommandHeader::SIZE
+         : t == uint8_t(MsgType::FleetSummary) ? FleetHeader::SIZE
+                                            : 0;
+}
+
+// validates the header at the front of `buf` without copying it
+constexpr ParseStatus parseHeader(const uint8_t* buf, size_t len) {
+  if (len < FrameHeader::SIZE) return ParseStatus::NeedMore;
+  HeaderView h(buf);
+  if (h.get<FrameHeader::Magic>() != FRAME_MAGIC) return ParseStatus::BadMagic;
+  if (h.get<FrameHeader::Version>() != PROTO_VERSION) return ParseStatus::BadVersion;
+  uint8_t type = h.get<FrameHeader::Type>();
+  if (!knownType(type)) return ParseStatus::BadType;
+  uint32_t length = h.get<FrameHeader::Length>();
+  if (length > MAX_PAYLOAD) return ParseStatus::TooLarge;
+  if (length < minPayload(type)) return ParseStatus::BadPayload;
+  return ParseStatus::Ok;
+}
+
+// a complete frame at the front of a buffer: header view plus payload span
+struct FrameRef {
+  HeaderView header{nullptr};
+  const uint8_t* payload = nullptr;
+  uint32_t length = 0;
+
+  MsgType type() const { return MsgType(header.get<FrameHeader::Type>()); }
+  uint8_t node() const { return header.get<FrameHeader::Node>(); }
+  uint16_t seq() const { return header.get<FrameHeader::Seq>(); }
+  uint8_t flags() const { return header.get<FrameHeader::Flags>(); }
+  size_t size() const { return frameSize(length); }
+};
+
+// parses and crc-checks one whole frame from the front of `buf`; `out` points into `buf`
+inline ParseStatus parseFrame(const uint8_t* buf, size_t len, FrameRef* out) {
+  ParseStatus s = parseHeader(buf, len);
+  if (s != ParseStatus::Ok) return s;
+  uint32_t length = HeaderView(buf).get<FrameHeader::Length>();
+  if (len < frameSize(length)) return ParseStatus::NeedMore;
+  const uint8_t* payload = buf + FrameHeader::SIZE;
+  if (loadBE<uint32_t>(payload + length) != frameCrc(buf, payload, length)) return ParseStatus::BadCrc;
+  out->header = HeaderView(buf);
+  out->payload = payload;
+  out->length = length;
+  return ParseStatus::Ok;
+}
+
+// offset of the jpeg bytes in a Mosaic payload, 0 if the payload is too short for its tile table
+inline size_t mosaicJpegOffset(const FrameRef& f) {
+  size_t off = MosaicHeader::SIZE + size_t(MosaicView(f.payload).get<MosaicHeader::TileCount>()) * MosaicTile::SIZE;
+  return off <= f.length ? off : 0;
+}
+
+// offset of the next FRAME_MAGIC in `buf` at or after `from`, or `len` if there is none
+inline size_t findMagic(const uint8_t* buf, size_t len, size_t from = 0) {
+  for (size_t i = from; i + 4 <= len; ++i) {
+    if (buf[i] == uint8_t(FRAME_MAGIC >> 24) && loadBE<uint32_t>(buf + i) == FRAME_MAGIC) return i;
+  }
+  return len;
+}
+
+}  // namespace proto
@@ -0,0 +1,168 @@
+// bench_fleet.cpp - control-plane uplink cost of fleet_summary.h against relaying every heartbeat
+//
+// build & run from the repo root:
+//   g++ -O2 -std=c++17 -Ilib/telemetry/src -Ilib/swarm_proto/src lib/telemetry/examples/bench_fleet.cpp -o bench_fleet
+//   ./bench_fleet [nodes] [minutes] [-o fleet.bin]
+//
+// simulates `nodes` secondaries sending a 1 Hz heartbeat (node_telemetry.h) for `minutes`:
+// noisy rssi with a slow walk, draining batteries, cameras at ~10 fps, occasional backlog bursts
+// and crc errors. along the way one node drops out for five minutes, one walks out of range and
+// one runs its battery low. prints the uplink bytes per node per minute of relaying every
+// heartbeat frame against the primary's fleet summaries, and how fast each alert went out.
+// -o writes the summary frames as the base would receive them.
+#include <fleet_summary.h>
+#include <node_telemetry.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace telemetry;
+
+struct SimNode {
+  uint8_t id;
+  bool camera;
+  double rssi, battery, fps;
+  int32_t crcErrors = 0;
+  int32_t queueKb = 0;
+  Encoder<NF_COUNT> enc{NODE_MODES, 16};
+};
+
+int main(int argc, char** argv) {
+  int nodes = 6, minutes = 60;
+  const char* outName = nullptr;
+  int positional = 0;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "-o") && i + 1 < argc) outName = argv[++i];
+    else if (positional++ == 0) nodes = atoi(argv[i]);
+    else minutes = atoi(argv[i]);
+  }
+  if (nodes < 1 || nodes > 32 || minutes < 1) {
+    fprintf(stderr, "usage: %s [nodes 1..32] [minutes] [-o fleet.bin]\n", argv[0]);
+    return 1;
+  }
+  FILE* out = outName ? fopen(outName, "wb") : nullptr;
+
+  std::mt19937 rng(7);
+  std::normal_distribution<double> noise(0.0, 1.0);
+  std::uniform_real_distribution<double> uni(0.0, 1.0);
+  std::vector<SimNode> sim;
+  for (int i = 0; i < nodes; ++i) {
+    SimNode n;
+    n.id = uint8_t(i + 1);
+    n.camera = i % 2 == 0;
+    n.rssi = -55 - 3 * (i % 6);
+    n.battery = i == 3 ? 3560 : 4150 - 20 * (i % 6);
+    n.fps = n.camera ? 10 : 0;
+    sim.push_back(n);
+  }
+  const int lostNode = 1, walkNode = 2 % nodes, drainNode = 3 % nodes;
+  const uint32_t lostFrom = 20 * 60000u, lostTo = 25 * 60000u;
+
+  FleetSummary<32> fleet;
+  std::vector<uint8_t> payload(FleetSummary<32>::maxPayload());
+  uint64_t relayBytes = 0, fleetBytes = 0;
+  uint8_t seenAlerts[33] = {}, sentAlerts[33] = {};
+  uint32_t raisedMs[33][4] = {};
+  static const char* const ALERT_NAMES[4] = {"lost", "low battery", "weak link", "backlog"};
+  std::vector<Decoder<FF_COUNT>> decoders(33, Decoder<FF_COUNT>(FLEET_MODES));
+  uint32_t undecodable = 0;
+  uint16_t seq = 0;
+
+  printf("%-11s %-5s %-12s %s\n", "time", "node", "alert", "sent after");
+  const uint32_t endMs = uint32_t(minutes) * 60000u;
+  for (uint32_t now = 0; now < endMs; now += 100) {
+    if (now % 1000 == 0) {
+      for (int i = 0; i < nodes; ++i) {
+        SimNode& n = sim[size_t(i)];
+        // each node's own drift
+        n.rssi += noise(rng) * 0.15;
+        if (i == walkNode && now > 30 * 60000u && now < 40 * 60000u) n.rssi -= 0.05;  // walks out of range
+        n.battery -= n.camera ? 0.4 : 0.25;
+        if (i == drainNode) n.battery -= 0.1;
+        if (n.camera) n.fps = 10 + noise(rng) * 0.3;
+        if (uni(rng) < 0.002) n.queueKb = 20 + int(uni(rng) * 20);
+        else n.queueKb = n.queueKb > 4 ? n.queueKb - 4 : 0;
+        if (uni(rng) < 1.0 / 600) n.crcErrors++;
+        if (i == lostNode && now >= lostFrom && now < lostTo) continue;
+
+        // what the node reports, and what relaying its heartbeat costs
+        int32_t hb[NF_COUNT];
+        hb[NF_UPTIME_S] = int32_t(now / 1000);
+        hb[NF_RSSI_DBM] = int32_t(n.rssi + noise(rng) * 1.5);
+        hb[NF_BATTERY_MV] = int32_t(n.battery + noise(rng) * 8);
+        hb[NF_TEMP_CENTI_C] = int32_t(4200 + noise(rng) * 30);
+        hb[NF_FREE_HEAP] = 180000 + int32_t(noise(rng) * 500);
+        uint8_t enc[maxEncodedSize(NF_COUNT)];
+        relayBytes += proto::frameSize(n.enc.encode(hb, enc, sizeof(enc)));
+
+        // what the primary knows about the node
+        fleet.heard(n.id, now);
+        int32_t st[FF_COUNT];
+        st[FF_RSSI_DBM] = hb[NF_RSSI_DBM];
+        st[FF_BATTERY_MV] = hb[NF_BATTERY_MV];
+        st[FF_FPS_X10] = int32_t(n.fps * 10 + 0.5);
+        st[FF_LAST_SEEN_S] = 0;
+        st[FF_QUEUE_KB] = n.queueKb;
+        st[FF_CRC_ERRORS] = n.crcErrors;
+        fleet.update(n.id, st, now);
+      }
+    }
+
+    uint8_t flags = 0;
+    size_t len = fleet.poll(now, payload.data(), payload.size(), &flags);
+    for (const SimNode& n : sim) {
+      uint8_t a = fleet.alerts(n.id);
+      for (int b = 0; b < 4; ++b)
+        if ((a >> b & 1) && !(seenAlerts[n.id] >> b & 1)) raisedMs[n.id][b] = now;
+      seenAlerts[n.id] = a;
+    }
+    if (!len) continue;
+    fleetBytes += proto::frameSize(len);
+    if (out) {
+      uint8_t hdr[proto::FrameHeader::SIZE], trailer[proto::CRC_SIZE];
+      proto::writeHeader(hdr, proto::MsgType::FleetSummary, 0, seq++, uint32_t(len), flags);
+      proto::writeTrailer(trailer, proto::frameCrc(hdr, payload.data(), len));
+      fwrite(hdr, 1, sizeof(hdr), out);
+      fwrite(payload.data(), 1, len, out);
+      fwrite(trailer, 1, sizeof(trailer), out);
+    }
+    // decode as the base does: every row must decode, and alert bits are timed from the first
+    // poll that saw the condition to the summary that carried it
+    size_t pos = proto::FleetHeader::SIZE;
+    uint8_t count = proto::FleetView(payload.data()).get<proto::FleetHeader::NodeCount>();
+    for (uint8_t r = 0; r < count; ++r) {
+      proto::FleetRowView row(payload.data() + pos);
+      uint8_t id = row.get<proto::FleetRow::Node>(), a = row.get<proto::FleetRow::Alerts>();
+      int32_t v[FF_COUNT];
+      size_t used = 0;
+      if (decoders[id].decode(payload.data() + pos + proto::FleetRow::SIZE, len - pos - proto::FleetRow::SIZE, v,
+                              &used) != DecodeStatus::Ok) {
+        undecodable++;
+      }
+      pos += proto::FleetRow::SIZE + used;
+      for (int b = 0; b < 4; ++b) {
+        uint8_t bit = uint8_t(1 << b);
+        if ((a & bit) && !(sentAlerts[id] & bit)) {
+          printf("%7.1f min  %-5u %-12s %4u ms\n", now / 60000.0, id, ALERT_NAMES[b], now - raisedMs[id][b]);
+        }
+      }
+      sentAlerts[id] = a;
+    }
+    if (pos != len) undecodable++;
+  }
+  if (out) fclose(out);
+
+  const FleetStats& st = fleet.stats();
+  double perNodeMin = double(nodes) * minutes;
+  printf("\n%d nodes, %d min\n", nodes, minutes);
+  printf("relay every heartbeat:  %8.0f bytes/node/min\n", relayBytes / perNodeMin);
+  printf("fleet summary:          %8.0f bytes/node/min  (%.1f%%)\n", fleetBytes / perNodeMin,
+         100.0 * double(fleetBytes) / double(relayBytes));
+  if (undecodable) printf("  %u rows did not decode\n", undecodable);
+  printf("  %u summaries (%u full, %u early for alerts), %u rows, %.1f payload bytes/row\n", st.summaries, st.full,
+         st.alertSummaries, st.rows, st.rows ? double(st.bytes - st.summaries * proto::FleetHeader::SIZE) / st.rows : 0.0);
+  return 0;
+}
@@ -0,0 +1,110 @@
+// bench_telemetry.cpp - native benchmark for telemetry_codec.h
+//
+// build & run from the repo root:
+//   g++ -O2 -std=c++17 -Ilib/telemetry/src lib/telemetry/examples/bench_telemetry.cpp -o bench_telemetry
+//   ./bench_telemetry                 # synthetic flight trace
+//   ./bench_telemetry trace.csv       # recorded trace: one sample per line, 6 integer columns
+//
+// trace columns (fixed point): lat*1e7, lon*1e7, altitude cm, battery mV, temperature 0.01C, rssi dBm
+#include <telemetry_codec.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace telemetry;
+
+static const size_t FIELDS = 6;
+using Sample = int32_t[FIELDS];
+
+static const FieldMode MODES[FIELDS] = {
+  FieldMode::DeltaOfDelta,  // lat
+  FieldMode::DeltaOfDelta,  // lon
+  FieldMode::Delta,         // altitude
+  FieldMode::Delta,         // battery
+  FieldMode::Delta,         // temperature
+  FieldMode::Delta,         // rssi
+};
+
+struct Row { int32_t v[FIELDS]; };
+
+static std::vector<Row> loadCsv(const char* path) {
+  std::vector<Row> rows;
+  FILE* f = fopen(path, "r");
+  if (!f) { perror(path); exit(1); }
+  Row r;
+  while (fscanf(f, "%d,%d,%d,%d,%d,%d", &r.v[0], &r.v[1], &r.v[2], &r.v[3], &r.v[4], &r.v[5]) == 6) {
+    rows.push_back(r);
+  }
+  fclose(f);
+  return rows;
+}
+
+// 10 Hz strip search: constant ground speed legs, gentle altitude hold, linear drain, noisy rssi
+static std::vector<Row> synthTrace(size_t n) {
+  std::vector<Row> rows(n);
+  std::mt19937 rng(42);
+  std::normal_distribution<double> noise(0.0, 1.0);
+  double lat = 129760000.0, lon = 802400000.0, alt = 3000.0, batt = 12600.0, temp = 3100.0;
+  double vlat = 45.0, vlon = 0.0;
+  for (size_t i = 0; i < n; ++i) {
+    if (i % 600 == 590) vlon = 90;                     // step over to the next strip
+    if (i % 600 == 0) { vlat = -vlat; vlon = 0; }      // and turn around
+    lat += vlat; lon += vlon;
+    alt += noise(rng) * 2.0;
+    batt -= 0.35;
+    temp += noise(rng) * 0.3;
+    rows[i].v[0] = int32_t(lat);
+    rows[i].v[1] = int32_t(lon);
+    rows[i].v[2] = int32_t(std::lround(alt));
+    rows[i].v[3] = int32_t(std::lround(batt));
+    rows[i].v[4] = int32_t(std::lround(temp));
+    rows[i].v[5] = int32_t(-60 + std::lround(noise(rng) * 3.0));
+  }
+  return rows;
+}
+
+int main(int argc, char** argv) {
+  std::vector<Row> trace = argc > 1 ? loadCsv(argv[1]) : synthTrace(100000);
+  if (trace.empty()) { fprintf(stderr, "empty trace\n"); return 1; }
+
+  const uint16_t intervals[] = {1, 16, 64, 256};
+  printf("samples: %zu  raw: %zu bytes/sample\n", trace.size(), sizeof(Sample));
+  printf("%-9s %10s %8s %12s %12s\n", "keyframe", "bytes", "ratio", "enc ns/smp", "dec ns/smp");
+
+  for (uint16_t interval : intervals) {
+    Encoder<FIELDS> enc(MODES, interval);
+    std::vector<uint8_t> stream(trace.size() * maxEncodedSize(FIELDS));
+    std::vector<size_t> sizes(trace.size());
+
+    auto t0 = std::chrono::steady_clock::now();
+    size_t off = 0;
+    for (size_t i = 0; i < trace.size(); ++i) {
+      sizes[i] = enc.encode(trace[i].v, stream.data() + off, stream.size() - off);
+      off += sizes[i];
+    }
+    auto t1 = std::chrono::steady_clock::now();
+
+    Decoder<FIELDS> dec(MODES);
+    Sample out;
+    size_t pos = 0, mismatches = 0;
+    for (size_t i = 0; i < trace.size(); ++i) {
+      if (dec.decode(stream.data() + pos, sizes[i], out) != DecodeStatus::Ok) ++mismatches;
+      else
+        for (size_t f = 0; f < FIELDS; ++f) mismatches += out[f] != trace[i].v[f];
+      pos += sizes[i];
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    double encNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / trace.size();
+    double decNs = std::chrono::duration<double, std::nano>(t2 - t1).count() / trace.size();
+    double ratio = double(trace.size() * sizeof(Sample)) / double(off);
+    printf("%-9u %10zu %7.2fx %12.1f %12.1f%s\n", interval, off, ratio, encNs, decNs,
+           mismatches ? "  ROUNDTRIP MISMATCH" : "");
+    if (mismatches) return 1;
+  }
+  return 0;
+}
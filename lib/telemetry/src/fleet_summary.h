@@ -0,0 +1,204 @@
+// fleet_summary.h - the primary's per-node status rolled up into one FleetSummary message
+//
+// header-only, no allocation. instead of relaying every secondary's heartbeat, the primary keeps
+// the latest status of each node and sends one summary for the whole fleet:
+//   - a full summary (FLAG_FLEET_FULL, every node, keyframe rows) every fullMs and whenever the
+//     base (re)connects, so a receiver can always resynchronise
+//   - in between, every periodMs, rows only for nodes whose status moved by more than a deadband
+//     (nothing at all if no node changed)
+//   - immediately (at most every alertGapMs) when a node's alert bits change
+// each row is a telemetry_codec.h sample delta-coded against the previous row of the same node,
+// so a node whose status barely moves costs a few bits per row. a lost summary leaves that
+// node's rows undecodable at the base until the next full summary; alert bits are plain.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <swarm_proto.h>
+
+#include "telemetry_codec.h"
+
+namespace telemetry {
+
+// status of one node as seen by the primary (fixed point)
+enum FleetField { FF_RSSI_DBM, FF_BATTERY_MV, FF_FPS_X10, FF_LAST_SEEN_S, FF_QUEUE_KB, FF_CRC_ERRORS, FF_COUNT };
+
+constexpr FieldMode FLEET_MODES[FF_COUNT] = {
+  FieldMode::Delta, FieldMode::Delta, FieldMode::Delta, FieldMode::Delta, FieldMode::Delta, FieldMode::Delta,
+};
+
+// smallest change worth a row; smaller moves are held at the last sent value
+constexpr int32_t FLEET_DEADBAND[FF_COUNT] = {4, 50, 10, 5, 4, 1};
+
+constexpr size_t maxFleetRowSize() { return proto::FleetRow::SIZE + maxEncodedSize(FF_COUNT); }
+
+struct FleetLimits {
+  uint32_t periodMs = 2000;
+  uint32_t fullMs = 60000;
+  uint32_t alertGapMs = 250;
+  uint32_t lostMs = 5000;
+  int32_t lowBatteryMv = 3400;  // 0 mV means the node has no battery sense
+  int32_t weakRssiDbm = -80;    // 0 dBm means unknown
+  int32_t backlogKb = 16;
+  // an alert clears only once the value is this far back on the good side, so noise around a
+  // limit does not flap it
+  int32_t batteryHysteresisMv = 100;
+  int32_t rssiHysteresisDb = 5;
+  int32_t backlogHysteresisKb = 8;
+};
+
+struct FleetStats {
+  uint32_t summaries = 0;
+  uint32_t full = 0;
+  uint32_t alertSummaries = 0;  // sent early because alert bits changed
+  uint32_t rows = 0;
+  uint32_t bytes = 0;           // payload bytes built
+};
+
+template <int MaxNodes>
+class FleetSummary {
+ public:
+  explicit FleetSummary(const FleetLimits& limits = FleetLimits()) : limits_(limits) {}
+
+  // any crc-checked frame from `node`; feeds FF_LAST_SEEN_S and the lost alert
+  void heard(uint8_t node, uint32_t nowMs) {
+    Node* n = find(node, nowMs);
+    if (n) n->lastSeenMs = nowMs;
+  }
+
+  // latest status of `node`; FF_LAST_SEEN_S is filled in from heard()
+  void update(uint8_t node, const int32_t (&status)[FF_COUNT], uint32_t nowMs) {
+    Node* n = find(node, nowMs);
+    if (!n) return;
+    for (int f = 0; f < FF_COUNT; ++f)
+      if (f != FF_LAST_SEEN_S) n->raw[f] = status[f];
+  }
+
+  // the next poll() sends a full summary (a new receiver has no reference)
+  void forceFull() { fullDue_ = true; }
+
+  // builds the FleetSummary payload if one is due; returns its length (0 if nothing to send) and
+  // the frame flags to send it with
+  size_t poll(uint32_t nowMs, uint8_t* out, size_t cap, uint8_t* flags) {
+    bool alertChanged = false, anyNode = false;
+    for (Node& n : nodes_) {
+      if (!n.used) continue;
+      anyNode = true;
+      n.raw[FF_LAST_SEEN_S] = int32_t((nowMs - n.lastSeenMs) / 1000);
+      n.alerts = alertsFor(n, nowMs);
+      alertChanged |= n.alerts != n.sentAlerts;
+    }
+    if (!anyNode) return 0;
+    bool full = fullDue_ || nowMs - lastFullMs_ >= limits_.fullMs;
+    bool periodic = nowMs - lastSentMs_ >= limits_.periodMs;
+    bool alert = alertChanged && nowMs - lastSentMs_ >= limits_.alertGapMs;
+    if (!full && !periodic && !alert) return 0;
+
+    size_t len = proto::FleetHeader::SIZE;
+    uint8_t count = 0;
+    for (Node& n : nodes_) {
+      if (!n.used || (!full && !changed(n))) continue;
+      if (len + maxFleetRowSize() > cap) break;
+      if (full) {
+        n.enc.forceKeyframe();
+        for (int f = 0; f < FF_COUNT; ++f) n.sent[f] = n.raw[f];
+      } else {
+        for (int f = 0; f < FF_COUNT; ++f)
+          if (moved(n, f)) n.sent[f] = n.raw[f];
+      }
+      proto::writeFleetRow(out + len, n.node, n.alerts);
+      size_t row = n.enc.encode(n.sent, out + len + proto::FleetRow::SIZE, cap - len - proto::FleetRow::SIZE);
+      n.sentAlerts = n.alerts;
+      len += proto::FleetRow::SIZE + row;
+      ++count;
+    }
+    lastSentMs_ = nowMs;
+    if (full) {
+      fullDue_ = false;
+      lastFullMs_ = nowMs;
+    }
+    if (!count) return 0;
+    proto::writeFleetHeader(out, nowMs, count);
+    *flags = full ? proto::FLAG_FLEET_FULL : 0;
+    stats_.summaries++;
+    stats_.full += full;
+    stats_.alertSummaries += !full && !periodic;
+    stats_.rows += count;
+    stats_.bytes += uint32_t(len);
+    return len;
+  }
+
+  // worst case payload of a full summary
+  static constexpr size_t maxPayload() { return proto::FleetHeader::SIZE + MaxNodes * maxFleetRowSize(); }
+
+  uint8_t alerts(uint8_t node) const {
+    for (const Node& n : nodes_)
+      if (n.used && n.node == node) return n.alerts;
+    return 0;
+  }
+
+  const FleetStats& stats() const { return stats_; }
+
+ private:
+  struct Node {
+    bool used = false;
+    uint8_t node = 0;
+    uint8_t alerts = 0;
+    uint8_t sentAlerts = 0;
+    uint32_t lastSeenMs = 0;
+    int32_t raw[FF_COUNT] = {};
+    int32_t sent[FF_COUNT] = {};
+    Encoder<FF_COUNT> enc{FLEET_MODES, 0xFFFF};  // keyframes only on full summaries
+  };
+
+  // the node's entry, taking over the longest silent one when the table is full
+  Node* find(uint8_t node, uint32_t nowMs) {
+    Node* victim = nullptr;
+    for (Node& n : nodes_) {
+      if (n.used && n.node == node) return &n;
+      if (!victim || (victim->used && (!n.used || n.lastSeenMs < victim->lastSeenMs))) victim = &n;
+    }
+    *victim = Node();
+    victim->used = true;
+    victim->node = node;
+    victim->lastSeenMs = nowMs;
+    fullDue_ = true;  // the new row needs a keyframe
+    return victim;
+  }
+
+  bool moved(const Node& n, int f) const {
+    int32_t d = n.raw[f] - n.sent[f];
+    return (d < 0 ? -d : d) >= FLEET_DEADBAND[f];
+  }
+
+  bool changed(const Node& n) const {
+    if (n.alerts != n.sentAlerts) return true;
+    for (int f = 0; f < FF_COUNT; ++f)
+      if (moved(n, f)) return true;
+    return false;
+  }
+
+  uint8_t alertsFor(const Node& n, uint32_t nowMs) const {
+    auto margin = [&](uint8_t bit, int32_t m) { return (n.alerts & bit) ? m : 0; };
+    const int32_t batt = n.raw[FF_BATTERY_MV], rssi = n.raw[FF_RSSI_DBM];
+    uint8_t a = 0;
+    if (nowMs - n.lastSeenMs >= limits_.lostMs) a |= proto::ALERT_LOST;
+    if (batt > 0 && batt < limits_.lowBatteryMv + margin(proto::ALERT_LOW_BATTERY, limits_.batteryHysteresisMv))
+      a |= proto::ALERT_LOW_BATTERY;
+    if (rssi < 0 && rssi < limits_.weakRssiDbm + margin(proto::ALERT_WEAK_LINK, limits_.rssiHysteresisDb))
+      a |= proto::ALERT_WEAK_LINK;
+    if (n.raw[FF_QUEUE_KB] >= limits_.backlogKb - margin(proto::ALERT_BACKLOG, limits_.backlogHysteresisKb))
+      a |= proto::ALERT_BACKLOG;
+    return a;
+  }
+
+  FleetLimits limits_;
+  Node nodes_[MaxNodes];
+  bool fullDue_ = true;
+  uint32_t lastSentMs_ = 0;
+  uint32_t lastFullMs_ = 0;
+  FleetStats stats_;
+};
+
+}  // namespace telemetry
@@ -0,0 +1,21 @@
+// node_telemetry.h - layout of the heartbeat sample a secondary sends (MsgType::Telemetry)
+//
+// shared so the primary can decode what the secondaries encode. values are fixed point, one
+// telemetry_codec.h sample per frame.
+#pragma once
+
+#include "telemetry_codec.h"
+
+namespace telemetry {
+
+enum NodeField { NF_UPTIME_S, NF_RSSI_DBM, NF_BATTERY_MV, NF_TEMP_CENTI_C, NF_FREE_HEAP, NF_COUNT };
+
+constexpr FieldMode NODE_MODES[NF_COUNT] = {
+  FieldMode::DeltaOfDelta,  // uptime ticks at a constant rate -> zero residual
+  FieldMode::Delta,
+  FieldMode::Delta,
+  FieldMode::Delta,
+  FieldMode::Delta,
+};
+
+}  // namespace telemetry
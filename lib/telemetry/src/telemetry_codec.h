@@ -0,0 +1,270 @@
+// telemetry_codec.h - streaming delta / delta-of-delta codec for slowly changing telemetry
+//
+// header-only, no allocation, builds for ESP32 (arduino) and natively (g++ -std=c++17).
+//
+// every sample is a fixed array of N int32 fields. callers pick the fixed-point scale
+// (e.g. lat/lon * 1e7, altitude in cm, battery in mV, temperature in 0.01 C) and a mode
+// per field:
+//   Raw           - value is sent as is (zigzag varint)
+//   Delta         - value - previous value
+//   DeltaOfDelta  - (value - previous) - previous delta; best for steady ramps (gps walk, drain)
+//
+// wire format of one encoded sample (bit-packed, msb first, padded to a whole byte):
+//   1 bit   keyframe flag
+//   8 bits  sequence number (wraps)
+//   keyframe: N x bit-varint(zigzag(value))            - absolute, decodable on its own
+//   delta:    N x 2 bit tag, then per field by tag:
+//               0 -> residual is zero (nothing follows)
+//               1 -> 4 bit zigzag residual
+//               2 -> 8 bit zigzag residual
+//               3 -> bit-varint(zigzag(residual))
+//
+// a keyframe is emitted every `keyframeInterval` samples (and on demand), so a receiver that
+// joins late or misses a sample resynchronises at the next keyframe.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace telemetry {
+
+enum class FieldMode : uint8_t { Raw, Delta, DeltaOfDelta };
+
+enum class DecodeStatus : uint8_t {
+  Ok,            // sample written to output
+  NeedKeyframe,  // delta sample without a preceding keyframe / after a gap; dropped
+  Truncated,     // input ended in the middle of a sample
+};
+
+inline uint32_t zigzagEncode(int32_t v) { return (uint32_t(v) << 1) ^ uint32_t(v >> 31); }
+inline int32_t zigzagDecode(uint32_t v) { return int32_t(v >> 1) ^ -int32_t(v & 1); }
+
+// msb-first bit writer over a caller supplied buffer. writes past the end are dropped and
+// flagged, so the encoder never touches memory it does not own.
+class BitWriter {
+ public:
+  BitWriter(uint8_t* buf, size_t cap) : buf_(buf), cap_(cap) {}
+
+  void put(uint32_t value, uint8_t bits) {
+    while (bits) {
+      size_t byte = bitPos_ >> 3;
+      if (byte >= cap_) { overflow_ = true; return; }
+      uint8_t used = bitPos_ & 7;
+      uint8_t room = 8 - used;
+      uint8_t n = bits < room ? bits : room;
+      uint8_t chunk = uint8_t((value >> (bits - n)) & ((1u << n) - 1));
+      if (used == 0) buf_[byte] = 0;
+      buf_[byte] |= uint8_t(chunk << (room - n));
+      bitPos_ += n;
+      bits -= n;
+    }
+  }
+
+  // 7 data bits + 1 continuation bit per group, least significant group first
+  void putVarint(uint32_t value) {
+    while (value >= 0x80) {
+      put((value & 0x7F) | 0x80, 8);
+      value >>= 7;
+    }
+    put(value, 8);
+  }
+
+  size_t bytes() const { return (bitPos_ + 7) >> 3; }
+  bool overflow() const { return overflow_; }
+
+ private:
+  uint8_t* buf_;
+  size_t cap_;
+  size_t bitPos_ = 0;
+  bool overflow_ = false;
+};
+
+class BitReader {
+ public:
+  BitReader(const uint8_t* buf, size_t len) : buf_(buf), len_(len) {}
+
+  uint32_t get(uint8_t bits) {
+    uint32_t value = 0;
+    while (bits) {
+      size_t byte = bitPos_ >> 3;
+      if (byte >= len_) { underflow_ = true; return 0; }
+      uint8_t used = bitPos_ & 7;
+      uint8_t room = 8 - used;
+      uint8_t n = bits < room ? bits : room;
+      uint8_t chunk = uint8_t((buf_[byte] >> (room - n)) & ((1u << n) - 1));
+      value = (value << n) | chunk;
+      bitPos_ += n;
+      bits -= n;
+    }
+    return value;
+  }
+
+  uint32_t getVarint() {
+    uint32_t value = 0;
+    for (uint8_t shift = 0; shift < 35; shift += 7) {
+      uint32_t group = get(8);
+      if (underflow_) return 0;
+      value |= (group & 0x7F) << shift;
+      if (!(group & 0x80)) break;
+    }
+    return value;
+  }
+
+  // position after the current sample, rounded up to the next byte
+  size_t bytes() const { return (bitPos_ + 7) >> 3; }
+  bool underflow() const { return underflow_; }
+
+ private:
+  const uint8_t* buf_;
+  size_t len_;
+  size_t bitPos_ = 0;
+  bool underflow_ = false;
+};
+
+// worst case encoded size of one sample: header + 2 bit tags + a 5 byte varint per field
+constexpr size_t maxEncodedSize(size_t fields) { return 2 + (fields * 2 + 7) / 8 + fields * 5; }
+
+namespace detail {
+
+inline int32_t residual(FieldMode mode, int32_t value, int32_t prev, int32_t prevDelta) {
+  switch (mode) {
+    case FieldMode::Raw: return value;
+    case FieldMode::Delta: return int32_t(uint32_t(value) - uint32_t(prev));
+    case FieldMode::DeltaOfDelta:
+    default: return int32_t(uint32_t(value) - uint32_t(prev) - uint32_t(prevDelta));
+  }
+}
+
+inline int32_t reconstruct(FieldMode mode, int32_t r, int32_t prev, int32_t prevDelta) {
+  switch (mode) {
+    case FieldMode::Raw: return r;
+    case FieldMode::Delta: return int32_t(uint32_t(prev) + uint32_t(r));
+    case FieldMode::DeltaOfDelta:
+    default: return int32_t(uint32_t(prev) + uint32_t(prevDelta) + uint32_t(r));
+  }
+}
+
+}  // namespace detail
+
+template <size_t N>
+class Encoder {
+ public:
+  Encoder(const FieldMode (&modes)[N], uint16_t keyframeInterval = 32)
+      : keyframeInterval_(keyframeInterval ? keyframeInterval : 1) {
+    for (size_t i = 0; i < N; ++i) modes_[i] = modes[i];
+  }
+
+  // next encode() emits an absolute keyframe (e.g. when a new receiver connects)
+  void forceKeyframe() { sinceKeyframe_ = 0; }
+
+  // returns the number of bytes written, 0 if `cap` is too small
+  size_t encode(const int32_t (&sample)[N], uint8_t* out, size_t cap) {
+    BitWriter w(out, cap);
+    bool key = sinceKeyframe_ == 0;
+    w.put(key ? 1 : 0, 1);
+    w.put(seq_, 8);
+
+    if (key) {
+      for (size_t i = 0; i < N; ++i) w.putVarint(zigzagEncode(sample[i]));
+    } else {
+      uint32_t zz[N];
+      for (size_t i = 0; i < N; ++i) {
+        zz[i] = zigzagEncode(detail::residual(modes_[i], sample[i], prev_[i], prevDelta_[i]));
+        w.put(tagFor(zz[i]), 2);
+      }
+      for (size_t i = 0; i < N; ++i) {
+        switch (tagFor(zz[i])) {
+          case 0: break;
+          case 1: w.put(zz[i], 4); break;
+          case 2: w.put(zz[i], 8); break;
+          default: w.putVarint(zz[i]); break;
+        }
+      }
+    }
+    if (w.overflow()) return 0;
+
+    for (size_t i = 0; i < N; ++i) {
+      prevDelta_[i] = key ? 0 : int32_t(uint32_t(sample[i]) - uint32_t(prev_[i]));
+      prev_[i] = sample[i];
+    }
+    ++seq_;
+    if (++sinceKeyframe_ >= keyframeInterval_) sinceKeyframe_ = 0;
+    return w.bytes();
+  }
+
+ private:
+  static uint8_t tagFor(uint32_t zz) {
+    if (zz == 0) return 0;
+    if (zz < 16) return 1;
+    if (zz < 256) return 2;
+    return 3;
+  }
+
+  FieldMode modes_[N];
+  int32_t prev_[N] = {};
+  int32_t prevDelta_[N] = {};
+  uint16_t keyframeInterval_;
+  uint16_t sinceKeyframe_ = 0;
+  uint8_t seq_ = 0;
+};
+
+template <size_t N>
+class Decoder {
+ public:
+  explicit Decoder(const FieldMode (&modes)[N]) {
+    for (size_t i = 0; i < N; ++i) modes_[i] = modes[i];
+  }
+
+  // decodes one sample from the front of `in`. `consumed` is set to the sample's size even when
+  // it is dropped with NeedKeyframe, so a caller can walk a buffer of back-to-back samples.
+  DecodeStatus decode(const uint8_t* in, size_t len, int32_t (&out)[N], size_t* consumed = nullptr) {
+    BitReader r(in, len);
+    bool key = r.get(1);
+    uint8_t seq = uint8_t(r.get(8));
+    int32_t values[N];
+
+    if (key) {
+      for (size_t i = 0; i < N; ++i) values[i] = zigzagDecode(r.getVarint());
+    } else {
+      uint8_t tags[N];
+      for (size_t i = 0; i < N; ++i) tags[i] = uint8_t(r.get(2));
+      for (size_t i = 0; i < N; ++i) {
+        uint32_t zz;
+        switch (tags[i]) {
+          case 0: zz = 0; break;
+          case 1: zz = r.get(4); break;
+          case 2: zz = r.get(8); break;
+          default: zz = r.getVarint(); break;
+        }
+        values[i] = detail::reconstruct(modes_[i], zigzagDecode(zz), prev_[i], prevDelta_[i]);
+      }
+    }
+    if (r.underflow()) return DecodeStatus::Truncated;
+    if (consumed) *consumed = r.bytes();
+
+    if (!key && (!synced_ || seq != expectedSeq_)) {
+      synced_ = false;
+      return DecodeStatus::NeedKeyframe;
+    }
+
+    for (size_t i = 0; i < N; ++i) {
+      prevDelta_[i] = key ? 0 : int32_t(uint32_t(values[i]) - uint32_t(prev_[i]));
+      prev_[i] = values[i];
+      out[i] = values[i];
+    }
+    synced_ = true;
+    expectedSeq_ = uint8_t(seq + 1);
+    return DecodeStatus::Ok;
+  }
+
+  bool synced() const { return synced_; }
+
+ private:
+  FieldMode modes_[N];
+  int32_t prev_[N] = {};
+  int32_t prevDelta_[N] = {};
+  uint8_t expectedSeq_ = 0;
+  bool synced_ = false;
+};
+
+}  // namespace telemetry
@@ -1,5 +1,15 @@
+#include <new>
 #include <WiFi.h>
+#include <lwip/sockets.h>
 #include "esp_wifi.h"
+#include <swarm_proto.h>
+#include <fleet_summary.h>
+#include <frame_cache.h>
+#include <jpeg_mosaic.h>
+#include <jpeg_scale.h>
+#include <mjpeg_server.h>
+#include <node_telemetry.h>
+#include <scale_governor.h>
 
 const char* PRIMARY_AP_SSID = "ESP32_PRIMARY_AP";
 const char* PRIMARY_AP_PASS = "esp32pass";
@@ -13,9 +23,167 @@ const uint16_t LAPTOP_PORT = 9000;
 const uint16_t SERVER_PORT = 8000; // primary's softAP server port for secondaries
 const int MAX_CLIENTS = 6;
 
+// one whole frame is read from a secondary before it is forwarded, so frames from different
+// secondaries never interleave on the uplink. a single buffer is enough since the loop relays
+// one frame at a time.
+const size_t FRAME_BUF_SIZE = 64 * 1024;
+const unsigned long FRAME_READ_TIMEOUT_MS = 2000;
+
+// latest complete picture of every node, kept so the base can fetch it without waiting for the
+// camera (Command GetLatest) and so a base that (re)connects gets every node's picture first.
+// with PSRAM half of each node's share holds the served picture, the other half the one being
+// assembled. without it the budget only holds a couple of whole pictures, so they are single-buffered
+// and only the most recently updated nodes are kept (frame_cache.h).
+const size_t CACHE_BUDGET_PSRAM = 384 * 1024;
+const size_t CACHE_BUDGET_DRAM = 48 * 1024;
+const size_t CACHE_MIN_PICTURE = 24 * 1024;  // a whole camera JPEG is 15-25 KB
+const size_t MAX_COMMAND_PAYLOAD = 16;
+
+// optional transcode stage: when the uplink saturates, pictures are downscaled in the DCT domain
+// (or re-quantized) before they are forwarded. the governor picks a step from the measured uplink
+// utilisation; step 0 forwards untouched. quality 0 marks passthrough.
+const bool TRANSCODE_ENABLED = true;
+struct TranscodeStep {
+  uint8_t scale;
+  uint8_t quality;
+};
+const TranscodeStep TRANSCODE_STEPS[] = {{1, 0}, {1, 40}, {2, 60}, {4, 60}, {8, 60}};
+const size_t TRANSCODE_BUF_SIZE = 32 * 1024;
+const uint32_t UPLINK_BUDGET_BPS = 0;  // nominal uplink bytes/s; 0 judges by blocked write time only
+
+// optional mosaic: the latest picture of every slot is decoded into a thumbnail tile (DCT-domain
+// downscale, jpeg_mosaic.h) and all tiles go up as one composite JPEG every MOSAIC_PERIOD_MS as a
+// Mosaic message from node 0. with MOSAIC_FORWARD_FEEDS false the individual jpeg streams are not
+// relayed at all and the operator sees only the overview.
+const bool MOSAIC_ENABLED = false;
+const bool MOSAIC_FORWARD_FEEDS = true;
+const unsigned long MOSAIC_PERIOD_MS = 500;
+const unsigned long MOSAIC_STALE_MS = 3000;  // older tiles are flagged stale and drawn dimmed
+const uint8_t MOSAIC_QUALITY = 60;
+const size_t MOSAIC_BUF_SIZE = 16 * 1024;
+const uint8_t PRIMARY_NODE_ID = 0;
+using MosaicCanvas = jpeg::Mosaic<3, 2, 80, 60>;  // one tile per slot
+using ThumbDecoder = jpeg::BasicTranscoder<160>;  // strips wide enough for 1/8 of 1280
+static_assert(MosaicCanvas::TILES >= MAX_CLIENTS, "mosaic needs a tile per slot");
+
+// fleet summary: each secondary's heartbeat is decoded here and folded, with what the primary
+// itself sees of the node (picture rate, last frame, socket backlog, crc errors), into one
+// FleetSummary message from node 0. only changed nodes go up every 2 s, alerts immediately, the
+// whole fleet once a minute (fleet_summary.h). heartbeats are no longer relayed one by one
+// unless FLEET_FORWARD_TELEMETRY is set.
+const bool FLEET_SUMMARY_ENABLED = true;
+const bool FLEET_FORWARD_TELEMETRY = false;
+const unsigned long FLEET_SAMPLE_MS = 1000;
+const int MAX_FLEET_NODES = 16;  // nodes remembered, including ones whose slot has gone away
+
+// local view server for phones on the softAP: http://192.168.4.1/ lists the nodes, /stream/<n>
+// is an MJPEG of node n out of the frame cache. it runs in its own low-priority task on the core
+// the relay loop does not use; each viewer's picture is copied out of the cache and written only as
+// fast as its socket takes it, so a slow phone stalls only its own stream.
+const bool HTTP_VIEW_ENABLED = true;
+const uint16_t HTTP_PORT = 80;
+const int HTTP_MAX_VIEWERS = 3;
+const uint32_t HTTP_TASK_STACK = 6144;
+const UBaseType_t HTTP_TASK_PRIORITY = 1;
+const BaseType_t HTTP_TASK_CORE = 0;  // loop() runs on core 1
+const uint32_t HTTP_POLL_MS = 10;
+
 WiFiServer server(SERVER_PORT);
 WiFiClient clients[MAX_CLIENTS];
 WiFiClient laptopClient;
+uint8_t* frameBuf = nullptr;
+
+struct SlotState {
+  uint32_t frames = 0;
+  uint32_t crcErrors = 0;
+  uint32_t resyncs = 0;
+  bool hunting = false;  // discarding bytes until the next FRAME_MAGIC
+  uint32_t window = 0;   // last four bytes seen while hunting
+  size_t carried = 0;    // bytes read past the last frame during a resync, kept in carryBufs[slot]
+  // fleet summary inputs
+  bool named = false;    // node id known from a frame
+  uint8_t node = 0;
+  uint32_t pictures = 0;
+  uint32_t lastPictures = 0;
+  int32_t fpsX10 = 0;    // smoothed picture rate
+  int32_t rssiDbm = 0;   // from the node's heartbeat, 0 until one decodes
+  int32_t batteryMv = 0;
+  telemetry::Decoder<telemetry::NF_COUNT> heartbeat{telemetry::NODE_MODES};
+};
+SlotState slots[MAX_CLIENTS];
+// per slot, the bytes a resync left past the frame it returned, allocated to their size and freed
+// once the slot's next readFrame() has them back; frameBuf is shared by every slot, so they cannot
+// wait there
+uint8_t* carryBufs[MAX_CLIENTS] = {};
+
+cache::FrameCache<MAX_CLIENTS> frameCache;
+
+telemetry::FleetSummary<MAX_FLEET_NODES> fleet;
+uint8_t fleetBuf[telemetry::FleetSummary<MAX_FLEET_NODES>::maxPayload()];
+uint16_t fleetSeq = 0;
+unsigned long lastFleetSampleMs = 0;
+
+// WiFiClient as the view server wants it: write() waits for the whole buffer, so pictures go out
+// through the socket with MSG_DONTWAIT instead, taking only what fits, and availableForWrite()
+// says whether anything does (the server writes again on its next pass)
+class ViewClient {
+ public:
+  ViewClient() = default;
+  explicit ViewClient(const WiFiClient& c) : c_(c) {}
+  int available() { return c_.available(); }
+  int read(uint8_t* buf, size_t n) { return c_.read(buf, n); }
+  int availableForWrite() {
+    int fd = c_.fd();
+    if (fd < 0) return 0;
+    fd_set w;
+    FD_ZERO(&w);
+    FD_SET(fd, &w);
+    timeval now = {0, 0};
+    return select(fd + 1, nullptr, &w, nullptr, &now) > 0 ? TCP_MSS : 0;
+  }
+  size_t write(const uint8_t* buf, size_t n) {
+    int fd = c_.fd();
+    int w = fd < 0 ? -1 : send(fd, buf, n, MSG_DONTWAIT);
+    return w > 0 ? size_t(w) : 0;
+  }
+  bool connected() { return c_.connected(); }
+  void stop() { c_.stop(); }
+
+ private:
+  WiFiClient c_;
+};
+
+using ViewServer = http::MjpegServer<ViewClient, MAX_CLIENTS, HTTP_MAX_VIEWERS>;
+WiFiServer httpServer(HTTP_PORT);
+ViewServer* viewServer = nullptr;
+
+jpeg::Transcoder* transcoder = nullptr;
+uint8_t* transcodeBuf = nullptr;
+jpeg::ScaleGovernor governor(sizeof(TRANSCODE_STEPS) / sizeof(TRANSCODE_STEPS[0]), 0.75f, 0.5f, UPLINK_BUDGET_BPS);
+
+struct TranscodeStats {
+  uint32_t pictures = 0;
+  uint32_t fallbacks = 0;  // forwarded untouched because the transcode failed
+  uint64_t bytesIn = 0;
+  uint64_t bytesOut = 0;
+  uint64_t cpuUs = 0;
+};
+TranscodeStats transcodeStats;
+
+MosaicCanvas* mosaic = nullptr;
+ThumbDecoder* thumbDecoder = nullptr;
+uint8_t* mosaicBuf = nullptr;
+uint16_t mosaicSeq = 0;
+unsigned long lastMosaicMs = 0;
+
+struct TileInfo {
+  bool filled = false;
+  bool dimmed = false;
+  uint8_t node = 0;
+  uint16_t seq = 0;
+  unsigned long updatedMs = 0;
+};
+TileInfo tiles[MAX_CLIENTS];
 
 // manual MACs (must be unique)
 uint8_t PRIMARY_AP_MAC[]  = {0x02, 0x11, 0x22, 0x33, 0x44, 0x55}; // softAP
@@ -39,10 +207,108 @@ void printWiFiStatus() {
   Serial.println(WiFi.RSSI());
 }
 
+#ifdef CRC_BENCHMARK
+// build with -DCRC_BENCHMARK to print the crc cost per MB at boot
+void benchmarkCrc() {
+  for (size_t i = 0; i < FRAME_BUF_SIZE; ++i) frameBuf[i] = uint8_t(i * 131);
+  const size_t MB = 1024 * 1024;
+  uint32_t crc = 0;
+  unsigned long t0 = micros();
+  for (size_t done = 0; done < MB; done += FRAME_BUF_SIZE) crc = proto::crc32Update(crc, frameBuf, FRAME_BUF_SIZE);
+  unsigned long us = micros() - t0;
+  Serial.printf("CRC32 (%s): %lu us per MB, %.1f MB/s (crc %08x)\n", psramFound() ? "psram" : "dram", us,
+                1e6 / double(us), (unsigned)crc);
+}
+#endif
+
+// large objects go to PSRAM when the board has it
+template <typename T>
+T* allocObject() {
+  void* p = psramFound() ? ps_malloc(sizeof(T)) : malloc(sizeof(T));
+  return p ? new (p) T() : nullptr;
+}
+
+uint8_t* allocBuffer(size_t size) { return (uint8_t*)(psramFound() ? ps_malloc(size) : malloc(size)); }
+
+// relay counters for the view server's status page; read from the http task, so only plain
+// word-sized fields that the relay loop updates in place
+size_t relayStatus(char* out, size_t cap) {
+  size_t n = 0;
+  auto put = [&](int w) { if (w > 0) n += size_t(w); };
+  put(snprintf(out, cap, "<p>transcode step %u, uplink utilisation %.2f</p><table border=1 cellpadding=4>"
+               "<tr><th>slot</th><th>frames</th><th>crc errors</th><th>resyncs</th></tr>",
+               governor.level(), governor.utilisation()));
+  for (int i = 0; i < MAX_CLIENTS && n < cap; ++i) {
+    put(snprintf(out + n, cap - n, "<tr><td>%d</td><td>%lu</td><td>%lu</td><td>%lu</td></tr>", i,
+                 (unsigned long)slots[i].frames, (unsigned long)slots[i].crcErrors, (unsigned long)slots[i].resyncs));
+  }
+  if (n < cap) put(snprintf(out + n, cap - n, "</table>"));
+  return n < cap ? n : cap;
+}
+
+void httpTask(void*) {
+  httpServer.begin();
+  httpServer.setNoDelay(true);
+  while (true) {
+    WiFiClient c = httpServer.available();
+    if (c) {
+      c.setNoDelay(true);
+      if (!viewServer->accept(ViewClient(c), millis())) Serial.println("View server full, refused a viewer");
+    }
+    viewServer->poll(millis());
+    vTaskDelay(pdMS_TO_TICKS(HTTP_POLL_MS));
+  }
+}
+
 void setup() {
   Serial.begin(115200);
   delay(200);
 
+  frameBuf = allocBuffer(FRAME_BUF_SIZE);
+  if (!frameBuf) {
+    Serial.println("Frame buffer allocation failed");
+    while (true) delay(1000);
+  }
+#ifdef CRC_BENCHMARK
+  benchmarkCrc();
+#endif
+  size_t cacheBudget = psramFound() ? CACHE_BUDGET_PSRAM : CACHE_BUDGET_DRAM;
+  uint8_t* cachePool = allocBuffer(cacheBudget);
+  if (cachePool && frameCache.init(cachePool, cacheBudget, CACHE_MIN_PICTURE)) {
+    Serial.printf("Frame cache: %d nodes, %u bytes per picture%s\n", frameCache.slots(),
+                  (unsigned)frameCache.capacity(), frameCache.doubleBuffered() ? "" : ", single-buffered");
+  } else if (cachePool) {
+    Serial.println("Frame cache budget holds no whole picture; GetLatest will find nothing");
+    free(cachePool);
+  } else {
+    Serial.println("Frame cache allocation failed; GetLatest will find nothing");
+  }
+  if (TRANSCODE_ENABLED) {
+    transcoder = allocObject<jpeg::Transcoder>();
+    transcodeBuf = allocBuffer(TRANSCODE_BUF_SIZE);
+    if (!transcoder || !transcodeBuf) {
+      Serial.println("Transcoder allocation failed; forwarding pictures untouched");
+      free(transcoder);
+      free(transcodeBuf);
+      transcoder = nullptr;
+      transcodeBuf = nullptr;
+    }
+  }
+  if (MOSAIC_ENABLED) {
+    mosaic = allocObject<MosaicCanvas>();
+    thumbDecoder = allocObject<ThumbDecoder>();
+    mosaicBuf = allocBuffer(MOSAIC_BUF_SIZE);
+    if (!mosaic || !thumbDecoder || !mosaicBuf) {
+      Serial.println("Mosaic allocation failed; mosaic disabled");
+      free(mosaic);
+      free(thumbDecoder);
+      free(mosaicBuf);
+      mosaic = nullptr;
+      thumbDecoder = nullptr;
+      mosaicBuf = nullptr;
+    }
+  }
+
   esp_wifi_set_mode(WIFI_MODE_APSTA);
   esp_wifi_set_mac(WIFI_IF_AP, PRIMARY_AP_MAC);
   esp_wifi_set_mac(WIFI_IF_STA, PRIMARY_STA_MAC);
@@ -51,6 +317,23 @@ void setup() {
   Serial.print("Primary softAP IP: ");
   Serial.println(WiFi.softAPIP());
 
+  if (HTTP_VIEW_ENABLED) {
+    void* p = malloc(sizeof(ViewServer));  // internal RAM: the http task touches it on every poll
+    size_t poolBytes = ViewServer::sendPoolSize(frameCache.capacity());
+    uint8_t* sendPool = allocBuffer(poolBytes);  // a picture per viewer, copied out of the cache
+    viewServer = p && sendPool ? new (p) ViewServer(frameCache, sendPool, poolBytes, relayStatus) : nullptr;
+    if (!viewServer || xTaskCreatePinnedToCore(httpTask, "http", HTTP_TASK_STACK, nullptr, HTTP_TASK_PRIORITY,
+                                               nullptr, HTTP_TASK_CORE) != pdPASS) {
+      if (viewServer) viewServer->~ViewServer();
+      free(p);  // whichever of the two allocations succeeded
+      free(sendPool);
+      viewServer = nullptr;
+      Serial.println("View server start failed");
+    } else {
+      Serial.printf("View server on port %u, up to %d viewers\n", HTTP_PORT, HTTP_MAX_VIEWERS);
+    }
+  }
+
   // start server for secondaries
   server.begin();
   server.setNoDelay(true);
@@ -73,6 +356,8 @@ void setup() {
   }
 }
 
+void serveCached(uint8_t node);
+
 void tryConnectLaptop() {
   if (laptopClient && laptopClient.connected()) return;
   if (WiFi.status() != WL_CONNECTED) {
@@ -96,11 +381,538 @@ void tryConnectLaptop() {
   bool ok = laptopClient.connect(LAPTOP_IP, LAPTOP_PORT);
   if (ok) {
     Serial.println("Connected to laptop server");
+    serveCached(proto::ALL_NODES);  // a base that joins late starts with every node's latest picture
+    fleet.forceFull();               // and a full fleet summary to delta-decode from
   } else {
     Serial.println("Failed to connect to laptop server (will retry)");
   }
 }
 
+// reads exactly len bytes; gives up if the client stalls for FRAME_READ_TIMEOUT_MS
+bool readFully(WiFiClient& c, uint8_t* dst, size_t len) {
+  size_t got = 0;
+  unsigned long lastProgress = millis();
+  while (got < len) {
+    int n = c.read(dst + got, len - got);
+    if (n > 0) {
+      got += n;
+      lastProgress = millis();
+      continue;
+    }
+    if (!c.connected() || millis() - lastProgress > FRAME_READ_TIMEOUT_MS) return false;
+    delay(1);
+  }
+  return true;
+}
+
+// discards len bytes of a frame that does not fit in frameBuf
+bool skipBytes(WiFiClient& c, size_t len) {
+  while (len > 0) {
+    size_t n = len < FRAME_BUF_SIZE ? len : FRAME_BUF_SIZE;
+    if (!readFully(c, frameBuf, n)) return false;
+    len -= n;
+  }
+  return true;
+}
+
+bool laptopReady() {
+  if (laptopClient && laptopClient.connected()) return true;
+  Serial.println("Laptop not connected; buffering not implemented (dropping frame)");
+  return false;
+}
+
+// every uplink write goes through here so the governor sees how long the link keeps us blocked
+void uplinkWrite(const uint8_t* data, size_t len) {
+  unsigned long t0 = micros();
+  laptopClient.write(data, len);
+  governor.onWrite(len, micros() - t0);
+}
+
+void uplinkFlush() {
+  unsigned long t0 = micros();
+  laptopClient.flush();
+  governor.onWrite(0, micros() - t0);
+}
+
+void forwardFrame(const uint8_t* frame, size_t len) {
+  if (!laptopReady()) return;
+  uplinkWrite(frame, len);
+  uplinkFlush();
+}
+
+// sends a frame built on the primary (header, prefix and data may live in separate buffers)
+void sendFrame(proto::MsgType type, uint8_t node, uint16_t seq, uint8_t flags, const uint8_t* prefix,
+               size_t prefixLen, const uint8_t* data, size_t len) {
+  if (!laptopReady()) return;
+  uint8_t hdr[proto::FrameHeader::SIZE];
+  proto::writeHeader(hdr, type, node, seq, uint32_t(prefixLen + len), flags);
+  uint32_t crc = proto::crc32Update(proto::crc32Update(proto::crc32(hdr, sizeof(hdr)), prefix, prefixLen), data, len);
+  uint8_t trailer[proto::CRC_SIZE];
+  proto::writeTrailer(trailer, crc);
+  uplinkWrite(hdr, sizeof(hdr));
+  uplinkWrite(prefix, prefixLen);
+  uplinkWrite(data, len);
+  uplinkWrite(trailer, sizeof(trailer));
+  uplinkFlush();
+}
+
+// after a bad header or crc, bytes are discarded until the next FRAME_MAGIC. the last bytes of
+// the discarded data seed the window so a magic split across reads is still found.
+void startHunt(int slot, const uint8_t* tail, size_t n) {
+  SlotState& st = slots[slot];
+  st.hunting = true;
+  st.window = 0;
+  for (size_t i = n > 3 ? n - 3 : 0; i < n; ++i) st.window = (st.window << 8) | tail[i];
+  st.resyncs++;
+}
+
+// consumes available bytes until FRAME_MAGIC; true once it has been read
+bool huntMagic(int slot) {
+  SlotState& st = slots[slot];
+  WiFiClient& c = clients[slot];
+  while (c.available() > 0) {
+    int b = c.read();
+    if (b < 0) break;
+    st.window = (st.window << 8) | uint8_t(b);
+    if (st.window == proto::FRAME_MAGIC) {
+      st.hunting = false;
+      return true;
+    }
+  }
+  return false;
+}
+
+void dropCarry(int slot) {
+  free(carryBufs[slot]);
+  carryBufs[slot] = nullptr;
+  slots[slot].carried = 0;
+}
+
+// keeps frameBuf[from, to) for the slot's next readFrame(); dropped (hunting from there on) if no
+// carry buffer can be had
+void carryOver(int slot, size_t from, size_t to) {
+  SlotState& st = slots[slot];
+  carryBufs[slot] = allocBuffer(to - from);
+  if (!carryBufs[slot]) {
+    startHunt(slot, frameBuf + from, to - from);
+    return;
+  }
+  memcpy(carryBufs[slot], frameBuf + from, to - from);
+  st.carried = to - from;
+}
+
+// reads one complete, crc-checked frame from a secondary into frameBuf and returns its size, or 0
+// if no frame is ready. with `wait` it blocks up to FRAME_READ_TIMEOUT_MS for a header to arrive.
+// frameBuf[0, have) always holds the start of the frame being parsed; after a failure the
+// buffer is searched for the next magic first so a desync costs only the damaged frame. bytes
+// that the resync finds already buffered past the frame it returns (have > total) are carried
+// into the slot's next call rather than read again or lost.
+size_t readFrame(int slot, bool wait) {
+  WiFiClient& c = clients[slot];
+  SlotState& st = slots[slot];
+  size_t have = 0;
+
+  if (st.carried) {
+    // they start where the next frame should; a bad header resyncs as below
+    memcpy(frameBuf, carryBufs[slot], st.carried);
+    have = st.carried;
+    dropCarry(slot);
+  } else {
+    if (wait) {
+      unsigned long start = millis();
+      while (c.connected() && c.available() < (int)proto::FrameHeader::SIZE &&
+             millis() - start < FRAME_READ_TIMEOUT_MS) {
+        delay(1);
+      }
+    }
+    if (st.hunting) {
+      if (!huntMagic(slot)) return 0;
+      proto::storeBE<uint32_t>(frameBuf, proto::FRAME_MAGIC);
+      have = 4;
+    } else if (c.available() < (int)proto::FrameHeader::SIZE) {
+      return 0;
+    }
+  }
+
+  for (;;) {
+    if (have < proto::FrameHeader::SIZE) {
+      if (!readFully(c, frameBuf + have, proto::FrameHeader::SIZE - have)) {
+        c.stop();
+        return 0;
+      }
+      have = proto::FrameHeader::SIZE;
+    }
+
+    proto::ParseStatus status = proto::parseHeader(frameBuf, have);
+    size_t total = have;
+    if (status == proto::ParseStatus::Ok) {
+      uint32_t len = proto::HeaderView(frameBuf).get<proto::FrameHeader::Length>();
+      total = proto::frameSize(len);
+      if (total > FRAME_BUF_SIZE) {
+        Serial.printf("Slot %d: %u byte frame exceeds buffer, skipping\n", slot, (unsigned)len);
+        if (!skipBytes(c, total - have)) c.stop();
+        return 0;
+      }
+      if (have < total && !readFully(c, frameBuf + have, total - have)) {
+        Serial.printf("Slot %d: frame read timed out\n", slot);
+        c.stop();
+        return 0;
+      }
+      proto::FrameRef ref;
+      status = proto::parseFrame(frameBuf, total, &ref);
+      if (status == proto::ParseStatus::Ok) {
+        st.frames++;
+        st.named = true;
+        st.node = ref.node();
+        if (ref.type() == proto::MsgType::JpegFrame ||
+            (ref.type() == proto::MsgType::JpegSlice && (ref.flags() & proto::FLAG_SLICE_HEADERS))) {
+          st.pictures++;
+        }
+        frameCache.add(ref, millis());
+        fleet.heard(ref.node(), millis());
+        if (have > total) carryOver(slot, total, have);
+        return total;
+      }
+      st.crcErrors++;
+    }
+
+    Serial.printf("Slot %d: dropped frame (status %d, crc errors %u), resyncing\n", slot, (int)status,
+                  (unsigned)st.crcErrors);
+    size_t filled = have > total ? have : total;  // everything buffered, this frame and past it
+    size_t next = proto::findMagic(frameBuf, filled, 1);
+    if (next < filled) {
+      st.resyncs++;
+      memmove(frameBuf, frameBuf + next, filled - next);
+      have = filled - next;
+      continue;
+    }
+    startHunt(slot, frameBuf, filled);
+    return 0;
+  }
+}
+
+void logTranscode(uint8_t node, size_t inBytes, size_t outBytes, unsigned long cpuUs) {
+  transcodeStats.pictures++;
+  transcodeStats.bytesIn += inBytes;
+  transcodeStats.bytesOut += outBytes;
+  transcodeStats.cpuUs += cpuUs;
+  governor.onTranscode(inBytes, outBytes);
+  Serial.printf("Transcoded node %u %ux%u -> %ux%u: %u -> %u bytes (%d%% saved), %lu us\n", node,
+                transcoder->width(), transcoder->height(), transcoder->outWidth(), transcoder->outHeight(),
+                (unsigned)inBytes, (unsigned)outBytes, int(100 - 100 * outBytes / inBytes), cpuUs);
+}
+
+void sendTranscoded(uint8_t node, uint16_t seq, uint32_t captureMs, size_t outLen) {
+  uint8_t jh[proto::JpegFrameHeader::SIZE];
+  proto::writeJpegHeader(jh, captureMs, transcoder->outWidth(), transcoder->outHeight());
+  sendFrame(proto::MsgType::JpegFrame, node, seq, 0, jh, sizeof(jh), transcodeBuf, outLen);
+}
+
+// jpeg feeds go up unless the mosaic replaces them
+bool feedsForwarded() { return !mosaic || MOSAIC_FORWARD_FEEDS; }
+
+void relayUntouched(const proto::FrameRef& ref, size_t total) {
+  bool isJpeg = ref.type() == proto::MsgType::JpegFrame || ref.type() == proto::MsgType::JpegSlice;
+  if (isJpeg && !feedsForwarded()) return;
+  forwardFrame(frameBuf, total);
+  Serial.print("Relayed ");
+  Serial.print(total);
+  Serial.print(" bytes from node ");
+  Serial.println(ref.node());
+}
+
+// a slot's tile is refreshed at most once per mosaic period, which bounds the decode cost
+bool tileDue(int slot) {
+  return mosaic && (!tiles[slot].filled || millis() - tiles[slot].updatedMs >= MOSAIC_PERIOD_MS);
+}
+
+void markTile(int slot, uint8_t node, uint16_t seq) {
+  TileInfo& t = tiles[slot];
+  t.filled = true;
+  t.dimmed = false;
+  t.node = node;
+  t.seq = seq;
+  t.updatedMs = millis();
+}
+
+// whole JpegFrame: transcode from frameBuf, or forward the original if that fails or saves nothing
+void transcodeJpegFrame(const proto::FrameRef& ref, size_t total, const TranscodeStep& step) {
+  proto::JpegView jv(ref.payload);
+  const uint8_t* jpegData = ref.payload + proto::JpegFrameHeader::SIZE;
+  size_t jpegLen = ref.length - proto::JpegFrameHeader::SIZE;
+
+  unsigned long t0 = micros();
+  size_t outLen = transcoder->transcode(jpegData, jpegLen, step.scale, step.quality, transcodeBuf, TRANSCODE_BUF_SIZE);
+  unsigned long cpuUs = micros() - t0;
+  if (!outLen || outLen >= jpegLen) {
+    transcodeStats.fallbacks++;
+    relayUntouched(ref, total);
+    return;
+  }
+  logTranscode(ref.node(), jpegLen, outLen, cpuUs);
+  sendTranscoded(ref.node(), ref.seq(), jv.get<proto::JpegFrameHeader::CaptureMs>(), outLen);
+}
+
+// sliced picture, entered on its headers packet, when it has to be transcoded (`step` set) and/or
+// decoded into the slot's mosaic tile. the same secondary's following slices are read back-to-back
+// and fed to both decoders as they arrive; the transcoded result goes up as one JpegFrame. a
+// decoder that gives up stops being fed but the rest of the picture is still drained so the stream
+// stays aligned; a frame that does not belong to the picture ends it and is relayed as is.
+void relaySlicedPicture(int slot, const proto::FrameRef& ref, size_t total, const TranscodeStep* step, bool thumb) {
+  proto::JpegSliceView sv(ref.payload);
+  const uint8_t node = ref.node();
+  const uint16_t seq = ref.seq();
+  const uint32_t captureMs = sv.get<proto::JpegSliceHeader::CaptureMs>();
+  const uint16_t frameId = sv.get<proto::JpegSliceHeader::FrameId>();
+  const uint16_t intervals = sv.get<proto::JpegSliceHeader::TotalIntervals>();
+  const uint8_t* headers = ref.payload + proto::JpegSliceHeader::SIZE;
+  size_t inBytes = ref.length - proto::JpegSliceHeader::SIZE;
+
+  unsigned long cpuUs = 0;
+  bool transcoding = false;
+  if (step) {
+    unsigned long t0 = micros();
+    transcoding =
+        transcoder->begin(headers, inBytes, step->scale, step->quality, transcodeBuf, TRANSCODE_BUF_SIZE) ==
+        jpeg::Transcoder::Status::Ok;
+    cpuUs += micros() - t0;
+    // unsupported or too wide: this picture passes through
+    if (!transcoding) transcodeStats.fallbacks++;
+  }
+  bool thumbing = thumb && mosaic->beginTile(slot, *thumbDecoder, headers, inBytes);
+  const bool forwardRaw = !transcoding;
+  if (forwardRaw) relayUntouched(ref, total);
+  if (!transcoding && !thumbing) return;  // the rest of the picture relays frame by frame
+
+  uint16_t expected = 0;
+  bool complete = true;
+  while (expected < intervals) {
+    size_t n = readFrame(slot, true);
+    if (!n) {
+      complete = false;
+      break;
+    }
+    proto::FrameRef next;
+    proto::parseFrame(frameBuf, n, &next);
+    proto::JpegSliceView nv(next.payload);
+    if (next.type() != proto::MsgType::JpegSlice || (next.flags() & proto::FLAG_SLICE_HEADERS) ||
+        nv.get<proto::JpegSliceHeader::FrameId>() != frameId) {
+      relayUntouched(next, n);
+      complete = false;
+      break;
+    }
+    if (forwardRaw) relayUntouched(next, n);
+    uint16_t first = nv.get<proto::JpegSliceHeader::FirstInterval>();
+    uint16_t count = nv.get<proto::JpegSliceHeader::IntervalCount>();
+    const uint8_t* data = next.payload + proto::JpegSliceHeader::SIZE;
+    size_t len = next.length - proto::JpegSliceHeader::SIZE;
+    inBytes += len;
+    if (first != expected) {
+      transcoding = thumbing = false;  // a slice went missing on the secondary link
+    }
+    if (transcoding) {
+      unsigned long t0 = micros();
+      transcoding = transcoder->feed(data, len) == jpeg::Transcoder::Status::Ok;
+      cpuUs += micros() - t0;
+    }
+    if (thumbing) thumbing = thumbDecoder->feed(data, len) == ThumbDecoder::Status::Ok;
+    expected = uint16_t(first + count);
+  }
+
+  if (thumbing && complete && thumbDecoder->finish()) markTile(slot, node, seq);
+  if (!step || forwardRaw) return;
+
+  unsigned long t0 = micros();
+  size_t outLen = transcoding && complete ? transcoder->finish() : 0;
+  cpuUs += micros() - t0;
+  if (!outLen) {
+    transcodeStats.fallbacks++;
+    Serial.printf("Transcode of node %u picture %u failed (status %d), dropped\n", node, frameId,
+                  (int)transcoder->status());
+    return;
+  }
+  logTranscode(node, inBytes, outLen, cpuUs);
+  sendTranscoded(node, seq, captureMs, outLen);
+}
+
+// keeps the rssi and battery of the node's last heartbeat for the fleet summary
+void noteHeartbeat(int slot, const proto::FrameRef& ref) {
+  SlotState& st = slots[slot];
+  int32_t sample[telemetry::NF_COUNT];
+  if (st.heartbeat.decode(ref.payload, ref.length, sample) != telemetry::DecodeStatus::Ok) return;
+  st.rssiDbm = sample[telemetry::NF_RSSI_DBM];
+  st.batteryMv = sample[telemetry::NF_BATTERY_MV];
+}
+
+// relays one frame from a secondary, through the transcode stage when the governor asks for it
+// and into the mosaic when the slot's tile is due
+void relayFrame(int slot) {
+  size_t total = readFrame(slot, false);
+  if (!total) return;
+  proto::FrameRef ref;
+  proto::parseFrame(frameBuf, total, &ref);
+
+  if (ref.type() == proto::MsgType::Telemetry) {
+    noteHeartbeat(slot, ref);
+    if (FLEET_SUMMARY_ENABLED && !FLEET_FORWARD_TELEMETRY) return;
+  }
+
+  const TranscodeStep& step = TRANSCODE_STEPS[governor.level()];
+  const bool transcode = transcoder && step.quality && feedsForwarded();
+  const bool thumb = tileDue(slot);
+
+  if (ref.type() == proto::MsgType::JpegFrame) {
+    if (thumb) {
+      const uint8_t* jpegData = ref.payload + proto::JpegFrameHeader::SIZE;
+      if (mosaic->setTile(slot, *thumbDecoder, jpegData, ref.length - proto::JpegFrameHeader::SIZE)) {
+        markTile(slot, ref.node(), ref.seq());
+      }
+    }
+    if (transcode) {
+      transcodeJpegFrame(ref, total, step);
+      return;
+    }
+  } else if (ref.type() == proto::MsgType::JpegSlice && (ref.flags() & proto::FLAG_SLICE_HEADERS) &&
+             (transcode || thumb)) {
+    relaySlicedPicture(slot, ref, total, transcode ? &step : nullptr, thumb);
+    return;
+  }
+  relayUntouched(ref, total);
+}
+
+// encodes the mosaic every MOSAIC_PERIOD_MS; stale tiles are dimmed once and flagged in the tile table
+void sendMosaic() {
+  if (!mosaic || millis() - lastMosaicMs < MOSAIC_PERIOD_MS) return;
+  lastMosaicMs = millis();
+  if (!(laptopClient && laptopClient.connected())) return;
+
+  uint8_t prefix[proto::MosaicHeader::SIZE + MAX_CLIENTS * proto::MosaicTile::SIZE];
+  proto::writeMosaicHeader(prefix, lastMosaicMs, MosaicCanvas::WIDTH, MosaicCanvas::HEIGHT, 3, 2, MAX_CLIENTS);
+  int fresh = 0;
+  for (int i = 0; i < MAX_CLIENTS; ++i) {
+    TileInfo& t = tiles[i];
+    uint32_t age = t.filled ? lastMosaicMs - t.updatedMs : 0;
+    proto::TileState state = !t.filled ? proto::TileState::Empty
+                             : age > MOSAIC_STALE_MS ? proto::TileState::Stale
+                                                     : proto::TileState::Fresh;
+    if (state == proto::TileState::Stale && !t.dimmed) {
+      mosaic->dimTile(i);
+      t.dimmed = true;
+    }
+    if (state == proto::TileState::Fresh) ++fresh;
+    proto::writeMosaicTile(prefix + proto::MosaicHeader::SIZE + i * proto::MosaicTile::SIZE, t.node, state, t.seq, age);
+  }
+
+  unsigned long t0 = micros();
+  size_t len = mosaic->encode(MOSAIC_QUALITY, mosaicBuf, MOSAIC_BUF_SIZE);
+  unsigned long us = micros() - t0;
+  if (!len) {
+    Serial.println("Mosaic does not fit its buffer; skipped");
+    return;
+  }
+  sendFrame(proto::MsgType::Mosaic, PRIMARY_NODE_ID, mosaicSeq++, 0, prefix, sizeof(prefix), mosaicBuf, len);
+  Serial.printf("Mosaic %u bytes, %d/%d tiles fresh, encoded in %lu us\n", (unsigned)len, fresh, MAX_CLIENTS, us);
+}
+
+// sends the cached latest picture of `node` (or of every node) as stored, FLAG_CACHED set
+void serveCached(uint8_t node) {
+  if (!(laptopClient && laptopClient.connected())) return;
+  int served = 0;
+  for (int i = 0; i < frameCache.size(); ++i) {
+    const cache::Picture* p = frameCache.at(i);
+    if (!p || (node != proto::ALL_NODES && p->node != node)) continue;
+    uplinkWrite(p->frame, p->len);
+    ++served;
+    Serial.printf("Served cached picture of node %u (%u bytes, %lu ms old)\n", p->node, (unsigned)p->len,
+                  millis() - p->storedMs);
+  }
+  if (served) uplinkFlush();
+  else if (node != proto::ALL_NODES) Serial.printf("No cached picture for node %u\n", node);
+}
+
+void handleCommand(const proto::FrameRef& ref) {
+  proto::CommandView cv(ref.payload);
+  uint8_t op = cv.get<proto::CommandHeader::Op>();
+  if (op == uint8_t(proto::CommandOp::GetLatest)) {
+    serveCached(cv.get<proto::CommandHeader::Node>());
+  } else {
+    Serial.printf("Unknown command %u from base\n", op);
+  }
+}
+
+// commands from the base arrive as frames on the uplink socket. they are tiny, so a bad one just
+// drops whatever is buffered rather than hunting for the next magic.
+void pollCommands() {
+  if (!(laptopClient && laptopClient.connected())) return;
+  uint8_t buf[proto::frameSize(MAX_COMMAND_PAYLOAD)];
+  while (laptopClient.available() >= (int)proto::FrameHeader::SIZE) {
+    if (!readFully(laptopClient, buf, proto::FrameHeader::SIZE)) return;
+    proto::ParseStatus status = proto::parseHeader(buf, proto::FrameHeader::SIZE);
+    uint32_t len = proto::HeaderView(buf).get<proto::FrameHeader::Length>();
+    if (status == proto::ParseStatus::Ok && len > MAX_COMMAND_PAYLOAD) status = proto::ParseStatus::TooLarge;
+    proto::FrameRef ref;
+    if (status == proto::ParseStatus::Ok) {
+      if (!readFully(laptopClient, buf + proto::FrameHeader::SIZE, proto::frameSize(len) - proto::FrameHeader::SIZE)) return;
+      status = proto::parseFrame(buf, proto::frameSize(len), &ref);
+    }
+    if (status != proto::ParseStatus::Ok) {
+      Serial.printf("Bad frame from base (status %d), flushing\n", (int)status);
+      while (laptopClient.available() > 0) laptopClient.read();
+      return;
+    }
+    if (ref.type() == proto::MsgType::Command) handleCommand(ref);
+  }
+}
+
+// called every loop: lets the governor close its window and reports step changes
+void updateGovernor() {
+  if (!transcoder || !governor.tick(millis())) return;
+  const TranscodeStep& step = TRANSCODE_STEPS[governor.level()];
+  Serial.printf("Uplink utilisation %.2f: transcode step %u (scale 1/%u, quality %u)\n", governor.utilisation(),
+                governor.level(), step.scale, step.quality);
+  if (transcodeStats.pictures) {
+    Serial.printf("Transcode totals: %u pictures, %u fallbacks, %llu -> %llu bytes, avg %llu us\n",
+                  (unsigned)transcodeStats.pictures, (unsigned)transcodeStats.fallbacks,
+                  (unsigned long long)transcodeStats.bytesIn, (unsigned long long)transcodeStats.bytesOut,
+                  (unsigned long long)(transcodeStats.cpuUs / transcodeStats.pictures));
+  }
+}
+
+// samples every connected slot once per FLEET_SAMPLE_MS and sends whatever summary is due
+void updateFleet() {
+  if (!FLEET_SUMMARY_ENABLED) return;
+  unsigned long now = millis();
+  if (now - lastFleetSampleMs >= FLEET_SAMPLE_MS) {
+    unsigned long elapsed = now - lastFleetSampleMs;
+    lastFleetSampleMs = now;
+    for (int i = 0; i < MAX_CLIENTS; ++i) {
+      SlotState& st = slots[i];
+      if (!st.named || !(clients[i] && clients[i].connected())) continue;
+      int32_t rate = int32_t((st.pictures - st.lastPictures) * 10000UL / elapsed);
+      st.lastPictures = st.pictures;
+      st.fpsX10 += (rate - st.fpsX10) / 4;  // smoothed so one late picture is not a change
+      int32_t status[telemetry::FF_COUNT];
+      status[telemetry::FF_RSSI_DBM] = st.rssiDbm;
+      status[telemetry::FF_BATTERY_MV] = st.batteryMv;
+      status[telemetry::FF_FPS_X10] = st.fpsX10;
+      status[telemetry::FF_LAST_SEEN_S] = 0;
+      status[telemetry::FF_QUEUE_KB] = clients[i].available() / 1024;
+      status[telemetry::FF_CRC_ERRORS] = int32_t(st.crcErrors);
+      fleet.update(st.node, status, now);
+    }
+  }
+  if (!(laptopClient && laptopClient.connected())) return;
+  uint8_t flags = 0;
+  size_t len = fleet.poll(now, fleetBuf, sizeof(fleetBuf), &flags);
+  if (!len) return;
+  sendFrame(proto::MsgType::FleetSummary, PRIMARY_NODE_ID, fleetSeq++, flags, nullptr, 0, fleetBuf, len);
+  if (flags & proto::FLAG_FLEET_FULL) {
+    const telemetry::FleetStats& fs = fleet.stats();
+    Serial.printf("Fleet summary: %u summaries (%u for alerts), %u rows, %u bytes so far\n", (unsigned)fs.summaries,
+                  (unsigned)fs.alertSummaries, (unsigned)fs.rows, (unsigned)fs.bytes);
+  }
+}
+
 void loop() {
   // accept secondaries
   WiFiClient newClient = server.available();
@@ -108,6 +920,8 @@ void loop() {
     for (int i = 0; i < MAX_CLIENTS; ++i) {
       if (!clients[i] || !clients[i].connected()) {
         clients[i] = newClient;
+        dropCarry(i);  // whatever the last connection in the slot left
+        slots[i] = SlotState();
         Serial.print("Secondary in slot ");
         Serial.println(i);
         break;
@@ -116,24 +930,14 @@ void loop() {
   }
 
   tryConnectLaptop();
+  pollCommands();
+  updateGovernor();
+  updateFleet();
+  sendMosaic();
 
-  // relay data from secondaries to laptop
+  // relay frames from secondaries to laptop
   for (int i = 0; i < MAX_CLIENTS; ++i) {
-    if (clients[i] && clients[i].connected() && clients[i].available()) {
-      uint8_t buf[512];
-      int len = clients[i].read(buf, sizeof(buf));
-      if (len > 0) {
-        if (laptopClient && laptopClient.connected()) {
-          laptopClient.write(buf, len);
-          laptopClient.flush();
-          Serial.print("Relayed ");
-          Serial.print(len);
-          Serial.println(" bytes to laptop");
-        } else {
-          Serial.println("Laptop not connected; buffering not implemented (dropping packet)");
-        }
-      }
-    }
+    if (clients[i] && clients[i].connected()) relayFrame(i);
     if (clients[i] && !clients[i].connected()) clients[i].stop();
   }
 
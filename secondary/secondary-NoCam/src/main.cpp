@@ -1,6 +1,8 @@
 #include <Arduino.h>
 #include <WiFi.h>
 #include "esp_wifi.h"
+#include <swarm_proto.h>
+#include <node_telemetry.h>
 
 const char* AP_SSID = "ESP32_PRIMARY_AP";
 const char* AP_PASS = "esp32pass";
@@ -9,10 +11,20 @@ const uint16_t PRIMARY_PORT = 8000;
 
 // manual MAC for secondary (must differ from primary)
 uint8_t SECONDARY_MAC[] = {0x02, 0x66, 0x77, 0x88, 0x99, 0xAA};
+const uint8_t NODE_ID = 2; // must be unique per secondary
 
 WiFiClient client;
 
-uint8_t payload[] = {0xDE, 0xAD, 0xBE, 0xEF};
+// battery sense through a resistor divider; set BATTERY_ADC_PIN to -1 if the board has none
+const int BATTERY_ADC_PIN = 35;
+const float BATTERY_DIVIDER = 2.0f;
+
+const unsigned long TELEMETRY_PERIOD_MS = 1000;
+const uint16_t TELEMETRY_KEYFRAME_INTERVAL = 16; // late joiners resync within 16 samples
+
+// sample layout (fixed point): lib/telemetry/src/node_telemetry.h
+telemetry::Encoder<telemetry::NF_COUNT> telemetryEncoder(telemetry::NODE_MODES, TELEMETRY_KEYFRAME_INTERVAL);
+uint16_t frameSeq = 0;
 
 void setup() {
   Serial.begin(115200);
@@ -37,19 +49,48 @@ void setup() {
   }
 }
 
+void readTelemetry(int32_t (&sample)[telemetry::NF_COUNT]) {
+  sample[telemetry::NF_UPTIME_S] = int32_t(millis() / 1000);
+  sample[telemetry::NF_RSSI_DBM] = WiFi.RSSI();
+  sample[telemetry::NF_BATTERY_MV] =
+      BATTERY_ADC_PIN >= 0 ? int32_t(analogReadMilliVolts(BATTERY_ADC_PIN) * BATTERY_DIVIDER) : 0;
+  sample[telemetry::NF_TEMP_CENTI_C] = int32_t(temperatureRead() * 100.0f);
+  sample[telemetry::NF_FREE_HEAP] = int32_t(ESP.getFreeHeap());
+}
+
+void sendFrameToPrimary(const uint8_t* data, size_t len) {
+  // frame header, the encoded sample, then the crc trailer (see lib/swarm_proto)
+  uint8_t hdr[proto::FrameHeader::SIZE];
+  proto::writeHeader(hdr, proto::MsgType::Telemetry, NODE_ID, frameSeq++, uint32_t(len));
+  uint8_t trailer[proto::CRC_SIZE];
+  proto::writeTrailer(trailer, proto::frameCrc(hdr, data, len));
+  client.write(hdr, sizeof(hdr));
+  client.write(data, len);
+  client.write(trailer, sizeof(trailer));
+  client.flush();
+}
+
 void loop() {
   if (!client.connected()) {
     client.stop();
     if (client.connect(PRIMARY_IP, PRIMARY_PORT)) {
       Serial.println("Reconnected to primary");
+      telemetryEncoder.forceKeyframe(); // the stream restarts, so the receiver has no reference
     } else {
       delay(1000);
       return;
     }
   }
 
-  client.write(payload, sizeof(payload));
-  client.flush();
-  Serial.println("Sent payload");
-  delay(5000);
+  int32_t sample[telemetry::NF_COUNT];
+  readTelemetry(sample);
+  uint8_t encoded[telemetry::maxEncodedSize(telemetry::NF_COUNT)];
+  size_t len = telemetryEncoder.encode(sample, encoded, sizeof(encoded));
+  if (len > 0) {
+    sendFrameToPrimary(encoded, len);
+    Serial.print("Sent telemetry (");
+    Serial.print(len);
+    Serial.println(" bytes)");
+  }
+  delay(TELEMETRY_PERIOD_MS);
 }
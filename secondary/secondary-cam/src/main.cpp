@@ -3,6 +3,8 @@
 #include "esp_camera.h"
 #include <WiFi.h>
 #include "esp_wifi.h"
+#include <jpeg_slices.h>
+#include <swarm_proto.h>
 
 // camera model - AI_THINKER pinout used here; change if different board
 #define CAMERA_MODEL_AI_THINKER
@@ -34,6 +36,17 @@ const uint16_t PRIMARY_PORT = 8000;
 
 // manual MAC for secondary
 uint8_t SECONDARY_MAC[] = {0x02,0x66,0x77,0x88,0x99,0xAA};
+const uint8_t NODE_ID = 1; // must be unique per secondary
+
+uint16_t frameSeq = 0;
+
+// camera frames travel as restart-interval slices (JpegSlice) rather than one JpegFrame, so a
+// damaged or dropped packet loses a band of the picture instead of the whole frame. off: the
+// OV2640's JPEGs carry no restart interval (DRI), so each would go out as one slice anyway; turn
+// it on only with an encoder that writes DRI and RSTn markers
+const bool SEND_JPEG_SLICES = false;
+const size_t SLICE_TARGET_BYTES = 1400; // group intervals into packets of about one MTU
+uint16_t jpegFrameId = 0;
 
 WiFiClient client;
 
@@ -107,16 +120,71 @@ void setup() {
   }
 }
 
-void sendFrameToPrimary(const uint8_t* data, size_t len) {
-  // send 4-byte big-endian length then bytes
-  uint8_t hdr[4];
-  hdr[0] = (len >> 24) & 0xFF;
-  hdr[1] = (len >> 16) & 0xFF;
-  hdr[2] = (len >> 8) & 0xFF;
-  hdr[3] = (len) & 0xFF;
-  if (!client.connected()) return;
-  client.write(hdr, 4);
+// writes one protocol frame: header, a fixed message prefix, data, crc trailer (see lib/swarm_proto)
+void writeFrame(proto::MsgType type, uint8_t flags, const uint8_t* prefix, size_t prefixLen,
+                const uint8_t* data, size_t len) {
+  uint8_t hdr[proto::FrameHeader::SIZE];
+  proto::writeHeader(hdr, type, NODE_ID, frameSeq++, uint32_t(prefixLen + len), flags);
+  uint32_t crc = proto::crc32Update(proto::crc32Update(proto::crc32(hdr, sizeof(hdr)), prefix, prefixLen), data, len);
+  uint8_t trailer[proto::CRC_SIZE];
+  proto::writeTrailer(trailer, crc);
+  client.write(hdr, sizeof(hdr));
+  client.write(prefix, prefixLen);
   client.write(data, len);
+  client.write(trailer, sizeof(trailer));
+}
+
+void sendFrameToPrimary(const uint8_t* data, size_t len, uint32_t captureMs, uint16_t width, uint16_t height) {
+  uint8_t jh[proto::JpegFrameHeader::SIZE];
+  proto::writeJpegHeader(jh, captureMs, width, height);
+  if (!client.connected()) return;
+  writeFrame(proto::MsgType::JpegFrame, 0, jh, sizeof(jh), data, len);
+  client.flush();
+}
+
+// sends the jpeg as its headers plus packets of whole restart intervals, so a lost packet costs
+// only the rows it carries. falls back to a single JpegFrame if the headers cannot be parsed.
+void sendSlicesToPrimary(const uint8_t* data, size_t len, uint32_t captureMs, uint16_t width, uint16_t height) {
+  jpeg::ScanInfo scan;
+  if (!jpeg::parseHeaders(data, len, &scan)) {
+    sendFrameToPrimary(data, len, captureMs, width, height);
+    return;
+  }
+  static bool warned = false;
+  if (scan.restartInterval == 0 && !warned) {
+    Serial.println("Camera JPEG has no restart interval; each frame travels as one slice");
+    warned = true;
+  }
+  if (!client.connected()) return;
+
+  uint16_t total = jpeg::countIntervals(data, scan);
+  uint16_t frameId = jpegFrameId++;
+  uint8_t sh[proto::JpegSliceHeader::SIZE];
+  proto::writeJpegSliceHeader(sh, captureMs, frameId, width, height, 0, 0, total);
+  writeFrame(proto::MsgType::JpegSlice, proto::FLAG_SLICE_HEADERS, sh, sizeof(sh), data, scan.headerLen);
+
+  // each packet is [start of its first interval, end of its last interval), rst markers included
+  jpeg::IntervalIterator it(data, scan);
+  size_t start, end, pktStart = 0, pktEnd = 0;
+  uint16_t index = 0, first = 0, count = 0;
+  auto flushPacket = [&]() {
+    proto::writeJpegSliceHeader(sh, captureMs, frameId, width, height, first, count, total);
+    writeFrame(proto::MsgType::JpegSlice, 0, sh, sizeof(sh), data + pktStart, pktEnd - pktStart);
+  };
+  while (it.next(&start, &end)) {
+    if (count > 0 && end - pktStart > SLICE_TARGET_BYTES) {
+      flushPacket();
+      count = 0;
+    }
+    if (count == 0) {
+      pktStart = start;
+      first = index;
+    }
+    pktEnd = end;
+    ++count;
+    ++index;
+  }
+  if (count > 0) flushPacket();
   client.flush();
 }
 
@@ -138,15 +206,18 @@ void loop() {
     return;
   }
 
+  uint32_t captureMs = millis();
+
   // fb may already be JPEG
   if (fb->format == PIXFORMAT_JPEG) {
-    if (client.connected()) sendFrameToPrimary(fb->buf, fb->len);
+    if (SEND_JPEG_SLICES) sendSlicesToPrimary(fb->buf, fb->len, captureMs, fb->width, fb->height);
+    else sendFrameToPrimary(fb->buf, fb->len, captureMs, fb->width, fb->height);
   } else {
     // convert to jpeg if not already (rare with config above)
     uint8_t * jpg = NULL;
     size_t jpglen = 0;
     if (frame2jpg(fb, 80, &jpg, &jpglen)) {
-      if (client.connected()) sendFrameToPrimary(jpg, jpglen);
+      sendFrameToPrimary(jpg, jpglen, captureMs, fb->width, fb->height);
       free(jpg);
     }
   }
@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+# batch.py - headless Monte Carlo sweeps of the coverage simulator (sim_engine.py)
+#
+# every combination of the parameter lists is run once per seed, spread over a process pool (one
+# worker per core by default). a seed fixes the obstacle layout, so all combinations of one seed
+# search the same map. one row per run goes to --out (.csv, or .parquet with pyarrow installed):
+# the parameters, ticks to reach each --reach percentage of the free area searched (empty if never
+# reached), the searched fraction and mean coverage level at the end, revisit counts and gaps,
+# drones stuck on obstacles at the end (stuck) and places drones got stuck at on the way (blocked).
+# the mean over seeds of each combination is printed.
+# with --comms the radio is modelled too (comms.py): a cell only counts once its pictures reach the
+# base through primaries placed for each epoch, and each row also gets ticks to each percentage
+# delivered, the delivered fraction, the queued backlog and detection-to-base latency.
+#
+#   python3 batch.py --swarm 1 5 --radius 1 5 --seeds 20 --out sweep.csv
+#   python3 batch.py --swarm 2 4 8 --speed 1 2 4 --obstacles 0 5 15 --decay 0.01 0.02 --ticks 600
+#   python3 batch.py --planner strips frontier-greedy frontier --swarm 4 --radius 3 --obstacles 0 10 20 40 --reach 95 --ticks 2000
+#   python3 batch.py --comms --max-relays 4 --swarm 2 5 10 --radio 15 30 --rates 8 24 48 --seeds 20
+
+import argparse
+import csv
+import itertools
+import multiprocessing as mp
+import os
+import random
+import sys
+import time
+from collections import defaultdict
+
+from comms import Comms
+from sim_engine import DECAY_RATE, GRID_SIZE, PLANNERS, Simulation, generate_obstacles
+
+PARAMS = ("swarm", "speed", "radius", "obstacles", "decay", "planner")
+
+
+def run_one(task):
+    """(params, seed, grid, ticks, reach, comms) -> one csv row. comms: Comms keywords, or None"""
+    params, seed, grid, ticks, reach, comms = task
+    t0 = time.process_time()
+    obstacles = generate_obstacles(grid, params["obstacles"], random.Random(seed))
+    sim = Simulation(obstacles, params["swarm"], params["speed"], params["radius"], params["decay"],
+                     planner=params["planner"])
+    if comms is not None:
+        radio = Comms(sim, rng=random.Random(f"targets{seed}"), **comms).run(ticks, [r / 100 for r in reach])
+    else:
+        sim.run(ticks, [r / 100 for r in reach])
+    row = dict(params, seed=seed, grid=grid)
+    for r in reach:
+        row[f"ticks_to_{r}"] = sim.reached.get(r / 100)
+    row.update(sim.stats())
+    if comms is not None:
+        for r in reach:
+            row[f"delivered_to_{r}"] = radio.reached.get(r / 100)
+        row.update(radio.stats())
+    row["cpu_s"] = round(time.process_time() - t0, 3)
+    return row
+
+
+def parquet():
+    try:
+        import pyarrow as pa
+        import pyarrow.parquet as pq
+    except ImportError:
+        sys.exit("parquet output needs pyarrow (pip install pyarrow); or write .csv")
+    return pa, pq
+
+
+def write_rows(path, rows):
+    if path.endswith(".parquet"):
+        pa, pq = parquet()
+        pq.write_table(pa.Table.from_pylist(rows), path)
+        return
+    with open(path, "w", newline="") as f:
+        w = csv.DictWriter(f, fieldnames=list(rows[0]))
+        w.writeheader()
+        w.writerows(rows)
+
+
+def reached(runs, key):
+    """mean ticks over the runs that got there, and how many did"""
+    hit = [x[key] for x in runs if x[key] is not None]
+    return f"{sum(hit) / len(hit):.0f}/{len(hit)}" if hit else "-/0"
+
+
+def summarize(rows, reach):
+    groups = defaultdict(list)
+    for row in rows:
+        groups[tuple(row[p] for p in PARAMS)].append(row)
+    comms = "delivered" in rows[0]
+    cols = [f"t{r}%" for r in reach] + ["searched", "coverage", "revisits", "gap", "stuck", "blocked"]
+    if comms:
+        cols += [f"d{r}%" for r in reach] + ["delivered", "latency", "lat95"]
+    print(" ".join(f"{p:>9}" for p in PARAMS) + " " + " ".join(f"{c:>9}" for c in cols))
+    for key, runs in sorted(groups.items()):
+        cells = [reached(runs, f"ticks_to_{r}") for r in reach]
+        gaps = [x["revisit_gap_mean"] for x in runs if x["revisit_gap_mean"] is not None]
+        cells += [f"{sum(x['searched'] for x in runs) / len(runs):.3f}",
+                  f"{sum(x['mean_coverage'] for x in runs) / len(runs):.3f}",
+                  f"{sum(x['revisits'] for x in runs) / len(runs):.0f}",
+                  f"{sum(gaps) / len(gaps):.1f}" if gaps else "-",
+                  f"{sum(x['stuck'] for x in runs) / len(runs):.1f}",
+                  f"{sum(x['blocked'] for x in runs) / len(runs):.1f}"]
+        if comms:
+            cells += [reached(runs, f"delivered_to_{r}") for r in reach]
+            lat = [x["latency_mean"] for x in runs if x["latency_mean"] is not None]
+            p95 = [x["latency_p95"] for x in runs if x["latency_p95"] is not None]
+            cells += [f"{sum(x['delivered'] for x in runs) / len(runs):.3f}",
+                      f"{sum(lat) / len(lat):.1f}" if lat else "-",
+                      f"{sum(p95) / len(p95):.1f}" if p95 else "-"]
+        print(" ".join(f"{v:>9}" for v in key) + " " + " ".join(f"{c:>9}" for c in cells))
+
+
+def main():
+    p = argparse.ArgumentParser(description="Headless coverage simulation sweep")
+    p.add_argument("--swarm", type=int, nargs="+", default=[1, 5], help="drones per run")
+    p.add_argument("--speed", type=int, nargs="+", default=[2], help="cells per tick")
+    p.add_argument("--radius", type=int, nargs="+", default=[1], help="search_area of each drone")
+    p.add_argument("--obstacles", type=int, nargs="+", default=[5], help="random obstacle blocks")
+    p.add_argument("--decay", type=float, nargs="+", default=[DECAY_RATE], help="DECAY_RATE values")
+    p.add_argument("--planner", nargs="+", default=["strips"], choices=PLANNERS, help="how drones pick where to go")
+    p.add_argument("--seeds", type=int, default=10, help="runs per combination")
+    p.add_argument("--first-seed", type=int, default=0)
+    p.add_argument("--ticks", type=int, default=400)
+    p.add_argument("--grid", type=int, default=GRID_SIZE)
+    p.add_argument("--reach", type=int, nargs="+", default=[50, 90, 95], metavar="PERCENT",
+                   help="searched percentages to time")
+    p.add_argument("--comms", action="store_true", help="model the radio links to the base (comms.py)")
+    p.add_argument("--radio", type=float, nargs=2, default=[15, 30], metavar=("REACH", "LINK"),
+                   help="drone to primary and primary to primary range, cells")
+    p.add_argument("--rates", type=float, nargs=3, default=[8, 24, 48], metavar=("DRONE", "RELAY", "LINK"),
+                   help="cells a tick a drone sends, a primary takes in, a link up to the base carries")
+    p.add_argument("--max-relays", type=int, default=None, help="primaries each epoch, default: as many as it takes")
+    p.add_argument("--hop-ticks", type=int, default=1)
+    p.add_argument("--epoch", type=int, default=25, help="ticks the primaries stay put")
+    p.add_argument("--targets", type=int, default=20, help="random cells to detect")
+    p.add_argument("--workers", type=int, default=os.cpu_count())
+    p.add_argument("--out", default="sweep.csv", help=".csv or .parquet")
+    args = p.parse_args()
+    if args.out.endswith(".parquet"):
+        parquet()  # fail before the runs, not after
+
+    combos = [dict(zip(PARAMS, values)) for values in
+              itertools.product(args.swarm, args.speed, args.radius, args.obstacles, args.decay, args.planner)]
+    comms = None
+    if args.comms:
+        comms = dict(reach=args.radio[0], link=args.radio[1], rate=args.rates[0], relay_rate=args.rates[1],
+                     link_rate=args.rates[2], hop_ticks=args.hop_ticks, epoch=args.epoch,
+                     max_relays=args.max_relays, targets=args.targets)
+    tasks = [(params, seed, args.grid, args.ticks, args.reach, comms)
+             for params in combos for seed in range(args.first_seed, args.first_seed + args.seeds)]
+    print(f"{len(tasks)} runs ({len(combos)} combinations x {args.seeds} seeds) on {args.workers} workers")
+    t0 = time.perf_counter()
+    if args.workers > 1:
+        with mp.Pool(args.workers) as pool:
+            rows = pool.map(run_one, tasks, chunksize=max(1, len(tasks) // (4 * args.workers)))
+    else:
+        rows = [run_one(t) for t in tasks]
+    wall = time.perf_counter() - t0
+    cpu = sum(r["cpu_s"] for r in rows)
+    write_rows(args.out, rows)
+    summarize(rows, args.reach)
+    print(f"{wall:.1f} s wall, {cpu:.1f} s of runs ({cpu / wall:.1f}x), {len(rows) / wall:.1f} runs/s -> {args.out}")
+
+
+if __name__ == "__main__":
+    main()
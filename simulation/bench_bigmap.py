@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+# bench_bigmap.py - memory and tick cost of a big map (16k x 16k cells by default)
+#
+# the obstacles are generated straight into the bit-packed form, so no bool per cell ever exists.
+# resident memory (VmRSS) is read before the map is made, after, and after `--ticks` ticks of
+# strip search: the uint16 last_seen only takes pages where drones have been. what the map would
+# have needed laid out the old way (int32 last-searched tick, a bool free mask, a bool obstacle
+# copy and the caller's bool map: 7 bytes a cell, all allocated up front) is printed alongside.
+# with --backing the map is memory-mapped to that file; its size on disk is reported too.
+#
+#   python3 bench_bigmap.py
+#   python3 bench_bigmap.py --grid 16384 --drones 64 --ticks 2000 --backing /tmp/map.u16
+
+import argparse
+import os
+import random
+import time
+
+from sim_engine import DECAY_RATE, Simulation, generate_obstacles
+
+MB = 1 << 20
+
+
+def rss():
+    with open("/proc/self/status") as f:
+        for line in f:
+            if line.startswith("VmRSS:"):
+                return int(line.split()[1]) * 1024
+    return 0
+
+
+def main():
+    p = argparse.ArgumentParser(description="Big map memory and step benchmark")
+    p.add_argument("--grid", type=int, default=16384)
+    p.add_argument("--drones", type=int, default=64)
+    p.add_argument("--radius", type=int, default=5)
+    p.add_argument("--speed", type=int, default=2)
+    p.add_argument("--decay", type=float, default=DECAY_RATE)
+    p.add_argument("--obstacles", type=int, default=None, help="default: one per 2500 cells")
+    p.add_argument("--ticks", type=int, default=2000)
+    p.add_argument("--seed", type=int, default=1)
+    p.add_argument("--backing", default=None, help="memory-map the map to this file")
+    args = p.parse_args()
+    n = args.grid
+    count = args.obstacles if args.obstacles is not None else n * n // 2500
+
+    base = rss()
+    t0 = time.perf_counter()
+    obstacles = generate_obstacles(n, count, random.Random(args.seed), packed=True)
+    sim = Simulation(obstacles, args.drones, args.speed, args.radius, args.decay, backing=args.backing)
+    made_s = time.perf_counter() - t0
+    made = rss() - base
+    env = sim.env
+    print(f"{n}^2 map, {count} obstacles, {args.drones} drones, radius {args.radius}")
+    print(f"old layout:      {7 * n * n / MB:9.0f} MB allocated up front")
+    print(f"obstacle bits:   {env._blocked.nbytes / MB:9.1f} MB")
+    print(f"last_seen:       {env._last_seen.nbytes / MB:9.0f} MB reserved, uint16")
+    print(f"resident, made:  {made / MB:9.1f} MB  ({made_s:.1f} s)")
+
+    t0 = time.perf_counter()
+    sim.run(args.ticks)
+    tick_s = (time.perf_counter() - t0) / args.ticks
+    ran = rss() - base
+    print(f"resident, {args.ticks} ticks: {ran / MB:6.1f} MB  ({sim.searched_fraction() * 100:.2f}% of the map searched)")
+    print(f"step: {tick_s * 1e3:.3f} ms per tick, {tick_s / args.drones * 1e9:.0f} ns per drone-step")
+    if args.backing:
+        env._last_seen.flush()
+        st = os.stat(args.backing)
+        print(f"backing file:    {st.st_size / MB:9.0f} MB long, {st.st_blocks * 512 / MB:.1f} MB on disk")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+# bench_decay.py - cost of a simulation tick with eager vs lazy coverage decay on a big map
+#
+# eager is how the simulator used to fade coverage: a float level per cell, every one of them
+# lowered by DECAY_RATE each tick, and summed for the mean coverage statistic. lazy is
+# Environment: only the tick each cell was last searched is stored, levels follow from it when
+# asked for, and the sum comes from per-tick counts. both stamp the same strip-search drones with
+# the same block copies, so the difference is the decay alone. the final coverage of both must
+# agree, and one on-demand coverage (what drawing a frame costs) is timed too.
+#
+#   python3 bench_decay.py --grid 4096 --drones 64
+#   python3 bench_decay.py --grid 1024 --drones 16 --ticks 500
+
+import argparse
+import random
+import time
+
+import numpy as np
+from numpy.lib.stride_tricks import sliding_window_view
+
+from sim_engine import DECAY_RATE, Environment, create_drones, generate_obstacles
+
+
+class EagerCoverage:
+    """the old way: a level per cell, all of them rewritten each tick"""
+
+    def __init__(self, obstacles, radius, decay_rate):
+        n, p = obstacles.shape[0], radius
+        self.decay_rate = decay_rate
+        self.padded = np.zeros((n + 2 * p,) * 2)
+        free = np.zeros(self.padded.shape)
+        free[p:p + n, p:p + n] = ~obstacles
+        k = 2 * radius + 1
+        self.windows = sliding_window_view(self.padded, (k, k), writeable=True)
+        self.free = sliding_window_view(free, (k, k))
+        self.coverage = self.padded[p:p + n, p:p + n]
+
+    def tick(self, xs, ys):
+        np.subtract(self.padded, self.decay_rate, out=self.padded)
+        np.maximum(self.padded, 0, out=self.padded)
+        y0, x0 = np.asarray(ys), np.asarray(xs)
+        self.windows[y0, x0] = self.free[y0, x0]
+        return float(self.coverage.sum())
+
+
+def run(obstacles, args, lazy):
+    env = Environment(args.grid, obstacles, args.decay, reach=args.radius)
+    drones = create_drones(env, args.drones, args.speed, args.radius)
+    eager = None if lazy else EagerCoverage(obstacles, args.radius, args.decay)
+    t0 = time.perf_counter()
+    for _ in range(args.ticks):
+        xs, ys = [d.x for d in drones], [d.y for d in drones]
+        if lazy:
+            env.decay()
+            env.stamp(xs, ys, args.radius)
+            env.coverage_sum()
+        else:
+            eager.tick(xs, ys)
+        for d in drones:
+            d.move()
+    elapsed = time.perf_counter() - t0
+    return (env if lazy else eager), elapsed
+
+
+def main():
+    p = argparse.ArgumentParser(description="Eager vs lazy coverage decay benchmark")
+    p.add_argument("--grid", type=int, default=4096)
+    p.add_argument("--drones", type=int, default=64)
+    p.add_argument("--radius", type=int, default=5)
+    p.add_argument("--speed", type=int, default=2)
+    p.add_argument("--decay", type=float, default=DECAY_RATE)
+    p.add_argument("--obstacles", type=int, default=2000)
+    p.add_argument("--ticks", type=int, default=100)
+    p.add_argument("--seed", type=int, default=1)
+    args = p.parse_args()
+
+    obstacles = generate_obstacles(args.grid, args.obstacles, random.Random(args.seed))
+    print(f"{args.grid}^2 grid, {args.drones} drones, radius {args.radius}, decay {args.decay}, {args.ticks} ticks")
+    eager, eager_s = run(obstacles, args, False)
+    env, lazy_s = run(obstacles, args, True)
+    t0 = time.perf_counter()
+    coverage = env.coverage
+    render_s = time.perf_counter() - t0
+    if not np.allclose(coverage, eager.coverage, atol=1e-9):
+        raise SystemExit("lazy coverage differs from eager")
+    if abs(env.coverage_sum() - eager.coverage.sum()) > 1e-6 * max(1.0, eager.coverage.sum()):
+        raise SystemExit("lazy coverage sum differs from eager")
+    ms = lambda s: s / args.ticks * 1e3
+    print(f"eager: {ms(eager_s):8.3f} ms per tick")
+    print(f"lazy:  {ms(lazy_s):8.3f} ms per tick  ({eager_s / lazy_s:.0f}x)")
+    print(f"coverage on demand (one frame drawn): {render_s * 1e3:.1f} ms")
+
+
+if __name__ == "__main__":
+    main()
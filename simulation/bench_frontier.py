@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+# bench_frontier.py - cost of keeping the frontier up to date, incrementally vs rescanning the map
+#
+# `--drones` frontier-planner drones search a `--grid` map. every tick the planner recomputes the
+# frontier only around the squares just stamped (FrontierPlanner.update); the alternative is to
+# work it out for the whole map from last_seen and the obstacles, which is timed here on the same
+# states every `--check` ticks. both must give the same frontier and tile counts. the drones move
+# greedily (frontier-greedy): the distance-field planner drops frontier it finds out of reach,
+# which a rescan would bring back. the whole step (update, assignment, moves) is reported as well.
+#
+#   python3 bench_frontier.py --grid 1024 --drones 16
+#   python3 bench_frontier.py --grid 4096 --drones 64 --radius 5 --ticks 500
+
+import argparse
+import random
+import time
+
+import numpy as np
+
+from planner import TILE
+from sim_engine import DECAY_RATE, Simulation, generate_obstacles
+
+
+def rescan(env, ntiles):
+    """the frontier of the whole map, and its per-tile counts, from scratch"""
+    seen = env._last_seen != 0
+    near = np.zeros_like(seen)
+    near[1:] |= seen[:-1]
+    near[:-1] |= seen[1:]
+    near[:, 1:] |= seen[:, :-1]
+    near[:, :-1] |= seen[:, 1:]
+    side = len(seen)
+    blocked = np.unpackbits(env._blocked, axis=1, count=side, bitorder="little").view(bool)
+    frontier = np.zeros((ntiles * TILE,) * 2, np.uint8)
+    frontier[:side, :side] = near > (seen | blocked)
+    return frontier, frontier.reshape(ntiles, TILE, ntiles, TILE).sum(axis=(1, 3))
+
+
+def main():
+    p = argparse.ArgumentParser(description="Incremental frontier vs full rescan benchmark")
+    p.add_argument("--grid", type=int, default=1024)
+    p.add_argument("--drones", type=int, default=16)
+    p.add_argument("--radius", type=int, default=3)
+    p.add_argument("--speed", type=int, default=2)
+    p.add_argument("--obstacles", type=int, default=None, help="default: one per 1000 cells")
+    p.add_argument("--ticks", type=int, default=300)
+    p.add_argument("--check", type=int, default=50, help="rescan and compare every this many ticks")
+    p.add_argument("--seed", type=int, default=1)
+    args = p.parse_args()
+    count = args.obstacles if args.obstacles is not None else args.grid ** 2 // 1000
+
+    obstacles = generate_obstacles(args.grid, count, random.Random(args.seed))
+    sim = Simulation(obstacles, args.drones, args.speed, args.radius, DECAY_RATE, planner="frontier-greedy")
+    env, planner = sim.env, sim.planner
+    update = planner.update
+    update_s = [0.0]
+
+    def timed(xs, ys):
+        t0 = time.perf_counter()
+        update(xs, ys)
+        update_s[0] += time.perf_counter() - t0
+    planner.update = timed
+
+    step_s = rescan_s = 0.0
+    rescans = 0
+    for t in range(1, args.ticks + 1):
+        t0 = time.perf_counter()
+        sim.step()
+        step_s += time.perf_counter() - t0
+        if t % args.check == 0:
+            t0 = time.perf_counter()
+            frontier, counts = rescan(env, planner.ntiles)
+            rescan_s += time.perf_counter() - t0
+            rescans += 1
+            if not np.array_equal(frontier, planner.frontier) or not np.array_equal(counts, planner.counts):
+                raise SystemExit(f"incremental frontier differs from a rescan at tick {t}")
+    ms = lambda s, n: s / n * 1e3
+    print(f"{args.grid}^2 grid, {count} obstacles, {args.drones} drones, radius {args.radius}, {args.ticks} ticks "
+          f"({sim.searched_fraction() * 100:.1f}% searched, {int(planner.counts.sum())} frontier cells)")
+    print(f"frontier update: {ms(update_s[0], args.ticks):8.3f} ms per tick")
+    print(f"full rescan:     {ms(rescan_s, rescans):8.3f} ms per tick  ({rescan_s / rescans / update_s[0] * args.ticks:.0f}x)")
+    print(f"simulation step: {ms(step_s, args.ticks):8.3f} ms per tick (stamp, frontier, assignment, greedy moves)")
+
+
+if __name__ == "__main__":
+    main()
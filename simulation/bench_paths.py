@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+# bench_paths.py - distance-field paths for frontier drones: their cost, and obstacles changing
+#
+# `--drones` frontier-planner drones search a `--grid` map, moving along distance fields (a BFS
+# wave from the frontier of each target tile, see planner.py). reported: how many fields were worked out and what one
+# costs, the planner's share of a tick, and blocked / out-of-reach counts next to greedy moves on the
+# same map. every `--change` ticks a `--block` sized obstacle is dropped just ahead of a random
+# drone; only the fields it touches are redone. every kept field is checked against a fresh wave
+# in its window: the cells it leads the drone over must have the same distances.
+#
+#   python3 bench_paths.py --grid 1024 --drones 16
+#   python3 bench_paths.py --grid 256 --drones 8 --obstacles 200 --change 5
+
+import argparse
+import random
+import time
+
+import numpy as np
+
+import planner as planner_module
+from planner import UNREACHED, distances
+from sim_engine import DECAY_RATE, Simulation, generate_obstacles
+
+
+def check_kept(planner, env):
+    """each kept field against a fresh wave from the same sources in the same window, on the cells
+    nearer than its drone"""
+    kept = 0
+    for d, path in zip(planner.drones, planner.paths):
+        if path is None:
+            continue
+        _, oy, ox, dist = path
+        h, w = dist.shape
+        bits = np.unpackbits(env._blocked[oy:oy + h, ox >> 3:(ox + w + 7) >> 3], axis=1, bitorder="little")
+        free = bits[:, ox & 7:(ox & 7) + w] == 0
+        free[[0, -1]] = free[:, [0, -1]] = False
+        goal = d.y + env._pad - oy, d.x + env._pad - ox
+        free[goal] = True
+        fresh = distances(free, dist == 0, goal)
+        here = dist[goal]
+        if fresh[goal] == UNREACHED or not np.array_equal(np.where(dist <= here, dist, UNREACHED),
+                                               np.where(fresh <= here, fresh, UNREACHED)):
+            raise SystemExit("a kept distance field no longer matches the obstacles")
+        kept += 1
+    return kept
+
+
+def run(obstacles, args, planner, change):
+    sim = Simulation(obstacles, args.drones, args.speed, args.radius, DECAY_RATE, planner=planner)
+    rng = random.Random(args.seed)
+    field_s = [0.0]
+    real = planner_module.distances
+
+    def timed(*a):
+        t0 = time.perf_counter()
+        out = real(*a)
+        field_s[0] += time.perf_counter() - t0
+        return out
+    planner_module.distances = timed
+    changes = dropped = kept = 0
+    t0 = time.perf_counter()
+    try:
+        for t in range(1, args.ticks + 1):
+            sim.step()
+            if change and t % change == 0:
+                d = rng.choice(sim.drones)
+                fields = sum(p is not None for p in sim.planner.paths)
+                y, x = d.y + rng.randint(2, 6), d.x + rng.randint(-3, 3)
+                sim.set_obstacles(y, y + args.block, x, x + args.block)
+                changes += 1
+                dropped += fields - sum(p is not None for p in sim.planner.paths)
+                kept += check_kept(sim.planner, sim.env)
+    finally:
+        planner_module.distances = real
+    return sim, time.perf_counter() - t0, field_s[0], changes, dropped, kept
+
+
+def main():
+    p = argparse.ArgumentParser(description="Distance-field path benchmark")
+    p.add_argument("--grid", type=int, default=1024)
+    p.add_argument("--drones", type=int, default=16)
+    p.add_argument("--radius", type=int, default=3)
+    p.add_argument("--speed", type=int, default=2)
+    p.add_argument("--obstacles", type=int, default=None, help="default: one per 400 cells")
+    p.add_argument("--ticks", type=int, default=1000)
+    p.add_argument("--change", type=int, default=20, help="drop an obstacle every this many ticks, 0: never")
+    p.add_argument("--block", type=int, default=6, help="side of a dropped obstacle")
+    p.add_argument("--seed", type=int, default=1)
+    args = p.parse_args()
+    count = args.obstacles if args.obstacles is not None else args.grid ** 2 // 400
+
+    obstacles = generate_obstacles(args.grid, count, random.Random(args.seed))
+    print(f"{args.grid}^2 grid, {count} obstacles, {args.drones} drones, radius {args.radius}, {args.ticks} ticks")
+    for planner in ("frontier-greedy", "frontier"):
+        sim, run_s, field_s, changes, dropped, kept = run(obstacles, args, planner, 0)
+        pl = sim.planner
+        print(f"{planner:>15}: {sim.searched_fraction() * 100:5.1f}% searched, {pl.blocked} blocked, "
+              f"{pl.unreachable} out of reach, {run_s / args.ticks * 1e3:.2f} ms per tick")
+    print(f"distance fields: {pl.fields} worked out, {field_s / max(1, pl.fields) * 1e3:.3f} ms each, "
+          f"{field_s / run_s * 100:.0f}% of the run")
+    if args.change:
+        sim, run_s, field_s, changes, dropped, kept = run(obstacles, args, "frontier", args.change)
+        print(f"obstacles dropped {changes} times: {dropped} fields redone, {kept} kept and checked; "
+              f"{sim.searched_fraction() * 100:.1f}% searched, {sim.planner.blocked} blocked")
+
+
+if __name__ == "__main__":
+    main()
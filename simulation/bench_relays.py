@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+# bench_relays.py - runtime and result of the primary (relay) placement for growing swarms
+#
+# for each `--swarm` size the search drones fly `--ticks` ticks of `--planner` search on a `--grid`
+# map, and relays.plan() places primaries every `--epoch` ticks for the positions of that stretch.
+# reported: primaries per epoch, the fraction of drone-ticks that reach the base through them, and
+# the time placement and the connectivity check take per epoch. the check (GridIndex link queries)
+# is also done by brute force, every position against every primary: both must agree. with
+# --max-relays the same runs are made under that budget.
+#
+#   python3 bench_relays.py --grid 1024 --swarm 16 64 256 512
+#   python3 bench_relays.py --grid 512 --swarm 64 --reach 15 --link 30 --max-relays 20
+
+import argparse
+import random
+import time
+
+import numpy as np
+
+from relays import connected, place, record
+from sim_engine import DECAY_RATE, PLANNERS, Simulation, generate_obstacles
+
+
+def brute_connected(xs, ys, rx, ry, reach, link, base):
+    nx, ny = np.concatenate([[base[0]], rx]), np.concatenate([[base[1]], ry])
+    adj = np.hypot(nx[:, None] - nx, ny[:, None] - ny) <= link
+    linked = np.zeros(len(nx), bool)
+    linked[0] = True
+    while True:
+        grown = linked | adj[linked].any(axis=0)
+        if (grown == linked).all():
+            break
+        linked = grown
+    px, py = np.ravel(xs).astype(float), np.ravel(ys).astype(float)
+    return (np.hypot(px[:, None] - nx[linked], py[:, None] - ny[linked]) <= reach).any(axis=1)
+
+
+def main():
+    p = argparse.ArgumentParser(description="Relay placement benchmark")
+    p.add_argument("--grid", type=int, default=1024)
+    p.add_argument("--swarm", type=int, nargs="+", default=[16, 64, 256, 512])
+    p.add_argument("--planner", default="frontier", choices=PLANNERS)
+    p.add_argument("--radius", type=int, default=3)
+    p.add_argument("--speed", type=int, default=2)
+    p.add_argument("--obstacles", type=int, default=None, help="default: one per 1000 cells")
+    p.add_argument("--ticks", type=int, default=400)
+    p.add_argument("--epoch", type=int, default=25, help="ticks one placement serves")
+    p.add_argument("--reach", type=float, default=20, help="search drone to primary range, cells")
+    p.add_argument("--link", type=float, default=40, help="primary to primary (and base) range, cells")
+    p.add_argument("--base", type=int, nargs=2, default=None, metavar=("X", "Y"), help="default: middle of the top edge")
+    p.add_argument("--max-relays", type=int, default=None)
+    p.add_argument("--seed", type=int, default=1)
+    args = p.parse_args()
+    count = args.obstacles if args.obstacles is not None else args.grid ** 2 // 1000
+    base = tuple(args.base) if args.base else (args.grid // 2, 0)
+
+    obstacles = generate_obstacles(args.grid, count, random.Random(args.seed))
+    print(f"{args.grid}^2 grid, {count} obstacles, {args.planner} search, {args.ticks} ticks, "
+          f"reach {args.reach:g}, link {args.link:g}, base {base}, epochs of {args.epoch} ticks"
+          + (f", at most {args.max_relays} primaries" if args.max_relays is not None else ""))
+    print(f"{'drones':>7} {'primaries':>10} {'max':>5} {'reach base':>11} {'place ms':>9} {'check ms':>9} {'brute ms':>9}")
+    for swarm in args.swarm:
+        sim = Simulation(obstacles, swarm, args.speed, args.radius, DECAY_RATE, planner=args.planner)
+        xs, ys = record(sim, args.ticks)
+        counts, reached = [], []
+        place_s = check_s = brute_s = 0.0
+        epochs = range(0, args.ticks, args.epoch)
+        for t0 in epochs:
+            ex, ey = xs[t0:t0 + args.epoch], ys[t0:t0 + args.epoch]
+            t = time.perf_counter()
+            rx, ry = place(ex, ey, args.reach, args.link, base, sim.env, args.max_relays)
+            place_s += time.perf_counter() - t
+            t = time.perf_counter()
+            ok = connected(ex, ey, rx, ry, args.reach, args.link, base)
+            check_s += time.perf_counter() - t
+            t = time.perf_counter()
+            brute = brute_connected(ex, ey, rx, ry, args.reach, args.link, base)
+            brute_s += time.perf_counter() - t
+            if not np.array_equal(ok, brute):
+                raise SystemExit(f"grid index and brute force disagree on who reaches the base (tick {t0})")
+            counts.append(len(rx))
+            reached.append(ok.mean())
+        ms = lambda s: s / len(epochs) * 1e3
+        print(f"{swarm:>7} {np.mean(counts):>10.1f} {max(counts):>5} {np.mean(reached) * 100:>10.1f}% "
+              f"{ms(place_s):>9.2f} {ms(check_s):>9.2f} {ms(brute_s):>9.2f}")
+
+
+if __name__ == "__main__":
+    main()
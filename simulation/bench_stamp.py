@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+# bench_stamp.py - ns per drone-step of coverage stamping, per-cell loop vs one numpy op per tick
+#
+# `--drones` strip-search drones on a `--grid` map with obstacles are stepped for `--ticks`. the loop
+# is the old Drone.step: a bounds and obstacle check for each of the (2r+1)^2 cells. the batched
+# version is Environment.stamp over every drone at once, a block copy per drone into a padded map;
+# it is timed alone and with the revisit bookkeeping Simulation asks for (track=True), which the loop
+# never had. the drones' moves (the same in all) are timed apart, so both the stamping and the
+# whole drone-step are reported. every version must leave the same coverage.
+#
+#   python3 bench_stamp.py --grid 1024 --drones 64 --radius 5
+#   python3 bench_stamp.py --radius 1 --drones 256
+
+import argparse
+import random
+import time
+
+import numpy as np
+
+from sim_engine import Environment, create_drones, generate_obstacles
+
+
+def loop_stamp(env, d):
+    r = d.search_area
+    for i in range(d.x - r, d.x + r + 1):
+        for j in range(d.y - r, d.y + r + 1):
+            if 0 <= i < env.grid_size and 0 <= j < env.grid_size:
+                if not env.blocked(j, i):
+                    env.last_seen[j, i] = env.tick - env.base
+
+
+def run(obstacles, args, mode):
+    env = Environment(args.grid, obstacles, reach=args.radius)
+    drones = create_drones(env, args.drones, args.speed, args.radius)
+    stamp_s = move_s = 0.0
+    for _ in range(args.ticks):
+        t0 = time.perf_counter()
+        env.decay()
+        if mode == "loop":
+            for d in drones:
+                loop_stamp(env, d)
+        else:
+            env.stamp([d.x for d in drones], [d.y for d in drones], args.radius, track=mode == "tracked")
+        t1 = time.perf_counter()
+        for d in drones:
+            d.move()
+        move_s += time.perf_counter() - t1
+        stamp_s += t1 - t0
+    return env.coverage, stamp_s, move_s
+
+
+def main():
+    p = argparse.ArgumentParser(description="Coverage stamping benchmark")
+    p.add_argument("--grid", type=int, default=1024)
+    p.add_argument("--drones", type=int, default=64)
+    p.add_argument("--radius", type=int, default=5)
+    p.add_argument("--speed", type=int, default=2)
+    p.add_argument("--obstacles", type=int, default=400)
+    p.add_argument("--ticks", type=int, default=200)
+    p.add_argument("--seed", type=int, default=1)
+    args = p.parse_args()
+
+    obstacles = generate_obstacles(args.grid, args.obstacles, random.Random(args.seed))
+    steps = args.ticks * args.drones
+    ns = lambda s: s / steps * 1e9
+    print(f"{args.grid}^2 grid, {args.drones} drones, radius {args.radius} ({(2 * args.radius + 1) ** 2} cells), "
+          f"{args.ticks} ticks")
+    cov_loop, loop_s, move = run(obstacles, args, "loop")
+    print(f"stamp  per-cell loop:     {ns(loop_s):9.0f} ns per drone-step")
+    for mode, label in (("batched", "batched:          "), ("tracked", "batched + revisits:")):
+        cov, stamp_s, move_s = run(obstacles, args, mode)
+        if not np.array_equal(cov_loop, cov):
+            raise SystemExit(f"{mode} stamping left different coverage")
+        move = min(move, move_s)
+        print(f"stamp  {label}{ns(stamp_s):9.0f} ns per drone-step  ({loop_s / stamp_s:.0f}x)")
+        if mode == "batched":
+            batch_s = stamp_s
+    print(f"move (all):               {ns(move):9.0f} ns per drone-step")
+    print(f"drone-step: {ns(loop_s + move):.0f} -> {ns(batch_s + move):.0f} ns "
+          f"({(loop_s + move) / (batch_s + move):.0f}x)")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,175 @@
+# comms.py - what the base has actually got: search drone -> primary -> base links, with queues
+#
+# a Simulation counts a cell searched the tick a drone passes over it; here it only counts once
+# its pictures are at the base. Comms steps a Simulation an `epoch` at a time, places primaries
+# for that stretch (relays.place, at most `max_relays`), links them into a tree to the base
+# (relays.tree) and then plays the radio out tick by tick, all drones at once:
+#
+#   range      a drone sends only when within `reach` of a linked primary or the base (the
+#              nearest one); primaries link to each other and the base within `link`.
+#   bandwidth  a drone sends at most `rate` cells of pictures a tick; a primary takes in at most
+#              `relay_rate` a tick from the drones on it, shared in proportion; each primary's
+#              link up the tree carries at most `link_rate`, an over-full one passing the same
+#              share of everything offered to it. what is not passed stays queued on the drone.
+#              the base takes in whatever arrives.
+#   queueing   each drone queues the cells it searches first (Simulation.found) and sends them in
+#              order, so out of range or short of bandwidth they wait; each hop to the base then
+#              adds `hop_ticks`.
+#
+# `targets` random free cells stand for things to find: one is detected the tick it first falls in
+# a search square and is at the base once the cells queued up to it are sent and have hopped
+# home. stats() gives delivered coverage next to the searched fraction, the ticks to each
+# threshold of both, and detection-to-base latency.
+#
+#   comms = Comms(Simulation(obstacles, 5, 2, 1), reach=15, link=30, max_relays=4).run(400, [0.5, 0.9])
+#   comms.stats()  # delivered, latency_mean, latency_p95, ...
+
+import random
+
+import numpy as np
+
+from relays import GridIndex, place, tree
+
+
+class Comms:
+    """a Simulation and the radio links that bring its results to the base"""
+
+    def __init__(self, sim, reach=15, link=30, base=None, rate=8.0, relay_rate=24.0, link_rate=48.0,
+                 hop_ticks=1, epoch=25, max_relays=None, targets=20, rng=random):
+        self.sim = sim
+        env = sim.env
+        n = env.grid_size
+        self.reach, self.link = reach, link
+        self.base = base if base is not None else (n // 2, 0)
+        self.rate, self.relay_rate, self.link_rate = rate, relay_rate, link_rate
+        self.hop_ticks, self.epoch, self.max_relays = hop_ticks, epoch, max_relays
+        drones = len(sim.drones)
+        sim.found = np.zeros(drones, np.int64)
+        self.radius = np.array([d.search_area for d in sim.drones])
+        self.queued = np.zeros(drones)  # cells searched first by each drone, all ticks so far
+        self.sent = np.zeros(drones)    # of those, sent on to a primary (or the base)
+        self.sent_at = []               # self.sent after each tick
+        self.hops_at = []               # each drone's hops to the base each tick, -1 out of range
+        self.arrived = np.zeros(0)      # cells at the base by tick
+        self.primaries = []             # primaries per epoch
+        cells = []
+        while len(cells) < targets and n:
+            x, y = rng.randrange(n), rng.randrange(n)
+            if not env.blocked(y, x):
+                cells.append((x, y))
+        self.tx, self.ty = np.array(cells, np.int64).reshape(-1, 2).T
+        self.detected = []  # (tick, drone, cells queued up to it) per target found
+        self.undetected = np.ones(len(self.tx), bool)
+        self.reached = {}   # delivered fraction threshold -> first tick at or above it
+
+    def run(self, ticks, thresholds=()):
+        """steps the simulation `ticks` times an epoch at a time, noting when each fraction in
+        `thresholds` is first searched (sim.reached) and first delivered (self.reached)"""
+        sim = self.sim
+        raw = sorted(thresholds)
+        drones = len(sim.drones)
+        for t0 in range(0, ticks, self.epoch):
+            span = min(self.epoch, ticks - t0)
+            xs = np.empty((span, drones), np.int64)
+            ys = np.empty_like(xs)
+            found = np.empty_like(xs)
+            for t in range(span):
+                xs[t] = [d.x for d in sim.drones]  # where it searches this tick, before it moves
+                ys[t] = [d.y for d in sim.drones]
+                sim.step()
+                found[t] = sim.found
+                while raw and sim.searched_fraction() >= raw[0]:
+                    sim.reached[raw.pop(0)] = sim.tick
+            rx, ry = place(xs, ys, self.reach, self.link, self.base, sim.env, self.max_relays)
+            self.primaries.append(len(rx))
+            self._send(xs, ys, found, rx, ry, sim.tick - span)
+        done = np.cumsum(self.arrived[:sim.tick]) / sim.free
+        for f in thresholds:
+            hit = np.flatnonzero(done >= f)
+            if len(hit) and f not in self.reached:
+                self.reached[f] = int(hit[0]) + 1
+        return self
+
+    def _send(self, xs, ys, found, rx, ry, tick0):
+        """one epoch of the radio: ticks tick0 + 1 .. with the drones at (xs, ys) and primaries
+        at (rx, ry)"""
+        parent, hops = tree(rx, ry, self.link, self.base)
+        ok = np.flatnonzero(hops >= 0)  # the base and the primaries linked to it
+        index = GridIndex(np.concatenate([[self.base[0]], rx])[ok], np.concatenate([[self.base[1]], ry])[ok],
+                          self.reach)
+        parent, hops = parent[ok], hops[ok]
+        parent = np.searchsorted(ok, np.maximum(parent, 0))  # renumbered onto the linked ones
+        depth = [np.flatnonzero(hops == h) for h in range(1, int(hops.max()) + 1)]
+        m = len(ok)
+        late = int(hops.max()) * self.hop_ticks + 1
+        if len(self.arrived) < tick0 + len(xs) + late:
+            self.arrived = np.concatenate([self.arrived, np.zeros(tick0 + len(xs) + late - len(self.arrived))])
+        nodes = index.nearest(xs.ravel(), ys.ravel(), self.reach).reshape(xs.shape)  # the primaries stay put
+        for t, node in enumerate(nodes):
+            tick = tick0 + t + 1
+            self.queued += found[t]
+            self._detect(xs[t], ys[t], tick)
+            on = node >= 0
+            want = np.where(on, np.minimum(self.queued - self.sent, self.rate), 0.0)
+            # each primary shares its intake among the drones on it
+            load = np.bincount(node[on], want[on], minlength=m)
+            share = np.minimum(1.0, self.relay_rate / np.maximum(load, 1e-12))
+            intake = load * share
+            # then each link up the tree, from the leaves: what it is offered is its primary's intake
+            # and what the links below pass on; an over-full one passes a share of each
+            through = intake.copy()
+            cut = np.ones(m)  # the base takes in all that arrives
+            for level in depth[::-1]:
+                cut[level] = np.minimum(1.0, self.link_rate / np.maximum(through[level], 1e-12))
+                np.add.at(through, parent[level], through[level] * cut[level])
+            for level in depth:
+                cut[level] *= cut[parent[level]]  # the share of a primary's intake that gets home
+            flow = np.zeros(len(want))
+            flow[on] = want[on] * (share * cut)[node[on]]
+            self.sent += flow
+            np.add.at(self.arrived, tick + hops[node[on]] * self.hop_ticks - 1, flow[on])
+            self.sent_at.append(self.sent.copy())
+            self.hops_at.append(np.where(on, hops[np.maximum(node, 0)], -1))
+
+    def _detect(self, xs, ys, tick):
+        """targets first inside a search square this tick, queued behind that drone's cells"""
+        left = np.flatnonzero(self.undetected)
+        if not len(left):
+            return
+        inside = ((np.abs(self.tx[left, None] - xs) <= self.radius) &
+                  (np.abs(self.ty[left, None] - ys) <= self.radius))
+        for i, j in zip(*np.nonzero(inside)):
+            if self.undetected[left[i]]:
+                self.undetected[left[i]] = False
+                self.detected.append((tick, int(j), float(self.queued[j])))
+
+    def latencies(self):
+        """ticks from detection to the base for each detected target, in order found; inf for
+        those not there yet"""
+        if not self.detected:
+            return np.zeros(0)
+        sent = np.array(self.sent_at)
+        hops = np.array(self.hops_at)
+        out = np.full(len(self.detected), np.inf)
+        for k, (tick, j, queued) in enumerate(self.detected):
+            # the first tick, from the one it was found on, that it was all sent (and sending)
+            t = max(int(np.searchsorted(sent[:, j], queued - 1e-9)), tick - 1)
+            on = np.flatnonzero(hops[t:, j] >= 0)
+            if len(on):
+                t += on[0]
+                out[k] = t + 1 + hops[t, j] * self.hop_ticks - tick
+        return out
+
+    def delivered_fraction(self):
+        return float(self.arrived[:self.sim.tick].sum() / self.sim.free)
+
+    def stats(self):
+        lat = self.latencies()
+        there = lat[np.isfinite(lat)]
+        return dict(delivered=round(self.delivered_fraction(), 4),
+                    backlog=int(round(float((self.queued - self.sent).sum()))),
+                    primaries=round(float(np.mean(self.primaries)), 1) if self.primaries else 0,
+                    detected=len(lat), detections_delivered=len(there),
+                    latency_mean=round(float(there.mean()), 1) if len(there) else None,
+                    latency_p95=round(float(np.percentile(there, 95)), 1) if len(there) else None,
+                    latency_max=int(there.max()) if len(there) else None)
@@ -0,0 +1,348 @@
+# planner.py - frontier-based search for the coverage simulator (sim_engine.py)
+#
+# a frontier cell is a free cell never searched with a searched cell next to it (4-neighbours):
+# the edge of what the swarm has seen. the set is kept as a flag per cell plus a count per
+# TILE x TILE tile, and only the squares the drones stamped this tick (and a cell round them) are
+# looked at again - the rest of the map cannot have changed. a drone whose target stops being a
+# frontier (it, or another drone, searched it) gets a new one: the tiles with frontier cells are
+# costed by how far the drone would fly (manhattan, they move a cell at a time along x or y), plus
+# a penalty for being close to a tile another drone is headed for, and handed out cheapest first,
+# one drone per tile. the drone then flies to the nearest frontier cell of its tile, and on to
+# the next nearest while the tile has any left.
+#
+# the way there is a distance field: a BFS wave from the frontier cells of the target's tile over
+# the free cells, out until it reaches the drone, in a window round the two (widened if the wave
+# dies out first). each step the drone moves to the neighbour one nearer - O(1), and round any
+# obstacle. a field is worked out once per tile and followed until the frontier it leads to is
+# within the drone's search area. from there the drone goes straight from frontier cell to
+# frontier cell of the tile (the frontier moves on with every square it searches, so a field to
+# it would be stale a step later), and only an obstacle in the way of the next one costs another
+# field, to that one cell. obstacles changing (Simulation.set_obstacles) only drop the fields
+# whose explored cells they touch. frontier no wave can reach (seen over a wall into a closed-off
+# pocket) is dropped; a drone shut in itself counts as stuck and stays put.
+#
+# paths="greedy" (planner "frontier-greedy") is the older way: each step simply takes the drone
+# closer. one boxed in by obstacles gives its tile up (another drone may still reach it; it tries
+# again once it has given up on all that are left). `blocked` counts the places a drone got stuck
+# at, not the tries.
+#
+#   sim = Simulation(obstacles, 8, 2, 5, planner="frontier")
+#   python3 batch.py --planner strips frontier-greedy frontier --obstacles 0 10 20 40 --reach 95 --ticks 2000
+
+import numpy as np
+from numpy.lib.stride_tricks import sliding_window_view
+
+TILE = 16
+UNREACHED = 0xFFFF  # distance of a cell the wave has not got to
+MAX_WINDOW = 1 << 22  # cells a distance field may cover before a target counts as out of this drone's reach
+
+
+def distances(free, sources, goal):
+    """BFS steps to the nearest of `sources` (a mask) over the True cells of `free`, a wave out from
+    them that stops once it reaches `goal` ((y, x) in free's coordinates). cells it did not get to
+    are UNREACHED - goal too, if it cannot be reached. every cell nearer than goal is final, so
+    from goal there is always a neighbour one step nearer, all the way down. each step only looks
+    at the neighbours of the cells the wave reached last (flat indices), so a field costs the
+    cells it covers"""
+    h, w = free.shape
+    dist = np.full(h * w, UNREACHED, np.uint16)
+    goal = goal[0] * w + goal[1]
+    open_ = np.ascontiguousarray(free).ravel() & ~sources.ravel()
+    wave = np.flatnonzero(sources & free)
+    dist[wave] = 0
+    d = 0
+    while len(wave) and dist[goal] == UNREACHED:
+        d += 1
+        col = wave % w
+        nxt = np.concatenate([wave[col != 0] - 1, wave[col != w - 1] + 1,
+                              wave[wave >= w] - w, wave[wave < (h - 1) * w] + w])
+        nxt = np.unique(nxt[open_[nxt]])
+        open_[nxt] = False
+        dist[nxt] = d
+        wave = nxt
+    return dist.reshape(h, w)
+
+
+class FrontierPlanner:
+    """moves `drones` (sim_engine.Drone, all with one search_area) over `env` frontier first, along
+    distance fields (paths="bfs") or greedily (paths="greedy"). step() after every stamp: it brings
+    the frontier up to date around the drones, then moves them"""
+
+    def __init__(self, env, drones, paths="bfs"):
+        if paths not in ("bfs", "greedy"):
+            raise ValueError(f"unknown paths {paths!r}, bfs or greedy")
+        self.env = env
+        self.drones = drones
+        r = self.radius = drones[0].search_area
+        if any(d.search_area != r for d in drones):
+            raise ValueError("frontier drones must all have the same search_area")
+        k = 2 * r + 1
+        if k + 2 > 57:
+            raise ValueError(f"search area {r} is wider than 27, the most a frontier row's 64 bits hold")
+        side = len(env._last_seen)
+        self.ntiles = -(-side // TILE)
+        # frontier flags in the padded coordinates of env._last_seen; all zero until searched, so
+        # the OS only gives pages to the part of a big map drones have been near
+        self.frontier = np.zeros((self.ntiles * TILE,) * 2, np.uint8)
+        self._tiles = self.frontier.reshape(self.ntiles, TILE, self.ntiles, TILE)
+        self.counts = np.zeros((self.ntiles, self.ntiles), np.int32)  # frontier cells per tile
+        # a square, one cell round it for cells that may have turned frontier, one more for their neighbours
+        self._seen = sliding_window_view(env._last_seen, (k + 4, k + 4))
+        self._blocked = sliding_window_view(env._blocked, (k + 2, 8))
+        self._flags = sliding_window_view(self.frontier, (k + 2, k + 2), writeable=True)
+        self._span = (k + 1) // TILE + 2  # most tiles a (k+2) wide region touches, per axis
+        self.spread = max(TILE, 4 * r + 2)  # a tile this close to another drone's costs up to this much more
+        self.targets = [None] * len(drones)  # padded (y, x) of each drone's frontier cell
+        self.avoid = [set() for _ in drones]  # tiles a drone got stuck on the way to
+        self.stuck_at = [None] * len(drones)  # where it last did: one incident however many tries
+        self.blocked = 0
+        self.assigned = 0
+        # each drone's (tile or cell it leads to, window origin y, x, distance field), padded; None
+        # with greedy paths
+        self.paths = [None] * len(drones) if paths == "bfs" else None
+        self.inside = [None] * len(drones)  # the tile whose frontier each drone has got to
+        self.fields = 0       # distance fields worked out
+        self.trapped = set()  # drones shut in by obstacles (or started on one), left where they are
+        self.unreachable = 0  # frontier cells dropped as out of reach
+
+    def tile_of(self, t):
+        return (t[0] // TILE) * self.ntiles + t[1] // TILE
+
+    def update(self, xs, ys):
+        """recomputes the frontier flags around the squares just stamped at (xs, ys), and the
+        counts of the tiles they touch"""
+        pad = self.env._pad
+        k = 2 * self.radius + 1
+        y0 = np.asarray(ys) + (pad - self.radius - 1)  # region origins, padded
+        x0 = np.asarray(xs) + (pad - self.radius - 1)
+        seen = self._seen[y0 - 1, x0 - 1] != 0
+        near = seen[:, :-2, 1:-1] | seen[:, 2:, 1:-1] | seen[:, 1:-1, :-2] | seen[:, 1:-1, 2:]
+        rows = np.right_shift(self._blocked[y0, x0 >> 3].view("<u8"), (x0 & 7)[:, None, None],
+                              dtype=np.uint64, casting="unsafe")
+        blocked = np.unpackbits(rows.astype("<u8", copy=False).view(np.uint8), axis=-1,
+                                count=k + 2, bitorder="little").view(bool)
+        self._flags[y0, x0] = near > (seen[:, 1:-1, 1:-1] | blocked)
+        # recount every tile a region touches (overlapping regions make counting changes unsafe)
+        offs = np.arange(self._span)
+        ty = np.minimum(y0[:, None] // TILE + offs, (y0[:, None] + k + 1) // TILE)
+        tx = np.minimum(x0[:, None] // TILE + offs, (x0[:, None] + k + 1) // TILE)
+        ids = np.unique((ty[:, :, None] * self.ntiles + tx[:, None, :]).ravel())
+        ty, tx = np.divmod(ids, self.ntiles)
+        self.counts.flat[ids] = self._tiles[ty, :, tx, :].sum(axis=(1, 2))
+
+    def assign(self, need, xs, ys):
+        """hands frontier tiles to the drones in `need`, cheapest (drone, tile) pair first"""
+        for i in need:
+            self.targets[i] = None  # until one is found it can take
+        cand = np.flatnonzero(self.counts)
+        if not len(cand):
+            return
+        pad = self.env._pad
+        cy, cx = np.divmod(cand, self.ntiles)
+        cy, cx = cy * TILE + TILE // 2 - pad, cx * TILE + TILE // 2 - pad  # tile centres on the map
+        cost = (np.abs(cy - ys[need][:, None]) + np.abs(cx - xs[need][:, None])).astype(float)
+        others = [t for t in self.targets if t is not None]
+        for t in others:
+            cost += self._crowding(cy, cx, t[0] - pad, t[1] - pad)
+        cost[:, np.isin(cand, [self.tile_of(t) for t in others])] = np.inf  # one drone per tile
+        for row, i in enumerate(need):
+            if self.avoid[i]:
+                cost[row, np.isin(cand, list(self.avoid[i]))] = np.inf
+        for _ in need:
+            row, j = np.unravel_index(np.argmin(cost), cost.shape)
+            if cost[row, j] == np.inf:
+                break
+            i = need[row]
+            self.targets[i] = self._nearest(cand[j], ys[i] + pad, xs[i] + pad)
+            self.assigned += 1
+            cost[row] = np.inf
+            cost[:, j] = np.inf
+            cost += self._crowding(cy, cx, cy[j], cx[j])
+        for i in need:
+            if self.targets[i] is None:
+                self.avoid[i].clear()  # everything left was given up on: try again next tick
+
+    def _crowding(self, cy, cx, y, x):
+        return np.maximum(0, self.spread - (np.abs(cy - y) + np.abs(cx - x)))
+
+    def _nearest(self, tile, y, x):
+        """the frontier cell of `tile` nearest padded (y, x), padded"""
+        ty, tx = divmod(int(tile), self.ntiles)
+        fy, fx = np.nonzero(self._tiles[ty, :, tx, :])
+        j = np.argmin(np.abs(fy + ty * TILE - y) + np.abs(fx + tx * TILE - x))
+        return int(fy[j]) + ty * TILE, int(fx[j]) + tx * TILE
+
+    def step(self):
+        drones = self.drones
+        xs = np.array([d.x for d in drones])
+        ys = np.array([d.y for d in drones])
+        self.update(xs, ys)
+        need = []
+        for i, t in enumerate(self.targets):
+            if i in self.trapped:
+                continue
+            if t is None:
+                need.append(i)
+            elif not self.frontier[t]:
+                tile = self.tile_of(t)
+                if self.counts.flat[tile]:  # its tile still has frontier: stay on it
+                    self.targets[i] = self._nearest(tile, ys[i] + self.env._pad, xs[i] + self.env._pad)
+                else:
+                    need.append(i)
+        if need:
+            self.assign(need, xs, ys)
+        move = self.move if self.paths is None else self.follow
+        for i, d in enumerate(drones):
+            if self.targets[i] is not None:
+                move(i, d)
+
+    def follow(self, i, d):
+        """up to speed cells down the distance field to the target's tile, then on from frontier
+        cell to frontier cell of the tile"""
+        target = self.targets[i]
+        tile = self.tile_of(target)
+        pad = self.env._pad
+        path = self.paths[i]
+        if self.inside[i] != tile:
+            if path is None or path[0] != tile:
+                path = self.paths[i] = self._field(i, tile, d)
+                if path is None:
+                    self.targets[i] = None
+                    return
+            if path[3][d.y + pad - path[1], d.x + pad - path[2]] > self.radius:
+                self._descend(d, path)
+                return
+            # the frontier this way led to is in its search area now: the field has done its work
+            self.inside[i] = tile
+            path = self.paths[i] = None
+        if path is not None and path[0] != target:
+            path = self.paths[i] = None  # the cell it went round an obstacle to has been searched
+        if path is None:
+            ty, tx = target[0] - pad, target[1] - pad
+            for _ in range(d.speed):
+                if (d.y, d.x) == (ty, tx):
+                    return
+                if not self._closer(d, ty, tx):
+                    break
+            else:
+                return
+            # an obstacle in the way: round it, along a field to that cell
+            path = self.paths[i] = self._field(i, tile, d, target)
+            if path is None:
+                self.targets[i] = None
+            return
+        self._descend(d, path)
+
+    def _descend(self, d, path):
+        """up to speed cells down `path`'s distance field"""
+        pad = self.env._pad
+        _, oy, ox, dist = path
+        y, x = d.y + pad - oy, d.x + pad - ox
+        for _ in range(d.speed):
+            here = dist[y, x]
+            if not here:
+                break
+            for ny, nx in ((y - 1, x), (y + 1, x), (y, x - 1), (y, x + 1)):
+                if dist[ny, nx] == here - 1:
+                    y, x = ny, nx
+                    break
+        d.y, d.x = y + oy - pad, x + ox - pad
+
+    def _field(self, i, tile, d, cell=None):
+        """(tile, window origin, distances to the tile's frontier cells) for a drone at d, the
+        window grown until the wave reaches it; with `cell` (padded), (cell, ...) and distances to
+        that one frontier cell of the tile. None if it cannot be reached: the frontier is dropped if
+        not even the whole map has a way to it (the drone is trapped if it is the one in a pocket),
+        and the tile given up on by this drone past MAX_WINDOW cells"""
+        env = self.env
+        side = len(env._last_seen)
+        ty, tx = divmod(tile, self.ntiles)
+        ty, tx = ty * TILE, tx * TILE
+        gy, gx = d.y + env._pad, d.x + env._pad
+        margin = max(TILE, (abs(ty - gy) + abs(tx - gx)) // 2)
+        while True:
+            y0, y1 = max(0, min(ty, gy) - margin), min(side, max(ty + TILE, gy) + margin + 1)
+            x0, x1 = max(0, min(tx, gx) - margin), min(side, max(tx + TILE, gx) + margin + 1)
+            bits = np.unpackbits(env._blocked[y0:y1, x0 >> 3:(x1 + 7) >> 3], axis=1, bitorder="little")
+            free = bits[:, x0 & 7:(x0 & 7) + x1 - x0] == 0
+            free[[0, -1]] = free[:, [0, -1]] = False  # paths keep off the edge, so a step never looks past it
+            free[gy - y0, gx - x0] = True  # it may be on an obstacle that has just appeared
+            sources = np.zeros_like(free)
+            if cell is None:
+                ey, ex = min(ty + TILE, y1), min(tx + TILE, x1)  # the last tiles run past the padded map
+                sources[ty - y0:ey - y0, tx - x0:ex - x0] = self.frontier[ty:ey, tx:ex]
+            else:
+                sources[cell[0] - y0, cell[1] - x0] = True
+            self.fields += 1
+            dist = distances(free, sources, (gy - y0, gx - x0))
+            if dist[gy - y0, gx - x0] != UNREACHED:
+                return (tile if cell is None else cell), y0, x0, dist
+            if (y1 - y0, x1 - x0) == (side, side):
+                # no way at all: whichever of the two is cut off from most of the map is in a pocket
+                if np.count_nonzero(dist != UNREACHED) < env.free_cells // 2:
+                    if cell is None:
+                        self.unreachable += int(self.counts.flat[tile])
+                        self.frontier[ty:ty + TILE, tx:tx + TILE] = 0
+                        self.counts.flat[tile] = 0
+                    else:
+                        self.unreachable += 1
+                        self.frontier[cell] = 0
+                        self.counts.flat[tile] -= 1
+                else:
+                    self.trapped.add(i)
+                    if self.stuck_at[i] != (d.x, d.y):
+                        self.blocked += 1
+                        self.stuck_at[i] = (d.x, d.y)
+                return None
+            if (y1 - y0) * (x1 - x0) >= MAX_WINDOW:
+                self.avoid[i].add(tile)
+                return None
+            margin *= 4
+
+    def obstacles_changed(self, y0, y1, x0, x1):
+        """after cells x0:x1 of rows y0:y1 of the map were blocked or freed: their frontier flags,
+        and the distance fields whose explored cells they (or their neighbours) are, are redone"""
+        pad = self.env._pad
+        side = len(self.env._last_seen)
+        y0, y1 = max(1, y0 + pad - 1), min(side - 1, y1 + pad + 1)
+        x0, x1 = max(1, x0 + pad - 1), min(side - 1, x1 + pad + 1)
+        seen = self.env._last_seen[y0 - 1:y1 + 1, x0 - 1:x1 + 1] != 0
+        near = seen[:-2, 1:-1] | seen[2:, 1:-1] | seen[1:-1, :-2] | seen[1:-1, 2:]
+        bits = np.unpackbits(self.env._blocked[y0:y1, x0 >> 3:(x1 + 7) >> 3], axis=1, bitorder="little")
+        blocked = bits[:, x0 & 7:(x0 & 7) + x1 - x0].view(bool)
+        self.frontier[y0:y1, x0:x1] = near > (seen[1:-1, 1:-1] | blocked)
+        ty, tx = slice(y0 // TILE, (y1 - 1) // TILE + 1), slice(x0 // TILE, (x1 - 1) // TILE + 1)
+        self.counts[ty, tx] = self._tiles[ty, :, tx, :].sum(axis=(1, 3))
+        self.trapped.clear()
+        for i, path in enumerate(self.paths or ()):
+            if path is not None:
+                _, oy, ox, dist = path
+                touched = dist[max(0, y0 - oy):max(0, y1 - oy), max(0, x0 - ox):max(0, x1 - ox)]
+                if (touched != UNREACHED).any():
+                    self.paths[i] = None
+
+    def _closer(self, d, ty, tx):
+        """moves d one cell nearer (ty, tx) along x or y, the longer way first; False if both ways
+        are blocked"""
+        dy, dx = ty - d.y, tx - d.x
+        sy, sx = (dy > 0) - (dy < 0), (dx > 0) - (dx < 0)
+        steps = ((d.y + sy, d.x), (d.y, d.x + sx)) if abs(dy) >= abs(dx) else ((d.y, d.x + sx), (d.y + sy, d.x))
+        for y, x in steps:
+            if (y, x) != (d.y, d.x) and not self.env.blocked(y, x):
+                d.y, d.x = y, x
+                return True
+        return False
+
+    def move(self, i, d):
+        """up to speed cells towards the target, one along x or y at a time, each one closer"""
+        ty, tx = self.targets[i][0] - self.env._pad, self.targets[i][1] - self.env._pad
+        for _ in range(d.speed):
+            if (d.y, d.x) == (ty, tx):
+                return
+            if not self._closer(d, ty, tx):
+                if self.stuck_at[i] != (d.x, d.y):
+                    self.blocked += 1
+                    self.stuck_at[i] = (d.x, d.y)
+                self.avoid[i].add(self.tile_of(self.targets[i]))
+                self.targets[i] = None
+                return
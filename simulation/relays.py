@@ -0,0 +1,304 @@
+# relays.py - where the primaries (transmit relays) should fly so the search drones reach base
+#
+# a search drone's video gets home only if it is within `reach` of a primary (or the base) and
+# that primary has a chain of primaries, each within `link` of the next, back to the base. given
+# the search drones' planned positions (record() a Simulation), place() works out primaries for
+# one stretch of them: a greedy cover of the positions with discs of radius `reach`, centred on a
+# lattice of half that spacing (lazily re-costed, cheapest first), then a spanning tree from the
+# base over the cover primaries, costed in primaries a hop needs, each long hop filled in by
+# stepping as far along it as link allows onto a cell free of obstacles (radio is taken to pass
+# over them; primaries cannot sit on them). with `max_relays` the leaves covering least per
+# primary saved are cut until it fits. plan() does it every `epoch` ticks; connected() says
+# which positions can reach the base.
+#
+# link queries (who is within range of whom) go through GridIndex, a uniform grid of buckets a
+# range wide: a query looks at the 3x3 buckets round it, not at every point.
+#
+#   track = record(Simulation(obstacles, 256, 2, 3, planner="frontier"), 600)
+#   epochs = plan(track, reach=20, link=40, base=(512, 0), epoch=25, env=sim.env)
+#   python3 bench_relays.py --grid 1024 --swarm 16 64 256 512
+
+import heapq
+import math
+
+import numpy as np
+
+
+class GridIndex:
+    """points in buckets `cell` wide. finds the points within r <= cell of a spot, or whether
+    there are any, looking only at the 3x3 buckets round it"""
+
+    def __init__(self, xs, ys, cell):
+        self.xs = np.asarray(xs, np.float64)
+        self.ys = np.asarray(ys, np.float64)
+        self.cell = cell
+        bx, by = self._bucket(self.xs, self.ys)
+        self.x0, self.y0 = (int(bx.min()), int(by.min())) if len(bx) else (0, 0)
+        self.width = int(bx.max()) - self.x0 + 3 if len(bx) else 1  # a spare column each side
+        keys = self._key(bx, by)
+        self.order = np.argsort(keys, kind="stable")
+        buckets = self.width * ((int(by.max()) - self.y0 + 3) if len(by) else 1)
+        # points of bucket b are order[start[b]:start[b + 1]]
+        self.start = np.searchsorted(keys[self.order], np.arange(buckets + 1))
+        self.deepest = int(np.diff(self.start).max()) if len(keys) else 0
+
+    def _bucket(self, xs, ys):
+        return np.floor_divide(xs, self.cell).astype(np.int64), np.floor_divide(ys, self.cell).astype(np.int64)
+
+    def _key(self, bx, by):
+        return (by - self.y0 + 1) * self.width + (bx - self.x0 + 1)
+
+    def near(self, x, y, r):
+        """indices of the points within r of (x, y)"""
+        bx, by = int(x // self.cell), int(y // self.cell)
+        found = []
+        for oy in (-1, 0, 1):
+            row = by + oy - self.y0 + 1
+            if not 0 <= row < len(self.start) // self.width:
+                continue
+            lo = row * self.width + max(0, bx - self.x0)
+            hi = row * self.width + min(self.width, bx - self.x0 + 3)
+            if lo < hi:
+                found.append(self.order[self.start[lo]:self.start[hi]])
+        if not found:
+            return np.zeros(0, np.int64)
+        idx = np.concatenate(found)
+        return idx[(self.xs[idx] - x) ** 2 + (self.ys[idx] - y) ** 2 <= r * r]
+
+    def any_near(self, qx, qy, r):
+        """for each query spot, whether any point is within r of it. vectorized over the spots:
+        one pass per neighbouring bucket and per point a bucket holds"""
+        qx, qy = np.asarray(qx, np.float64), np.asarray(qy, np.float64)
+        hit = np.zeros(len(qx), bool)
+        if not len(self.xs):
+            return hit
+        for live, p in self._passes(qx, qy, hit):
+            hit[live] |= (self.xs[p] - qx[live]) ** 2 + (self.ys[p] - qy[live]) ** 2 <= r * r
+        return hit
+
+    def nearest(self, qx, qy, r):
+        """for each query spot, the index of the nearest point within r of it, -1 if none. the
+        same passes as any_near"""
+        qx, qy = np.asarray(qx, np.float64), np.asarray(qy, np.float64)
+        best = np.full(len(qx), -1, np.int64)
+        gap = np.full(len(qx), r * r + 1e-9)
+        if not len(self.xs):
+            return best
+        for live, p in self._passes(qx, qy):
+            d = (self.xs[p] - qx[live]) ** 2 + (self.ys[p] - qy[live]) ** 2
+            closer = d < gap[live]
+            gap[live[closer]] = d[closer]
+            best[live[closer]] = p[closer]
+        return best
+
+    def _passes(self, qx, qy, done=None):
+        """(spots, points) per neighbouring bucket and per point a bucket holds: the query spots
+        that have a k-th point in that bucket, and those points. spots already `done` (a mask the
+        caller may update between passes) are left out"""
+        bx, by = self._bucket(qx, qy)
+        rows = len(self.start) // self.width
+        for oy in (-1, 0, 1):
+            for ox in (-1, 0, 1):
+                cx, cy = bx + ox - self.x0 + 1, by + oy - self.y0 + 1
+                ok = (cx >= 0) & (cx < self.width) & (cy >= 0) & (cy < rows)
+                key = np.where(ok, cy * self.width + cx, 0)
+                lo, hi = np.where(ok, self.start[key], 0), np.where(ok, self.start[key + 1], 0)
+                for k in range(self.deepest):
+                    more = lo + k < hi
+                    live = np.flatnonzero(more if done is None else more & ~done)
+                    if not len(live):
+                        break
+                    yield live, self.order[lo[live] + k]
+
+
+def record(sim, ticks):
+    """steps `sim` `ticks` times; the search drones' positions, (ticks, drones) arrays xs and ys"""
+    xs = np.empty((ticks, len(sim.drones)), np.int32)
+    ys = np.empty_like(xs)
+    for t in range(ticks):
+        sim.step()
+        xs[t] = [d.x for d in sim.drones]
+        ys[t] = [d.y for d in sim.drones]
+    return xs, ys
+
+
+def _cover(px, py, reach, env):
+    """greedy disc cover of the points: centres on a lattice of cells reach/2 apart (off obstacles),
+    each next one the disc taking in most points not yet covered; points no such disc takes in get
+    one of their own. (centres x, y, points each covers)"""
+    step = max(1, int(reach // 2))
+    lx, ly = np.floor_divide(px, step).astype(np.int64), np.floor_divide(py, step).astype(np.int64)
+    m = int(math.ceil(reach / step))
+    width = int(lx.max()) + 2 * m + 2
+    pts, cands = [], []
+    for oy in range(-m, m + 1):
+        for ox in range(-m, m + 1):
+            cx, cy = lx + ox, ly + oy
+            ok = (cx * step - px) ** 2 + (cy * step - py) ** 2 <= reach * reach
+            pts.append(np.flatnonzero(ok))
+            cands.append((cy[ok] + m) * width + cx[ok] + m)
+    pts, cands = np.concatenate(pts), np.concatenate(cands)
+    ids, cands = np.unique(cands, return_inverse=True)
+    order = np.argsort(cands, kind="stable")
+    members = np.split(pts[order], np.cumsum(np.bincount(cands, minlength=len(ids)))[:-1])
+    cx = (ids % width - m) * step
+    cy = (ids // width - m) * step
+    n = env.grid_size if env is not None else None
+    heap = []
+    for c, mem in enumerate(members):
+        x, y = cx[c], cy[c]
+        if env is not None and not (0 <= x < n and 0 <= y < n and not env.blocked(y, x)):
+            continue  # no primary on an obstacle: its points are left to the discs round it
+        heap.append((-len(mem), c))
+    heapq.heapify(heap)
+    uncovered = np.ones(len(px), bool)
+    chosen, covers = [], []
+    while heap:
+        gain, c = heapq.heappop(heap)
+        mem = members[c]
+        real = int(np.count_nonzero(uncovered[mem]))
+        if not real:
+            continue
+        if real < -gain:  # costed before others were taken: re-cost and put back
+            heapq.heappush(heap, (-real, c))
+            continue
+        chosen.append((cx[c], cy[c]))
+        covers.append(real)
+        uncovered[mem] = False
+    if uncovered.any():  # every lattice centre near them on an obstacle: one on the point itself
+        index = GridIndex(px, py, reach)
+        for i in np.flatnonzero(uncovered):
+            if uncovered[i]:
+                mem = index.near(px[i], py[i], reach)
+                chosen.append((int(px[i]), int(py[i])))
+                covers.append(int(np.count_nonzero(uncovered[mem])))
+                uncovered[mem] = False
+    chosen = np.array(chosen, np.int64).reshape(-1, 2)
+    return chosen[:, 0], chosen[:, 1], np.array(covers, np.int64)
+
+
+def place(xs, ys, reach, link, base, env=None, max_relays=None):
+    """primaries for search drones at the points (xs, ys): every point within reach of one, and
+    each one chained back to the base (x, y) in hops of at most link. returns their x, y arrays"""
+    px, py = np.asarray(xs, np.float64).ravel(), np.asarray(ys, np.float64).ravel()
+    keep = (px - base[0]) ** 2 + (py - base[1]) ** 2 > reach * reach  # the base hears these itself
+    if not keep.any():
+        return np.zeros(0, np.int64), np.zeros(0, np.int64)
+    px, py = np.unique(np.stack([px[keep], py[keep]]), axis=1)
+    cx, cy, covers = _cover(px, py, reach, env)
+    # spanning tree from the base (node 0), each edge costing the primaries its hop needs in between
+    nx = np.concatenate([[base[0]], cx]).astype(np.float64)
+    ny = np.concatenate([[base[1]], cy]).astype(np.float64)
+    k = len(nx)
+    parent = np.zeros(k, np.int64)
+    best = np.full(k, np.inf)
+    done = np.zeros(k, bool)
+    done[0] = True
+    last = 0
+    for _ in range(k - 1):
+        d = np.hypot(nx - nx[last], ny - ny[last])
+        cost = np.ceil(d / link) + d * 1e-6  # fewer primaries first, then the shorter hop
+        better = ~done & (cost < best)
+        best[better] = cost[better]
+        parent[better] = last
+        last = int(np.argmin(np.where(done, np.inf, best)))
+        done[last] = True
+    chains = [[]] + [_chain(env, nx[parent[i]], ny[parent[i]], nx[i], ny[i], link) for i in range(1, k)]
+    hops = np.array([len(c) for c in chains], np.int64)
+    alive = np.ones(k, bool)
+    if max_relays is not None:
+        _prune(parent, hops, np.concatenate([[0], covers]), alive, max_relays)
+    spots = [spot for i in np.flatnonzero(alive)[1:] for spot in chains[i] + [(int(nx[i]), int(ny[i]))]]
+    spots = np.array(spots, np.int64).reshape(-1, 2)
+    return spots[:, 0], spots[:, 1]
+
+
+def _chain(env, x0, y0, x1, y1, link):
+    """primaries in between for a hop from (x0, y0) to (x1, y1): each the furthest cell along the
+    line, within link of the one before, that is not on an obstacle"""
+    out = []
+    x, y = x0, y0
+    while math.hypot(x1 - x, y1 - y) > link:
+        gap = math.hypot(x1 - x, y1 - y)
+        for s in range(int(link), 0, -1):
+            nx, ny = int(round(x + (x1 - x) * s / gap)), int(round(y + (y1 - y) * s / gap))
+            if math.hypot(nx - x, ny - y) <= link and (env is None or not env.blocked(ny, nx)):
+                break
+        else:  # the line is blocked as far as link reaches: the free cell in range nearest the end
+            nx, ny = _detour(env, x, y, x1, y1, link)
+        out.append((nx, ny))
+        x, y = nx, ny
+    return out
+
+
+def _detour(env, x, y, x1, y1, link):
+    """the cell within link of (x, y), on the map and off obstacles, nearest (x1, y1); the cell
+    straight along the line if none is nearer it than (x, y) is (radio passes over obstacles)"""
+    r = int(link)
+    oy, ox = np.mgrid[-r:r + 1, -r:r + 1]
+    ring = oy * oy + ox * ox <= link * link
+    cx, cy = (ox[ring] + int(round(x))), (oy[ring] + int(round(y)))
+    n = env.grid_size
+    ok = (cx >= 0) & (cx < n) & (cy >= 0) & (cy < n) & (np.hypot(cx - x, cy - y) <= link)
+    cx, cy = cx[ok], cy[ok]
+    ok = np.array([not env.blocked(b, a) for a, b in zip(cx.tolist(), cy.tolist())], bool)
+    gap = np.hypot(cx[ok] - x1, cy[ok] - y1)
+    if len(gap) and gap.min() < math.hypot(x1 - x, y1 - y):
+        i = int(np.argmin(gap))
+        return int(cx[ok][i]), int(cy[ok][i])
+    s = (link - 1) / math.hypot(x1 - x, y1 - y)  # rounding moves it under 1
+    return int(round(x + (x1 - x) * s)), int(round(y + (y1 - y) * s))
+
+
+def _prune(parent, hops, covers, alive, max_relays):
+    """cuts leaves of the tree, least covered per primary saved first, until max_relays are left"""
+    children = np.bincount(parent[1:], minlength=len(parent))
+    total = int((hops[1:] + 1).sum())
+    heap = [(covers[i] / (hops[i] + 1), i) for i in range(1, len(parent)) if not children[i]]
+    heapq.heapify(heap)
+    while total > max_relays and heap:
+        _, i = heapq.heappop(heap)
+        alive[i] = False
+        total -= hops[i] + 1
+        j = parent[i]
+        children[j] -= 1
+        if j and not children[j]:
+            heapq.heappush(heap, (covers[j] / (hops[j] + 1), j))
+
+
+def tree(rx, ry, link, base):
+    """the base (node 0) and primaries (rx, ry) as a tree of links of at most link, fewest hops
+    to the base: each node's parent and hops, -1 for those no chain of links reaches"""
+    nodes = GridIndex(np.concatenate([[base[0]], rx]), np.concatenate([[base[1]], ry]), link)
+    parent = np.full(len(nodes.xs), -1, np.int64)
+    hops = np.full(len(nodes.xs), -1, np.int64)
+    hops[0] = 0
+    todo = [0]
+    for i in todo:  # breadth first: todo grows as it goes
+        for j in nodes.near(nodes.xs[i], nodes.ys[i], link):
+            if hops[j] < 0:
+                hops[j] = hops[i] + 1
+                parent[j] = i
+                todo.append(j)
+    return parent, hops
+
+
+def connected(xs, ys, rx, ry, reach, link, base):
+    """whether each point (xs, ys) reaches the base: within reach of it, or of a primary (rx, ry)
+    linked to it by hops of at most link"""
+    _, hops = tree(rx, ry, link, base)
+    ok = hops >= 0
+    nx, ny = np.concatenate([[base[0]], rx])[ok], np.concatenate([[base[1]], ry])[ok]
+    return GridIndex(nx, ny, reach).any_near(np.ravel(xs), np.ravel(ys), reach)
+
+
+def plan(track, reach, link, base, epoch, env=None, max_relays=None):
+    """primaries for each `epoch` ticks of a record()ed track: a list of (first tick, rx, ry,
+    fraction of the drone-ticks in it that reach the base)"""
+    xs, ys = track
+    out = []
+    for t0 in range(0, len(xs), epoch):
+        ex, ey = xs[t0:t0 + epoch], ys[t0:t0 + epoch]
+        rx, ry = place(ex, ey, reach, link, base, env, max_relays)
+        out.append((t0, rx, ry, float(connected(ex, ey, rx, ry, reach, link, base).mean())))
+    return out
@@ -0,0 +1,392 @@
+# sim_engine.py - the coverage simulator itself: grid, obstacles, drones and stepping, no drawing
+#
+# simulation4.py animates it, batch.py sweeps it headless. a Simulation advances one tick per
+# step(): coverage fades (lazily, see Environment), then every drone stamps its search area and
+# moves - along its strip, or with planner="frontier" to the frontier (planner.py). it also keeps the
+# numbers a sweep compares: how much of the free area has ever been searched (and at which tick
+# each threshold was reached), the mean coverage level, and revisits - a cell searched again
+# after having been out of every drone's search area for a while.
+
+import math
+import random
+
+import numpy as np
+from numpy.lib.stride_tricks import sliding_window_view
+
+from planner import FrontierPlanner
+
+GRID_SIZE = 100
+DECAY_RATE = 0.02  # how fast cells "fade" back to unsurveyed
+PLANNERS = ("strips", "frontier", "frontier-greedy")  # how Simulation's drones choose where to go
+REACH = 16         # widest search_area an Environment makes room for unless told otherwise
+TICK_SPAN = 1 << 15  # last_seen holds ticks as 1 .. TICK_SPAN-1 above base; the codes above are scratch
+
+_RANKS = np.arange(TICK_SPAN, 2 * TICK_SPAN, dtype=np.uint16)
+_POPCOUNT = np.unpackbits(np.arange(256, dtype=np.uint8)[:, None], axis=1).sum(axis=1).astype(np.uint8)
+
+
+def popcount(packed):
+    """set bits in a uint8 array, a slab at a time"""
+    return sum(int(_POPCOUNT[packed[i:i + 1024]].sum(dtype=np.int64)) for i in range(0, len(packed), 1024))
+
+
+def fill_bits(packed, y0, y1, x0, x1, value=1):
+    """sets (or clears) columns x0:x1 of rows y0:y1 in a bit-packed map (see pack_obstacles)"""
+    b0, b1 = x0 >> 3, (x1 + 7) >> 3
+    block = np.unpackbits(packed[y0:y1, b0:b1], axis=1, bitorder="little")
+    block[:, x0 - 8 * b0:x1 - 8 * b0] = value
+    packed[y0:y1, b0:b1] = np.packbits(block, axis=1, bitorder="little")
+
+
+def pack_obstacles(obstacles):
+    """a bool per cell -> a bit per cell, each row's first cell in the low bit of its first byte"""
+    return np.packbits(obstacles, axis=1, bitorder="little")
+
+
+class Environment:
+    """the map. only the tick each cell was last searched is stored; its coverage level,
+    1 - decay_rate * age down to 0, is worked out when asked for, so a tick costs what the drones
+    stamp and not the whole grid. last_seen is a view into an array with `reach` cells of padding
+    all round (two more for a frontier's neighbours, see planner.py; rounded up to whole bytes), so
+    every search square is one (2r+1)^2 window of it, never cut by the edge.
+
+    sized for big maps: last_seen is uint16, the tick relative to `base` (0: never), and obstacles
+    are a bit per cell. the array starts all zero, so the pages of it no drone has reached are never
+    allocated by the OS - only the part of a 16k x 16k map that has been flown over costs memory.
+    with `backing` a file path it is memory-mapped to that (sparse) file instead, for maps that
+    would not fit in RAM once searched"""
+
+    def __init__(self, grid_size=GRID_SIZE, obstacles=None, decay_rate=DECAY_RATE, reach=REACH,
+                 backing=None):
+        n = self.grid_size = grid_size
+        self.decay_rate = decay_rate
+        self.reach = reach
+        pad = self._pad = -(-(reach + 2) // 8) * 8
+        side = n + 2 * pad
+        if backing is None:
+            self._last_seen = np.zeros((side, side), np.uint16)
+        else:
+            self._last_seen = np.memmap(backing, np.uint16, "w+", shape=(side, side))
+        inner = slice(pad, pad + n)
+        self.last_seen = self._last_seen[inner, inner]  # tick - base a cell was last under a drone, 0: never
+        self.base = 0
+        # obstacles, 1 bit per cell, set on the padding too. a bytearray so blocked() is plain python
+        if obstacles is None:
+            packed = np.zeros((n, (n + 7) // 8), np.uint8)
+        elif obstacles.dtype == bool:
+            packed = pack_obstacles(obstacles)
+        else:
+            packed = obstacles  # already a bit per cell (pack_obstacles())
+        self._row_bytes = side // 8 + 8  # room for the 8 bytes read from a square's first one
+        self._bits = bytearray(b"\xff") * (side * self._row_bytes)
+        self._blocked = np.frombuffer(self._bits, np.uint8).reshape(side, self._row_bytes)
+        self._row_bits = 8 * self._row_bytes
+        self._origin = pad * self._row_bits + pad  # bit of cell (0, 0)
+        self._blocked[inner, pad // 8:pad // 8 + packed.shape[1]] = packed
+        if n % 8:
+            self._blocked[inner, pad // 8 + packed.shape[1] - 1] |= 0xFF << (n % 8) & 0xFF
+        off_map = n * (8 * self._row_bytes - n)  # padding bits in the map's rows
+        self.free_cells = n * n - (popcount(self._blocked[inner]) - off_map)
+        self.tick = 0
+        # coverage_sum() keeps a count and tick sum of the free cells that still have coverage; they
+        # drop out fade ticks after being searched, found from the free cells last seen at each tick,
+        # by tick % len: a ring longer than fade, or all of TICK_SPAN for slow or no decay
+        self.fade = max(1, math.ceil(1 / decay_rate)) if decay_rate > 0 else 1 << 30
+        self._recent = np.zeros(min(1 << (self.fade + 1).bit_length(), TICK_SPAN), np.int64)
+        self._live = 0        # free cells with coverage left (with no decay: every searched one)
+        self._live_ticks = 0  # the sum of the ticks they were last searched at
+        self._windows = {}  # radius -> sliding window views of the padded arrays
+
+    def blocked(self, y, x):
+        """1 if cell (x, y) of the map is an obstacle, else 0"""
+        i = y * self._row_bits + x + self._origin
+        return self._bits[i >> 3] >> (i & 7) & 1
+
+    def row(self, y, x0, x1):
+        """cells x0:x1 of row y as an int, x's bit being row >> (x - x0) & 1"""
+        i = y * self._row_bits + self._origin + x0
+        return int.from_bytes(self._bits[i >> 3:(i + x1 - x0 + 7) >> 3], "little") >> (i & 7)
+
+    @property
+    def obstacles(self):
+        """the obstacle map as a bool per cell. O(grid): for drawing"""
+        n, pad = self.grid_size, self._pad
+        return np.unpackbits(self._blocked[pad:pad + n], axis=1, count=pad + n, bitorder="little")[:, pad:].astype(bool)
+
+    def set_obstacles(self, y0, y1, x0, x1, value=1):
+        """blocks (or with value=0 frees) cells x0:x1 of rows y0:y1 of the map"""
+        n, pad = self.grid_size, self._pad
+        y0, y1, x0, x1 = max(0, y0), min(n, y1), max(0, x0), min(n, x1)
+        if y0 >= y1 or x0 >= x1:
+            return
+        rows = self._blocked[y0 + pad:y1 + pad]
+        before = popcount(rows)
+        if not value:
+            # stamp() writes the tick into obstacle cells too: a freed one starts out never searched
+            b0 = (x0 + pad) >> 3
+            was = np.unpackbits(rows[:, b0:(x1 + pad + 7) >> 3], axis=1, bitorder="little")
+            was = was[:, x0 + pad - 8 * b0:x1 + pad - 8 * b0].astype(bool)
+            self.last_seen[y0:y1, x0:x1][was] = 0
+        fill_bits(rows, 0, y1 - y0, x0 + pad, x1 + pad, value)
+        self.free_cells -= popcount(rows) - before
+
+    def decay(self):
+        """one tick on. nothing is touched: the coverage levels follow from the tick"""
+        self.tick += 1
+        n = len(self._recent)
+        if self.fade <= n:  # the ones searched fade ticks ago are at 0 now
+            gone = int(self._recent[(self.tick - self.fade) % n])
+            self._live -= gone
+            self._live_ticks -= gone * (self.tick - self.fade)
+        self._recent[self.tick % n] = 0  # held the ones a whole ring ago
+        if self.tick - self.base >= TICK_SPAN:
+            self._rebase()
+
+    def _rebase(self):
+        """moves base on half a span, so last_seen keeps fitting in uint16. once every 16k ticks.
+        a cell not searched for longer than that is put at base + 1: its coverage is long 0 either
+        way, but a revisit gap that long comes out short"""
+        half = TICK_SPAN // 2
+        # the counts follow: every tick up to base + half still in the ring moves to base + half + 1
+        n, to = len(self._recent), self.base + half + 1
+        ticks = np.arange(max(self.base + 1, self.tick - n + 1), to)
+        if len(ticks):
+            counts = self._recent[ticks % n]
+            self._recent[ticks % n] = 0
+            self._recent[to % n] += counts.sum()
+            live = ticks > self.tick - self.fade
+            joined = int(counts[~live].sum()) if self.tick - to < self.fade else 0
+            self._live += joined
+            self._live_ticks += int((counts[live] * (to - ticks[live])).sum()) + joined * to
+        for i in range(0, len(self._last_seen), 256):
+            rows = self._last_seen[i:i + 256]
+            old = (rows != 0) & (rows <= half)
+            np.subtract(rows, half, out=rows, where=rows > half)
+            rows[old] = 1
+        self.base += half
+
+    @property
+    def coverage(self):
+        """every cell's coverage level now: 1 when under a drone this tick, fading by decay_rate
+        a tick since, 0 for never and on obstacles. O(grid): for drawing and summaries"""
+        last = self.last_seen.astype(np.int32)
+        level = 1.0 - self.decay_rate * (self.tick - self.base - last)
+        level[(last == 0) | self.obstacles] = 0
+        return np.maximum(level, 0, out=level)
+
+    def coverage_sum(self):
+        """sum of coverage(), from the running totals: O(1), not O(grid). the cells with coverage
+        left are at 1 - decay_rate * (tick - t) each; with no decay, all at 1"""
+        if not self.decay_rate:
+            return float(self._live)
+        return self._live - self.decay_rate * (self._live * self.tick - self._live_ticks)
+
+    def windows(self, radius):
+        w = self._windows.get(radius)
+        if w is None:
+            if radius > self.reach:
+                raise ValueError(f"search area {radius} is wider than the map's padding ({self.reach})")
+            if radius > 28:
+                raise ValueError(f"search area {radius} is wider than 28, the most a row's 64 bits of obstacles hold")
+            k = 2 * radius + 1
+            w = self._windows[radius] = (sliding_window_view(self._blocked, (k, 8)),
+                                         sliding_window_view(self._last_seen, (k, k), writeable=True))
+        return w
+
+    def stamp(self, xs, ys, radius, track=True, found=None):
+        """marks the (2r+1)^2 square around every (x, y) as searched this tick, all drones in one
+        go: a block copy per drone. returns, for each free cell that had been out of sight since
+        before the last tick, how many ticks it had been (0 if never searched), each cell once.
+        track=False only marks: faster, but coverage_sum() no longer adds up. `found`, an int
+        array a slot per square, gets each square's never-searched cells added to it"""
+        blocked, last_seen = self.windows(radius)
+        k = 2 * radius + 1
+        y0 = np.asarray(ys) + (self._pad - radius)  # window origins
+        x0 = np.asarray(xs) + (self._pad - radius)
+        now = self.tick - self.base
+        if not track:
+            last_seen[y0, x0] = now
+            return None
+        if len(x0) * k * k > TICK_SPAN:  # more cells than rank codes (below): half the squares at a time
+            half = len(x0) // 2
+            fa, fb = (None, None) if found is None else (found[:half], found[half:])
+            return np.concatenate([self.stamp(xs[:half], ys[:half], radius, found=fa),
+                                   self.stamp(xs[half:], ys[half:], radius, found=fb)])
+        # obstacle cells: each row of a square as the 64 bits from the byte it starts in, shifted
+        # down to its first cell and unpacked
+        rows = np.right_shift(blocked[y0, x0 >> 3].view("<u8"), (x0 & 7)[:, None, None],
+                              dtype=np.uint64, casting="unsafe")
+        blocked_cells = np.unpackbits(rows.astype("<u8", copy=False).view(np.uint8), axis=-1,
+                                      count=k, bitorder="little")
+        # a cell under two squares is in both blocks: the last block written to it keeps it
+        before = last_seen[y0, x0]
+        rank = _RANKS[:before.size].reshape(before.shape)
+        last_seen[y0, x0] = rank
+        seen = (last_seen[y0, x0] == rank) > blocked_cells
+        last_seen[y0, x0] = now  # obstacle cells too; they never count
+        if found is not None:
+            found += np.count_nonzero(seen & (before == 0), axis=(1, 2))
+        stored = before[seen & (before != now)]  # (not already stamped this tick by another group)
+        # move the cells from the tick they were last seen at to this one
+        recent = len(self._recent)
+        kept = stored[stored > max(0, now - recent)].astype(np.int64)
+        self._recent -= np.bincount((kept + self.base) & (recent - 1), minlength=recent)
+        self._recent[self.tick % recent] += len(stored)
+        live = stored[stored > max(0, now - self.fade)]
+        self._live += len(stored) - len(live)
+        self._live_ticks += len(stored) * self.tick - int(live.sum(dtype=np.int64)) - len(live) * self.base
+        unseen = now - stored
+        unseen[stored == 0] = 0
+        return unseen[unseen != 1]
+
+
+class Drone:
+    def __init__(self, env, start_x, start_y, x_start, x_end, type, speed=1, search_area=1):
+        self.env = env
+        self.x = start_x
+        self.y = start_y
+        self.x_start = x_start
+        self.x_end = x_end
+        self.speed = speed
+        self.search_area = search_area
+        self.dir = 1  # start moving right
+        self.stuck = False  # an obstacle ahead and below: it will not move again
+        self.blocked = 0    # times it got stuck
+        self.row = env.row(start_y, x_start, x_end)  # obstacle bits of its strip on the row it is on
+
+    def step(self):
+        self.env.stamp([self.x], [self.y], self.search_area)
+        self.move()
+
+    def move(self):
+        next_x = self.x + self.dir * self.speed
+        if self.x_start <= next_x < self.x_end and not self.row >> (next_x - self.x_start) & 1:
+            self.x = next_x
+        else:
+            next_y = self.y + max(1, self.search_area * 2)
+            if next_y < self.env.grid_size and not self.env.blocked(next_y, self.x):
+                self.y = next_y
+                self.dir *= -1
+                self.row = self.env.row(next_y, self.x_start, self.x_end)
+            elif next_y < self.env.grid_size:
+                self.blocked += not self.stuck
+                self.stuck = True
+
+
+def generate_obstacles(grid_size, num_obstacles, rng=random, packed=False):
+    """random rectangles, as a bool per cell or (packed) a bit per cell as pack_obstacles() makes"""
+    if packed:
+        obstacles = np.zeros((grid_size, (grid_size + 7) // 8), dtype=np.uint8)
+    else:
+        obstacles = np.zeros((grid_size, grid_size), dtype=bool)
+    for _ in range(num_obstacles):
+        x, y = rng.randint(0, grid_size-10), rng.randint(0, grid_size-10)
+        w, h = rng.randint(5, 15), rng.randint(5, 15)
+        if packed:
+            fill_bits(obstacles, y, y+h, x, min(x+w, grid_size))
+        else:
+            obstacles[y:y+h, x:x+w] = True
+    return obstacles
+
+
+def create_drones(env, swarm_size, speed, radius):
+    drones = []
+    if (swarm_size>1):
+        type = "swarm"
+    else:
+        type = "single"
+    strip_width = env.grid_size // swarm_size
+    for i in range(swarm_size):
+        x_start = i * strip_width
+        x_end = (i+1) * strip_width if i < swarm_size-1 else env.grid_size
+        drones.append(Drone(env, x_start, 0, x_start, x_end,
+                            type=type, speed=speed, search_area=radius))
+    return drones
+
+
+class Simulation:
+    """one environment and its drones, stepped a tick at a time"""
+
+    def __init__(self, obstacles, swarm_size, speed, radius, decay_rate=DECAY_RATE, backing=None,
+                 planner="strips"):
+        if planner not in PLANNERS:
+            raise ValueError(f"unknown planner {planner!r}, one of {PLANNERS}")
+        self.env = Environment(obstacles.shape[0], obstacles, decay_rate, reach=radius, backing=backing)
+        self.drones = create_drones(self.env, swarm_size, speed, radius)
+        self.planner = None
+        if planner != "strips":
+            self.planner = FrontierPlanner(self.env, self.drones, "greedy" if planner == "frontier-greedy" else "bfs")
+        self.groups = {}  # search_area -> its drones, stamped together
+        self._slots = {}  # search_area -> where its drones are in self.drones
+        for i, d in enumerate(self.drones):
+            self.groups.setdefault(d.search_area, []).append(d)
+            self._slots.setdefault(d.search_area, []).append(i)
+        self.found = None  # set to an int array a slot per drone to have each tick's never-searched cells per drone in it (comms.py)
+        self.free = self.env.free_cells
+        self.searched = 0          # cells searched at least once
+        self.coverage_sum = 0.0    # of mean coverage level over the free cells, per tick
+        self.revisits = 0
+        self.revisit_gap_sum = 0   # ticks unseen before each revisit
+        self.revisit_gap_max = 0
+        self.reached = {}          # searched fraction threshold -> first tick at or above it
+
+    @property
+    def tick(self):
+        return self.env.tick
+
+    def step(self):
+        env = self.env
+        env.decay()
+        # stamping only reads obstacles, so every drone can stamp before any of them moves
+        if self.found is not None:
+            self.found[:] = 0
+        for r, group in self.groups.items():
+            found = np.zeros(len(group), np.int64) if self.found is not None else None
+            unseen = env.stamp([d.x for d in group], [d.y for d in group], r, found=found)
+            if found is not None:
+                self.found[self._slots[r]] = found
+            gaps = unseen[unseen > 0]
+            self.searched += len(unseen) - len(gaps)
+            if len(gaps):
+                self.revisits += len(gaps)
+                self.revisit_gap_sum += int(gaps.sum())
+                self.revisit_gap_max = max(self.revisit_gap_max, int(gaps.max()))
+        if self.planner:
+            self.planner.step()
+        else:
+            for d in self.drones:
+                d.move()
+        self.coverage_sum += env.coverage_sum() / self.free
+
+    def set_obstacles(self, y0, y1, x0, x1, value=1):
+        """blocks (or with value=0 frees) cells x0:x1 of rows y0:y1 while the search runs"""
+        self.env.set_obstacles(y0, y1, x0, x1, value)
+        self.free = self.env.free_cells
+        for d in self.drones:
+            d.row = self.env.row(d.y, d.x_start, d.x_end)
+            d.stuck = False  # it may have a way on now
+        if self.planner:
+            self.planner.obstacles_changed(y0, y1, x0, x1)
+
+    def searched_fraction(self):
+        return self.searched / self.free
+
+    def run(self, ticks, thresholds=()):
+        """steps `ticks` times, noting when each searched fraction in `thresholds` is first reached"""
+        pending = sorted(thresholds)
+        for _ in range(ticks):
+            self.step()
+            while pending and self.searched_fraction() >= pending[0]:
+                self.reached[pending.pop(0)] = self.tick
+        return self
+
+    def stats(self):
+        """stuck: drones that cannot move on now (strips at an obstacle, frontier drones shut in);
+        blocked: the places drones got stuck at on the way, however they got going again"""
+        return dict(ticks=self.tick, searched=round(self.searched_fraction(), 4),
+                    mean_coverage=round(self.coverage_sum / max(1, self.tick), 4),
+                    revisits=self.revisits,
+                    revisit_gap_mean=round(self.revisit_gap_sum / self.revisits, 1) if self.revisits else None,
+                    revisit_gap_max=self.revisit_gap_max,
+                    stuck=len(self.planner.trapped) if self.planner else sum(d.stuck for d in self.drones),
+                    blocked=self.planner.blocked if self.planner else sum(d.blocked for d in self.drones))
@@ -65,22 +65,21 @@ def make_obstacles(count, rng_seed=None):
             mask[circle] = True
     return mask
 
-def coverage_update_from_drone(coverage, obstacle_mask, x, y):
-    # mark grid cells within SENSOR_RADIUS around (x,y) as fully covered (value=1)
-    r = SENSOR_RADIUS
-    minx = max(0, int(math.floor(x - r)))
-    maxx = min(GRID_SIZE-1, int(math.ceil(x + r)))
-    miny = max(0, int(math.floor(y - r)))
-    maxy = min(GRID_SIZE-1, int(math.ceil(y + r)))
-    for iy in range(miny, maxy+1):
-        for ix in range(minx, maxx+1):
-            if obstacle_mask[iy, ix]:
-                continue
-            # center of cell at (ix+0.5, iy+0.5)
-            cx = ix + 0.5
-            cy = iy + 0.5
-            if (cx - x)**2 + (cy - y)**2 <= r*r:
-                coverage[iy, ix] = 1.0
+_REACH = np.arange(-int(math.ceil(SENSOR_RADIUS)) - 1, int(math.ceil(SENSOR_RADIUS)) + 2)  # cells around a drone's own
+
+def coverage_update_from_drones(coverage, obstacle_mask, xs, ys):
+    # mark grid cells within SENSOR_RADIUS around every (x,y) as fully covered (value=1), all drones at once
+    xs = np.asarray(xs, dtype=float)[:, None, None]
+    ys = np.asarray(ys, dtype=float)[:, None, None]
+    ix = np.floor(xs).astype(int) + _REACH[None, None, :]
+    iy = np.floor(ys).astype(int) + _REACH[None, :, None]
+    # center of cell at (ix+0.5, iy+0.5)
+    near = ((ix + 0.5 - xs)**2 + (iy + 0.5 - ys)**2 <= SENSOR_RADIUS**2) \
+        & (ix >= 0) & (ix < GRID_SIZE) & (iy >= 0) & (iy < GRID_SIZE)
+    iy, ix = np.broadcast_arrays(iy, ix)
+    iy, ix = iy[near], ix[near]
+    free = ~obstacle_mask[iy, ix]
+    coverage[iy[free], ix[free]] = 1.0
 
 # -------------------- Drone class --------------------
 class Drone:
@@ -183,11 +182,11 @@ class Simulation:
         # advance simulation by dt
         # single drone
         self.single_drone.step(self.speed, dt)
-        coverage_update_from_drone(self.coverage_single, self.obstacle_mask, self.single_drone.x, self.single_drone.y)
-        # swarm
+        coverage_update_from_drones(self.coverage_single, self.obstacle_mask, [self.single_drone.x], [self.single_drone.y])
+        # swarm: every drone moves, then all of them mark their coverage in one go
         for d in self.swarm:
             d.step(self.speed, dt)
-            coverage_update_from_drone(self.coverage_swarm, self.obstacle_mask, d.x, d.y)
+        coverage_update_from_drones(self.coverage_swarm, self.obstacle_mask, [d.x for d in self.swarm], [d.y for d in self.swarm])
         # decay coverage
         self.coverage_single *= DECAY_FACTOR
         self.coverage_swarm *= DECAY_FACTOR